@@ -39,6 +39,13 @@ make > /dev/null
 DATA_PATH=~/cs50/labs/lab5/crawler/data
 INDEX_FILE=index.dat
 NEW_INDEX_FILE=new_index.dat
+TEXT_FILE=index.txt
+PARALLEL_INDEX_FILE=parallel_index.dat
+BUDGET_INDEX_FILE=budget_index.dat
+POSITIONS_INDEX_FILE=positions_index.dat
+POSITIONS_BUDGET_INDEX_FILE=positions_budget_index.dat
+FOLLOW_DIR=follow_data
+FOLLOW_INDEX_FILE=follow_index.dat
 
 # Build Indexer
 # ./indexer ~/cs50/labs/lab5/crawler/data index.dat new_index.dat
@@ -153,21 +160,21 @@ touch $NEW_INDEX_FILE
 
 # Good output
 echo "GOOD OUTPUT." >> IndexerTestlog.$filename
-echo "The first 4 lines of the index files will be printed to show how the files should look like." >> IndexerTestlog.$filename
+echo "The index files are binary, so the first 4 lines of the text export will be printed to show how the index should look like." >> IndexerTestlog.$filename
 printf "\n" >> IndexerTestlog.$filename
 
 
 # Case of 2 arguments passed.
 echo "Case of 2 arguments passed." >> IndexerTestlog.$filename
-echo "The program will create an index and save it to the file passed." >> IndexerTestlog.$filename
-echo "Input: ./indexer $DATA_PATH $INDEX_FILE" >> IndexerTestlog.$filename
+echo "The program will create an index, save it to the file passed, and export it as text." >> IndexerTestlog.$filename
+echo "Input: ./indexer -t $TEXT_FILE $DATA_PATH $INDEX_FILE" >> IndexerTestlog.$filename
 echo "Output: " >> IndexerTestlog.$filename
-./indexer $DATA_PATH $INDEX_FILE >> IndexerTestlog.$filename
+./indexer -t $TEXT_FILE $DATA_PATH $INDEX_FILE >> IndexerTestlog.$filename
 
 printf "\n" >> IndexerTestlog.$filename
-echo "Preview of $INDEX_FILE" >> IndexerTestlog.$filename
+echo "Preview of $TEXT_FILE" >> IndexerTestlog.$filename
 printf "\n" >> IndexerTestlog.$filename
-head -4 $INDEX_FILE >> IndexerTestlog.$filename # Print first 4 lines of file.
+head -4 $TEXT_FILE >> IndexerTestlog.$filename # Print first 4 lines of file.
 printf "\n" >> IndexerTestlog.$filename
 
 
@@ -179,14 +186,9 @@ echo "Output: " >> IndexerTestlog.$filename
 ./indexer $DATA_PATH $INDEX_FILE $NEW_INDEX_FILE >> IndexerTestlog.$filename
 
 printf "\n" >> IndexerTestlog.$filename
-echo "Preview of $INDEX_FILE" >> IndexerTestlog.$filename
+echo "Sizes of $INDEX_FILE and $NEW_INDEX_FILE" >> IndexerTestlog.$filename
 printf "\n" >> IndexerTestlog.$filename
-head -4 $INDEX_FILE >> IndexerTestlog.$filename # Print first 4 lines of file.
-printf "\n" >> IndexerTestlog.$filename
-
-echo "Preview of $NEW_INDEX_FILE" >> IndexerTestlog.$filename
-printf "\n" >> IndexerTestlog.$filename
-head -4 $NEW_INDEX_FILE >> IndexerTestlog.$filename # Print first 4 lines of file.
+wc -c $INDEX_FILE $NEW_INDEX_FILE >> IndexerTestlog.$filename
 printf "\n\n" >> IndexerTestlog.$filename
 
 
@@ -205,11 +207,115 @@ else
 	echo "The two files are different!" >> IndexerTestlog.$filename
 fi
 
+# Case of -j 4.
+echo "Case of -j 4." >> IndexerTestlog.$filename
+echo "The program will build the index with 4 threads. It should be the same as the index built with one thread." >> IndexerTestlog.$filename
+echo "Input: ./indexer -j 4 $DATA_PATH $PARALLEL_INDEX_FILE" >> IndexerTestlog.$filename
+echo "Output: " >> IndexerTestlog.$filename
+touch $PARALLEL_INDEX_FILE
+./indexer -j 4 $DATA_PATH $PARALLEL_INDEX_FILE >> IndexerTestlog.$filename
+
+printf "\n" >> IndexerTestlog.$filename
+printf "Test output: " >> IndexerTestlog.$filename
+FILE_CMP=`diff -q $INDEX_FILE $PARALLEL_INDEX_FILE` 
+if [ "$FILE_CMP" = "" ]
+then
+	echo "The two files are the same!" >> IndexerTestlog.$filename
+else
+	echo "The two files are different!" >> IndexerTestlog.$filename
+fi
+
+# Case of -m 2.
+echo "Case of -m 2." >> IndexerTestlog.$filename
+echo "The program will build the index in sorted runs of about 2 MB and merge them. It should be the same as the index built in memory." >> IndexerTestlog.$filename
+echo "Input: ./indexer -m 2 $DATA_PATH $BUDGET_INDEX_FILE" >> IndexerTestlog.$filename
+echo "Output: " >> IndexerTestlog.$filename
+touch $BUDGET_INDEX_FILE
+./indexer -m 2 $DATA_PATH $BUDGET_INDEX_FILE >> IndexerTestlog.$filename
+
+printf "\n" >> IndexerTestlog.$filename
+printf "Test output: " >> IndexerTestlog.$filename
+FILE_CMP=`diff -q $INDEX_FILE $BUDGET_INDEX_FILE` 
+if [ "$FILE_CMP" = "" ]
+then
+	echo "The two files are the same!" >> IndexerTestlog.$filename
+else
+	echo "The two files are different!" >> IndexerTestlog.$filename
+fi
+
+# Case of -u with no change to TARGET_DIRECTORY.
+echo "Case of -u with no change." >> IndexerTestlog.$filename
+echo "The program will find no new or changed documents, so the index should be left as it is." >> IndexerTestlog.$filename
+echo "Input: ./indexer -u $DATA_PATH $INDEX_FILE" >> IndexerTestlog.$filename
+echo "Output: " >> IndexerTestlog.$filename
+./indexer -u $DATA_PATH $INDEX_FILE >> IndexerTestlog.$filename
+
+printf "\n" >> IndexerTestlog.$filename
+printf "Test output: " >> IndexerTestlog.$filename
+FILE_CMP=`diff -q $INDEX_FILE $BUDGET_INDEX_FILE` 
+if [ "$FILE_CMP" = "" ] && [ ! -e $INDEX_FILE.seg1 ]
+then
+	echo "The index is unchanged!" >> IndexerTestlog.$filename
+else
+	echo "The index changed!" >> IndexerTestlog.$filename
+fi
+
+# Case of -p.
+echo "Case of -p." >> IndexerTestlog.$filename
+echo "The program will build the index with positions, then again with 4 threads in runs of about 2 MB. The two should be the same." >> IndexerTestlog.$filename
+echo "Input: ./indexer -p $DATA_PATH $POSITIONS_INDEX_FILE" >> IndexerTestlog.$filename
+echo "Input: ./indexer -p -j 4 -m 2 $DATA_PATH $POSITIONS_BUDGET_INDEX_FILE" >> IndexerTestlog.$filename
+echo "Output: " >> IndexerTestlog.$filename
+touch $POSITIONS_INDEX_FILE $POSITIONS_BUDGET_INDEX_FILE
+./indexer -p $DATA_PATH $POSITIONS_INDEX_FILE >> IndexerTestlog.$filename
+./indexer -p -j 4 -m 2 $DATA_PATH $POSITIONS_BUDGET_INDEX_FILE >> IndexerTestlog.$filename
+
+printf "\n" >> IndexerTestlog.$filename
+printf "Test output: " >> IndexerTestlog.$filename
+FILE_CMP=`diff -q $POSITIONS_INDEX_FILE $POSITIONS_BUDGET_INDEX_FILE` 
+if [ "$FILE_CMP" = "" ]
+then
+	echo "The two files are the same!" >> IndexerTestlog.$filename
+else
+	echo "The two files are different!" >> IndexerTestlog.$filename
+fi
+
+# Case of -f with a crawler writing to TARGET_DIRECTORY.
+echo "Case of -f." >> IndexerTestlog.$filename
+echo "The program will index 10 documents, then the 10 more written while it runs, until it is interrupted." >> IndexerTestlog.$filename
+echo "Input: ./indexer -f $FOLLOW_DIR $FOLLOW_INDEX_FILE" >> IndexerTestlog.$filename
+echo "Output: " >> IndexerTestlog.$filename
+mkdir -p $FOLLOW_DIR
+cp $DATA_PATH/[1-9] $DATA_PATH/10 $FOLLOW_DIR
+touch $FOLLOW_INDEX_FILE
+./indexer -f $FOLLOW_DIR $FOLLOW_INDEX_FILE >> IndexerTestlog.$filename &
+FOLLOW_PID=$!
+sleep 2
+cp $DATA_PATH/1[1-9] $DATA_PATH/20 $FOLLOW_DIR
+sleep 8
+kill -INT $FOLLOW_PID
+wait $FOLLOW_PID
+
+printf "\n" >> IndexerTestlog.$filename
+printf "Test output: " >> IndexerTestlog.$filename
+if grep -q "^docs 20$" $FOLLOW_INDEX_FILE.manifest && [ -e $FOLLOW_INDEX_FILE.seg1 ]
+then
+	echo "The new documents were indexed into a new segment!" >> IndexerTestlog.$filename
+else
+	echo "The new documents were not indexed!" >> IndexerTestlog.$filename
+fi
+
 # Print build end time
 printf "\n\n" >> IndexerTestlog.$filename
 echo "Build End: `date`" >> IndexerTestlog.$filename
 
 # Cleanup
+rm -f $TEXT_FILE
+rm -f $PARALLEL_INDEX_FILE $PARALLEL_INDEX_FILE.manifest $PARALLEL_INDEX_FILE.docs
+rm -f $BUDGET_INDEX_FILE $BUDGET_INDEX_FILE.manifest $BUDGET_INDEX_FILE.docs
+rm -f $POSITIONS_INDEX_FILE $POSITIONS_INDEX_FILE.manifest $POSITIONS_INDEX_FILE.docs
+rm -f $POSITIONS_BUDGET_INDEX_FILE $POSITIONS_BUDGET_INDEX_FILE.manifest $POSITIONS_BUDGET_INDEX_FILE.docs
+rm -rf $FOLLOW_DIR $FOLLOW_INDEX_FILE $FOLLOW_INDEX_FILE.*
 make clean > /dev/null
 
 
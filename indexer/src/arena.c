@@ -0,0 +1,168 @@
+/* ========================================================================== */
+/* File: arena.c
+ *
+ * Project name: CS50 Tiny Search Engine
+ * Component name: Indexer
+ *
+ * This file includes the bump-pointer arena used to build the InvertedIndex.
+ * Please go to the top of each function for more detailed descriptions.
+ */
+/* ========================================================================== */
+#define _DEFAULT_SOURCE                      // MAP_ANONYMOUS
+
+// ---------------- Open Issues
+
+// ---------------- System includes e.g., <stdio.h>
+#include <string.h>                          // strlen, memcpy
+#include <sys/mman.h>                        // mmap, munmap
+
+// ---------------- Local includes  e.g., "file.h"
+#include "arena.h"                           // arena functionality
+
+// ---------------- Constant definitions
+
+// ---------------- Macro definitions
+#define ARENA_ALIGN 16                       // alignment of every allocation
+#define ALIGN_UP(X) (((X) + ARENA_ALIGN - 1) & ~((size_t)ARENA_ALIGN - 1))
+#define HEADER_SIZE ALIGN_UP(sizeof(ArenaBlock))
+
+// ---------------- Structures/Types
+
+// ---------------- Private variables
+
+// ---------------- Private prototypes
+static ArenaBlock *NewBlock(Arena *, size_t);
+
+
+void InitializeArena(Arena *arena) {
+	arena->head = NULL;
+	arena->reserved = 0;
+}
+
+
+/*
+ * ArenaAlloc - allocate zeroed memory from the arena.
+ * @arena: arena to allocate from.
+ * @size: number of bytes needed.
+ *
+ * Returns a pointer to the memory, NULL if a new block could not be mapped.
+ *
+ * Pseudocode:
+ *     1. Round the request up to the arena alignment.
+ *     2. If the current block does not have room, map a new block.
+ *     3. Bump the used counter of the block and return the old position.
+ */
+
+void *ArenaAlloc(Arena *arena, size_t size) {
+
+	size = ALIGN_UP(size);
+	ArenaBlock *block = arena->head;
+
+	// Map a new block if the current one is full.
+	if (block == NULL || block->size - block->used < size) {
+		if (!(block = NewBlock(arena, size))) {
+			return NULL;
+		}
+	}
+
+	void *ptr = (char *)block + HEADER_SIZE + block->used;
+	block->used += size;
+	return ptr; // Fresh anonymous pages are already zeroed.
+}
+
+
+char *ArenaStrdup(Arena *arena, const char *str) {
+	size_t len = strlen(str) + 1;
+	char *copy = ArenaAlloc(arena, len);
+
+	if (copy) {
+		memcpy(copy, str, len);
+	}
+	return copy;
+}
+
+
+/*
+ * FreeArena - unmap every block of the arena.
+ * @arena: arena to free.
+ *
+ * Pseudocode:
+ *     1. Walk the list of blocks, unmapping each one.
+ *     2. Reset the arena to its empty state.
+ */
+
+void FreeArena(Arena *arena) {
+	ArenaBlock *block = arena->head;
+
+	while (block != NULL) {
+		ArenaBlock *next = block->next;
+		munmap(block, HEADER_SIZE + block->size);
+		block = next;
+	}
+	InitializeArena(arena);
+}
+
+
+/*
+ * ArenaAdopt - move every block of from into arena.
+ * @arena: arena that takes ownership.
+ * @from: arena to empty.
+ *
+ * Pseudocode:
+ *     1. Find the last block of from.
+ *     2. Splice the blocks of from in behind the current block of arena, so
+ *        arena keeps filling the block it was filling before.
+ *     3. Reset from to its empty state.
+ */
+
+void ArenaAdopt(Arena *arena, Arena *from) {
+	ArenaBlock *tail = from->head;
+
+	if (tail == NULL) {
+		return;
+	}
+	while (tail->next != NULL) {
+		tail = tail->next;
+	}
+
+	if (arena->head == NULL) {
+		arena->head = from->head;
+	}
+	else {
+		tail->next = arena->head->next;
+		arena->head->next = from->head;
+	}
+	arena->reserved += from->reserved;
+	InitializeArena(from);
+}
+
+
+/*
+ * NewBlock - map a new block and make it the current block of the arena.
+ * @arena: arena that will own the block.
+ * @size: smallest allocation the block must be able to hold.
+ *
+ * Returns the new block, NULL if mmap failed.
+ *
+ * Requests larger than the default block size get a block of their own.
+ */
+
+static ArenaBlock *NewBlock(Arena *arena, size_t size) {
+	size_t total = HEADER_SIZE + size;
+
+	if (total < ARENA_BLOCK_SIZE) {
+		total = ARENA_BLOCK_SIZE;
+	}
+
+	ArenaBlock *block = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (block == MAP_FAILED) {
+		return NULL;
+	}
+
+	block->size = total - HEADER_SIZE;
+	block->used = 0;
+	block->next = arena->head;
+	arena->head = block;
+	arena->reserved += total;
+	return block;
+}
@@ -0,0 +1,94 @@
+/* ========================================================================== */
+/* File: arena.h
+ *
+ * Project name: CS50 Tiny Search Engine
+ * Component name: Indexer
+ *
+ * This file contains a bump-pointer arena allocator. Every node, word and
+ * posting of the InvertedIndex is carved out of a few large blocks, so the
+ * whole index is released with one munmap per block instead of one free per
+ * node.
+ *
+ */
+/* ========================================================================== */
+#ifndef ARENA_H
+#define ARENA_H
+
+// ---------------- Prerequisites e.g., Requires "math.h"
+#include <stddef.h>                          // size_t
+
+// ---------------- Constants
+#define ARENA_BLOCK_SIZE (1 << 20)           // default block size (1 MB)
+
+// ---------------- Structures/Types
+
+typedef struct ArenaBlock {
+  struct ArenaBlock *next;                   // previously filled block
+  size_t size;                               // usable bytes in the block
+  size_t used;                               // bytes handed out so far
+} ArenaBlock;
+
+typedef struct Arena {
+  ArenaBlock *head;                          // block currently being filled
+  size_t reserved;                           // total bytes mapped by the arena
+} Arena;
+
+// ---------------- Public Variables
+
+// ---------------- Prototypes/Macros
+
+/*
+ * InitializeArena - prepare an empty arena
+ * @arena: arena to initialize
+ *
+ * No memory is mapped until the first allocation.
+ */
+void InitializeArena(Arena *arena);
+
+/*
+ * ArenaAlloc - allocate zeroed memory from the arena
+ * @arena: arena to allocate from
+ * @size: number of bytes needed
+ *
+ * Returns a pointer aligned for any type, or NULL if no memory could be mapped.
+ * The memory is only released by FreeArena; there is no per-allocation free.
+ *
+ * Usage example:
+ * Arena arena;
+ * InitializeArena(&arena);
+ * WordNode *node = ArenaAlloc(&arena, sizeof(WordNode));
+ * ...
+ * FreeArena(&arena);
+ */
+void *ArenaAlloc(Arena *arena, size_t size);
+
+/*
+ * ArenaStrdup - copy a c-style string into the arena
+ * @arena: arena to allocate from
+ * @str: string to copy
+ *
+ * Returns the copy, or NULL if no memory could be mapped.
+ */
+char *ArenaStrdup(Arena *arena, const char *str);
+
+/*
+ * FreeArena - release every block owned by the arena
+ * @arena: arena to free
+ *
+ * All pointers handed out by the arena become invalid. The arena is left
+ * empty and may be reused without calling InitializeArena again.
+ */
+void FreeArena(Arena *arena);
+
+/*
+ * ArenaAdopt - move every block of one arena into another
+ * @arena: arena that takes ownership of the blocks
+ * @from: arena to empty; it is left initialized and can be reused
+ *
+ * Memory handed out by from stays where it is, so pointers into it remain
+ * valid and are released by FreeArena(arena). Used to combine the partial
+ * indexes built by several threads without copying any node.
+ */
+void ArenaAdopt(Arena *arena, Arena *from);
+
+#endif // ARENA_H
@@ -0,0 +1,205 @@
+/* ========================================================================== */
+/* File: docfile.c
+ *
+ * Project name: CS50 Tiny Search Engine
+ * Component name: Indexer
+ *
+ * This file includes the writer and the reader of the document table.
+ * Please go to the top of each function for more detailed descriptions.
+ */
+/* ========================================================================== */
+
+// ---------------- Open Issues
+
+// ---------------- System includes e.g., <stdio.h>
+#define _POSIX_C_SOURCE 200809L              // fstat, mmap
+#include <stdio.h>                           // FILE, fwrite, rename
+#include <stdlib.h>                          // malloc, free
+#include <string.h>                          // memcpy, strlen
+#include <fcntl.h>                           // open
+#include <unistd.h>                          // close
+#include <sys/mman.h>                        // mmap, munmap
+#include <sys/stat.h>                        // fstat
+
+// ---------------- Local includes  e.g., "file.h"
+#include "docfile.h"                         // document table functionality
+#include "indexfile.h"                       // Crc32, Reserve
+
+// ---------------- Constant definitions
+
+// ---------------- Macro definitions
+
+// ---------------- Structures/Types
+
+// ---------------- Private variables
+
+// ---------------- Private prototypes
+
+
+/*
+ * WriteDocFile - replace the document table of an index.
+ * @file_name: path of the document table.
+ * @manifest: manifest listing the documents.
+ *
+ * Returns 1 if successful, 0 if not.
+ *
+ * Pseudocode:
+ *     1. Make a DocRecord for every doc_id up to the largest one, with no document.
+ *     2. Fill in the record of every document of the manifest, and append its URL.
+ *     3. Write the header, the records and the URLs to file_name.tmp.
+ *     4. Rename it over file_name.
+ */
+
+int WriteDocFile(const char *file_name, const Manifest *manifest) {
+
+	DocsHeader header;
+	memset(&header, 0, sizeof(DocsHeader));
+	header.max_doc_id = manifest->num_docs ? manifest->docs[manifest->num_docs - 1].doc_id : 0;
+	header.num_docs = manifest->num_docs;
+
+	// Start with no document at any doc_id.
+	size_t num_records = (size_t)header.max_doc_id + 1;
+	DocRecord *records = (DocRecord *)calloc(num_records, sizeof(DocRecord));
+	unsigned char *urls = NULL;
+	size_t urls_cap = 0;
+	int ok = records != NULL;
+	for (size_t i = 0; ok && i < num_records; i++) {
+		records[i].url = NO_URL;
+	}
+
+	// Fill in the documents.
+	for (int i = 0; ok && i < manifest->num_docs; i++) {
+		const DocEntry *doc = &manifest->docs[i];
+		const char *url = doc->url ? doc->url : "";
+		size_t len = strlen(url) + 1;
+		DocRecord *record = &records[doc->doc_id];
+
+		ok = header.urls_size + len < NO_URL && Reserve(&urls, &urls_cap, header.urls_size + len);
+		if (ok) {
+			record->hash = doc->hash;
+			record->url = header.urls_size;
+			record->length = doc->length;
+			record->depth = doc->depth;
+			header.total_length += doc->length;
+			memcpy(urls + header.urls_size, url, len);
+			header.urls_size += len;
+		}
+	}
+
+	// Fill in the header.
+	memcpy(header.magic, DOCS_MAGIC, sizeof(header.magic));
+	header.version = DOCS_VERSION;
+	header.header_size = sizeof(DocsHeader);
+	header.urls_offset = sizeof(DocsHeader) + num_records * sizeof(DocRecord);
+	if (ok) {
+		header.records_crc = Crc32(0, records, num_records * sizeof(DocRecord));
+		header.urls_crc = Crc32(0, urls, header.urls_size);
+		header.header_crc = Crc32(0, &header, sizeof(DocsHeader));
+	}
+
+	// Write the table next to the old one, then replace it.
+	char *temp = (char *)malloc(strlen(file_name) + 5);
+	FILE *fp = NULL;
+	if (ok && temp) {
+		sprintf(temp, "%s.tmp", file_name);
+		fp = fopen(temp, "wb");
+	}
+	ok = ok && fp != NULL;
+	if (fp) {
+		ok = fwrite(&header, sizeof(DocsHeader), 1, fp) == 1 &&
+				fwrite(records, sizeof(DocRecord), num_records, fp) == num_records &&
+				(header.urls_size == 0 || fwrite(urls, 1, header.urls_size, fp) == header.urls_size);
+		ok = (fclose(fp) == 0) && ok && rename(temp, file_name) == 0;
+	}
+
+	// Cleanup.
+	free(records);
+	free(urls);
+	free(temp);
+	return ok;
+}
+
+
+/*
+ * OpenDocFile - map and validate a document table.
+ * @docs: document table to fill in.
+ * @file_name: path of the document table.
+ *
+ * Returns 1 if successful, 0 if not.
+ *
+ * Pseudocode:
+ *     1. Map the whole file read-only.
+ *     2. Check the magic, the version, the header checksum and the size of each section.
+ *     3. Check the records and the URLs against their checksums, and that every
+ *        record points at a URL.
+ */
+
+int OpenDocFile(DocFile *docs, const char *file_name) {
+
+	memset(docs, 0, sizeof(DocFile));
+
+	int fd = open(file_name, O_RDONLY);
+	if (fd < 0) {
+		return 0;
+	}
+
+	// Map the whole file.
+	struct stat st;
+	void *data = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(DocsHeader)) {
+		data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	}
+	close(fd); // The mapping stays valid.
+	if (data == MAP_FAILED) {
+		return 0;
+	}
+	docs->header = data;
+	docs->records = (const DocRecord *)((const char *)data + sizeof(DocsHeader));
+	docs->size = st.st_size;
+
+	// Check the header.
+	DocsHeader header;
+	memcpy(&header, data, sizeof(DocsHeader));
+	header.header_crc = 0;
+	size_t records_size = ((size_t)header.max_doc_id + 1) * sizeof(DocRecord);
+	if (memcmp(header.magic, DOCS_MAGIC, sizeof(header.magic)) != 0 || header.version != DOCS_VERSION ||
+			header.header_size != sizeof(DocsHeader) || Crc32(0, &header, sizeof(DocsHeader)) != docs->header->header_crc ||
+			header.urls_offset != sizeof(DocsHeader) + records_size ||
+			header.urls_offset + header.urls_size > docs->size) {
+		CloseDocFile(docs);
+		return 0;
+	}
+	docs->urls = (const char *)data + header.urls_offset;
+
+	// Check the sections. The last URL must be terminated, so none runs past the end.
+	if (Crc32(0, docs->records, records_size) != header.records_crc ||
+			Crc32(0, docs->urls, header.urls_size) != header.urls_crc ||
+			(header.urls_size && docs->urls[header.urls_size - 1] != '\0')) {
+		CloseDocFile(docs);
+		return 0;
+	}
+	for (uint32_t doc_id = 0; doc_id <= header.max_doc_id; doc_id++) {
+		if (docs->records[doc_id].url != NO_URL && docs->records[doc_id].url >= header.urls_size) {
+			CloseDocFile(docs);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+
+void CloseDocFile(DocFile *docs) {
+	if (docs->header) {
+		munmap((void *)docs->header, docs->size);
+	}
+	memset(docs, 0, sizeof(DocFile));
+}
+
+
+const DocRecord *GetDocRecord(const DocFile *docs, int doc_id) {
+	if (!docs->header || doc_id < 0 || (uint32_t)doc_id > docs->header->max_doc_id ||
+			docs->records[doc_id].url == NO_URL) {
+		return NULL;
+	}
+	return &docs->records[doc_id];
+}
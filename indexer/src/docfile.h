@@ -0,0 +1,120 @@
+/* ========================================================================== */
+/* File: docfile.h
+ *
+ * Project name: CS50 Tiny Search Engine
+ * Component name: Indexer
+ *
+ * This file contains the document table index.dat.docs, written by the
+ * indexer next to the manifest and mapped by the query engine, so results
+ * are shown without opening the crawled files.
+ *
+ * Layout (all integers little-endian):
+ *
+ *     DocsHeader
+ *     records    a DocRecord for every doc_id from 0 to max_doc_id
+ *     urls       the URL of every document, null terminated
+ *
+ * A doc_id is an index into the records, so a lookup is one array access.
+ * doc_ids with no document have a DocRecord whose url is NO_URL. The header
+ * also holds the total length of the collection, for BM25.
+ *
+ * Version 2 added total_length to the header.
+ *
+ */
+/* ========================================================================== */
+#ifndef DOCFILE_H
+#define DOCFILE_H
+
+// ---------------- Prerequisites e.g., Requires "math.h"
+#include <stdint.h>                          // fixed-width integers
+#include <stddef.h>                          // size_t
+#include "segments.h"                        // Manifest
+
+// ---------------- Constants
+#define DOCS_MAGIC "TSEDOCS"                 // first 8 bytes of every document table, null included
+#define DOCS_VERSION 2                       // bumped on every layout change
+#define NO_URL UINT32_MAX                    // url of a doc_id with no document
+
+// ---------------- Structures/Types
+
+typedef struct DocsHeader {
+  char magic[8];                             // DOCS_MAGIC
+  uint32_t version;                          // DOCS_VERSION
+  uint32_t header_size;                      // sizeof(DocsHeader)
+  uint32_t num_docs;                         // number of documents
+  uint32_t max_doc_id;                       // largest doc_id
+  uint64_t total_length;                     // number of words in all the documents
+  uint64_t urls_offset;                      // file offset of the URLs
+  uint64_t urls_size;                        // bytes of URLs
+  uint32_t records_crc;                      // CRC-32 of the DocRecords
+  uint32_t urls_crc;                         // CRC-32 of the URLs
+  uint32_t header_crc;                       // CRC-32 of the header, this field zeroed
+  uint32_t padding;                          // zero
+} DocsHeader;
+
+typedef struct DocRecord {
+  uint64_t hash;                             // FNV-1a hash of its file when indexed
+  uint32_t url;                              // offset of its URL in the URLs, NO_URL if no document
+  uint32_t length;                           // number of words in the document
+  uint32_t depth;                            // crawl depth of the page
+  uint32_t padding;                          // zero
+} DocRecord;
+
+typedef struct DocFile {
+  const DocsHeader *header;                  // validated header, NULL if not open
+  const DocRecord *records;                  // DocRecords, indexed by doc_id
+  const char *urls;                          // URLs
+  size_t size;                               // bytes mapped
+} DocFile;
+
+// ---------------- Public Variables
+
+// ---------------- Prototypes/Macros
+
+/*
+ * WriteDocFile - replace the document table of an index
+ * @file_name: path of the document table (see DocsName)
+ * @manifest: manifest listing every live document and its metadata
+ *
+ * Returns 1 if successful; otherwise, 0. The table is written to a temporary
+ * file and renamed over the old one.
+ */
+int WriteDocFile(const char *file_name, const Manifest *manifest);
+
+/*
+ * OpenDocFile - map and validate a document table
+ * @docs: document table to fill in; zeroed if not successful
+ * @file_name: path of the document table
+ *
+ * Returns 1 if successful; 0 if the file is missing, is not a document table,
+ * has the wrong version or fails a checksum.
+ *
+ * Usage example:
+ * DocFile docs;
+ * char *name = DocsName("index.dat");
+ * if (OpenDocFile(&docs, name)) {
+ *     const DocRecord *record = GetDocRecord(&docs, doc_id);
+ *     if (record) {
+ *         printf("%s\n", DocURL(&docs, record));
+ *     }
+ *     CloseDocFile(&docs);
+ * }
+ * free(name);
+ */
+int OpenDocFile(DocFile *docs, const char *file_name);
+
+void CloseDocFile(DocFile *docs);
+
+/*
+ * GetDocRecord - look up a document
+ *
+ * Returns its DocRecord, or NULL if the table is not open or has no such document.
+ */
+const DocRecord *GetDocRecord(const DocFile *docs, int doc_id);
+
+/*
+ * DocURL - URL of a document returned by GetDocRecord
+ */
+#define DocURL(docs, record) ((docs)->urls + (record)->url)
+
+#endif // DOCFILE_H
@@ -25,18 +25,21 @@
 // ---------------- Constant definitions
 
 // ---------------- Macro definitions
-#define MAX 100000
+
 // ---------------- Structures/Types
 
 // ---------------- Private variables
 
 // ---------------- Private prototypes
 int AddWord(char *, int, HashTable *);
+DocumentNode *AddOccurrence(char *, int, HashTable *);
 int InHashTable(char *, HashTable *);
 int CleanHashTable(HashTable *);
 int InitializeHashTable(HashTable *);
 int FreeHashTable(HashTable *);
+int MergeHashTable(HashTable *, HashTable *, int, int);
 void NormalizeWord(char *);
+static DocumentNode *MergeDocuments(DocumentNode *, DocumentNode *);
 
 
 // Function to compute the hash code for a given string.
@@ -67,20 +70,35 @@ unsigned long JenkinsHash(const char *str, unsigned long mod)
  * @Index: pointer to the InvertedIndex.
  *
  * Returns 1 if successful, 0 if not.
+ */
+
+int AddWord(char *WORD, int doc_ID, HashTable *Index) {
+	return AddOccurrence(WORD, doc_ID, Index) != NULL;
+}
+
+
+/*
+ * AddOccurrence - adds a word to the InvertedIndex, as AddWord.
+ * @WORD: word to be added.
+ * @doc_ID: doc_ID of the doc in which the word was found.
+ * @Index: pointer to the InvertedIndex.
+ *
+ * Returns the DocumentNode of the word and the document, NULL if not successful.
  *
  * Assumptions:
  *     1. InvertedIndex has been initialized.
+ *     2. Documents are added in increasing doc_id order.
  *
  * Pseudocode:
  *     1. Compute the hash code.
  *     2. Check if the word already exists in the InvertedIndex.
- *     3. If it does, then see if there is a matching DocumentNode. Increment frequency if found.
- *     4. If there is no matching DocumentNode, create a new one and add to the InvertedIndex.
+ *     3. If it does, then see if its last DocumentNode matches. Increment frequency if so.
+ *     4. If there is no matching DocumentNode, create a new one and add to the end of the list.
  *     5. If the word does not exist in the InvertedIndex, create a new WordNode and add to the InvertedIndex.
  *
  */
  
-int AddWord(char *WORD, int doc_ID, HashTable *Index) {
+DocumentNode *AddOccurrence(char *WORD, int doc_ID, HashTable *Index) {
 	
 	NormalizeWord(WORD);
 	unsigned long index = JenkinsHash(WORD, MAX_HASH_SLOT); // Get the hash code.
@@ -90,7 +108,7 @@ int AddWord(char *WORD, int doc_ID, HashTable *Index) {
 	
 	// Check that the word is valid.
 	if (!WORD) {
-		return 0;
+		return NULL;
 	}
 	
 	// Check if the word already exists.
@@ -103,47 +121,47 @@ int AddWord(char *WORD, int doc_ID, HashTable *Index) {
 			current = current->next;
 		}
 		
-		DocumentNode *ptr; // ptr for traversal
-		// Search if the WordNode has the matching DocumentNode.
-		for (ptr = current->page; ptr->next != NULL; ptr = ptr->next) {
-			// Check whether the correct DocumentNode is in the index or not.
-			if (ptr->doc_id == doc_ID) {
-				ptr->freq++; // Increment frequency if match is found.
-				return 1;
-			}
-		}
+		// Documents arrive in doc_id order, so only the last DocumentNode can match.
+		DocumentNode *ptr = current->last;
 		if (ptr->doc_id == doc_ID) {
 			ptr->freq++; // Increment frequency if match is found.
-			return 1;
+			return ptr;
 		}
 		
 		// There is no matching DocumentNode, so create a new DocumentNode.
 		DocumentNode *doc_node;
-		doc_node = (DocumentNode *)calloc(1, sizeof(DocumentNode));
+		doc_node = (DocumentNode *)ArenaAlloc(&Index->arena, sizeof(DocumentNode));
+		if (!doc_node) {
+			return NULL;
+		}
 		doc_node->doc_id = doc_ID;
 		doc_node->freq = 1;
 		
-		ptr->next = doc_node; // Add this DocumentNode to the list of DocumentNodes.
-		return 1;
+		ptr->next = doc_node; // Add this DocumentNode to the end of the list of DocumentNodes.
+		current->last = doc_node;
+		return doc_node;
 	}
 	
 	// Word does not exist in the Index.
 	
 	// Create and initialize a new WordNode.
-	node = (WordNode *)calloc(1, sizeof(WordNode));
+	node = (WordNode *)ArenaAlloc(&Index->arena, sizeof(WordNode));
 	if (!node) {
-		return 0;
+		return NULL;
 	}
-	node->word = (char *)malloc(strlen(WORD)+1);
+	node->word = ArenaStrdup(&Index->arena, WORD);
 	if (!node->word) {
-		return 0;
+		return NULL;
 	}
-	strcpy(node->word, WORD);
 	
 	// Add a DocumentNode to the WordNode. 
-	node->page = (DocumentNode *)calloc(1, sizeof(DocumentNode));
+	node->page = (DocumentNode *)ArenaAlloc(&Index->arena, sizeof(DocumentNode));
+	if (!node->page) {
+		return NULL;
+	}
 	node->page->doc_id = doc_ID;
 	node->page->freq = 1;
+	node->last = node->page;
 	
 	// Case when there is no WordNode in the bin.
 	if (Index->table[index]->data == NULL) {
@@ -154,7 +172,7 @@ int AddWord(char *WORD, int doc_ID, HashTable *Index) {
 		for(current = Index->table[index]->data; current->next != NULL; current = current->next);
 		current->next = node; // Set the new WordNode as the last element of the list.
 	}
-	return 1;
+	return node->page;
 }
 
 
@@ -196,70 +214,111 @@ int InHashTable(char *WORD, HashTable *Index) {
 }
 
 /*
- * CleanHashTable - frees all WordNodes and DocumentNodes in the InvertedIndex.
- * @Index: pointer to the InvertedIndex.
+ * MergeHashTable - moves the WordNodes of a range of bins from one InvertedIndex into another.
+ * @Index: pointer to the InvertedIndex to merge into.
+ * @Part: pointer to a partial InvertedIndex, built over other documents.
+ * @lo: first bin to merge.
+ * @hi: one past the last bin to merge.
  *
- * Returns 0 at program termination.
+ * Returns 1 after function is run.
  *
  * Assumptions:
- *     1. InvertedIndex has been initialized.
+ *     1. Both InvertedIndexes use the same hash, so a word sits in the same bin in both.
+ *     2. Each list of DocumentNodes is sorted by doc_id, and no document is in both InvertedIndexes.
+ *     3. No other thread touches bins lo to hi of either InvertedIndex meanwhile.
  *
  * Pseudocode:
- *     1. Loop through the entire InvertedIndex.
- *     2. Add WordNode and word pointers to arrays of WordNode and word pointers.
- *     3. Add DocumentNode pointers of each WordNode to array of DocumentNode pointers.
- *     4. Looping backwards through the three arrays, free the content in them.
+ *     1. Take each WordNode out of the bins of Part.
+ *     2. If the word is already in the same bin of Index, merge the two lists of
+ *        DocumentNodes by doc_id.
+ *     3. Else, move the WordNode to the front of the bin of Index.
  *
+ * No node is copied; the nodes stay in the arena of Part, so the caller must hand
+ * that arena over with ArenaAdopt before releasing it.
  */
 
-int CleanHashTable(HashTable *Index) {
-	
-	// Variable for traversal.
-	WordNode *current; 
+int MergeHashTable(HashTable *Index, HashTable *Part, int lo, int hi) {
 	
-	// Loop through the entire InvertedIndex.
-	for (int index=0; index < MAX_HASH_SLOT; index++) {
-		WordNode *wn_ptr[100] = {0}; // Array to hold pointers to WordNodes.
-		char *word_ptr[100] = {0}; // Array to hold pointers to words of WordNodes.
-		DocumentNode *dn_ptr[MAX] = {0}; // Array to hold pointers to DocumentNodes.
-		
-		int i=0; // counter for wn_ptr and word_ptr.
+	for (int index=lo; index < hi; index++) {
+		WordNode *node = Part->table[index]->data;
+		Part->table[index]->data = NULL;
 		
-		// Check that the bin is not empty.
-		if (Index->table[index]->data != NULL) {
-			DocumentNode *ptr;
-			// Loop through each WordNode of the bin.
-			for(current = Index->table[index]->data; current != NULL; current = current->next) {
+		while (node != NULL) {
+			WordNode *next = node->next;
+			WordNode *current; // node ptr for traversal
 			
-				// Add WordNode and its word pointer to the respective arrays.
-				wn_ptr[i] = current;
-				word_ptr[i] = current->word;
-				
-				int j = 0; // counter for dn_ptr.
-				// Loop through each document node of the word node.
-				for (ptr = current->page; ptr != NULL; ptr = ptr->next) {
-					dn_ptr[j] = ptr;
-					j++;
+			// Look for the word in the same bin of Index.
+			for (current = Index->table[index]->data; current != NULL; current = current->next) {
+				if (strcmp(current->word, node->word) == 0) {
+					break;
 				}
-				j--; // Decrement to account for the increment when program exits the for loop.
-				
-				// Loop through the dn_ptr backwards.
-				for (int k=j; k >=0; k--) {
-					free(dn_ptr[k]); // Free memory allocated to the document nodes.
+			}
+			
+			if (current != NULL) {
+				current->page = MergeDocuments(current->page, node->page);
+				if (node->last->doc_id > current->last->doc_id) {
+					current->last = node->last;
 				}
-				i++;
 			}
-			i--; // Offset the final i increment.
+			else {
+				node->next = Index->table[index]->data;
+				Index->table[index]->data = node;
+			}
+			node = next;
 		}
-		
-		// Loop through the word_ptr, wn_ptr arrays backwards.
-		for (int m=i; m>=0; m--) {
-			free(word_ptr[m]); // Free memory allocated to char *word in the WordNode.
-			free(wn_ptr[m]); // Free memory allocated to the WordNode.
+	}
+	return 1;
+}
+
+
+/*
+ * MergeDocuments - merges two lists of DocumentNodes sorted by doc_id into one.
+ */
+
+static DocumentNode *MergeDocuments(DocumentNode *a, DocumentNode *b) {
+	DocumentNode head = {0};
+	DocumentNode *tail = &head;
+	
+	while (a != NULL && b != NULL) {
+		if (a->doc_id < b->doc_id) {
+			tail->next = a;
+			a = a->next;
 		}
-		
-		Index->table[index]->data = NULL; // Make sure the data isn't pointing to any WordNode.
+		else {
+			tail->next = b;
+			b = b->next;
+		}
+		tail = tail->next;
 	}
+	tail->next = (a != NULL) ? a : b;
+	return head.next;
+}
+
+
+/*
+ * CleanHashTable - frees all WordNodes and DocumentNodes in the InvertedIndex.
+ * @Index: pointer to the InvertedIndex.
+ *
+ * Returns 0 at program termination.
+ *
+ * Assumptions:
+ *     1. InvertedIndex has been initialized.
+ *
+ * Pseudocode:
+ *     1. Empty every bin of the InvertedIndex.
+ *     2. Release the arena, which owns every WordNode, word and DocumentNode.
+ *
+ * The InvertedIndex is left empty and can be filled again.
+ */
+
+int CleanHashTable(HashTable *Index) {
+	
+	// Make sure no bin points into the arena anymore.
+	for (int index=0; index < MAX_HASH_SLOT; index++) {
+		Index->table[index]->data = NULL;
+	}
+	
+	FreeArena(&Index->arena); // One munmap per arena block.
 	return 0;
 }
 
@@ -310,5 +369,6 @@ int InitializeHashTable(HashTable *Index) {
 		Index->table[i] = (HashTableNode *)calloc(1, sizeof(HashTableNode)); // Initialize the hash table node.
 		Index->table[i]->data = NULL; // Set the void * data to NULL for the node.
 	}
+	InitializeArena(&Index->arena); // Nodes are drawn from the arena as words are added.
 	return 0;
 }
\ No newline at end of file
@@ -12,6 +12,7 @@
 #define HASHTABLE_H
 
 // ---------------- Prerequisites e.g., Requires "math.h"
+#include "arena.h"                           // arena functionality
 
 // ---------------- Constants
 #define MAX_HASH_SLOT 10000                  // number of "buckets"
@@ -22,12 +23,14 @@ typedef struct DocumentNode {
   struct DocumentNode *next;         // pointer to the next member of the list.
   int doc_id;                        // document identifier
   int freq;                          // number of occurrences of the word
+  int *positions;                    // freq positions of the word in the document, NULL unless indexed with -p
 } DocumentNode;
 
 typedef struct WordNode {
   struct WordNode *next;            // pointer to the next word (for collisions)
   char *word;                       // the word
   DocumentNode *page;               // pointer to the first element of the page list.
+  DocumentNode *last;               // pointer to the last element of the page list.
 } WordNode;
 
 typedef struct HashTableNode {
@@ -36,6 +39,7 @@ typedef struct HashTableNode {
 
 typedef struct HashTable {
     HashTableNode *table[MAX_HASH_SLOT];     // actual index
+    Arena arena;                             // owns every WordNode, word and DocumentNode
 } HashTable;
 
 // ---------------- Public Variables
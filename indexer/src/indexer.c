@@ -6,9 +6,20 @@
  *
  * Input: A TARGET DIRECTORY of crawled webpages, a file to save the index to, and if passed,
  * 		  another file to recreate the index and save this new index to, for comparison.
+ * 		  Option -t TEXT_FILE also exports the index in the old text format.
+ * 		  Option -j N indexes the files with N threads.
+ * 		  Option -m MB keeps the in-memory index under MB megabytes by spilling sorted runs to disk.
+ * 		  Option -u only indexes the documents added or changed since the last build, into a new
+ * 		  segment of the index (see segments.h).
+ * 		  Option -f keeps running after the build and indexes the documents written to
+ * 		  TARGET DIRECTORY from then on, as with -u, until it is interrupted.
+ * 		  Option -p also stores the position of every word in each document, for phrase queries.
+ * 		  Option -s N splits the doc_ids into N ranges and builds an independent index for each,
+ * 		  index.dat.shard0 to index.dat.shard<N-1>, for "query --shards".
  *
  * Output: Outputs error messages if boundary cases are reached. Otherwise, there is no
  * 	       output, but instead the index is saved to the file(s) passed.
+ * 	       The index is saved in the binary format described in indexfile.h.
  *
  * Error Conditions: 1) Command line arguments are invalid.
  * 		     		 2) Memory cannot be allocated sufficiently.
@@ -27,34 +38,134 @@
 #include <ctype.h>			     // character functionality
 #include <unistd.h>			     // sleep functionality
 #include <stdlib.h> 			 // memory functionality
+#include <pthread.h>			     // thread functionality
+#include <signal.h>			     // sigaction
+#include <poll.h>			     // poll functionality
+#include <time.h>			     // time functionality
+#include <sys/inotify.h>		     // directory watch functionality
 // ---------------- Local includes  e.g., "file.h"
 #include "iweb.h"                             // web/html functionality
 #include "file.h"							 // file/dir functionality
 #include "ihashtable.h" 						 // hashtable functionality
+#include "indexfile.h" 						 // binary index functionality
+#include "runfile.h" 						 // sorted run functionality
+#include "segments.h" 						 // segment manifest functionality
+#include "docfile.h" 						 // document table functionality
 
 // ---------------- Constant definitions
 
 // ---------------- Macro definitions
 #define MAX 100000
+#define WORK_CHUNK 16                        // files a thread takes from the queue at a time
+#define MAX_THREADS 256                      // largest N accepted by -j
+#define FOLLOW_DELAY 5                       // seconds -f waits after a change before indexing
+#define MAX_SHARDS 64                        // largest N accepted by -s
+#define MAX_MERGE_RUNS 64                    // runs merged at once, each with an open file and buffer
 // ---------------- Structures/Types
 
+// Files still to be indexed, shared by the worker threads.
+typedef struct WorkQueue {
+	char **file_names;                       // files of TARGET_DIRECTORY, in doc_id order
+	DocEntry *entries;                       // metadata of each file, filled in as it is indexed
+	int num_files;                           // number of files
+	int next;                                // first file no thread has taken yet
+	pthread_mutex_t lock;                    // guards next
+} WorkQueue;
+
+// A worker thread and the partial InvertedIndex it builds.
+typedef struct Worker {
+	pthread_t thread;                        // the thread
+	WorkQueue *queue;                        // where it takes files from
+	HashTable Index;                         // partial InvertedIndex, touched by this thread only
+	int ok;                                  // 0 if a file could not be indexed
+} Worker;
+
+// A range of bins to merge from every partial InvertedIndex into the final one.
+typedef struct MergeJob {
+	pthread_t thread;                        // the thread
+	HashTable *Index;                        // final InvertedIndex
+	Worker *workers;                         // the partial InvertedIndexes
+	int num_workers;                         // number of workers
+	int lo;                                  // first bin of the range
+	int hi;                                  // one past the last bin of the range
+} MergeJob;
+
+// Deletion bitmaps being updated, one per live segment of the manifest.
+typedef struct Deletions {
+	unsigned char *bits[MAX_SEGMENTS];       // bitmap of each segment, by position in the manifest
+	size_t size[MAX_SEGMENTS];               // bytes of each bitmap
+	int changed[MAX_SEGMENTS];               // 1 once the bitmap is loaded and has to be written
+} Deletions;
+
 // ---------------- Private variables
 char *dir_path; 							 // passed directory path
 char *file; 								 // passed file path
 char *new_file; 							 // passed new file path
+char *text_file; 							 // passed text export path
+int num_docs; 								 // number of documents in the index
+int num_threads = 1; 						 // threads used to build the index
+size_t memory_budget; 						 // bytes the in-memory index may use, 0 for no limit
+int num_runs; 								 // number of sorted runs written so far
+pthread_mutex_t run_lock = PTHREAD_MUTEX_INITIALIZER; // guards num_runs
+int incremental; 							 // 1 to only index what changed since the last build
+int follow; 								 // 1 to keep indexing new documents until interrupted
+int positional; 							 // 1 to store the positions of the words
+int num_shards = 1; 						 // indexes the doc_ids are split into
+uint32_t *doc_lengths; 						 // length of each doc_id, for the blocks of postings
+uint32_t num_lengths; 						 // doc_ids in doc_lengths
+volatile sig_atomic_t stopping; 			 // set by SIGINT or SIGTERM in follow mode
 
 
 // ---------------- Private prototypes
-char *LoadDocument(char *);
+char *LoadDocument(char *, DocEntry *);
 int GetDocumentId (char *);
+int CompareFileNames(const void *, const void *);
+int IndexDocument(char *, HashTable *, DocEntry *);
+int AddPositions(DocumentNode **, int, HashTable *);
+int BuildIndex(char **, int, HashTable *, DocEntry *);
+void *IndexWorker(void *);
+void *MergeWorker(void *);
+int MergeHashTable(HashTable *, HashTable *, int, int);
+char *RunName(int);
+int FlushRun(HashTable *);
+int MergeRuns(char *);
+int MergeRunGroup(int, int, IndexWriter *, RunWriter *, FILE *);
+void RemoveRuns(int, int);
+void SiftDown(RunReader *, int *, int, int);
+int CompareRuns(RunReader *, int, int);
+int CompareDocIds(const void *, const void *);
+int GatherPostings(WordNode *, Posting **, size_t *, int **, size_t *);
+int SortPostings(Posting *, int, int *, size_t);
+int CompareKeys(const void *, const void *);
+char *DocumentPath(char *);
+int StatDocument(char *, long long *, long long *);
+int WriteFullManifest(char **, int, DocEntry *);
+int SetDocLengths(Manifest *, char **, int, DocEntry *);
+int PublishManifest(Manifest *);
+int UpdateSegments(char **, int, Manifest *, HashTable *);
+int MarkDeleted(Manifest *, Deletions *, int, int);
+int MergeSegments(Manifest *);
+int MergeSegmentGroup(Manifest *, int *, int);
+int Tier(int);
+int IndexDirectory(HashTable *);
+int BuildFullIndex(char **, int, HashTable *);
+int BuildShards(char **, int, HashTable *);
+int FollowDirectory(HashTable *);
+int WaitForChanges(int);
+void StopFollowing(int);
 int UpdateIndex(char *, int, HashTable *);
 int InitializeHashTable();
 int AddWord(char *, int, HashTable *);
+DocumentNode *AddOccurrence(char *, int, HashTable *);
 int InHashTable(char *, HashTable *);
+WordNode **GetSortedWords(HashTable *, int *);
+int CompareWords(const void *, const void *);
 int SaveIndexToFile(HashTable *, char *);
+int SaveIndexToText(HashTable *, char *);
 int CleanHashTable (HashTable *);
 int FreeHashTable(HashTable *);
 HashTable *ReadFile(char *, HashTable *);
+HashTable *ReadSegment(char *, HashTable *, unsigned char *, size_t);
 
 /* ========================================================================== */
 
@@ -62,6 +173,45 @@ int main (int argc, char *argv[]) {
 	
 	// Check arguments
 	
+	// Read in the options, then shift them out so argv[1] is the TARGET_DIRECTORY.
+	int arg = 1;
+	while (arg < argc && argv[arg][0] == '-') {
+		if (strcmp(argv[arg], "-t") == 0 && arg + 1 < argc) {
+			text_file = argv[arg + 1];
+			arg += 2;
+		}
+		else if (strcmp(argv[arg], "-j") == 0 && arg + 1 < argc &&
+				(num_threads = atoi(argv[arg + 1])) >= 1 && num_threads <= MAX_THREADS) {
+			arg += 2;
+		}
+		else if (strcmp(argv[arg], "-m") == 0 && arg + 1 < argc && atoi(argv[arg + 1]) >= 1) {
+			memory_budget = (size_t)atoi(argv[arg + 1]) << 20;
+			arg += 2;
+		}
+		else if (strcmp(argv[arg], "-u") == 0) {
+			incremental = 1;
+			arg++;
+		}
+		else if (strcmp(argv[arg], "-f") == 0) {
+			incremental = follow = 1;
+			arg++;
+		}
+		else if (strcmp(argv[arg], "-p") == 0) {
+			positional = 1;
+			arg++;
+		}
+		else if (strcmp(argv[arg], "-s") == 0 && arg + 1 < argc &&
+				(num_shards = atoi(argv[arg + 1])) >= 1 && num_shards <= MAX_SHARDS) {
+			arg += 2;
+		}
+		else {
+			printf("Usage: ./indexer [-t TEXT_FILE] [-j N] [-m MB] [-u] [-f] [-p] [-s N] TARGET_DIRECTORY index.dat [new_index.dat]\n");
+			return 1;
+		}
+	}
+	argc -= arg - 1;
+	argv += arg - 1;
+	
 	// Check that there are the correct number of arguments.
 	if (argc != 3 && argc != 4) {
 		printf("Please input the correct number of arguments.\n");
@@ -69,6 +219,18 @@ int main (int argc, char *argv[]) {
 	
 	}
 	
+	// An incremental build only writes a new segment, so there is no whole index to export or test.
+	if (incremental && (text_file || argc == 4)) {
+		printf("-u and -f cannot be combined with -t or new_index.dat.\n");
+		return 1;
+	}
+	
+	// Each shard is a whole index of its own, so there is no single index to update, export or test.
+	if (num_shards > 1 && (incremental || text_file || argc == 4)) {
+		printf("-s cannot be combined with -u, -f, -t or new_index.dat.\n");
+		return 1;
+	}
+	
 	// Check that the target directory exists.
 	if (!IsDir(argv[1])) {
 		printf("Please input a valid TARGET_DIRECTORY.\n");
@@ -89,7 +251,7 @@ int main (int argc, char *argv[]) {
 	FILE *fp;
 	fp = fopen(argv[2], "r+");
 	if (fp) {
-		if (fgetc(fp) != EOF) {
+		if (!incremental && fgetc(fp) != EOF) {
 			printf("index.dat is not empty. The contents will be overwritten.\n");
 		}
 	}
@@ -127,13 +289,25 @@ int main (int argc, char *argv[]) {
 	HashTable Index;
 	InitializeHashTable(&Index);
 	
-	// Get all file names in TARGET_DIRECTORY
-	char **file_names;
-	int num_files;
+	// With -f, index TARGET_DIRECTORY again every time files are written to it.
+	if (follow) {
+		int ok = FollowDirectory(&Index);
+		
+		// Cleanup.
+		FreeHashTable(&Index);
+		free(dir_path);
+		free(file);
+		if (!ok) {
+			printf("Error following TARGET_DIRECTORY.\n");
+			return 1;
+		}
+		printf("Done!\n");
+		return 0;
+	}
 	
-	num_files = GetFilenamesInDir(argv[1], &file_names);
+	// Build the index, or update it with -u.
+	int num_files = IndexDirectory(&Index);
 	if (num_files < 0) {
-		printf("Error getting file names from TARGET_DIRECTORY.\n");
 		return 1;
 	}
 	else if (num_files == 0) {
@@ -141,37 +315,6 @@ int main (int argc, char *argv[]) {
 		return 1;
 	}
 	
-	printf("Building Index!\n");
-	
-	// Declare variables for building the InvertedIndex.
-	char *doc;
-	char *word;
-	int doc_Id;
-	int pos;
-
-	// Loop through each html file.
-	for (int i = 0; i < num_files; i++) {
-		
-		doc = LoadDocument(file_names[i]); // Store html content into a string.
-		doc_Id = GetDocumentId(file_names[i]); // Get document_id.
-		
-		pos = 0; // Set the position to start of the document string.
-		
-		// Loop through a document string to get each word.
-		while ((pos = GetNextWord(doc, pos, &word)) > 0) {
-		
-			// Update the InvertedIndex for the specified word.
-			UpdateIndex(word, doc_Id, &Index);
-			free(word);
-		}
-		// Cleanup.
-		free(doc);
-		free(file_names[i]);
-	}
-	
-	SaveIndexToFile(&Index, file); // Save the built InvertedIndex to the target file.
-	CleanHashTable(&Index); // Free all memory associated with the Hash Table.
-	
 	printf("Done!\n");
 	
 	// If there are 3 args passed, recreate index and save to a new file for comparison.
@@ -179,7 +322,11 @@ int main (int argc, char *argv[]) {
 		printf("Testing!\n");
 		HashTable *ptr; // A new index pointer.
 		
-		ptr = ReadFile(file, &Index); // Read in from index.dat to create a new index.
+		// Read in from index.dat to create a new index.
+		if (!(ptr = ReadFile(file, &Index))) {
+			printf("Error reading the index back from %s.\n", file);
+			return 1;
+		}
 		SaveIndexToFile(ptr, new_file); // Save the recreated index to a new file, ie new_index.dat.
 		CleanHashTable(ptr); // Free all memory associated with the Hash Table.
 		
@@ -187,11 +334,11 @@ int main (int argc, char *argv[]) {
 	}
 	
 	// Cleanup.
-	free(file_names);
 	FreeHashTable(&Index); // Free all hashtablenodes.
 	free(dir_path);
 	free(file);
 	free(new_file);
+	free(doc_lengths);
 	return 0;
 
 }
@@ -203,17 +350,18 @@ int main (int argc, char *argv[]) {
 /*
  * LoadDocument - Load a document into a string.
  * @file_name: file to be loaded.
+ * @entry: filled in with the URL and the depth of the page.
  *
  * Returns the string of html if successful.
  * If not successful, returns NULL.
  *
  * Pseudocode:
  *     1. Get the full filename, complete with the directory.
- *     2. Set the position of the file to the start of the third line.
+ *     2. Read the URL from the first line and the depth from the second.
  *     3. Read each line and add to a string variable.
  */
 
-char *LoadDocument(char *file_name) {
+char *LoadDocument(char *file_name, DocEntry *entry) {
 
 	// Declare variables.
 	FILE *fp;
@@ -229,10 +377,23 @@ char *LoadDocument(char *file_name) {
 	
 	// Initialize variables.
 	fp = fopen(full_file_name, "r");
-	
-	// Set the position in the file to the third line.
-	for (int i=0; i < 2; i++) {
-		fgets(buf, MAX, fp);
+	if (!fp) {
+		free(full_file_name);
+		return NULL;
+	}
+
+	// Read the URL and the depth, which take up the first two lines.
+	if (fgets(buf, MAX, fp)) {
+		size_t len = strcspn(buf, " \t\r\n");
+		len = (len < MAX_URL_LENGTH) ? len : MAX_URL_LENGTH;
+		free(entry->url);
+		if ((entry->url = (char *)malloc(len + 1))) {
+			memcpy(entry->url, buf, len);
+			entry->url[len] = '\0';
+		}
+	}
+	if (fgets(buf, MAX, fp)) {
+		entry->depth = atoi(buf);
 	}
 	
 	html = (char *)calloc(1, 1);
@@ -269,6 +430,289 @@ int GetDocumentId (char *file_name) {
 	return id;
 }
 
+/*
+ * CompareFileNames - qsort compare function ordering file names by doc_id.
+ * @e1: element to compare.
+ * @e2: element to compare.
+ *
+ * Returns -1 if e1<e2, 1 if e1>e2, 0 if e1==e2.
+ */
+
+int CompareFileNames(const void *e1, const void *e2) {
+	int id1 = GetDocumentId(*(char **)e1);
+	int id2 = GetDocumentId(*(char **)e2);
+
+	return (id1 > id2) - (id1 < id2);
+}
+
+/*
+ * IndexDocument - adds every word of a document to the InvertedIndex.
+ * @file_name: file of TARGET_DIRECTORY to be indexed.
+ * @Index: pointer to the InvertedIndex.
+ * @entry: filled in with the URL, the depth and the number of words of the document.
+ *
+ * Returns 1 if successful, 0 if the file could not be loaded.
+ *
+ * Pseudocode:
+ *     1. Load the html of the file and get its doc_id.
+ *     2. Loop through the html to get each word, and update the InvertedIndex.
+ *     3. With -p, remember the DocumentNode of each word, and then give every
+ *        DocumentNode of the document its positions (see AddPositions).
+ */
+
+int IndexDocument(char *file_name, HashTable *Index, DocEntry *entry) {
+	
+	// Declare variables for building the InvertedIndex.
+	char *doc;
+	char *word;
+	int doc_Id;
+	int pos;
+	DocumentNode **nodes = NULL; // with -p, the DocumentNode of each word, in document order
+	size_t nodes_cap = 0; // bytes allocated for nodes
+	int ok = 1;
+	
+	doc = LoadDocument(file_name, entry); // Store html content into a string.
+	if (!doc) {
+		return 0;
+	}
+	doc_Id = GetDocumentId(file_name); // Get document_id.
+	
+	pos = 0; // Set the position to start of the document string.
+	
+	// Loop through a document string to get each word.
+	while ((pos = GetNextWord(doc, pos, &word)) > 0) {
+		
+		// Update the InvertedIndex for the specified word.
+		if (positional) {
+			DocumentNode *dn = AddOccurrence(word, doc_Id, Index);
+			ok = ok && dn && Reserve((unsigned char **)&nodes, &nodes_cap, (entry->length + 1) * sizeof(DocumentNode *));
+			if (ok) {
+				nodes[entry->length] = dn;
+			}
+		}
+		else {
+			UpdateIndex(word, doc_Id, Index);
+		}
+		entry->length++;
+		free(word);
+	}
+	if (positional && ok) {
+		ok = AddPositions(nodes, entry->length, Index);
+	}
+	
+	// Cleanup.
+	free(nodes);
+	free(doc);
+	return ok;
+}
+
+/*
+ * AddPositions - gives the DocumentNodes of a document the positions of their word.
+ * @nodes: the DocumentNode of each word of the document, in order.
+ * @num: number of words in the document.
+ * @Index: InvertedIndex whose arena holds the positions.
+ *
+ * Returns 1 if successful, 0 if memory could not be allocated.
+ *
+ * Pseudocode:
+ *     1. The first time a DocumentNode comes up, allocate its freq positions.
+ *     2. Append each position to the positions of its DocumentNode, moving them forward.
+ *     3. Walk the words back, moving the positions of each DocumentNode back to their start.
+ */
+
+int AddPositions(DocumentNode **nodes, int num, HashTable *Index) {
+	
+	for (int i = 0; i < num; i++) {
+		DocumentNode *dn = nodes[i];
+		if (!dn->positions && !(dn->positions = (int *)ArenaAlloc(&Index->arena, dn->freq * sizeof(int)))) {
+			return 0;
+		}
+		*dn->positions++ = i;
+	}
+	for (int i = num - 1; i >= 0; i--) {
+		nodes[i]->positions--;
+	}
+	return 1;
+}
+
+/*
+ * BuildIndex - builds the InvertedIndex of all the files, with num_threads threads.
+ * @file_names: files of TARGET_DIRECTORY, in doc_id order.
+ * @num_files: number of files.
+ * @Index: pointer to an empty InvertedIndex.
+ * @entries: zeroed metadata of each file, filled in as it is indexed (see IndexDocument).
+ *
+ * Returns 1 if successful, 0 if not successful.
+ *
+ * Pseudocode:
+ *     1. With one thread, index each file in order.
+ *     2. Else, start num_threads workers. Each takes WORK_CHUNK files at a time from a
+ *        shared queue and indexes them into its own partial InvertedIndex, with no locking.
+ *     3. Once every worker is done, split the bins into num_threads ranges and merge
+ *        each range of every partial InvertedIndex into Index in its own thread.
+ *     4. Hand the arenas of the partial InvertedIndexes over to Index.
+ *
+ * With a memory budget, an InvertedIndex that outgrows it (each worker gets an equal
+ * share) is written to a sorted run and emptied. If any run was written, whatever is
+ * left in memory is written as a run too, and Index is left empty for MergeRuns.
+ *
+ * Workers take chunks in doc_id order, so each partial InvertedIndex sees its
+ * documents in increasing doc_id order, as AddWord expects, and the merge only
+ * has to interleave sorted lists.
+ */
+
+int BuildIndex(char **file_names, int num_files, HashTable *Index, DocEntry *entries) {
+	
+	// Sequential case.
+	if (num_threads == 1) {
+		int ok = 1;
+		for (int i = 0; i < num_files; i++) {
+			ok = IndexDocument(file_names[i], Index, &entries[i]) && ok;
+			
+			// Spill the index to a sorted run once it outgrows the budget.
+			if (memory_budget && Index->arena.reserved >= memory_budget) {
+				ok = FlushRun(Index) && ok;
+			}
+		}
+		
+		// Once there are runs, the rest of the index has to become a run as well.
+		if (num_runs > 0) {
+			ok = FlushRun(Index) && ok;
+		}
+		return ok;
+	}
+	
+	WorkQueue queue = { file_names, entries, num_files, 0, PTHREAD_MUTEX_INITIALIZER };
+	Worker *workers = (Worker *)calloc(num_threads, sizeof(Worker));
+	MergeJob *jobs = (MergeJob *)calloc(num_threads, sizeof(MergeJob));
+	int started = 0;
+	int ok = 1;
+	
+	if (!workers || !jobs) {
+		free(workers);
+		free(jobs);
+		return 0;
+	}
+	
+	// Map phase: each worker builds a partial InvertedIndex.
+	for (started = 0; started < num_threads; started++) {
+		Worker *worker = &workers[started];
+		InitializeHashTable(&worker->Index);
+		worker->queue = &queue;
+		worker->ok = 1;
+		if (pthread_create(&worker->thread, NULL, IndexWorker, worker) != 0) {
+			FreeHashTable(&worker->Index);
+			ok = 0;
+			break;
+		}
+	}
+	for (int t = 0; t < started; t++) {
+		pthread_join(workers[t].thread, NULL);
+		ok = ok && workers[t].ok;
+	}
+	
+	// With runs on disk, every partial InvertedIndex becomes a run and MergeRuns does the merge.
+	if (num_runs > 0) {
+		for (int t = 0; t < started; t++) {
+			ok = ok && FlushRun(&workers[t].Index);
+			CleanHashTable(&workers[t].Index);
+			FreeHashTable(&workers[t].Index);
+		}
+		pthread_mutex_destroy(&queue.lock);
+		free(workers);
+		free(jobs);
+		return ok;
+	}
+	
+	// Merge phase: each thread owns a range of bins of every InvertedIndex.
+	int merging = 0;
+	for (merging = 0; ok && merging < num_threads; merging++) {
+		MergeJob *job = &jobs[merging];
+		job->Index = Index;
+		job->workers = workers;
+		job->num_workers = started;
+		job->lo = (long)MAX_HASH_SLOT * merging / num_threads;
+		job->hi = (long)MAX_HASH_SLOT * (merging + 1) / num_threads;
+		if (pthread_create(&job->thread, NULL, MergeWorker, job) != 0) {
+			ok = 0;
+			break;
+		}
+	}
+	for (int t = 0; t < merging; t++) {
+		pthread_join(jobs[t].thread, NULL);
+	}
+	
+	// The merged nodes still live in the arenas of the workers.
+	for (int t = 0; t < started; t++) {
+		if (ok) {
+			ArenaAdopt(&Index->arena, &workers[t].Index.arena);
+		}
+		else {
+			CleanHashTable(&workers[t].Index);
+		}
+		FreeHashTable(&workers[t].Index);
+	}
+	
+	// Cleanup.
+	pthread_mutex_destroy(&queue.lock);
+	free(workers);
+	free(jobs);
+	return ok;
+}
+
+/*
+ * IndexWorker - thread function indexing chunks of files into a partial InvertedIndex.
+ * @arg: pointer to the Worker.
+ *
+ * Returns NULL.
+ */
+
+void *IndexWorker(void *arg) {
+	Worker *worker = (Worker *)arg;
+	WorkQueue *queue = worker->queue;
+	
+	while (1) {
+		// Take the next chunk of files.
+		pthread_mutex_lock(&queue->lock);
+		int start = queue->next;
+		queue->next += WORK_CHUNK;
+		pthread_mutex_unlock(&queue->lock);
+		
+		if (start >= queue->num_files) {
+			break;
+		}
+		int end = (start + WORK_CHUNK < queue->num_files) ? start + WORK_CHUNK : queue->num_files;
+		for (int i = start; i < end; i++) {
+			if (!IndexDocument(queue->file_names[i], &worker->Index, &queue->entries[i])) {
+				worker->ok = 0;
+			}
+			
+			// Spill the partial index to a sorted run once it outgrows its share of the budget.
+			if (memory_budget && worker->Index.arena.reserved >= memory_budget / num_threads &&
+					!FlushRun(&worker->Index)) {
+				worker->ok = 0;
+			}
+		}
+	}
+	return NULL;
+}
+
+/*
+ * MergeWorker - thread function merging a range of bins of every partial InvertedIndex.
+ * @arg: pointer to the MergeJob.
+ *
+ * Returns NULL.
+ */
+
+void *MergeWorker(void *arg) {
+	MergeJob *job = (MergeJob *)arg;
+	
+	for (int t = 0; t < job->num_workers; t++) {
+		MergeHashTable(job->Index, &job->workers[t].Index, job->lo, job->hi);
+	}
+	return NULL;
+}
+
 /*
  * UpdateIndex - updates the InvertedIndex for each word of a document.
  * @word: word to be added to the InvertedIndex.
@@ -297,7 +741,61 @@ int UpdateIndex(char *word, int documentId, HashTable *Index) {
 }
 
 /*
- * SaveIndexToFile - outputs the InvertedIndex to a file.
+ * GetSortedWords - list the WordNodes of the InvertedIndex in word order.
+ * @Index: pointer to the InvertedIndex.
+ * @num: set to the number of WordNodes.
+ *
+ * Returns an array of WordNode pointers that the caller must free, NULL if not successful.
+ *
+ * Pseudocode:
+ *     1. Count the WordNodes in every bin.
+ *     2. Add each WordNode pointer to an array.
+ *     3. Sort the array by word.
+ */
+
+WordNode **GetSortedWords(HashTable *Index, int *num) {
+	WordNode *current; // variable for traversal
+	int n = 0;
+	
+	// Count the WordNodes.
+	for (int i=0; i < MAX_HASH_SLOT; i++) {
+		for (current = Index->table[i]->data; current != NULL; current = current->next) {
+			n++;
+		}
+	}
+	
+	WordNode **words = (WordNode **)malloc((n ? n : 1) * sizeof(WordNode *));
+	if (!words) {
+		return NULL;
+	}
+	
+	// Add the WordNodes to the array and sort it.
+	n = 0;
+	for (int i=0; i < MAX_HASH_SLOT; i++) {
+		for (current = Index->table[i]->data; current != NULL; current = current->next) {
+			words[n++] = current;
+		}
+	}
+	qsort(words, n, sizeof(WordNode *), CompareWords);
+	
+	*num = n;
+	return words;
+}
+
+/*
+ * CompareWords - qsort compare function ordering WordNodes by word.
+ * @e1: element to compare.
+ * @e2: element to compare.
+ *
+ * Returns the strcmp of the two words.
+ */
+
+int CompareWords(const void *e1, const void *e2) {
+	return strcmp((*(WordNode **)e1)->word, (*(WordNode **)e2)->word);
+}
+
+/*
+ * SaveIndexToFile - outputs the InvertedIndex to a binary index file.
  * @Index: pointer to the InvertedIndex.
  * @file_name: file to be written to.
  *
@@ -305,155 +803,1560 @@ int UpdateIndex(char *word, int documentId, HashTable *Index) {
  *
  * Assumptions:
  *     1. InvertedIndex has been initialized.
+ *     2. Each list of DocumentNodes is sorted by doc_id.
  *
  * Pseudocode:
- *     1. Check that the args are valid.
- *     2. Add the word to the Index.
+ *     1. Get the WordNodes in word order.
+ *     2. Copy the DocumentNodes of each WordNode into an array of postings (see GatherPostings).
+ *     3. Add the word and its postings to the index file.
  */
 
 int SaveIndexToFile(HashTable *Index, char *file_name) {
-	// Declare and open a stream to file_name.
-	FILE *fp;
-	fp = fopen(file_name, "w");
 	
-	WordNode *current; // variable for traversal
+	IndexWriter writer;
+	WordNode **words;
+	int num_words;
 	
-	// Loop through each bin of the Index.
-	for (int i=0; i < MAX_HASH_SLOT; i++) {
+	if (!(words = GetSortedWords(Index, &num_words))) {
+		return 0;
+	}
+	if (!OpenIndexWriter(&writer, file_name, positional ? INDEX_POSITIONS : 0)) {
+		free(words);
+		return 0;
+	}
+	writer.lengths = doc_lengths;
+	writer.num_lengths = num_lengths;
 	
-		// Loop through each Word Node, if it exists.
-		for (current = Index->table[i]->data; current != NULL; current = current->next) {
-			fprintf(fp, "%s", current->word); // Write word to file.
-			
-			DocumentNode *ptr; // variable for traversal
-			char arr[MAX]={0}; // variable to hold all information about the current word.
-			int num=0; // variable to get the number of docs the current word appears in.
-			
-			// Loop through each document node.
-			for (ptr = current->page; ptr != NULL; ptr = ptr->next) {
-				char arr2[10];
-				sprintf(arr2, "%d %d ", ptr->doc_id, ptr->freq);
-				strcat(arr, arr2); // Add doc_id, freq to arr.
-				
-				num++;
+	Posting *postings = NULL; // postings of the current word
+	size_t cap = 0; // bytes allocated for postings
+	int *positions = NULL; // positions of the current word, with -p
+	size_t positions_cap = 0; // bytes allocated for positions
+	int ok = 1;
+	
+	// Loop through each WordNode in word order.
+	for (int i=0; i < num_words && ok; i++) {
+		int num = GatherPostings(words[i], &postings, &cap, &positions, &positions_cap);
+		ok = num > 0 && AddIndexTerm(&writer, words[i]->word, postings, num, positions);
+	}
+	
+	// Cleanup.
+	if (ok) {
+		ok = CloseIndexWriter(&writer, num_docs);
+	}
+	else {
+		AbortIndexWriter(&writer);
+	}
+	free(postings);
+	free(positions);
+	free(words);
+	return ok;
+}
+
+
+/*
+ * GatherPostings - copies the DocumentNodes of a WordNode into an array of postings.
+ * @wn: the WordNode.
+ * @postings: array of postings, grown as needed.
+ * @cap: bytes allocated for *postings.
+ * @positions: with -p, array of the positions of each posting in turn, grown as needed.
+ * @positions_cap: bytes allocated for *positions.
+ *
+ * Returns the number of postings, 0 if memory could not be allocated or, with -p,
+ * a DocumentNode has no positions.
+ */
+
+int GatherPostings(WordNode *wn, Posting **postings, size_t *cap, int **positions, size_t *positions_cap) {
+	DocumentNode *ptr; // variable for traversal
+	size_t num_positions = 0;
+	int num = 0;
+	
+	for (ptr = wn->page; ptr != NULL; ptr = ptr->next) {
+		if (!Reserve((unsigned char **)postings, cap, (num + 1) * sizeof(Posting))) {
+			return 0;
+		}
+		(*postings)[num].doc_id = ptr->doc_id;
+		(*postings)[num].freq = ptr->freq;
+		num++;
+		
+		// Append the positions of the document.
+		if (positional) {
+			if (!ptr->positions ||
+					!Reserve((unsigned char **)positions, positions_cap, (num_positions + ptr->freq) * sizeof(int))) {
+				return 0;
 			}
-			
-			// Write information to file.
-			fprintf(fp, " %d", num);
-			fprintf(fp, " %s", arr);
-			fprintf(fp, "\n");
+			memcpy(*positions + num_positions, ptr->positions, ptr->freq * sizeof(int));
+			num_positions += ptr->freq;
 		}
 	}
-	fclose(fp);
-	return 1;
+	return num;
 }
 
 
 /*
- * ReadFile - Read from a file to create an InvertedIndex.
- * @file_name: file to be read.
- * @New_Index: pointer to an InvertedIndex to be created.
+ * SaveIndexToText - outputs the InvertedIndex to a file in text format.
+ * @Index: pointer to the InvertedIndex.
+ * @file_name: file to be written to.
  *
- * Returns a pointer to an InvertedIndex.
+ * Returns 1 if successful, 0 if not successful.
  *
- * Pseudocode:
- *     1. Read each line of file_name.
- *     2. Parse for the word and the number of docs the word appears in.
- *     3. Create a WordNode and add to the InvertedIndex.
- *     4. Loop through the rest of the line, parsing for doc_id and freq.
- *     5. Create a DocumentNode and add to the InvertedIndex.
+ * Each line of the file is "word num doc_id freq doc_id freq ...", with the
+ * words in sorted order.
  */
 
-HashTable *ReadFile(char *file_name, HashTable *New_Index) {
+int SaveIndexToText(HashTable *Index, char *file_name) {
 	
-	// Declare variables.
-	FILE *fp;
-	char *buf;
-	char *WORD; // word
-	char *num; // number of docs the word appears in.
-	char *ptr; // pointer referencing position in the current line.
+	WordNode **words;
+	int num_words;
 	
-	// Initialize variables.
-	fp = fopen(file_name, "r");
-	buf = (char *)malloc(MAX);
-	WORD = (char *)malloc(100);
-	num = (char *)malloc(10);
+	if (!(words = GetSortedWords(Index, &num_words))) {
+		return 0;
+	}
 	
-	// Read each line of file_name.
-	while (fgets(buf, MAX, fp) != NULL) {
-		
-		sscanf(buf, "%s %s", WORD, num);
-		ptr = buf + strlen(WORD) + strlen(num) + 2; // Update position.
-		
-		// Create and initialize new word node.
-		WordNode *wn;
-		wn = (WordNode *)calloc(1, sizeof(WordNode)); // Initialize a new WordNode.
-		wn->word = (char *)malloc(strlen(WORD) + 1);
-		strcpy(wn->word, WORD);
-		
-		unsigned long index = JenkinsHash(WORD, MAX_HASH_SLOT); // Get the hash code.
+	// Declare and open a stream to file_name.
+	FILE *fp;
+	if (!(fp = fopen(file_name, "w"))) {
+		free(words);
+		return 0;
+	}
+	
+	// Loop through each WordNode in word order.
+	for (int i=0; i < num_words; i++) {
+		DocumentNode *ptr; // variable for traversal
+		int num=0; // variable to get the number of docs the current word appears in.
 		
-		// Check that the bin is empty.
-		if (New_Index->table[index]->data == NULL) {
-			New_Index->table[index]->data = wn;
+		for (ptr = words[i]->page; ptr != NULL; ptr = ptr->next) {
+			num++;
 		}
-		else { // The bin is not empty.
-			WordNode *wn_ptr; // pointer for traversal.
-			
-			// Loop until the last wordnode.
-			for(wn_ptr = New_Index->table[index]->data; wn_ptr->next != NULL; wn_ptr = wn_ptr->next);
-			wn_ptr->next = wn; // Set the new WordNode as the last element of the WordNode list.
+		
+		// Write the word, the number of docs, and each doc_id, freq pair.
+		fprintf(fp, "%s %d ", words[i]->word, num);
+		for (ptr = words[i]->page; ptr != NULL; ptr = ptr->next) {
+			fprintf(fp, "%d %d ", ptr->doc_id, ptr->freq);
 		}
+		fprintf(fp, "\n");
+	}
+	
+	// Cleanup.
+	free(words);
+	return fclose(fp) == 0;
+}
 
-		// Loop while position in the line is less than or equal to the end of the line.
-		while (ptr <= buf + strlen(buf) - 2) { // -2 is to account for whitespace and newline char at the end.
-			
-			// Variables used for parsing to get the doc_id and freq.
-			char *number1, *number2;
-			int doc_id, freq;
-			
-			// Read in doc_id and freq as char *.
-			number1 = calloc(1, 10);
-			number2 = calloc(1, 10);
-			sscanf(ptr, "%s %s", number1, number2);
-			
-			// update position in the line.
-			ptr += strlen(number1) + strlen(number2) + 2;
-			
-			// Convert doc_id and freq from char* to int.
-			sscanf(number1, "%d", &doc_id);
-			sscanf(number2, "%d", &freq);
-			
-			// Create and initialize a DocumentNode.
-			DocumentNode *dn;
-			dn = (DocumentNode *)calloc(1, sizeof(DocumentNode));
-			dn->doc_id = doc_id;
-			dn->freq = freq;
-			
-			DocumentNode *dn_ptr; // pointer for traversal.
+
+/*
+ * RunName - makes the name of a sorted run file, which lives next to the index file.
+ * @run: number of the run.
+ *
+ * Returns the name, which the caller must free. NULL if memory could not be allocated.
+ */
+
+char *RunName(int run) {
+	char *name = (char *)malloc(strlen(file) + 32);
+	
+	if (name) {
+		sprintf(name, "%s.run%d", file, run);
+	}
+	return name;
+}
+
+/*
+ * FlushRun - writes the InvertedIndex to a new sorted run file, and empties it.
+ * @Index: pointer to the InvertedIndex.
+ *
+ * Returns 1 if successful, 0 if not successful.
+ *
+ * Assumptions:
+ *     1. Each list of DocumentNodes is sorted by doc_id.
+ *
+ * Pseudocode:
+ *     1. Take the next run number.
+ *     2. Write each word and its postings to the run, in word order.
+ *     3. Empty the InvertedIndex, which releases its arena.
+ */
+
+int FlushRun(HashTable *Index) {
+	
+	WordNode **words;
+	int num_words;
+	
+	if (!(words = GetSortedWords(Index, &num_words))) {
+		return 0;
+	}
+	
+	// Take the next run number.
+	pthread_mutex_lock(&run_lock);
+	int run = num_runs++;
+	pthread_mutex_unlock(&run_lock);
+	
+	RunWriter writer;
+	char *name = RunName(run);
+	int ok = name && OpenRunWriter(&writer, name);
+	free(name);
+	if (!ok) {
+		free(words);
+		return 0;
+	}
+	
+	Posting *postings = NULL; // postings of the current word
+	size_t cap = 0; // bytes allocated for postings
+	int *positions = NULL; // positions of the current word, with -p
+	size_t positions_cap = 0; // bytes allocated for positions
+	
+	// Loop through each WordNode in word order.
+	for (int i=0; i < num_words && ok; i++) {
+		int num = GatherPostings(words[i], &postings, &cap, &positions, &positions_cap);
+		ok = num > 0 && AddRunTerm(&writer, words[i]->word, postings, num, positional ? positions : NULL);
+	}
+	
+	// Cleanup.
+	ok = CloseRunWriter(&writer) && ok;
+	free(postings);
+	free(positions);
+	free(words);
+	CleanHashTable(Index);
+	return ok;
+}
+
+/*
+ * MergeRuns - merges all the sorted runs into the index file, then removes them.
+ * @file_name: index file to be written to.
+ *
+ * Returns 1 if successful, 0 if not successful.
+ *
+ * Pseudocode:
+ *     1. While more than MAX_MERGE_RUNS runs are left, merge the MAX_MERGE_RUNS oldest
+ *        ones into a new run and remove them, so no more than MAX_MERGE_RUNS files are
+ *        open at once however small the memory budget.
+ *     2. Merge the runs left into the index file (and the text export if asked to).
+ *     3. Remove the runs left.
+ */
+
+int MergeRuns(char *file_name) {
+	
+	int first = 0; // oldest run not merged yet
+	int ok = 1;
+	
+	// Merge the oldest runs into a new one while there are too many.
+	while (ok && num_runs - first > MAX_MERGE_RUNS) {
+		RunWriter run;
+		char *name = RunName(num_runs++);
+		ok = name && OpenRunWriter(&run, name);
+		free(name);
+		if (ok) {
+			ok = MergeRunGroup(first, MAX_MERGE_RUNS, NULL, &run, NULL);
+			ok = CloseRunWriter(&run) && ok;
+		}
+		RemoveRuns(first, MAX_MERGE_RUNS);
+		first += MAX_MERGE_RUNS;
+	}
+	
+	// Merge the runs left into the index file.
+	IndexWriter writer;
+	FILE *text = NULL;
+	ok = ok && OpenIndexWriter(&writer, file_name, positional ? INDEX_POSITIONS : 0);
+	int writing = ok;
+	if (writing) {
+		writer.lengths = doc_lengths;
+		writer.num_lengths = num_lengths;
+	}
+	if (ok && text_file && !(text = fopen(text_file, "w"))) {
+		ok = 0;
+	}
+	ok = ok && MergeRunGroup(first, num_runs - first, &writer, NULL, text);
+	
+	// Cleanup.
+	if (writing && ok) {
+		ok = CloseIndexWriter(&writer, num_docs);
+	}
+	else if (writing) {
+		AbortIndexWriter(&writer);
+	}
+	if (text) {
+		ok = (fclose(text) == 0) && ok;
+	}
+	RemoveRuns(first, num_runs - first);
+	num_runs = 0; // The next build starts its own runs.
+	return ok;
+}
+
+/*
+ * MergeRunGroup - merges a group of consecutive runs into the index file or into a run.
+ * @first: number of the first run of the group.
+ * @n: number of runs of the group.
+ * @writer: index file to be written to, NULL to write to run instead.
+ * @run: run to be written to, when writer is NULL.
+ * @text: text export to be written to as well, NULL if none.
+ *
+ * Returns 1 if successful, 0 if not successful. The runs are left on disk.
+ *
+ * Pseudocode:
+ *     1. Open every run and read its first word.
+ *     2. Keep the runs in a min-heap ordered by their current word, then by run number.
+ *     3. Pop every run whose current word is the smallest one, gathering its postings
+ *        and their positions, and advance it.
+ *     4. Sort the gathered postings by doc_id if the runs interleave, and add the word
+ *        to the index file or to the run (and to the text export if asked to).
+ *     5. Close the runs.
+ *
+ * Only the current word of each run is in memory, plus the dictionary kept by the
+ * IndexWriter.
+ */
+
+int MergeRunGroup(int first, int n, IndexWriter *writer, RunWriter *run, FILE *text) {
+	
+	RunReader *readers = (RunReader *)calloc(n > 0 ? n : 1, sizeof(RunReader));
+	int *heap = (int *)malloc((n > 0 ? n : 1) * sizeof(int));
+	int heap_size = 0;
+	int opened = 0;
+	int ok = readers && heap;
+	
+	// Open every run and read its first word.
+	for (opened = 0; ok && opened < n; opened++) {
+		char *name = RunName(first + opened);
+		ok = name && OpenRunReader(&readers[opened], name);
+		free(name);
+		if (!ok) {
+			break;
+		}
+		
+		int result = NextRunTerm(&readers[opened]);
+		if (result < 0) {
+			ok = 0;
+		}
+		else if (result > 0) {
+			heap[heap_size++] = opened;
+		}
+	}
+	for (int i = heap_size / 2 - 1; ok && i >= 0; i--) {
+		SiftDown(readers, heap, heap_size, i);
+	}
+	
+	char *word = NULL; // word being merged
+	size_t word_cap = 0; // bytes allocated for word
+	Posting *postings = NULL; // postings of the word
+	size_t cap = 0; // bytes allocated for postings
+	int *positions = NULL; // positions of the postings of the word, with -p
+	size_t positions_cap = 0; // bytes allocated for positions
+	
+	while (ok && heap_size > 0) {
+		
+		// Copy the smallest word, since its run moves on.
+		RunReader *top = &readers[heap[0]];
+		ok = Reserve((unsigned char **)&word, &word_cap, strlen(top->word) + 1);
+		if (!ok) {
+			break;
+		}
+		strcpy(word, top->word);
+		
+		// Gather the postings of the word from every run that has it.
+		int num = 0;
+		size_t num_positions = 0;
+		int sorted = 1;
+		while (ok && heap_size > 0 && strcmp(readers[heap[0]].word, word) == 0) {
+			top = &readers[heap[0]];
+			ok = Reserve((unsigned char **)&postings, &cap, (num + top->df) * sizeof(Posting));
+			if (!ok) {
+				break;
+			}
+			if (num > 0 && postings[num - 1].doc_id > top->postings[0].doc_id) {
+				sorted = 0;
+			}
+			memcpy(postings + num, top->postings, top->df * sizeof(Posting));
+			num += top->df;
+			if (positional) {
+				ok = Reserve((unsigned char **)&positions, &positions_cap, (num_positions + top->num_positions) * sizeof(int));
+				if (!ok) {
+					break;
+				}
+				memcpy(positions + num_positions, top->positions, top->num_positions * sizeof(int));
+				num_positions += top->num_positions;
+			}
 			
-			// Check if there is no document node associated with the word node.
-			if (wn->page == NULL) {
-				wn->page = dn;
+			// Advance the run, dropping it from the heap at its end.
+			int result = NextRunTerm(top);
+			if (result < 0) {
+				ok = 0;
+			}
+			else if (result == 0) {
+				heap[0] = heap[--heap_size];
+			}
+			SiftDown(readers, heap, heap_size, 0);
+		}
+		if (!ok) {
+			break;
+		}
+		
+		// Runs written by different threads interleave their doc_ids.
+		if (!sorted) {
+			ok = SortPostings(postings, num, positional ? positions : NULL, num_positions);
+		}
+		if (writer) {
+			ok = ok && AddIndexTerm(writer, word, postings, num, positions);
+		}
+		else {
+			ok = ok && AddRunTerm(run, word, postings, num, positional ? positions : NULL);
+		}
+		
+		// Export the word as text if asked to.
+		if (ok && text) {
+			fprintf(text, "%s %d ", word, num);
+			for (int i = 0; i < num; i++) {
+				fprintf(text, "%d %d ", postings[i].doc_id, postings[i].freq);
+			}
+			fprintf(text, "\n");
+		}
+	}
+	
+	// Cleanup.
+	for (int i = 0; i < opened; i++) {
+		CloseRunReader(&readers[i]);
+	}
+	free(word);
+	free(postings);
+	free(positions);
+	free(readers);
+	free(heap);
+	return ok;
+}
+
+/*
+ * RemoveRuns - removes the files of a group of consecutive runs.
+ * @first: number of the first run of the group.
+ * @n: number of runs of the group.
+ */
+
+void RemoveRuns(int first, int n) {
+	for (int i = first; i < first + n; i++) {
+		char *name = RunName(i);
+		if (name) {
+			remove(name);
+		}
+		free(name);
+	}
+}
+
+/*
+ * SiftDown - restores the heap order of the runs below position i.
+ * @readers: the runs.
+ * @heap: run numbers, ordered by CompareRuns.
+ * @size: number of runs in the heap.
+ * @i: position to start from.
+ */
+
+void SiftDown(RunReader *readers, int *heap, int size, int i) {
+	while (1) {
+		int smallest = i;
+		int left = 2 * i + 1;
+		int right = 2 * i + 2;
+		
+		if (left < size && CompareRuns(readers, heap[left], heap[smallest]) < 0) {
+			smallest = left;
+		}
+		if (right < size && CompareRuns(readers, heap[right], heap[smallest]) < 0) {
+			smallest = right;
+		}
+		if (smallest == i) {
+			return;
+		}
+		
+		int temp = heap[i];
+		heap[i] = heap[smallest];
+		heap[smallest] = temp;
+		i = smallest;
+	}
+}
+
+/*
+ * CompareRuns - orders two runs by their current word, then by run number.
+ *
+ * Returns a negative number if run a comes first, a positive number otherwise.
+ */
+
+int CompareRuns(RunReader *readers, int a, int b) {
+	int result = strcmp(readers[a].word, readers[b].word);
+	
+	return result ? result : a - b;
+}
+
+/*
+ * CompareDocIds - qsort compare function ordering postings by doc_id.
+ * @e1: element to compare.
+ * @e2: element to compare.
+ *
+ * Returns -1 if e1<e2, 1 if e1>e2, 0 if e1==e2.
+ */
+
+int CompareDocIds(const void *e1, const void *e2) {
+	int id1 = ((Posting *)e1)->doc_id;
+	int id2 = ((Posting *)e2)->doc_id;
+	
+	return (id1 > id2) - (id1 < id2);
+}
+
+/*
+ * SortPostings - sorts postings by doc_id, along with their positions.
+ * @postings: postings, each doc_id once.
+ * @num: number of postings.
+ * @positions: positions of each posting in turn, NULL if none.
+ * @num_positions: number of positions.
+ *
+ * Returns 1 if successful, 0 if memory could not be allocated.
+ *
+ * Pseudocode:
+ *     1. Without positions, sort the postings.
+ *     2. Otherwise, sort keys made of the doc_id and the place of each posting.
+ *     3. Copy the postings, and their positions, in the order of the keys.
+ */
+
+int SortPostings(Posting *postings, int num, int *positions, size_t num_positions) {
+	
+	if (!positions) {
+		qsort(postings, num, sizeof(Posting), CompareDocIds);
+		return 1;
+	}
+	
+	uint64_t *keys = (uint64_t *)malloc(num * sizeof(uint64_t));
+	size_t *starts = (size_t *)malloc(num * sizeof(size_t));
+	Posting *copy = (Posting *)malloc(num * sizeof(Posting));
+	int *moved = (int *)malloc(num_positions * sizeof(int) + 1);
+	int ok = keys && starts && copy && moved;
+	
+	if (ok) {
+		// Sort the places of the postings by doc_id.
+		size_t start = 0;
+		for (int i = 0; i < num; i++) {
+			keys[i] = (uint64_t)postings[i].doc_id << 32 | (uint32_t)i;
+			starts[i] = start;
+			start += postings[i].freq;
+			copy[i] = postings[i];
+		}
+		qsort(keys, num, sizeof(uint64_t), CompareKeys);
+		
+		// Move each posting and its positions to its place.
+		size_t out = 0;
+		for (int i = 0; i < num; i++) {
+			int j = (int)(keys[i] & UINT32_MAX);
+			postings[i] = copy[j];
+			memcpy(moved + out, positions + starts[j], copy[j].freq * sizeof(int));
+			out += copy[j].freq;
+		}
+		memcpy(positions, moved, num_positions * sizeof(int));
+	}
+	
+	// Cleanup.
+	free(keys);
+	free(starts);
+	free(copy);
+	free(moved);
+	return ok;
+}
+
+/*
+ * CompareKeys - qsort compare function for the keys of SortPostings.
+ */
+
+int CompareKeys(const void *e1, const void *e2) {
+	uint64_t k1 = *(const uint64_t *)e1;
+	uint64_t k2 = *(const uint64_t *)e2;
+	
+	return (k1 > k2) - (k1 < k2);
+}
+
+/*
+ * DocumentPath - makes the full path of a file of TARGET_DIRECTORY.
+ * @file_name: file name.
+ *
+ * Returns the path, which the caller must free. NULL if memory could not be allocated.
+ */
+
+char *DocumentPath(char *file_name) {
+	char *path = (char *)malloc(strlen(dir_path) + strlen(file_name) + 2);
+	
+	if (path) {
+		sprintf(path, "%s/%s", dir_path, file_name);
+	}
+	return path;
+}
+
+/*
+ * StatDocument - gets the modification time and size of a file of TARGET_DIRECTORY.
+ * @file_name: file name.
+ * @mtime: set to the modification time.
+ * @size: set to the size in bytes.
+ *
+ * Returns 1 if successful, 0 if the file cannot be stat'ed.
+ */
+
+int StatDocument(char *file_name, long long *mtime, long long *size) {
+	char *path = DocumentPath(file_name);
+	struct stat statbuf;
+	int ok = path && stat(path, &statbuf) == 0;
+	
+	if (ok) {
+		*mtime = statbuf.st_mtime;
+		*size = statbuf.st_size;
+	}
+	free(path);
+	return ok;
+}
+
+/*
+ * WriteFullManifest - writes the manifest of a full build, with index.dat as the only segment.
+ * @file_names: files of TARGET_DIRECTORY.
+ * @num_files: number of files.
+ * @entries: metadata gathered while indexing each file; their URLs are handed over.
+ *
+ * Returns 1 if successful, 0 if not successful.
+ *
+ * Pseudocode:
+ *     1. Record the mtime, size, hash and metadata of every file, all in segment 0.
+ *     2. Write the document table and the manifest.
+ *     3. Remove the segments and deletion bitmaps of an earlier build, which the
+ *        manifest no longer names.
+ */
+
+int WriteFullManifest(char **file_names, int num_files, DocEntry *entries) {
+	
+	Manifest manifest, old;
+	int had_manifest = ReadManifest(file, &old);
+	
+	// Record every file as part of segment 0.
+	InitializeManifest(&manifest);
+	manifest.num_segments = 1;
+	manifest.segments[0].id = 0;
+	manifest.segments[0].num_docs = num_files;
+	
+	int ok = 1;
+	for (int i = 0; i < num_files && ok; i++) {
+		DocEntry *doc = AddDoc(&manifest, GetDocumentId(file_names[i]));
+		char *path = DocumentPath(file_names[i]);
+		ok = doc && path && StatDocument(file_names[i], &doc->mtime, &doc->size);
+		if (ok) {
+			doc->segment = 0;
+			doc->hash = HashFile(path);
+			doc->length = entries[i].length;
+			doc->depth = entries[i].depth;
+			doc->url = entries[i].url;
+			entries[i].url = NULL;
+		}
+		free(path);
+	}
+	
+	ok = ok && PublishManifest(&manifest);
+	FreeManifest(&manifest);
+	
+	// Remove what is left of an earlier build.
+	if (had_manifest) {
+		for (int i = 0; i < old.num_segments && ok; i++) {
+			char *name = SegmentName(file, old.segments[i].id);
+			char *deleted = DeletedName(file, old.segments[i].id, old.segments[i].deleted_gen);
+			if (name && old.segments[i].id != 0) {
+				remove(name);
+			}
+			if (deleted && old.segments[i].deleted_gen > 0) {
+				remove(deleted);
+			}
+			free(name);
+			free(deleted);
+		}
+		FreeManifest(&old);
+	}
+	return ok;
+}
+
+/*
+ * SetDocLengths - records the length of every document, for the blocks of postings of the index file.
+ * @manifest: manifest whose documents are recorded, or NULL.
+ * @file_names: files that were indexed, or NULL.
+ * @num_files: number of files.
+ * @entries: metadata gathered while indexing each file.
+ *
+ * Returns 1 if successful, 0 if memory could not be allocated.
+ *
+ * Pseudocode:
+ *     1. Size doc_lengths to the largest doc_id of the manifest and of the files.
+ *     2. Record the length of each document of the manifest, then of each file.
+ *        Every other doc_id has length 0, ie unknown.
+ */
+
+int SetDocLengths(Manifest *manifest, char **file_names, int num_files, DocEntry *entries) {
+	
+	// Find the largest doc_id.
+	uint32_t num = 0;
+	if (manifest && manifest->num_docs > 0) {
+		num = manifest->docs[manifest->num_docs - 1].doc_id + 1;
+	}
+	for (int i = 0; i < num_files; i++) {
+		uint32_t doc_id = GetDocumentId(file_names[i]);
+		if (doc_id >= num) {
+			num = doc_id + 1;
+		}
+	}
+	
+	// Record the lengths.
+	uint32_t *lengths = (uint32_t *)calloc(num ? num : 1, sizeof(uint32_t));
+	if (!lengths) {
+		return 0;
+	}
+	for (int j = 0; manifest && j < manifest->num_docs; j++) {
+		lengths[manifest->docs[j].doc_id] = manifest->docs[j].length;
+	}
+	for (int i = 0; i < num_files; i++) {
+		lengths[GetDocumentId(file_names[i])] = entries[i].length;
+	}
+	free(doc_lengths);
+	doc_lengths = lengths;
+	num_lengths = num;
+	return 1;
+}
+
+/*
+ * PublishManifest - writes the document table of a manifest, then the manifest itself.
+ * @manifest: manifest to write.
+ *
+ * Returns 1 if successful, 0 if not successful.
+ *
+ * The manifest is written last so that it never lists a document the table is missing.
+ */
+
+int PublishManifest(Manifest *manifest) {
+	char *docs = DocsName(file);
+	int ok = docs && WriteDocFile(docs, manifest) && WriteManifest(file, manifest);
+	
+	free(docs);
+	return ok;
+}
+
+/*
+ * UpdateSegments - indexes the documents added or changed since the last build into a new segment.
+ * @file_names: files of TARGET_DIRECTORY, in doc_id order.
+ * @num_files: number of files.
+ * @manifest: manifest of the last build; updated.
+ * @Index: pointer to an empty InvertedIndex.
+ *
+ * Returns 1 if successful, 0 if not successful.
+ *
+ * Pseudocode:
+ *     1. For each file, compare its mtime and size with the manifest. If they differ,
+ *        compare its hash; if that differs too, the file has to be indexed, and its old
+ *        copy is marked deleted in the segment holding it.
+ *     2. Mark the documents of the manifest that are no longer in TARGET_DIRECTORY deleted.
+ *     3. Index the files that changed into a new segment.
+ *     4. Write the next generation of each deletion bitmap that changed, drop the
+ *        segments with no live document left, and write the manifest, which names
+ *        the new bitmaps.
+ *     5. Remove the files the manifest no longer names: the old generation of each
+ *        bitmap, and the segments dropped.
+ *
+ * The files the old manifest names are left as they are until the new one is in
+ * place, so a query sees either all of the old index or all of the new one.
+ */
+
+int UpdateSegments(char **file_names, int num_files, Manifest *manifest, HashTable *Index) {
+	
+	Deletions deletions;
+	memset(&deletions, 0, sizeof(Deletions));
+	
+	// Size a bitmap of the doc_ids seen in TARGET_DIRECTORY.
+	int max_id = GetDocumentId(file_names[num_files - 1]);
+	if (manifest->num_docs > 0 && manifest->docs[manifest->num_docs - 1].doc_id > max_id) {
+		max_id = manifest->docs[manifest->num_docs - 1].doc_id;
+	}
+	unsigned char *seen = (unsigned char *)calloc(max_id / 8 + 1, 1);
+	char **changed = (char **)malloc(num_files * sizeof(char *));
+	DocEntry *entries = (DocEntry *)calloc(num_files, sizeof(DocEntry));
+	int num_changed = 0;
+	int num_removed = 0;
+	int new_id = manifest->next_id;
+	int ok = seen && changed && entries && manifest->num_segments < MAX_SEGMENTS;
+	
+	// Find the files that were added or changed.
+	for (int i = 0; i < num_files && ok; i++) {
+		int doc_id = GetDocumentId(file_names[i]);
+		long long mtime, size;
+		
+		seen[doc_id / 8] |= 1 << (doc_id % 8);
+		if (!(ok = StatDocument(file_names[i], &mtime, &size))) {
+			break;
+		}
+		
+		// Files that were not touched are skipped without reading them.
+		DocEntry *doc = FindDoc(manifest, doc_id);
+		if (doc && doc->mtime == mtime && doc->size == size) {
+			continue;
+		}
+		
+		// Files that were rewritten with the same contents are skipped too.
+		char *path = DocumentPath(file_names[i]);
+		uint64_t hash = path ? HashFile(path) : 0;
+		free(path);
+		if (doc && doc->hash == hash) {
+			doc->mtime = mtime;
+			doc->size = size;
+			continue;
+		}
+		
+		// The old copy, if any, is deleted, and the file goes into the new segment.
+		if (doc) {
+			ok = MarkDeleted(manifest, &deletions, doc->segment, doc_id);
+		}
+		else {
+			ok = (doc = AddDoc(manifest, doc_id)) != NULL;
+		}
+		if (ok) {
+			doc->segment = new_id;
+			doc->mtime = mtime;
+			doc->size = size;
+			doc->hash = hash;
+			changed[num_changed++] = file_names[i];
+		}
+	}
+	
+	// Delete the documents whose files are gone. The loop runs to the end so every URL has one owner.
+	int kept = 0;
+	for (int j = 0; j < manifest->num_docs && seen; j++) {
+		DocEntry *doc = &manifest->docs[j];
+		if (IsDeleted(seen, (size_t)(max_id / 8 + 1), doc->doc_id)) {
+			manifest->docs[kept++] = *doc;
+		}
+		else {
+			ok = ok && MarkDeleted(manifest, &deletions, doc->segment, doc->doc_id);
+			free(doc->url);
+			num_removed++;
+		}
+	}
+	if (seen) {
+		manifest->num_docs = kept;
+	}
+	
+	// Index the changed files into a new segment.
+	if (ok && num_changed > 0) {
+		char *name = SegmentName(file, new_id);
+		num_docs = num_changed;
+		ok = name && BuildIndex(changed, num_changed, Index, entries) && SetDocLengths(NULL, changed, num_changed, entries);
+		if (ok && num_runs > 0) {
+			ok = MergeRuns(name);
+		}
+		else if (ok) {
+			ok = SaveIndexToFile(Index, name);
+		}
+		CleanHashTable(Index);
+		free(name);
+		
+		if (ok) {
+			Segment *segment = &manifest->segments[manifest->num_segments++];
+			segment->id = new_id;
+			segment->num_docs = num_changed;
+			segment->num_deleted = 0;
+			manifest->next_id++;
+		}
+		
+		// Record the metadata gathered while indexing, replacing that of the old copies.
+		for (int i = 0; i < num_changed && ok; i++) {
+			DocEntry *doc = FindDoc(manifest, GetDocumentId(changed[i]));
+			free(doc->url);
+			doc->url = entries[i].url;
+			doc->length = entries[i].length;
+			doc->depth = entries[i].depth;
+			entries[i].url = NULL;
+		}
+	}
+	
+	// Write the next generation of each bitmap that changed, keeping the old one for now.
+	Segment stale[MAX_SEGMENTS]; // old bitmaps, by segment id and generation
+	int num_stale = 0;
+	for (int i = 0; i < MAX_SEGMENTS; i++) {
+		if (ok && deletions.changed[i]) {
+			Segment *segment = &manifest->segments[i];
+			stale[num_stale++] = *segment;
+			ok = WriteDeleted(file, segment->id, segment->deleted_gen + 1, deletions.bits[i], deletions.size[i]);
+			segment->deleted_gen++;
+		}
+		free(deletions.bits[i]);
+	}
+	
+	// Drop the segments with no live document left, then publish the manifest.
+	Segment dead[MAX_SEGMENTS];
+	int num_dead = 0;
+	int live = 0;
+	for (int i = 0; i < manifest->num_segments && ok; i++) {
+		if (manifest->segments[i].num_deleted >= manifest->segments[i].num_docs) {
+			dead[num_dead++] = manifest->segments[i];
+		}
+		else {
+			manifest->segments[live++] = manifest->segments[i];
+		}
+	}
+	if (ok) {
+		manifest->num_segments = live;
+		ok = PublishManifest(manifest);
+	}
+	
+	// Remove the old bitmaps and the segments dropped, which the manifest no longer names.
+	for (int i = 0; i < num_stale && ok; i++) {
+		char *deleted = DeletedName(file, stale[i].id, stale[i].deleted_gen);
+		if (deleted && stale[i].deleted_gen > 0) {
+			remove(deleted);
+		}
+		free(deleted);
+	}
+	for (int i = 0; i < num_dead && ok; i++) {
+		char *name = SegmentName(file, dead[i].id);
+		char *deleted = DeletedName(file, dead[i].id, dead[i].deleted_gen);
+		if (name && dead[i].id != 0) {
+			remove(name); // index.dat itself is kept, since it names the index.
+		}
+		if (deleted) {
+			remove(deleted);
+		}
+		free(name);
+		free(deleted);
+	}
+	
+	if (ok) {
+		printf("Indexed %d new or changed documents, removed %d!\n", num_changed, num_removed);
+	}
+	
+	// Cleanup.
+	for (int i = 0; i < num_changed; i++) {
+		free(entries[i].url);
+	}
+	free(seen);
+	free(changed);
+	free(entries);
+	return ok;
+}
+
+/*
+ * MarkDeleted - marks a document deleted in the deletion bitmap of a segment.
+ * @manifest: manifest holding the segment.
+ * @deletions: bitmaps being updated.
+ * @id: id of the segment.
+ * @doc_id: document to be marked.
+ *
+ * Returns 1 if successful, 0 if memory could not be allocated.
+ *
+ * Pseudocode:
+ *     1. The first time a segment is touched, load its bitmap if it has one.
+ *     2. Grow the bitmap to cover doc_id, and set its bit.
+ */
+
+int MarkDeleted(Manifest *manifest, Deletions *deletions, int id, int doc_id) {
+	
+	int pos;
+	for (pos = 0; pos < manifest->num_segments && manifest->segments[pos].id != id; pos++);
+	if (pos == manifest->num_segments) {
+		return 1; // The document was in no live segment.
+	}
+	Segment *segment = &manifest->segments[pos];
+	
+	// Load the bitmap the first time the segment is touched.
+	if (!deletions->changed[pos]) {
+		if (segment->num_deleted > 0) {
+			deletions->bits[pos] = ReadDeleted(file, id, segment->deleted_gen, &deletions->size[pos]);
+		}
+		deletions->changed[pos] = 1;
+	}
+	
+	// Grow the bitmap to cover doc_id.
+	size_t need = doc_id / 8 + 1;
+	if (need > deletions->size[pos]) {
+		unsigned char *bits = (unsigned char *)realloc(deletions->bits[pos], need);
+		if (!bits) {
+			return 0;
+		}
+		memset(bits + deletions->size[pos], 0, need - deletions->size[pos]);
+		deletions->bits[pos] = bits;
+		deletions->size[pos] = need;
+	}
+	
+	if (!IsDeleted(deletions->bits[pos], deletions->size[pos], doc_id)) {
+		deletions->bits[pos][doc_id / 8] |= 1 << (doc_id % 8);
+		segment->num_deleted++;
+	}
+	return 1;
+}
+
+/*
+ * MergeSegments - applies the tiered merge policy to the segments of the manifest.
+ * @manifest: manifest to compact; updated.
+ *
+ * Returns 1 if successful, 0 if not successful.
+ *
+ * Pseudocode:
+ *     1. Put each segment in the tier of its number of live documents (see Tier).
+ *     2. While a tier holds MERGE_FACTOR segments, merge its MERGE_FACTOR oldest ones.
+ *
+ * Each merge writes one segment about MERGE_FACTOR times larger, so a document is
+ * rewritten about once per tier, and the number of segments stays logarithmic.
+ */
+
+int MergeSegments(Manifest *manifest) {
+	
+	while (1) {
+		int tiers[MAX_SEGMENTS];
+		int group[MERGE_FACTOR];
+		int tier = -1;
+		
+		for (int i = 0; i < manifest->num_segments; i++) {
+			tiers[i] = Tier(manifest->segments[i].num_docs - manifest->segments[i].num_deleted);
+		}
+		
+		// Find the first tier with MERGE_FACTOR segments.
+		for (int i = 0; i < manifest->num_segments && tier < 0; i++) {
+			int count = 0;
+			for (int j = 0; j < manifest->num_segments; j++) {
+				count += (tiers[j] == tiers[i]);
+			}
+			if (count >= MERGE_FACTOR) {
+				tier = tiers[i];
+			}
+		}
+		if (tier < 0) {
+			return 1;
+		}
+		
+		// Merge its oldest segments.
+		int n = 0;
+		for (int i = 0; i < manifest->num_segments && n < MERGE_FACTOR; i++) {
+			if (tiers[i] == tier) {
+				group[n++] = i;
+			}
+		}
+		if (!MergeSegmentGroup(manifest, group, n)) {
+			return 0;
+		}
+	}
+}
+
+/*
+ * MergeSegmentGroup - merges some segments of the manifest into one, dropping deleted documents.
+ * @manifest: manifest holding the segments; updated.
+ * @group: positions of the segments in the manifest, in increasing order.
+ * @n: number of segments.
+ *
+ * Returns 1 if successful, 0 if not successful.
+ *
+ * Pseudocode:
+ *     1. Read each segment without its deleted documents, and merge it into one InvertedIndex.
+ *     2. Write the merged segment, which the IndexWriter renames into place once complete.
+ *        It takes id 0 if segment 0 is one of the group, so index.dat stays the oldest
+ *        segment; a new id otherwise.
+ *     3. Replace the group with the merged segment in the manifest, and move its documents
+ *        to the merged segment.
+ *     4. Write the manifest, then remove the files of the group.
+ */
+
+int MergeSegmentGroup(Manifest *manifest, int *group, int n) {
+	
+	HashTable Merged;
+	InitializeHashTable(&Merged);
+	int ids[MERGE_FACTOR];
+	int gens[MERGE_FACTOR];
+	int target = manifest->next_id;
+	int live = 0;
+	int ok = 1;
+	
+	// Read each segment and merge it into one InvertedIndex.
+	for (int k = 0; k < n && ok; k++) {
+		Segment *segment = &manifest->segments[group[k]];
+		char *name = SegmentName(file, segment->id);
+		size_t size = 0;
+		unsigned char *bits = segment->num_deleted ? ReadDeleted(file, segment->id, segment->deleted_gen, &size) : NULL;
+		HashTable Part;
+		
+		InitializeHashTable(&Part);
+		ok = name && (!segment->num_deleted || bits) && ReadSegment(name, &Part, bits, size);
+		if (ok) {
+			MergeHashTable(&Merged, &Part, 0, MAX_HASH_SLOT);
+			ArenaAdopt(&Merged.arena, &Part.arena);
+		}
+		else {
+			CleanHashTable(&Part);
+		}
+		FreeHashTable(&Part);
+		free(bits);
+		free(name);
+		
+		ids[k] = segment->id;
+		gens[k] = segment->deleted_gen;
+		live += segment->num_docs - segment->num_deleted;
+		if (segment->id == 0) {
+			target = 0;
+		}
+	}
+	
+	// Write the merged segment. For segment 0, readers may briefly see the new index.dat with the old manifest.
+	char *name = SegmentName(file, target);
+	if (ok && (ok = (name != NULL))) {
+		printf("Merging %d segments into segment %d!\n", n, target);
+		num_docs = live;
+		ok = SetDocLengths(manifest, NULL, 0, NULL) && SaveIndexToFile(&Merged, name);
+	}
+	CleanHashTable(&Merged);
+	FreeHashTable(&Merged);
+	
+	if (ok) {
+		// Replace the group with the merged segment, at the place of its oldest segment.
+		Segment merged = { target, live, 0, 0 };
+		int kept = 0;
+		for (int i = 0, k = 0; i < manifest->num_segments; i++) {
+			if (k < n && i == group[k]) {
+				if (k++ == 0) {
+					manifest->segments[kept++] = merged;
+				}
 			}
 			else {
-				// Loop to the end of the DocumentNode list.
-				for (dn_ptr = wn->page; dn_ptr->next != NULL; dn_ptr = dn_ptr->next);
-				dn_ptr->next = dn;
+				manifest->segments[kept++] = manifest->segments[i];
 			}
-			
-			// Cleanup.
-			free(number1);
-			free(number2);
 		}
+		manifest->num_segments = kept;
+		if (target != 0) {
+			manifest->next_id++;
+		}
+		
+		// Move the documents of the group to the merged segment.
+		for (int j = 0; j < manifest->num_docs; j++) {
+			for (int k = 0; k < n; k++) {
+				if (manifest->docs[j].segment == ids[k]) {
+					manifest->docs[j].segment = target;
+				}
+			}
+		}
+		
+		ok = WriteManifest(file, manifest);
+	}
+	
+	// Remove the files of the group.
+	for (int k = 0; k < n && ok; k++) {
+		char *segment_name = SegmentName(file, ids[k]);
+		char *deleted = DeletedName(file, ids[k], gens[k]);
+		if (segment_name && ids[k] != target) {
+			remove(segment_name);
+		}
+		if (deleted && gens[k] > 0) {
+			remove(deleted);
+		}
+		free(segment_name);
+		free(deleted);
 	}
 	
 	// Cleanup.
-	free(WORD);
-	free(num);
-	free(buf);
-	fclose(fp);
+	free(name);
+	return ok;
+}
 
-	return New_Index;
+/*
+ * Tier - tier of a segment with num live documents: floor(log(num) / log(MERGE_FACTOR)).
+ */
+
+int Tier(int num) {
+	int tier = 0;
+	
+	while (num >= MERGE_FACTOR) {
+		num /= MERGE_FACTOR;
+		tier++;
+	}
+	return tier;
 }
 
+/*
+ * IndexDirectory - builds the index of TARGET_DIRECTORY, or updates it with -u.
+ * @Index: pointer to an empty InvertedIndex.
+ *
+ * Returns the number of files in TARGET_DIRECTORY, -1 if not successful.
+ *
+ * Pseudocode:
+ *     1. Get the files of TARGET_DIRECTORY, in doc_id order.
+ *     2. With -u and the manifest of an earlier build, only index what changed since,
+ *        into a new segment, and merge the segments.
+ *     3. With -s, build an index for each range of doc_ids (see BuildShards).
+ *     4. Otherwise, build the whole index into index.dat.
+ */
+
+int IndexDirectory(HashTable *Index) {
+	
+	// Get all file names in TARGET_DIRECTORY
+	char **file_names;
+	int num_files = GetFilenamesInDir(dir_path, &file_names);
+	if (num_files < 0) {
+		printf("Error getting file names from TARGET_DIRECTORY.\n");
+		return -1;
+	}
+	else if (num_files == 0) {
+		free(file_names);
+		return 0;
+	}
+	
+	// Index the files in doc_id order so every posting list comes out sorted.
+	qsort(file_names, num_files, sizeof(char *), CompareFileNames);
+	num_docs = num_files;
+	
+	// With -u and the manifest of an earlier build, only index what changed since.
+	Manifest manifest;
+	int ok;
+	if (incremental && ReadManifest(file, &manifest)) {
+		printf("Updating Index!\n");
+		
+		// Every segment has positions if index.dat has them, so the new ones follow it.
+		IndexFile index_file;
+		int had_positions = positional;
+		if ((ok = OpenIndexFile(&index_file, file))) {
+			positional = (index_file.header.flags & INDEX_POSITIONS) != 0;
+			CloseIndexFile(&index_file);
+		}
+		if (ok && had_positions && !positional) {
+			printf("index.dat has no positions. Build it again without -u to add them.\n");
+			ok = 0;
+		}
+		ok = ok && UpdateSegments(file_names, num_files, &manifest, Index) && MergeSegments(&manifest);
+		FreeManifest(&manifest);
+		if (!ok) {
+			printf("Error updating the index.\n");
+		}
+	}
+	else if (num_shards > 1) {
+		printf("Building %d Shards!\n", num_shards);
+		ok = BuildShards(file_names, num_files, Index);
+	}
+	else {
+		printf("Building Index!\n");
+		ok = BuildFullIndex(file_names, num_files, Index);
+	}
+	
+	// Cleanup.
+	for (int i = 0; i < num_files; i++) {
+		free(file_names[i]);
+	}
+	free(file_names);
+	return ok ? num_files : -1;
+}
+
+/*
+ * BuildFullIndex - builds the whole index into index.dat, with index.dat as its only segment.
+ * @file_names: files of TARGET_DIRECTORY, in doc_id order.
+ * @num_files: number of files.
+ * @Index: pointer to an empty InvertedIndex; left empty.
+ *
+ * Returns 1 if successful, 0 if not successful.
+ */
+
+int BuildFullIndex(char **file_names, int num_files, HashTable *Index) {
+	
+	// Build the InvertedIndex, gathering the metadata of every document.
+	DocEntry *entries = (DocEntry *)calloc(num_files, sizeof(DocEntry));
+	int ok = entries && BuildIndex(file_names, num_files, Index, entries) &&
+			SetDocLengths(NULL, file_names, num_files, entries);
+	if (!ok) {
+		printf("Error building the index.\n");
+	}
+	
+	// If the budget was hit, the index is in sorted runs; merge them into the target file.
+	else if (num_runs > 0) {
+		printf("Merging %d runs!\n", num_runs);
+		if (!(ok = MergeRuns(file))) {
+			printf("Error merging the runs into %s.\n", file);
+		}
+	}
+	else {
+		// Save the built InvertedIndex to the target file.
+		if (!(ok = SaveIndexToFile(Index, file))) {
+			printf("Error writing the index to %s.\n", file);
+		}
+		
+		// Export the InvertedIndex as text if asked to.
+		else if (text_file && !(ok = SaveIndexToText(Index, text_file))) {
+			printf("Error writing the text index to %s.\n", text_file);
+		}
+	}
+	CleanHashTable(Index); // Free all memory associated with the Hash Table.
+	
+	// Start a new manifest with index.dat as the only segment.
+	if (ok && !(ok = WriteFullManifest(file_names, num_files, entries))) {
+		printf("Error writing the manifest of %s.\n", file);
+	}
+	
+	// Cleanup.
+	for (int i = 0; entries && i < num_files; i++) {
+		free(entries[i].url);
+	}
+	free(entries);
+	return ok;
+}
+
+/*
+ * BuildShards - builds an independent index for each of num_shards ranges of doc_ids.
+ * @file_names: files of TARGET_DIRECTORY, in doc_id order.
+ * @num_files: number of files.
+ * @Index: pointer to an empty InvertedIndex; left empty.
+ *
+ * Returns 1 if successful, 0 if not successful.
+ *
+ * Pseudocode:
+ *     1. Split the files into num_shards ranges of consecutive doc_ids, with the same
+ *        number of files give or take one.
+ *     2. Build the whole index of each range into index.dat.shard<n>, with its own
+ *        manifest and document table (see BuildFullIndex), one range at a time, so
+ *        only one shard is in memory at once.
+ *
+ * A shard only knows its own documents; "query --shards" adds up the statistics of
+ * every shard for BM25.
+ */
+
+int BuildShards(char **file_names, int num_files, HashTable *Index) {
+	
+	if (num_files < num_shards) {
+		printf("TARGET_DIRECTORY has fewer files than -s shards.\n");
+		return 0;
+	}
+	
+	char *index_file = file; // index.dat; file names each shard in turn.
+	int ok = 1;
+	for (int n = 0; n < num_shards && ok; n++) {
+		int lo = (long)num_files * n / num_shards;
+		int hi = (long)num_files * (n + 1) / num_shards;
+		
+		file = ShardName(index_file, n);
+		num_docs = hi - lo;
+		ok = file && BuildFullIndex(file_names + lo, hi - lo, Index);
+		if (ok) {
+			printf("Shard %d: doc_ids %d to %d.\n", n, GetDocumentId(file_names[lo]), GetDocumentId(file_names[hi - 1]));
+		}
+		free(file);
+	}
+	file = index_file;
+	return ok;
+}
+
+/*
+ * FollowDirectory - indexes TARGET_DIRECTORY, then every document written to it, until interrupted.
+ * @Index: pointer to an empty InvertedIndex.
+ *
+ * Returns 1 if it stopped on SIGINT or SIGTERM, 0 if an update failed.
+ *
+ * Pseudocode:
+ *     1. Watch TARGET_DIRECTORY with inotify for files closed after writing, moved in,
+ *        or removed. If it cannot be watched, check it every FOLLOW_DELAY seconds.
+ *     2. Index it as with -u, so each batch of new documents goes into a new segment.
+ *     3. Wait for changes, and repeat from 2 until SIGINT or SIGTERM.
+ *
+ * The watch is set up before the first update so no file written during it is missed.
+ * A file caught half written is indexed again once its mtime or size changes.
+ */
+
+int FollowDirectory(HashTable *Index) {
+	
+	// Watch TARGET_DIRECTORY.
+	int fd = inotify_init1(IN_NONBLOCK);
+	if (fd >= 0 && inotify_add_watch(fd, dir_path, IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE) < 0) {
+		close(fd);
+		fd = -1;
+	}
+	if (fd < 0) {
+		printf("Cannot watch %s; checking it every %d seconds instead.\n", dir_path, FOLLOW_DELAY);
+	}
+	
+	// Finish the current update before stopping. Without SA_RESTART, the signal interrupts poll.
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = StopFollowing;
+	sigemptyset(&action.sa_mask);
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+	printf("Following %s!\n", dir_path);
+	
+	// Index what is there, then what is written after.
+	int ok;
+	do {
+		ok = IndexDirectory(Index) >= 0;
+		fflush(stdout);
+	} while (ok && WaitForChanges(fd));
+	
+	if (fd >= 0) {
+		close(fd);
+	}
+	return ok;
+}
+
+/*
+ * WaitForChanges - waits until TARGET_DIRECTORY changes, then for FOLLOW_DELAY more seconds.
+ * @fd: inotify descriptor watching TARGET_DIRECTORY, -1 to just sleep FOLLOW_DELAY seconds.
+ *
+ * Returns 1 when it is time to update the index, 0 if interrupted.
+ *
+ * Waiting FOLLOW_DELAY seconds after the first change lets a crawler write a batch of
+ * documents, so each update writes one segment for the batch instead of one per file.
+ */
+
+int WaitForChanges(int fd) {
+	char events[4096];
+	struct pollfd watch = { fd, POLLIN, 0 };
+	
+	if (fd < 0) {
+		sleep(FOLLOW_DELAY);
+		return !stopping;
+	}
+	
+	// Wait for the first change.
+	while (!stopping && poll(&watch, 1, -1) <= 0);
+	
+	// Drain the events until the delay is over; only the fact that something changed matters.
+	time_t deadline = time(NULL) + FOLLOW_DELAY;
+	while (!stopping) {
+		while (read(fd, events, sizeof(events)) > 0);
+		
+		time_t now = time(NULL);
+		if (now >= deadline) {
+			break;
+		}
+		poll(&watch, 1, (int)(deadline - now) * 1000);
+	}
+	return !stopping;
+}
+
+/*
+ * StopFollowing - SIGINT and SIGTERM handler of -f; the current update is finished first.
+ */
+
+void StopFollowing(int signum) {
+	(void)signum;
+	stopping = 1;
+}
+
+/*
+ * ReadFile - Read from a binary index file to create an InvertedIndex.
+ * @file_name: file to be read.
+ * @New_Index: pointer to an InvertedIndex to be created.
+ *
+ * Returns a pointer to an InvertedIndex, NULL if the file is not a valid index.
+ */
+
+HashTable *ReadFile(char *file_name, HashTable *New_Index) {
+	return ReadSegment(file_name, New_Index, NULL, 0);
+}
+
+/*
+ * ReadSegment - Read from a binary index file to create an InvertedIndex, leaving out deleted documents.
+ * @file_name: file to be read.
+ * @New_Index: pointer to an empty InvertedIndex to be created.
+ * @deleted: deletion bitmap of the file, NULL if none.
+ * @deleted_size: bytes of the deletion bitmap.
+ *
+ * Returns a pointer to an InvertedIndex, NULL if the file is not a valid index or memory
+ * could not be allocated; New_Index may then hold some of the words, for CleanHashTable.
+ *
+ * Pseudocode:
+ *     1. Map and validate the whole index file.
+ *     2. For each word of the dictionary, decode its postings (and positions) and drop the deleted ones.
+ *     3. If any posting is left, create a WordNode and add to the InvertedIndex.
+ *     4. Create a DocumentNode for each posting and add to the WordNode.
+ */
+
+HashTable *ReadSegment(char *file_name, HashTable *New_Index, unsigned char *deleted, size_t deleted_size) {
+	
+	// Declare variables.
+	IndexFile index_file;
+	TermCursor cursor = {0};
+	IndexTerm term;
+	Posting *postings = NULL; // decoded postings of the current word
+	int cap = 0; // number of postings allocated
+	int *positions = NULL; // decoded positions of the current word, if the file has them
+	size_t positions_cap = 0; // bytes allocated for positions
+	
+	if (!OpenIndexFile(&index_file, file_name)) {
+		return NULL;
+	}
+	if (!VerifyIndexFile(&index_file)) {
+		CloseIndexFile(&index_file);
+		return NULL;
+	}
+	num_docs = index_file.header.num_docs;
+	
+	// Loop through each word of the dictionary.
+	while (NextIndexTerm(&index_file, &cursor, &term)) {
+		
+		// Make room for the postings of the word.
+		if (term.df > cap) {
+			cap = term.df;
+			free(postings);
+			postings = (Posting *)malloc(cap * sizeof(Posting));
+			if (!postings) {
+				free(positions);
+				CloseIndexFile(&index_file);
+				return NULL;
+			}
+		}
+		DecodePostings(&term, postings);
+		
+		// Decode the positions, if the file has them.
+		if (term.positions) {
+			size_t total = 0;
+			for (int i=0; i < term.df; i++) {
+				total += postings[i].freq;
+			}
+			if (!Reserve((unsigned char **)&positions, &positions_cap, total * sizeof(int)) ||
+					DecodePositions(&term, postings, term.df, positions) < 0) {
+				free(postings);
+				free(positions);
+				CloseIndexFile(&index_file);
+				return NULL;
+			}
+		}
+		
+		// Drop the deleted documents, and their positions.
+		int num = 0;
+		size_t start = 0, kept = 0;
+		for (int i=0; i < term.df; i++) {
+			if (!deleted || !IsDeleted(deleted, deleted_size, postings[i].doc_id)) {
+				if (term.positions) {
+					memmove(positions + kept, positions + start, postings[i].freq * sizeof(int));
+					kept += postings[i].freq;
+				}
+				postings[num++] = postings[i];
+			}
+			start += postings[i].freq;
+		}
+		if (num == 0) {
+			continue;
+		}
+		
+		// Create and initialize new word node, its DocumentNodes and their positions.
+		WordNode *wn;
+		wn = (WordNode *)ArenaAlloc(&New_Index->arena, sizeof(WordNode)); // Initialize a new WordNode.
+		DocumentNode *dn = (DocumentNode *)ArenaAlloc(&New_Index->arena, num * sizeof(DocumentNode));
+		int *pos = term.positions ? (int *)ArenaAlloc(&New_Index->arena, kept * sizeof(int)) : NULL;
+		if (!wn || !(wn->word = ArenaStrdup(&New_Index->arena, term.word)) || !dn || (term.positions && !pos)) {
+			free(postings);
+			free(positions);
+			CloseIndexFile(&index_file);
+			return NULL;
+		}
+		if (pos) {
+			memcpy(pos, positions, kept * sizeof(int));
+		}
+		
+		// Add the WordNode to the front of its bin.
+		unsigned long index = JenkinsHash(term.word, MAX_HASH_SLOT); // Get the hash code.
+		wn->next = New_Index->table[index]->data;
+		New_Index->table[index]->data = wn;
+		
+		// Create a DocumentNode for each posting, keeping doc_id order.
+		for (int i=0; i < num; i++) {
+			dn[i].doc_id = postings[i].doc_id;
+			dn[i].freq = postings[i].freq;
+			dn[i].next = (i + 1 < num) ? &dn[i + 1] : NULL;
+			if (pos) {
+				dn[i].positions = pos;
+				pos += postings[i].freq;
+			}
+		}
+		wn->page = dn;
+		wn->last = &dn[num - 1];
+	}
+	
+	// Cleanup.
+	free(postings);
+	free(positions);
+	CloseIndexFile(&index_file);
+
+	return New_Index;
+}
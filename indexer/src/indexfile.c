@@ -0,0 +1,803 @@
+/* ========================================================================== */
+/* File: indexfile.c
+ *
+ * Project name: CS50 Tiny Search Engine
+ * Component name: Indexer
+ *
+ * This file includes the writer and the reader of the binary index file.
+ * Please go to the top of each function for more detailed descriptions.
+ */
+/* ========================================================================== */
+
+// ---------------- Open Issues
+
+// ---------------- System includes e.g., <stdio.h>
+#define _POSIX_C_SOURCE 200809L              // fstat, mmap
+#include <stdio.h>                           // FILE, fwrite, tmpfile, rename, remove
+#include <stdlib.h>                          // malloc, free
+#include <string.h>                          // memcpy, strcmp, strlen
+#include <fcntl.h>                           // open
+#include <unistd.h>                          // close
+#include <sys/mman.h>                        // mmap, munmap
+#include <sys/stat.h>                        // fstat
+
+// ---------------- Local includes  e.g., "file.h"
+#include "indexfile.h"                       // binary index functionality
+#include "postings.h"                        // posting codec functionality
+
+// ---------------- Constant definitions
+
+// ---------------- Macro definitions
+#define NumDictBlocks(num_terms) (((uint64_t)(num_terms) + DICT_BLOCK - 1) / DICT_BLOCK)
+#define COPY_BUFFER_SIZE 65536               // bytes copied at a time from the positions file
+
+// ---------------- Structures/Types
+
+// ---------------- Private variables
+static const uint32_t crc_table[256] = {   // CRC-32 lookup table, polynomial 0xEDB88320
+	0x00000000u, 0x77073096u, 0xee0e612cu, 0x990951bau, 0x076dc419u, 0x706af48fu,
+	0xe963a535u, 0x9e6495a3u, 0x0edb8832u, 0x79dcb8a4u, 0xe0d5e91eu, 0x97d2d988u,
+	0x09b64c2bu, 0x7eb17cbdu, 0xe7b82d07u, 0x90bf1d91u, 0x1db71064u, 0x6ab020f2u,
+	0xf3b97148u, 0x84be41deu, 0x1adad47du, 0x6ddde4ebu, 0xf4d4b551u, 0x83d385c7u,
+	0x136c9856u, 0x646ba8c0u, 0xfd62f97au, 0x8a65c9ecu, 0x14015c4fu, 0x63066cd9u,
+	0xfa0f3d63u, 0x8d080df5u, 0x3b6e20c8u, 0x4c69105eu, 0xd56041e4u, 0xa2677172u,
+	0x3c03e4d1u, 0x4b04d447u, 0xd20d85fdu, 0xa50ab56bu, 0x35b5a8fau, 0x42b2986cu,
+	0xdbbbc9d6u, 0xacbcf940u, 0x32d86ce3u, 0x45df5c75u, 0xdcd60dcfu, 0xabd13d59u,
+	0x26d930acu, 0x51de003au, 0xc8d75180u, 0xbfd06116u, 0x21b4f4b5u, 0x56b3c423u,
+	0xcfba9599u, 0xb8bda50fu, 0x2802b89eu, 0x5f058808u, 0xc60cd9b2u, 0xb10be924u,
+	0x2f6f7c87u, 0x58684c11u, 0xc1611dabu, 0xb6662d3du, 0x76dc4190u, 0x01db7106u,
+	0x98d220bcu, 0xefd5102au, 0x71b18589u, 0x06b6b51fu, 0x9fbfe4a5u, 0xe8b8d433u,
+	0x7807c9a2u, 0x0f00f934u, 0x9609a88eu, 0xe10e9818u, 0x7f6a0dbbu, 0x086d3d2du,
+	0x91646c97u, 0xe6635c01u, 0x6b6b51f4u, 0x1c6c6162u, 0x856530d8u, 0xf262004eu,
+	0x6c0695edu, 0x1b01a57bu, 0x8208f4c1u, 0xf50fc457u, 0x65b0d9c6u, 0x12b7e950u,
+	0x8bbeb8eau, 0xfcb9887cu, 0x62dd1ddfu, 0x15da2d49u, 0x8cd37cf3u, 0xfbd44c65u,
+	0x4db26158u, 0x3ab551ceu, 0xa3bc0074u, 0xd4bb30e2u, 0x4adfa541u, 0x3dd895d7u,
+	0xa4d1c46du, 0xd3d6f4fbu, 0x4369e96au, 0x346ed9fcu, 0xad678846u, 0xda60b8d0u,
+	0x44042d73u, 0x33031de5u, 0xaa0a4c5fu, 0xdd0d7cc9u, 0x5005713cu, 0x270241aau,
+	0xbe0b1010u, 0xc90c2086u, 0x5768b525u, 0x206f85b3u, 0xb966d409u, 0xce61e49fu,
+	0x5edef90eu, 0x29d9c998u, 0xb0d09822u, 0xc7d7a8b4u, 0x59b33d17u, 0x2eb40d81u,
+	0xb7bd5c3bu, 0xc0ba6cadu, 0xedb88320u, 0x9abfb3b6u, 0x03b6e20cu, 0x74b1d29au,
+	0xead54739u, 0x9dd277afu, 0x04db2615u, 0x73dc1683u, 0xe3630b12u, 0x94643b84u,
+	0x0d6d6a3eu, 0x7a6a5aa8u, 0xe40ecf0bu, 0x9309ff9du, 0x0a00ae27u, 0x7d079eb1u,
+	0xf00f9344u, 0x8708a3d2u, 0x1e01f268u, 0x6906c2feu, 0xf762575du, 0x806567cbu,
+	0x196c3671u, 0x6e6b06e7u, 0xfed41b76u, 0x89d32be0u, 0x10da7a5au, 0x67dd4accu,
+	0xf9b9df6fu, 0x8ebeeff9u, 0x17b7be43u, 0x60b08ed5u, 0xd6d6a3e8u, 0xa1d1937eu,
+	0x38d8c2c4u, 0x4fdff252u, 0xd1bb67f1u, 0xa6bc5767u, 0x3fb506ddu, 0x48b2364bu,
+	0xd80d2bdau, 0xaf0a1b4cu, 0x36034af6u, 0x41047a60u, 0xdf60efc3u, 0xa867df55u,
+	0x316e8eefu, 0x4669be79u, 0xcb61b38cu, 0xbc66831au, 0x256fd2a0u, 0x5268e236u,
+	0xcc0c7795u, 0xbb0b4703u, 0x220216b9u, 0x5505262fu, 0xc5ba3bbeu, 0xb2bd0b28u,
+	0x2bb45a92u, 0x5cb36a04u, 0xc2d7ffa7u, 0xb5d0cf31u, 0x2cd99e8bu, 0x5bdeae1du,
+	0x9b64c2b0u, 0xec63f226u, 0x756aa39cu, 0x026d930au, 0x9c0906a9u, 0xeb0e363fu,
+	0x72076785u, 0x05005713u, 0x95bf4a82u, 0xe2b87a14u, 0x7bb12baeu, 0x0cb61b38u,
+	0x92d28e9bu, 0xe5d5be0du, 0x7cdcefb7u, 0x0bdbdf21u, 0x86d3d2d4u, 0xf1d4e242u,
+	0x68ddb3f8u, 0x1fda836eu, 0x81be16cdu, 0xf6b9265bu, 0x6fb077e1u, 0x18b74777u,
+	0x88085ae6u, 0xff0f6a70u, 0x66063bcau, 0x11010b5cu, 0x8f659effu, 0xf862ae69u,
+	0x616bffd3u, 0x166ccf45u, 0xa00ae278u, 0xd70dd2eeu, 0x4e048354u, 0x3903b3c2u,
+	0xa7672661u, 0xd06016f7u, 0x4969474du, 0x3e6e77dbu, 0xaed16a4au, 0xd9d65adcu,
+	0x40df0b66u, 0x37d83bf0u, 0xa9bcae53u, 0xdebb9ec5u, 0x47b2cf7fu, 0x30b5ffe9u,
+	0xbdbdf21cu, 0xcabac28au, 0x53b39330u, 0x24b4a3a6u, 0xbad03605u, 0xcdd70693u,
+	0x54de5729u, 0x23d967bfu, 0xb3667a2eu, 0xc4614ab8u, 0x5d681b02u, 0x2a6f2b94u,
+	0xb40bbe37u, 0xc30c8ea1u, 0x5a05df1bu, 0x2d02ef8du
+};
+
+// ---------------- Private prototypes
+static int CompareBlockWord(const IndexFile *, uint32_t, const char *);
+static void StartBlock(const IndexFile *, TermCursor *, uint32_t);
+static int CopyPositions(IndexWriter *);
+
+
+uint32_t Crc32(uint32_t crc, const void *buf, size_t len) {
+	const unsigned char *p = buf;
+
+	crc = ~crc;
+	while (len--) {
+		crc = crc_table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+
+/*
+ * OpenIndexWriter - start writing a binary index file.
+ * @writer: writer to initialize.
+ * @file_name: file to be written to.
+ * @flags: INDEX_POSITIONS, or 0.
+ *
+ * Returns 1 if successful, 0 if not.
+ *
+ * Pseudocode:
+ *     1. Open file_name.tmp and reserve room for the header. The file is renamed
+ *        over file_name at close, never written in place, since readers map it.
+ *     2. Postings are streamed right after the header as words are added.
+ *     3. Positions are streamed to a temporary file, copied after the postings at close.
+ *     4. The dictionary is kept in memory until CloseIndexWriter.
+ */
+
+int OpenIndexWriter(IndexWriter *writer, const char *file_name, uint32_t flags) {
+
+	memset(writer, 0, sizeof(IndexWriter));
+	writer->header.flags = flags;
+
+	writer->file_name = malloc(strlen(file_name) + 1);
+	writer->temp_name = malloc(strlen(file_name) + 5);
+	if (!writer->file_name || !writer->temp_name) {
+		free(writer->file_name);
+		free(writer->temp_name);
+		return 0;
+	}
+	strcpy(writer->file_name, file_name);
+	sprintf(writer->temp_name, "%s.tmp", file_name);
+
+	writer->fp = fopen(writer->temp_name, "wb");
+	if (!writer->fp) {
+		free(writer->file_name);
+		free(writer->temp_name);
+		return 0;
+	}
+	if ((flags & INDEX_POSITIONS) && !(writer->positions = tmpfile())) {
+		AbortIndexWriter(writer);
+		return 0;
+	}
+
+	// Write a blank header; the real one is written once the counts are known.
+	if (fwrite(&writer->header, sizeof(IndexHeader), 1, writer->fp) != 1) {
+		AbortIndexWriter(writer);
+		return 0;
+	}
+
+	writer->header.postings_offset = sizeof(IndexHeader);
+	return 1;
+}
+
+
+/*
+ * AddIndexTerm - append a word and its posting list to the index file.
+ * @writer: open writer.
+ * @word: the word.
+ * @postings: postings of the word, sorted by doc_id.
+ * @num: number of postings.
+ * @positions: positions of the word in each posting in turn, with INDEX_POSITIONS.
+ *
+ * Returns 1 if successful, 0 if not.
+ *
+ * Assumptions:
+ *     1. Words are added in strcmp order.
+ *
+ * Pseudocode:
+ *     1. Check that the word comes after the previous word.
+ *     2. Encode the list with EncodePostingList.
+ *     3. Write the encoded list to the file, and its encoded positions to the positions file.
+ *     4. Start a new DictBlock every DICT_BLOCK words.
+ *     5. Append the word, front coded against the previous word of its block, its df
+ *        and the sizes of its list and its positions to the dictionary.
+ */
+
+int AddIndexTerm(IndexWriter *writer, const char *word, const Posting *postings, int num, const int *positions) {
+
+	// Check that the dictionary stays sorted.
+	size_t word_len = strlen(word);
+	if (num <= 0 || word_len > MAX_TERM_LENGTH ||
+			(writer->header.num_terms && strcmp(writer->last_word, word) >= 0)) {
+		return 0;
+	}
+
+	// Encode the posting list.
+	size_t len = EncodePostingList(postings, num, writer->lengths, writer->num_lengths, &writer->scratch);
+	if (len == 0) {
+		return 0;
+	}
+	if (fwrite(writer->scratch.buf, 1, len, writer->fp) != len) {
+		return 0;
+	}
+	writer->header.postings_crc = Crc32(writer->header.postings_crc, writer->scratch.buf, len);
+	writer->header.postings_size += len;
+
+	// Encode the positions.
+	size_t positions_len = 0;
+	if (writer->positions) {
+		if (!positions || !(positions_len = EncodePositionList(postings, num, positions, &writer->scratch)) ||
+				fwrite(writer->scratch.positions, 1, positions_len, writer->positions) != positions_len) {
+			return 0;
+		}
+		writer->header.positions_crc = Crc32(writer->header.positions_crc, writer->scratch.positions, positions_len);
+		writer->header.positions_size += positions_len;
+	}
+
+	// Make room for the dictionary entry.
+	size_t dict_len = writer->header.dict_size;
+	uint32_t num_terms = writer->header.num_terms;
+	if (dict_len > UINT32_MAX || !Reserve(&writer->dict, &writer->dict_cap, dict_len + word_len + 4 * MAX_VARINT) ||
+			!Reserve((unsigned char **)&writer->blocks, &writer->blocks_cap, (num_terms / DICT_BLOCK + 1) * sizeof(DictBlock))) {
+		return 0;
+	}
+
+	// Start a new block, whose first word is stored whole.
+	size_t prefix = 0;
+	if (num_terms % DICT_BLOCK == 0) {
+		DictBlock *block = &writer->blocks[num_terms / DICT_BLOCK];
+		block->postings = writer->header.postings_size - len;
+		block->positions = writer->header.positions_size - positions_len;
+		block->dict = dict_len;
+		block->padding = 0;
+	}
+	else {
+		while (writer->last_word[prefix] == word[prefix]) {
+			prefix++;
+		}
+	}
+
+	// Append the dictionary entry.
+	dict_len += PutVarint(writer->dict + dict_len, prefix);
+	dict_len += PutVarint(writer->dict + dict_len, word_len - prefix);
+	memcpy(writer->dict + dict_len, word + prefix, word_len - prefix);
+	dict_len += word_len - prefix;
+	dict_len += PutVarint(writer->dict + dict_len, num);
+	dict_len += PutVarint(writer->dict + dict_len, len);
+	if (writer->positions) {
+		dict_len += PutVarint(writer->dict + dict_len, positions_len);
+	}
+	writer->header.dict_size = dict_len;
+	memcpy(writer->last_word, word, word_len + 1);
+
+	// Update the counts.
+	writer->header.num_terms++;
+	writer->header.num_postings += num;
+	if (postings[num - 1].doc_id > writer->header.max_doc_id) {
+		writer->header.max_doc_id = postings[num - 1].doc_id;
+	}
+	return 1;
+}
+
+
+/*
+ * CloseIndexWriter - finish the index file.
+ * @writer: open writer.
+ * @num_docs: number of documents indexed.
+ *
+ * Returns 1 if successful, 0 if not.
+ *
+ * Pseudocode:
+ *     1. Copy the positions after the postings.
+ *     2. Append the dictionary after them, and the DictBlocks after it, aligned to 8 bytes.
+ *     3. Fill in the header and its checksum.
+ *     4. Rewrite the header at the start of the file, and rename the file into place.
+ */
+
+int CloseIndexWriter(IndexWriter *writer, int num_docs) {
+
+	IndexHeader *header = &writer->header;
+	int ok = 1;
+
+	// Copy the positions.
+	header->positions_offset = header->postings_offset + header->postings_size;
+	if (writer->positions) {
+		ok = CopyPositions(writer);
+		fclose(writer->positions); // The temporary file goes away.
+	}
+
+	// Append the dictionary.
+	header->dict_offset = header->positions_offset + header->positions_size;
+	if (header->dict_size && fwrite(writer->dict, 1, header->dict_size, writer->fp) != header->dict_size) {
+		ok = 0;
+	}
+	header->dict_crc = Crc32(0, writer->dict, header->dict_size);
+
+	// Append the DictBlocks, aligned so they can be used in place.
+	static const unsigned char zeros[8];
+	size_t padding = (8 - (header->dict_offset + header->dict_size) % 8) % 8;
+	header->blocks_offset = header->dict_offset + header->dict_size + padding;
+	header->blocks_size = NumDictBlocks(header->num_terms) * sizeof(DictBlock);
+	if ((padding && fwrite(zeros, 1, padding, writer->fp) != padding) ||
+			(header->blocks_size && fwrite(writer->blocks, 1, header->blocks_size, writer->fp) != header->blocks_size)) {
+		ok = 0;
+	}
+	header->blocks_crc = Crc32(0, writer->blocks, header->blocks_size);
+
+	// Fill in the header.
+	memcpy(header->magic, INDEX_MAGIC, sizeof(header->magic));
+	header->version = INDEX_VERSION;
+	header->header_size = sizeof(IndexHeader);
+	header->num_docs = num_docs;
+	header->header_crc = 0;
+	header->header_crc = Crc32(0, header, sizeof(IndexHeader));
+
+	// Rewrite the header.
+	if (fseek(writer->fp, 0, SEEK_SET) != 0 || fwrite(header, sizeof(IndexHeader), 1, writer->fp) != 1) {
+		ok = 0;
+	}
+	if (fclose(writer->fp) != 0) {
+		ok = 0;
+	}
+	if (ok) {
+		ok = rename(writer->temp_name, writer->file_name) == 0;
+	}
+	if (!ok) {
+		remove(writer->temp_name);
+	}
+
+	// Cleanup.
+	free(writer->dict);
+	free(writer->blocks);
+	free(writer->file_name);
+	free(writer->temp_name);
+	FreePostingScratch(&writer->scratch);
+	return ok;
+}
+
+
+void AbortIndexWriter(IndexWriter *writer) {
+	fclose(writer->fp);
+	if (writer->positions) {
+		fclose(writer->positions);
+	}
+	remove(writer->temp_name);
+	free(writer->dict);
+	free(writer->blocks);
+	free(writer->file_name);
+	free(writer->temp_name);
+	FreePostingScratch(&writer->scratch);
+}
+
+
+/*
+ * OpenIndexFile - map and validate a binary index file.
+ * @index: index file to fill in.
+ * @file_name: file to be mapped.
+ *
+ * Returns 1 if successful, 0 if not.
+ *
+ * Pseudocode:
+ *     1. Map the whole file read-only.
+ *     2. Check the magic, version and header checksum.
+ *     3. Check that every section lies inside the file.
+ *     4. Check the dictionary and the DictBlocks against their checksums, and that
+ *        every DictBlock points into the dictionary and the postings, in order.
+ */
+
+int OpenIndexFile(IndexFile *index, const char *file_name) {
+
+	memset(index, 0, sizeof(IndexFile));
+
+	int fd = open(file_name, O_RDONLY);
+	if (fd < 0) {
+		return 0;
+	}
+
+	// Map the whole file.
+	struct stat st;
+	void *data = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(IndexHeader)) {
+		data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	}
+	close(fd); // The mapping stays valid.
+	if (data == MAP_FAILED) {
+		return 0;
+	}
+	index->data = data;
+	index->size = st.st_size;
+
+	// Check the header.
+	IndexHeader *header = &index->header;
+	memcpy(header, index->data, sizeof(IndexHeader));
+	uint32_t crc = header->header_crc;
+	header->header_crc = 0;
+	if (memcmp(header->magic, INDEX_MAGIC, sizeof(header->magic)) != 0 || header->version != INDEX_VERSION ||
+			header->header_size != sizeof(IndexHeader) || Crc32(0, header, sizeof(IndexHeader)) != crc) {
+		CloseIndexFile(index);
+		return 0;
+	}
+	header->header_crc = crc;
+
+	// Check the sections. The last byte of the dictionary must end a varint, so no entry runs past it.
+	if (header->postings_offset + header->postings_size > index->size ||
+			header->positions_offset + header->positions_size > index->size ||
+			(!(header->flags & INDEX_POSITIONS) && header->positions_size) ||
+			header->dict_offset + header->dict_size > index->size ||
+			header->blocks_offset % 8 != 0 || header->blocks_offset + header->blocks_size > index->size ||
+			header->blocks_size != NumDictBlocks(header->num_terms) * sizeof(DictBlock) ||
+			(header->num_terms && index->data[header->dict_offset + header->dict_size - 1] & 0x80) ||
+			Crc32(0, index->data + header->dict_offset, header->dict_size) != header->dict_crc ||
+			Crc32(0, index->data + header->blocks_offset, header->blocks_size) != header->blocks_crc) {
+		CloseIndexFile(index);
+		return 0;
+	}
+
+	// Check that the DictBlocks point into the dictionary, the postings and the positions, in order.
+	const DictBlock *blocks = (const DictBlock *)(index->data + header->blocks_offset);
+	for (uint64_t b = 0; b < NumDictBlocks(header->num_terms); b++) {
+		if (blocks[b].dict >= header->dict_size || blocks[b].postings >= header->postings_size ||
+				blocks[b].positions > header->positions_size ||
+				(b > 0 && (blocks[b].dict <= blocks[b - 1].dict || blocks[b].postings <= blocks[b - 1].postings ||
+				blocks[b].positions < blocks[b - 1].positions))) {
+			CloseIndexFile(index);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+
+int VerifyIndexFile(const IndexFile *index) {
+	const IndexHeader *header = &index->header;
+
+	return Crc32(0, index->data + header->postings_offset, header->postings_size) == header->postings_crc &&
+			Crc32(0, index->data + header->positions_offset, header->positions_size) == header->positions_crc;
+}
+
+
+void CloseIndexFile(IndexFile *index) {
+	if (index->data) {
+		munmap((void *)index->data, index->size);
+	}
+	index->data = NULL;
+	index->size = 0;
+}
+
+
+/*
+ * NextIndexTerm - get the next word of the dictionary.
+ * @index: open index file.
+ * @cursor: position in the dictionary, zeroed before the first call.
+ * @term: filled in with the word, its df and its encoded postings.
+ *
+ * Returns 1 if a word was found, 0 at the end of the dictionary or at a corrupt entry.
+ *
+ * Pseudocode:
+ *     1. Move to the next block after DICT_BLOCK words.
+ *     2. Rebuild the word from the prefix it shares with the previous word.
+ *     3. Read its df, and find its postings right after the postings of the previous word,
+ *        and its positions right after the positions of the previous word.
+ */
+
+int NextIndexTerm(const IndexFile *index, TermCursor *cursor, IndexTerm *term) {
+
+	const unsigned char *end = index->data + index->header.dict_offset + index->header.dict_size;
+
+	// Start at the first entry on the first call, and at the next block after DICT_BLOCK entries.
+	if (cursor->pos == NULL) {
+		StartBlock(index, cursor, 0);
+	}
+	else if (cursor->in_block == DICT_BLOCK) {
+		StartBlock(index, cursor, cursor->block + 1);
+	}
+	if (cursor->pos >= end) {
+		return 0;
+	}
+
+	// Rebuild the word.
+	size_t prefix = GetVarint(&cursor->pos);
+	size_t rest = GetVarint(&cursor->pos);
+	if (prefix > strlen(cursor->word) || prefix + rest > MAX_TERM_LENGTH || rest > (size_t)(end - cursor->pos)) {
+		cursor->pos = end; // The entry is corrupt; stop here.
+		return 0;
+	}
+	memcpy(cursor->word + prefix, cursor->pos, rest);
+	cursor->word[prefix + rest] = '\0';
+	cursor->pos += rest;
+
+	// Read its df and find its postings.
+	term->word = cursor->word;
+	term->df = GetVarint(&cursor->pos);
+	term->postings_size = GetVarint(&cursor->pos);
+	term->postings = index->data + index->header.postings_offset + cursor->postings;
+	cursor->postings += term->postings_size;
+	term->positions = NULL;
+	term->positions_size = 0;
+	if (index->header.flags & INDEX_POSITIONS) {
+		term->positions_size = GetVarint(&cursor->pos);
+		term->positions = index->data + index->header.positions_offset + cursor->positions;
+		cursor->positions += term->positions_size;
+	}
+	cursor->in_block++;
+	return cursor->postings <= index->header.postings_size && cursor->positions <= index->header.positions_size;
+}
+
+
+/*
+ * SeekIndexTerm - find the first word of the dictionary that is not before word.
+ * @index: open index file.
+ * @cursor: cursor to position.
+ * @word: the word to seek.
+ * @term: filled in with the word found.
+ *
+ * Returns 1 if a word was found, 0 if word is after the whole dictionary.
+ *
+ * Pseudocode:
+ *     1. Binary search the blocks for the last one whose first word is not after word.
+ *     2. Scan that block, and the next one if needed, for the first word not before word.
+ */
+
+int SeekIndexTerm(const IndexFile *index, TermCursor *cursor, const char *word, IndexTerm *term) {
+
+	// Find the last block whose first word is not after word.
+	long lo = 0, hi = (long)NumDictBlocks(index->header.num_terms) - 1, found = 0;
+	while (lo <= hi) {
+		long mid = lo + (hi - lo) / 2;
+		if (CompareBlockWord(index, mid, word) <= 0) {
+			found = mid;
+			lo = mid + 1;
+		}
+		else {
+			hi = mid - 1;
+		}
+	}
+
+	// Scan from the start of the block.
+	StartBlock(index, cursor, found);
+	while (NextIndexTerm(index, cursor, term)) {
+		if (strcmp(term->word, word) >= 0) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+
+/*
+ * FindIndexTerm - look up a word of the dictionary.
+ * @index: open index file.
+ * @word: the word.
+ * @term: filled in with the word, its df and its encoded postings.
+ *
+ * Returns 1 if the word was found, 0 if not.
+ */
+
+int FindIndexTerm(const IndexFile *index, const char *word, IndexTerm *term) {
+	TermCursor cursor;
+
+	if (SeekIndexTerm(index, &cursor, word, term) && strcmp(term->word, word) == 0) {
+		term->word = word; // The cursor goes away.
+		return 1;
+	}
+	return 0;
+}
+
+
+/*
+ * DecodePostings - decode the posting list of a word.
+ * @term: word returned by NextIndexTerm.
+ * @postings: filled in with the postings of the word.
+ *
+ * Returns the number of postings decoded.
+ *
+ * Pseudocode:
+ *     1. Decode the list one block at a time.
+ *     2. Copy the doc_ids and freqs of each block into postings.
+ */
+
+int DecodePostings(const IndexTerm *term, Posting *postings) {
+	uint32_t doc_ids[POSTING_BLOCK], freqs[POSTING_BLOCK];
+	int num = 0;
+
+	for (int b = 0; b < NumBlocks(term->df); b++) {
+		int n = DecodeBlock(term->postings, term->df, b, doc_ids, freqs);
+		for (int i = 0; i < n; i++) {
+			postings[num].doc_id = doc_ids[i];
+			postings[num].freq = freqs[i];
+			num++;
+		}
+	}
+	return num;
+}
+
+
+/*
+ * DecodePositions - decode the positions of the postings of a word.
+ * @term: word returned by NextIndexTerm.
+ * @postings: decoded postings of the word.
+ * @num: number of postings.
+ * @positions: filled in with the positions of each posting in turn.
+ *
+ * Returns the number of positions decoded, -1 if they run past the positions of the word.
+ *
+ * Pseudocode:
+ *     1. For each posting, read freq varints.
+ *     2. The first one is a position, and each one after it the gap from the one before.
+ */
+
+int DecodePositions(const IndexTerm *term, const Posting *postings, int num, int *positions) {
+	const unsigned char *pos = term->positions;
+	const unsigned char *end = term->positions + term->positions_size;
+	int total = 0;
+
+	if (!pos) {
+		return -1;
+	}
+	for (int i = 0; i < num; i++) {
+		int position = 0;
+		for (int k = 0; k < postings[i].freq; k++) {
+			if (pos >= end) {
+				return -1;
+			}
+			position += GetVarint(&pos);
+			positions[total++] = position;
+		}
+	}
+	return pos <= end ? total : -1;
+}
+
+
+/*
+ * EncodePositionList - encode the positions of a posting list into scratch->positions.
+ * @postings: postings of the word.
+ * @num: number of postings.
+ * @positions: positions of each posting in turn.
+ * @scratch: scratch buffers, grown as needed.
+ *
+ * Returns the number of bytes encoded, 0 if not successful.
+ *
+ * Pseudocode:
+ *     1. Make room for one varint per position.
+ *     2. For each posting, write its first position, then the gap to each next one.
+ */
+
+size_t EncodePositionList(const Posting *postings, int num, const int *positions, PostingScratch *scratch) {
+	size_t total = 0;
+	size_t len = 0;
+
+	for (int i = 0; i < num; i++) {
+		total += postings[i].freq;
+	}
+	if (!Reserve(&scratch->positions, &scratch->positions_cap, total * MAX_VARINT + 1)) {
+		return 0;
+	}
+
+	for (int i = 0; i < num; i++) {
+		int prev = 0;
+		for (int k = 0; k < postings[i].freq; k++) {
+			int position = *positions++;
+			if (position < prev || (k > 0 && position == prev)) {
+				return 0; // Positions must increase within a document.
+			}
+			len += PutVarint(scratch->positions + len, position - prev);
+			prev = position;
+		}
+	}
+	return len;
+}
+
+
+/*
+ * EncodePostingList - encode a posting list into scratch->buf.
+ * @postings: postings, sorted by doc_id.
+ * @num: number of postings.
+ * @lengths: length of each doc_id below num_lengths, NULL if unknown.
+ * @num_lengths: doc_ids in lengths.
+ * @scratch: scratch buffers, grown as needed.
+ *
+ * Returns the number of bytes encoded, 0 if not successful.
+ *
+ * Pseudocode:
+ *     1. Check that the doc_ids are increasing, and split the postings into doc_ids and freqs,
+ *        and the lengths of their documents if known.
+ *     2. Encode them into blocks of POSTING_BLOCK postings (see postings.h).
+ */
+
+size_t EncodePostingList(const Posting *postings, int num, const uint32_t *lengths, uint32_t num_lengths,
+		PostingScratch *scratch) {
+
+	if (num <= 0 || !Reserve(&scratch->ids, &scratch->ids_cap, (size_t)num * 3 * sizeof(uint32_t)) ||
+			!Reserve(&scratch->buf, &scratch->buf_cap, MaxEncodedSize(num))) {
+		return 0;
+	}
+
+	// Split the postings into doc_ids and freqs.
+	uint32_t *doc_ids = (uint32_t *)scratch->ids;
+	uint32_t *freqs = doc_ids + num;
+	uint32_t *doc_lengths = freqs + num;
+	int prev = 0;
+	for (int i = 0; i < num; i++) {
+		if (postings[i].doc_id < prev || (i > 0 && postings[i].doc_id == prev) || postings[i].freq <= 0) {
+			return 0; // Postings must be sorted by doc_id.
+		}
+		doc_ids[i] = postings[i].doc_id;
+		freqs[i] = postings[i].freq;
+		if (lengths) {
+			doc_lengths[i] = (uint32_t)postings[i].doc_id < num_lengths ? lengths[postings[i].doc_id] : 0;
+		}
+		prev = postings[i].doc_id;
+	}
+
+	return EncodePostings(doc_ids, freqs, lengths ? doc_lengths : NULL, num, scratch->buf);
+}
+
+
+/*
+ * CompareBlockWord - compare the first word of a block of the dictionary with word, as strcmp.
+ */
+
+static int CompareBlockWord(const IndexFile *index, uint32_t b, const char *word) {
+	const DictBlock *blocks = (const DictBlock *)(index->data + index->header.blocks_offset);
+	const unsigned char *pos = index->data + index->header.dict_offset + blocks[b].dict;
+	const unsigned char *end = index->data + index->header.dict_offset + index->header.dict_size;
+
+	GetVarint(&pos); // The first word shares no prefix.
+	size_t len = GetVarint(&pos);
+	size_t word_len = strlen(word);
+	if (len > (size_t)(end - pos)) {
+		len = end - pos;
+	}
+
+	int cmp = memcmp(pos, word, len < word_len ? len : word_len);
+	if (cmp != 0) {
+		return cmp;
+	}
+	return (len > word_len) - (len < word_len);
+}
+
+
+/*
+ * StartBlock - point a cursor at the first entry of block b, or at the end of the dictionary.
+ */
+
+static void StartBlock(const IndexFile *index, TermCursor *cursor, uint32_t b) {
+	const DictBlock *blocks = (const DictBlock *)(index->data + index->header.blocks_offset);
+
+	if (b < NumDictBlocks(index->header.num_terms)) {
+		cursor->pos = index->data + index->header.dict_offset + blocks[b].dict;
+		cursor->postings = blocks[b].postings;
+		cursor->positions = blocks[b].positions;
+	}
+	else {
+		cursor->pos = index->data + index->header.dict_offset + index->header.dict_size;
+	}
+	cursor->block = b;
+	cursor->in_block = 0;
+	cursor->word[0] = '\0';
+}
+
+
+/*
+ * CopyPositions - append the positions file of a writer to the index file.
+ *
+ * Returns 1 if successful, 0 if not.
+ */
+
+static int CopyPositions(IndexWriter *writer) {
+	unsigned char buf[COPY_BUFFER_SIZE];
+	size_t got;
+
+	if (fflush(writer->positions) != 0 || fseek(writer->positions, 0, SEEK_SET) != 0) {
+		return 0;
+	}
+	while ((got = fread(buf, 1, sizeof(buf), writer->positions)) > 0) {
+		if (fwrite(buf, 1, got, writer->fp) != got) {
+			return 0;
+		}
+	}
+	return !ferror(writer->positions);
+}
+
+
+void FreePostingScratch(PostingScratch *scratch) {
+	free(scratch->buf);
+	free(scratch->ids);
+	free(scratch->positions);
+	memset(scratch, 0, sizeof(PostingScratch));
+}
+
+
+/*
+ * Reserve - grow a buffer to hold at least need bytes.
+ *
+ * Returns 1 if successful, 0 if memory could not be allocated.
+ */
+
+int Reserve(unsigned char **buf, size_t *cap, size_t need) {
+	if (need <= *cap) {
+		return 1;
+	}
+
+	size_t new_cap = *cap ? *cap : 4096;
+	while (new_cap < need) {
+		new_cap *= 2;
+	}
+
+	unsigned char *new_buf = realloc(*buf, new_cap);
+	if (!new_buf) {
+		return 0;
+	}
+	*buf = new_buf;
+	*cap = new_cap;
+	return 1;
+}
@@ -0,0 +1,374 @@
+/* ========================================================================== */
+/* File: indexfile.h
+ *
+ * Project name: CS50 Tiny Search Engine
+ * Component name: Indexer
+ *
+ * This file contains the binary on-disk format of the InvertedIndex, shared by
+ * the indexer (which writes it) and the query engine (which reads it).
+ *
+ * Layout (all integers little-endian):
+ *
+ *     IndexHeader
+ *     postings   for each term: its posting list in blocks of POSTING_BLOCK
+ *                postings, laid out as described in postings.h
+ *     positions  only with INDEX_POSITIONS; for each term: for each of its
+ *                postings, the freq positions of the word in the document as
+ *                varints, the first one as is and the others as the gap from
+ *                the one before
+ *     dictionary for each term in strcmp order, in blocks of DICT_BLOCK terms:
+ *                varint(length of the prefix shared with the previous word
+ *                of the block), varint(length of the rest), the rest of the
+ *                word, varint(df), varint(length of its postings), and with
+ *                INDEX_POSITIONS, varint(length of its positions)
+ *     padding    zeros up to a multiple of 8 bytes
+ *     blocks     a DictBlock for each block of the dictionary
+ *
+ * Posting lists are sorted by doc_id, so each doc_id is stored as the gap
+ * from the previous one. The position of a word is the number of words
+ * before it in the document. Positions are a stream of their own, so looking
+ * up a posting list never reads them. The words are front coded: the first
+ * word of each block is stored whole, the others only after the prefix they
+ * share with the word before them. Every section is protected by a CRC-32.
+ *
+ * Every offset is relative, so the file is used in place: OpenIndexFile maps
+ * it read-only, and SeekIndexTerm binary searches the first words of the
+ * blocks and then scans one block. Query processes share one copy of the
+ * index through the page cache.
+ *
+ * Version 2 replaced the plain varint posting lists of version 1 with
+ * bit-packed blocks. Version 3 added a table of the dictionary entries.
+ * Version 4 front coded the dictionary and replaced the table with one
+ * DictBlock per DICT_BLOCK words. Version 5 added the positions. Version 6
+ * added the length of the shortest document of each block of postings.
+ *
+ */
+/* ========================================================================== */
+#ifndef INDEXFILE_H
+#define INDEXFILE_H
+
+// ---------------- Prerequisites e.g., Requires "math.h"
+#include <stdio.h>                           // FILE
+#include <stdint.h>                          // fixed-width integers
+#include <stddef.h>                          // size_t
+
+// ---------------- Constants
+#define INDEX_MAGIC "TSEINDEX"               // first 8 bytes of every index file
+#define INDEX_VERSION 6                      // bumped on every layout change
+#define INDEX_POSITIONS 1                    // flag: the index has the positions of every word
+
+#define DICT_BLOCK 16                        // words per dictionary block
+#define MAX_TERM_LENGTH 1023                 // longest word the dictionary can hold
+
+// ---------------- Structures/Types
+
+typedef struct IndexHeader {
+  char magic[8];                             // INDEX_MAGIC, not null terminated
+  uint32_t version;                          // INDEX_VERSION
+  uint32_t header_size;                      // sizeof(IndexHeader)
+  uint32_t num_terms;                        // number of distinct words
+  uint32_t num_docs;                         // number of documents indexed
+  uint32_t max_doc_id;                       // largest doc_id in any posting
+  uint32_t flags;                            // INDEX_POSITIONS, or zero
+  uint64_t num_postings;                     // total (doc_id, freq) pairs
+  uint64_t postings_offset;                  // file offset of the postings
+  uint64_t postings_size;                    // bytes of postings
+  uint64_t positions_offset;                 // file offset of the positions
+  uint64_t positions_size;                   // bytes of positions, 0 without INDEX_POSITIONS
+  uint64_t dict_offset;                      // file offset of the dictionary
+  uint64_t dict_size;                        // bytes of dictionary
+  uint64_t blocks_offset;                    // file offset of the DictBlocks, a multiple of 8
+  uint64_t blocks_size;                      // bytes of DictBlocks
+  uint32_t postings_crc;                     // CRC-32 of the postings
+  uint32_t positions_crc;                    // CRC-32 of the positions
+  uint32_t dict_crc;                         // CRC-32 of the dictionary
+  uint32_t blocks_crc;                       // CRC-32 of the DictBlocks
+  uint32_t header_crc;                       // CRC-32 of the header, this field zeroed
+  uint32_t padding;                          // zero
+} IndexHeader;
+
+typedef struct DictBlock {
+  uint64_t postings;                         // offset of the postings of its first word in the postings
+  uint64_t positions;                        // offset of the positions of its first word in the positions
+  uint32_t dict;                             // offset of the block in the dictionary
+  uint32_t padding;                          // zero
+} DictBlock;
+
+typedef struct Posting {
+  int doc_id;                                // document identifier
+  int freq;                                  // number of occurrences of the word
+} Posting;
+
+typedef struct PostingScratch {
+  unsigned char *buf;                        // encoded posting list
+  size_t buf_cap;                            // bytes allocated for buf
+  unsigned char *ids;                        // doc_ids and freqs of the posting list
+  size_t ids_cap;                            // bytes allocated for ids
+  unsigned char *positions;                  // encoded positions of the posting list
+  size_t positions_cap;                      // bytes allocated for positions
+} PostingScratch;
+
+typedef struct IndexWriter {
+  FILE *fp;                                  // index file being written, under temp_name
+  char *file_name;                           // path it is renamed to once complete
+  char *temp_name;                           // path it is written to, file_name.tmp
+  FILE *positions;                           // positions, copied after the postings at close; NULL without INDEX_POSITIONS
+  IndexHeader header;                        // counts gathered so far
+  unsigned char *dict;                       // dictionary, appended at close
+  size_t dict_cap;                           // bytes allocated for dict
+  DictBlock *blocks;                         // DictBlocks, appended at close
+  size_t blocks_cap;                         // bytes allocated for blocks
+  PostingScratch scratch;                    // space to encode one posting list
+  const uint32_t *lengths;                   // length of each doc_id below num_lengths, NULL if unknown
+  uint32_t num_lengths;                      // doc_ids in lengths
+  char last_word[MAX_TERM_LENGTH + 1];       // previous word
+} IndexWriter;
+
+typedef struct IndexFile {
+  IndexHeader header;                        // validated header
+  const unsigned char *data;                 // the whole file, mapped read-only
+  size_t size;                               // bytes in data
+} IndexFile;
+
+typedef struct IndexTerm {
+  const char *word;                          // the word, null terminated
+  int df;                                    // number of documents with the word
+  const unsigned char *postings;             // encoded posting list
+  size_t postings_size;                      // bytes of encoded postings
+  const unsigned char *positions;            // encoded positions, NULL without INDEX_POSITIONS
+  size_t positions_size;                     // bytes of encoded positions
+} IndexTerm;
+
+typedef struct TermCursor {
+  const unsigned char *pos;                  // next dictionary entry, NULL before the first one
+  uint32_t block;                            // block of the next entry
+  int in_block;                              // entries of the block read so far
+  uint64_t postings;                         // offset of the postings of the next entry
+  uint64_t positions;                        // offset of the positions of the next entry
+  char word[MAX_TERM_LENGTH + 1];            // word of the last entry read
+} TermCursor;
+
+// ---------------- Public Variables
+
+// ---------------- Prototypes/Macros
+
+/*
+ * OpenIndexWriter - start writing a binary index file
+ * @writer: writer to initialize
+ * @file_name: path of the index file, replaced if it exists
+ * @flags: INDEX_POSITIONS to store the positions of the words, or 0
+ *
+ * Returns 1 if successful; otherwise, 0. The file is written to file_name.tmp
+ * and renamed over file_name by CloseIndexWriter, so a reader that has the old
+ * file mapped keeps it whole. With INDEX_POSITIONS, the positions
+ * are streamed to a temporary file until CloseIndexWriter. Set writer->lengths
+ * to the length of every document before adding words, for the shortest
+ * length of each block of postings (see postings.h); it is not copied.
+ *
+ * Usage example:
+ * IndexWriter writer;
+ * if (OpenIndexWriter(&writer, "index.dat", 0)) {
+ *     AddIndexTerm(&writer, "dog", postings, num, NULL);   // words in strcmp order
+ *     ...
+ *     CloseIndexWriter(&writer, num_docs);
+ * }
+ */
+int OpenIndexWriter(IndexWriter *writer, const char *file_name, uint32_t flags);
+
+/*
+ * AddIndexTerm - append a word and its posting list
+ * @writer: open writer
+ * @word: the word; must sort strictly after the previous word
+ * @postings: array of postings, sorted by doc_id
+ * @num: number of postings
+ * @positions: with INDEX_POSITIONS, the positions of the word in each posting
+ *             in turn, freq of them per posting, increasing within a posting;
+ *             ignored otherwise
+ *
+ * Returns 1 if successful; otherwise, 0.
+ */
+int AddIndexTerm(IndexWriter *writer, const char *word, const Posting *postings, int num, const int *positions);
+
+/*
+ * CloseIndexWriter - write the dictionary and header, then close the file
+ * @writer: open writer
+ * @num_docs: number of documents that were indexed
+ *
+ * Returns 1 if successful; otherwise, 0. The writer is freed either way, and
+ * the file is only renamed into place if successful.
+ */
+int CloseIndexWriter(IndexWriter *writer, int num_docs);
+
+/*
+ * AbortIndexWriter - give up an index file, leaving the one in place as it was
+ * @writer: open writer, freed
+ */
+void AbortIndexWriter(IndexWriter *writer);
+
+/*
+ * OpenIndexFile - map and validate a binary index file
+ * @index: index file to fill in
+ * @file_name: path of the index file
+ *
+ * Returns 1 if successful; 0 if the file cannot be mapped, is not a binary
+ * index, has the wrong version, or its dictionary or DictBlocks fail a
+ * checksum. The postings are not read; see VerifyIndexFile.
+ *
+ * The file is mapped shared and read-only, so every process that opens the
+ * same index uses the same pages of the page cache.
+ */
+int OpenIndexFile(IndexFile *index, const char *file_name);
+
+/*
+ * VerifyIndexFile - check the postings of an open index file
+ * @index: index file opened with OpenIndexFile
+ *
+ * Returns 1 if the postings match their checksum; otherwise, 0. This reads
+ * the whole file, so callers that decode every posting list call it, and
+ * callers that only look up a few words do not.
+ */
+int VerifyIndexFile(const IndexFile *index);
+
+/*
+ * CloseIndexFile - unmap an index file
+ * @index: index file opened with OpenIndexFile
+ */
+void CloseIndexFile(IndexFile *index);
+
+/*
+ * SeekIndexTerm - find the first word of the dictionary that is not before a word
+ * @index: open index file
+ * @cursor: cursor to position; NextIndexTerm then goes on from the word found
+ * @word: the word to seek
+ * @term: filled in with the first word in strcmp order that is >= word
+ *
+ * Returns 1 if there is such a word; 0 if word is after the whole dictionary.
+ * A binary search of the first words of the blocks picks one block, and the
+ * block is scanned. Prefix and range queries seek their lower bound and call
+ * NextIndexTerm until the word no longer matches.
+ *
+ * Usage example:
+ * TermCursor cursor;
+ * IndexTerm term;
+ * for (int more = SeekIndexTerm(&index, &cursor, "comp", &term);
+ *         more && strncmp(term.word, "comp", 4) == 0;
+ *         more = NextIndexTerm(&index, &cursor, &term)) {
+ *     // term.word starts with "comp"
+ * }
+ */
+int SeekIndexTerm(const IndexFile *index, TermCursor *cursor, const char *word, IndexTerm *term);
+
+/*
+ * FindIndexTerm - look up a word with SeekIndexTerm
+ * @index: open index file
+ * @word: the word
+ * @term: filled in with its df and its encoded postings; term->word is word
+ *
+ * Returns 1 if the index has the word; otherwise, 0.
+ *
+ * Usage example:
+ * IndexTerm term;
+ * if (FindIndexTerm(&index, "dog", &term)) {
+ *     Posting *postings = calloc(term.df, sizeof(Posting));
+ *     DecodePostings(&term, postings);
+ *     ...
+ * }
+ */
+int FindIndexTerm(const IndexFile *index, const char *word, IndexTerm *term);
+
+/*
+ * NextIndexTerm - walk the dictionary in word order
+ * @index: open index file
+ * @cursor: cursor; zero it before the first call, or position it with SeekIndexTerm
+ * @term: filled in with the next word; term->word lives in the cursor
+ *
+ * Returns 1 while there are words left; otherwise, 0.
+ *
+ * Usage example:
+ * TermCursor cursor = {0};
+ * IndexTerm term;
+ * while (NextIndexTerm(&index, &cursor, &term)) {
+ *     Posting *postings = calloc(term.df, sizeof(Posting));
+ *     DecodePostings(&term, postings);
+ *     ...
+ * }
+ */
+int NextIndexTerm(const IndexFile *index, TermCursor *cursor, IndexTerm *term);
+
+/*
+ * DecodePostings - decode the posting list of a word
+ * @term: word returned by NextIndexTerm
+ * @postings: array of at least term->df postings
+ *
+ * Returns the number of postings decoded.
+ */
+int DecodePostings(const IndexTerm *term, Posting *postings);
+
+/*
+ * DecodePositions - decode the positions of the postings of a word
+ * @term: word returned by NextIndexTerm, of an index with INDEX_POSITIONS
+ * @postings: its postings, from DecodePostings
+ * @num: number of postings, term->df
+ * @positions: array of at least the sum of the freqs of the postings
+ *
+ * Returns the number of positions decoded, or -1 if the positions of the word
+ * end before those of its last posting.
+ *
+ * Usage example:
+ * DecodePostings(&term, postings);
+ * int *positions = malloc(total_freq * sizeof(int));
+ * DecodePositions(&term, postings, term.df, positions);
+ * // the positions of postings[1] follow the postings[0].freq positions of postings[0]
+ */
+int DecodePositions(const IndexTerm *term, const Posting *postings, int num, int *positions);
+
+/*
+ * EncodePositionList - encode the positions of a posting list into scratch->positions
+ * @postings: array of postings
+ * @num: number of postings
+ * @positions: positions of each posting in turn, as for AddIndexTerm
+ * @scratch: as for EncodePostingList
+ *
+ * Returns the number of bytes encoded, 0 if the positions of a posting are
+ * not increasing or memory could not be allocated.
+ */
+size_t EncodePositionList(const Posting *postings, int num, const int *positions, PostingScratch *scratch);
+
+/*
+ * EncodePostingList - encode a posting list with EncodePostings
+ * @postings: array of postings, sorted by doc_id
+ * @num: number of postings, at least 1
+ * @lengths: length of each doc_id below num_lengths, NULL if unknown
+ * @num_lengths: doc_ids in lengths
+ * @scratch: zeroed before first use; the encoded list is left in scratch->buf
+ *
+ * Returns the number of bytes encoded, 0 if the postings are not sorted by
+ * doc_id or memory could not be allocated. Free scratch with FreePostingScratch.
+ */
+size_t EncodePostingList(const Posting *postings, int num, const uint32_t *lengths, uint32_t num_lengths,
+		PostingScratch *scratch);
+
+void FreePostingScratch(PostingScratch *scratch);
+
+/*
+ * Reserve - grow a malloc'd buffer to hold at least need bytes
+ * @buf: buffer, NULL to start
+ * @cap: bytes allocated for *buf
+ * @need: bytes needed
+ *
+ * Returns 1 if successful, 0 if memory could not be allocated.
+ */
+int Reserve(unsigned char **buf, size_t *cap, size_t need);
+
+/*
+ * Crc32 - continue a CRC-32 (IEEE 802.3) over a buffer
+ * @crc: CRC of the preceding bytes, 0 to start
+ * @buf: bytes to add
+ * @len: number of bytes
+ *
+ * Returns the updated CRC. Its lookup table is a constant, so threads can call
+ * it at the same time.
+ */
+uint32_t Crc32(uint32_t crc, const void *buf, size_t len);
+
+#endif // INDEXFILE_H
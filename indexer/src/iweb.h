@@ -50,7 +50,9 @@ int GetNextWord(const char *doc, int pos, char **word);
  * NormalizeWord - lowercases all the alphabetic characters in word
  * @word: the character buffer to normalize
  *
- * Word is modified in-place, with all uppercase letters lowered.
+ * Word is modified in-place, with all uppercase letters lowered. A word
+ * longer than MAX_TERM_LENGTH is cut to its first MAX_TERM_LENGTH letters,
+ * so the indexer and the query engine agree on the words of a long token.
  *
  * Usage example:
  * char *str = "HELLO WORLD!";
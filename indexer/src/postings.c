@@ -0,0 +1,362 @@
+/* ========================================================================== */
+/* File: postings.c
+ *
+ * Project name: CS50 Tiny Search Engine
+ * Component name: Indexer
+ *
+ * This file includes the block codec used for the posting lists of the index file.
+ * Please go to the top of each function for more detailed descriptions.
+ */
+/* ========================================================================== */
+
+// ---------------- Open Issues
+
+// ---------------- System includes e.g., <stdio.h>
+#include <string.h>                          // memcpy, memset
+#ifdef __SSE2__
+#include <emmintrin.h>                       // SSE2 intrinsics
+#endif
+
+// ---------------- Local includes  e.g., "file.h"
+#include "postings.h"                        // posting codec functionality
+
+// ---------------- Constant definitions
+
+// ---------------- Macro definitions
+#define LANES 4                              // 32-bit lanes in a 128-bit register
+
+// ---------------- Structures/Types
+_Static_assert(sizeof(PostingBlock) == 16, "PostingBlock must be packed");
+
+// ---------------- Private variables
+
+// ---------------- Private prototypes
+static int BitsNeeded(const uint32_t *, int);
+static void PackBits(const uint32_t *, int, unsigned char *);
+static void PrefixSum(uint32_t *, uint32_t);
+static void AddOne(uint32_t *);
+
+
+size_t MaxEncodedSize(int num) {
+	return (size_t)NumBlocks(num) * sizeof(PostingBlock) + (size_t)num * 2 * MAX_VARINT;
+}
+
+
+/*
+ * EncodePostings - encode a posting list into blocks.
+ * @doc_ids: doc_ids of the list, strictly increasing.
+ * @freqs: freqs of the list.
+ * @lengths: length of the document of each posting, NULL if unknown.
+ * @num: number of postings.
+ * @out: buffer for the encoded list.
+ *
+ * Returns the number of bytes written.
+ *
+ * Pseudocode:
+ *     1. Reserve room for one header per block at the start of out.
+ *     2. For each full block, turn doc_ids into gaps - 1 and freqs into freqs - 1,
+ *        find the bits needed for each, and bit-pack them.
+ *     3. Write a short last block as varint pairs.
+ *     4. Fill in the header of each block, with its largest freq and shortest document.
+ *        A document of unknown length makes the shortest length of its block 0.
+ */
+
+size_t EncodePostings(const uint32_t *doc_ids, const uint32_t *freqs, const uint32_t *lengths, int num,
+		unsigned char *out) {
+
+	int num_blocks = NumBlocks(num);
+	unsigned char *data = out + num_blocks * sizeof(PostingBlock); // block data follows the headers
+	size_t len = 0;
+	uint32_t prev = 0;
+
+	for (int b = 0; b < num_blocks; b++) {
+		const uint32_t *docs = doc_ids + b * POSTING_BLOCK;
+		const uint32_t *fqs = freqs + b * POSTING_BLOCK;
+		int n = (num - b * POSTING_BLOCK < POSTING_BLOCK) ? num - b * POSTING_BLOCK : POSTING_BLOCK;
+		PostingBlock block = {0};
+
+		block.offset = len;
+		block.last_doc_id = docs[n - 1];
+		block.min_length = lengths ? UINT32_MAX : 0;
+		for (int i = 0; i < n; i++) {
+			if (fqs[i] > block.max_freq) {
+				block.max_freq = fqs[i] > 0xFFFF ? 0xFFFF : fqs[i];
+			}
+			if (lengths && lengths[b * POSTING_BLOCK + i] < block.min_length) {
+				block.min_length = lengths[b * POSTING_BLOCK + i];
+			}
+		}
+
+		if (n == POSTING_BLOCK) {
+			// Bit-pack a full block.
+			uint32_t gaps[POSTING_BLOCK], vals[POSTING_BLOCK];
+			for (int i = 0; i < n; i++) {
+				gaps[i] = docs[i] - prev - 1;
+				vals[i] = fqs[i] - 1;
+				prev = docs[i];
+			}
+			block.doc_bits = BitsNeeded(gaps, n);
+			block.freq_bits = BitsNeeded(vals, n);
+			PackBits(gaps, block.doc_bits, data + len);
+			len += 16 * block.doc_bits;
+			PackBits(vals, block.freq_bits, data + len);
+			len += 16 * block.freq_bits;
+		}
+		else {
+			// Write a short last block as varints.
+			for (int i = 0; i < n; i++) {
+				len += PutVarint(data + len, docs[i] - prev);
+				len += PutVarint(data + len, fqs[i]);
+				prev = docs[i];
+			}
+		}
+
+		memcpy(out + b * sizeof(PostingBlock), &block, sizeof(PostingBlock));
+	}
+	return num_blocks * sizeof(PostingBlock) + len;
+}
+
+
+void GetPostingBlock(const unsigned char *list, int b, PostingBlock *block) {
+	memcpy(block, list + b * sizeof(PostingBlock), sizeof(PostingBlock));
+}
+
+
+/*
+ * DecodeBlock - decode one block of an encoded posting list.
+ * @list: start of the encoded list.
+ * @df: number of postings in the list.
+ * @b: block number.
+ * @doc_ids: filled in with the doc_ids of the block.
+ * @freqs: filled in with the freqs of the block.
+ *
+ * Returns the number of postings in the block.
+ *
+ * Pseudocode:
+ *     1. Get the header of the block, and the last doc_id of the block before it.
+ *     2. For a full block, unpack the gaps and rebuild doc_ids with a prefix sum,
+ *        then unpack the freqs and add one back.
+ *     3. For a short last block, read the varint pairs.
+ */
+
+int DecodeBlock(const unsigned char *list, int df, int b, uint32_t *doc_ids, uint32_t *freqs) {
+
+	int num_blocks = NumBlocks(df);
+	const unsigned char *data = list + num_blocks * sizeof(PostingBlock);
+	PostingBlock block;
+	uint32_t prev = 0;
+
+	GetPostingBlock(list, b, &block);
+	if (b > 0) {
+		PostingBlock before;
+		GetPostingBlock(list, b - 1, &before);
+		prev = before.last_doc_id;
+	}
+	data += block.offset;
+
+	int n = df - b * POSTING_BLOCK;
+	if (n >= POSTING_BLOCK) {
+		UnpackBits(data, block.doc_bits, doc_ids);
+		PrefixSum(doc_ids, prev);
+		UnpackBits(data + 16 * block.doc_bits, block.freq_bits, freqs);
+		AddOne(freqs);
+		return POSTING_BLOCK;
+	}
+
+	for (int i = 0; i < n; i++) {
+		prev += GetVarint(&data);
+		doc_ids[i] = prev;
+		freqs[i] = GetVarint(&data);
+	}
+	return n;
+}
+
+
+/*
+ * UnpackBits - unpack a block of interleaved bit-packed values.
+ * @in: packed values; each lane holds every fourth value, bits bits apiece.
+ * @bits: bits per value.
+ * @out: POSTING_BLOCK unpacked values.
+ *
+ * Pseudocode:
+ *     1. Load the first packed word of all four lanes.
+ *     2. For each group of four values, shift the current words right and mask.
+ *     3. When a value runs past the end of the current words, load the next
+ *        words and or in their low bits.
+ */
+
+void UnpackBits(const unsigned char *in, int bits, uint32_t *out) {
+#ifdef __SSE2__
+	if (bits == 0) {
+		memset(out, 0, POSTING_BLOCK * sizeof(uint32_t));
+		return;
+	}
+
+	const __m128i mask = _mm_set1_epi32(bits == 32 ? 0xFFFFFFFFu : (1u << bits) - 1);
+	const __m128i *src = (const __m128i *)in;
+	__m128i cur = _mm_loadu_si128(src++);
+	int shift = 0;
+
+	for (int k = 0; k < POSTING_BLOCK / LANES; k++) {
+		__m128i v = _mm_srl_epi32(cur, _mm_cvtsi32_si128(shift));
+		shift += bits;
+
+		// The value continues in the next word of each lane.
+		if (shift >= 32) {
+			shift -= 32;
+			if (k < POSTING_BLOCK / LANES - 1) {
+				cur = _mm_loadu_si128(src++);
+				if (shift > 0) {
+					v = _mm_or_si128(v, _mm_sll_epi32(cur, _mm_cvtsi32_si128(bits - shift)));
+				}
+			}
+		}
+		_mm_storeu_si128((__m128i *)(out + k * LANES), _mm_and_si128(v, mask));
+	}
+#else
+	UnpackBitsScalar(in, bits, out);
+#endif
+}
+
+
+void UnpackBitsScalar(const unsigned char *in, int bits, uint32_t *out) {
+	uint32_t mask = (bits == 32) ? 0xFFFFFFFFu : (1u << bits) - 1;
+
+	for (int lane = 0; lane < LANES; lane++) {
+		int bit = 0; // bit position within the lane
+		for (int k = 0; k < POSTING_BLOCK / LANES; k++) {
+			uint32_t word, next;
+			int shift = bit % 32;
+			uint64_t v;
+
+			if (bits == 0) {
+				out[k * LANES + lane] = 0;
+				continue;
+			}
+			memcpy(&word, in + 4 * (LANES * (bit / 32) + lane), 4);
+			v = word >> shift;
+			if (shift + bits > 32) {
+				memcpy(&next, in + 4 * (LANES * (bit / 32 + 1) + lane), 4);
+				v |= (uint64_t)next << (32 - shift);
+			}
+			out[k * LANES + lane] = (uint32_t)v & mask;
+			bit += bits;
+		}
+	}
+}
+
+
+int PutVarint(unsigned char *buf, uint32_t v) {
+	int n = 0;
+
+	while (v >= 0x80) {
+		buf[n++] = (unsigned char)(v | 0x80);
+		v >>= 7;
+	}
+	buf[n++] = (unsigned char)v;
+	return n;
+}
+
+
+uint32_t GetVarint(const unsigned char **pos) {
+	const unsigned char *p = *pos;
+	uint32_t v = 0;
+	int shift = 0;
+
+	while (*p & 0x80) {
+		v |= (uint32_t)(*p++ & 0x7F) << shift;
+		shift += 7;
+	}
+	v |= (uint32_t)*p++ << shift;
+	*pos = p;
+	return v;
+}
+
+
+/*
+ * BitsNeeded - number of bits needed to hold the largest of n values.
+ */
+
+static int BitsNeeded(const uint32_t *vals, int n) {
+	uint32_t all = 0;
+	int bits = 0;
+
+	for (int i = 0; i < n; i++) {
+		all |= vals[i];
+	}
+	while (all) {
+		bits++;
+		all >>= 1;
+	}
+	return bits;
+}
+
+
+/*
+ * PackBits - pack POSTING_BLOCK values of bits bits each, interleaved over four lanes.
+ */
+
+static void PackBits(const uint32_t *vals, int bits, unsigned char *out) {
+	uint32_t words[POSTING_BLOCK] = {0}; // at most 32 words per lane
+
+	for (int lane = 0; lane < LANES && bits > 0; lane++) {
+		int bit = 0;
+		for (int k = 0; k < POSTING_BLOCK / LANES; k++) {
+			uint32_t v = vals[k * LANES + lane];
+			int w = bit / 32, shift = bit % 32;
+
+			words[LANES * w + lane] |= v << shift;
+			if (shift + bits > 32) {
+				words[LANES * (w + 1) + lane] |= v >> (32 - shift);
+			}
+			bit += bits;
+		}
+	}
+	memcpy(out, words, 16 * bits);
+}
+
+
+/*
+ * PrefixSum - turn gaps - 1 back into doc_ids, starting from the doc_id before the block.
+ */
+
+static void PrefixSum(uint32_t *vals, uint32_t prev) {
+#ifdef __SSE2__
+	const __m128i one = _mm_set1_epi32(1);
+	__m128i run = _mm_set1_epi32(prev);
+
+	for (int k = 0; k < POSTING_BLOCK; k += LANES) {
+		__m128i v = _mm_add_epi32(_mm_loadu_si128((__m128i *)(vals + k)), one);
+		v = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+		v = _mm_add_epi32(v, _mm_slli_si128(v, 8));
+		v = _mm_add_epi32(v, run);
+		_mm_storeu_si128((__m128i *)(vals + k), v);
+		run = _mm_shuffle_epi32(v, 0xFF); // broadcast the last doc_id
+	}
+#else
+	for (int i = 0; i < POSTING_BLOCK; i++) {
+		prev += vals[i] + 1;
+		vals[i] = prev;
+	}
+#endif
+}
+
+
+/*
+ * AddOne - turn freqs - 1 back into freqs.
+ */
+
+static void AddOne(uint32_t *vals) {
+#ifdef __SSE2__
+	const __m128i one = _mm_set1_epi32(1);
+
+	for (int k = 0; k < POSTING_BLOCK; k += LANES) {
+		__m128i v = _mm_loadu_si128((__m128i *)(vals + k));
+		_mm_storeu_si128((__m128i *)(vals + k), _mm_add_epi32(v, one));
+	}
+#else
+	for (int i = 0; i < POSTING_BLOCK; i++) {
+		vals[i]++;
+	}
+#endif
+}
@@ -0,0 +1,126 @@
+/* ========================================================================== */
+/* File: postings.h
+ *
+ * Project name: CS50 Tiny Search Engine
+ * Component name: Indexer
+ *
+ * This file contains the block codec for posting lists.
+ *
+ * A posting list is cut into blocks of POSTING_BLOCK postings. The list starts
+ * with one PostingBlock header per block, followed by the block data:
+ *
+ *     full block   doc_id gaps - 1 bit-packed with doc_bits bits, then
+ *                  freqs - 1 bit-packed with freq_bits bits
+ *     last block   if it has fewer than POSTING_BLOCK postings, varint pairs
+ *                  of (doc_id gap, freq)
+ *
+ * Bit-packed values are interleaved over four 32-bit lanes (value i lives in
+ * lane i % 4), so a block unpacks four values per SSE2 instruction.
+ * The header of each block carries its last doc_id, its largest freq and the
+ * length of its shortest document, so whole blocks can be skipped without
+ * decoding them, and the best score of any posting of a block bounded (see
+ * ../../query/src/topk.h).
+ *
+ */
+/* ========================================================================== */
+#ifndef POSTINGS_H
+#define POSTINGS_H
+
+// ---------------- Prerequisites e.g., Requires "math.h"
+#include <stdint.h>                          // fixed-width integers
+#include <stddef.h>                          // size_t
+
+// ---------------- Constants
+#define POSTING_BLOCK 128                    // postings per block
+#define MAX_VARINT 5                         // bytes needed for a 32 bit varint
+
+// ---------------- Structures/Types
+
+typedef struct PostingBlock {
+  uint32_t last_doc_id;                      // largest doc_id in the block
+  uint32_t offset;                           // offset of the block data from the end of the headers
+  uint16_t max_freq;                         // largest freq in the block, capped at 65535
+  uint8_t doc_bits;                          // bits per packed doc_id gap
+  uint8_t freq_bits;                         // bits per packed freq
+  uint32_t min_length;                       // words in the shortest document of the block, 0 if unknown
+} PostingBlock;
+
+// ---------------- Public Variables
+
+// ---------------- Prototypes/Macros
+
+/*
+ * NumBlocks - number of blocks in a posting list of df postings
+ */
+#define NumBlocks(df) (((df) + POSTING_BLOCK - 1) / POSTING_BLOCK)
+
+/*
+ * MaxEncodedSize - upper bound on the bytes EncodePostings writes for num postings
+ */
+size_t MaxEncodedSize(int num);
+
+/*
+ * EncodePostings - encode a posting list into blocks
+ * @doc_ids: doc_ids, strictly increasing
+ * @freqs: freqs, all at least 1
+ * @lengths: length of the document of each posting, 0 if unknown; NULL if none is known
+ * @num: number of postings
+ * @out: buffer of at least MaxEncodedSize(num) bytes
+ *
+ * Returns the number of bytes written.
+ */
+size_t EncodePostings(const uint32_t *doc_ids, const uint32_t *freqs, const uint32_t *lengths, int num,
+		unsigned char *out);
+
+/*
+ * GetPostingBlock - read the header of block b of an encoded posting list
+ * @list: start of the encoded list
+ * @b: block number
+ * @block: filled in with the header
+ */
+void GetPostingBlock(const unsigned char *list, int b, PostingBlock *block);
+
+/*
+ * DecodeBlock - decode one block of an encoded posting list
+ * @list: start of the encoded list
+ * @df: number of postings in the whole list
+ * @b: block number
+ * @doc_ids: array of at least POSTING_BLOCK entries
+ * @freqs: array of at least POSTING_BLOCK entries
+ *
+ * Returns the number of postings in the block.
+ *
+ * Usage example:
+ * uint32_t doc_ids[POSTING_BLOCK], freqs[POSTING_BLOCK];
+ * for (int b = 0; b < NumBlocks(df); b++) {
+ *     int n = DecodeBlock(list, df, b, doc_ids, freqs);
+ *     // use doc_ids[0..n-1], freqs[0..n-1]
+ * }
+ */
+int DecodeBlock(const unsigned char *list, int df, int b, uint32_t *doc_ids, uint32_t *freqs);
+
+/*
+ * UnpackBits - unpack POSTING_BLOCK values of bits bits each
+ * @in: 16 * bits bytes of interleaved packed values
+ * @bits: bits per value, 0 to 32
+ * @out: array of POSTING_BLOCK values
+ *
+ * Uses SSE2 when the compiler targets it. UnpackBitsScalar does the same
+ * one value at a time; both are exposed for testing and benchmarking.
+ */
+void UnpackBits(const unsigned char *in, int bits, uint32_t *out);
+void UnpackBitsScalar(const unsigned char *in, int bits, uint32_t *out);
+
+/*
+ * PutVarint - write v as a little-endian base 128 varint
+ *
+ * Returns the number of bytes written (1 to MAX_VARINT).
+ */
+int PutVarint(unsigned char *buf, uint32_t v);
+
+/*
+ * GetVarint - read a varint and advance *pos past it
+ */
+uint32_t GetVarint(const unsigned char **pos);
+
+#endif // POSTINGS_H
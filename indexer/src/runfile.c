@@ -0,0 +1,181 @@
+/* ========================================================================== */
+/* File: runfile.c
+ *
+ * Project name: CS50 Tiny Search Engine
+ * Component name: Indexer
+ *
+ * This file includes the writer and the reader of the sorted run files.
+ * Please go to the top of each function for more detailed descriptions.
+ */
+/* ========================================================================== */
+
+// ---------------- Open Issues
+
+// ---------------- System includes e.g., <stdio.h>
+#include <stdio.h>                           // FILE, fread, fwrite, setvbuf
+#include <stdlib.h>                          // malloc, free
+#include <string.h>                          // memset, strlen
+
+// ---------------- Local includes  e.g., "file.h"
+#include "runfile.h"                         // run file functionality
+
+// ---------------- Constant definitions
+
+// ---------------- Macro definitions
+
+// ---------------- Structures/Types
+
+// ---------------- Private variables
+
+// ---------------- Private prototypes
+static FILE *OpenBuffered(const char *, const char *, char **);
+
+
+int OpenRunWriter(RunWriter *writer, const char *file_name) {
+	memset(writer, 0, sizeof(RunWriter));
+	writer->fp = OpenBuffered(file_name, "wb", &writer->stdio_buf);
+	return writer->fp != NULL;
+}
+
+
+/*
+ * AddRunTerm - append a word and its posting list to a run file.
+ * @writer: open writer.
+ * @word: the word.
+ * @postings: postings of the word, sorted by doc_id.
+ * @num: number of postings.
+ * @positions: positions of each posting in turn, NULL if none.
+ *
+ * Returns 1 if successful, 0 if not.
+ *
+ * Pseudocode:
+ *     1. Encode the postings with EncodePostingList, and the positions with EncodePositionList.
+ *     2. Write the lengths, the word, the encoded postings and the encoded positions.
+ */
+
+int AddRunTerm(RunWriter *writer, const char *word, const Posting *postings, int num, const int *positions) {
+
+	size_t len = EncodePostingList(postings, num, NULL, 0, &writer->scratch);
+	if (len == 0) {
+		return 0;
+	}
+	size_t positions_len = 0;
+	if (positions && !(positions_len = EncodePositionList(postings, num, positions, &writer->scratch))) {
+		return 0;
+	}
+
+	uint32_t lengths[4] = { strlen(word), num, len, positions_len };
+	return fwrite(lengths, sizeof(lengths), 1, writer->fp) == 1 &&
+			fwrite(word, 1, lengths[0], writer->fp) == lengths[0] &&
+			fwrite(writer->scratch.buf, 1, len, writer->fp) == len &&
+			fwrite(writer->scratch.positions, 1, positions_len, writer->fp) == positions_len;
+}
+
+
+int CloseRunWriter(RunWriter *writer) {
+	int ok = fclose(writer->fp) == 0;
+
+	FreePostingScratch(&writer->scratch);
+	free(writer->stdio_buf);
+	writer->fp = NULL;
+	writer->stdio_buf = NULL;
+	return ok;
+}
+
+
+int OpenRunReader(RunReader *reader, const char *file_name) {
+	memset(reader, 0, sizeof(RunReader));
+	reader->fp = OpenBuffered(file_name, "rb", &reader->stdio_buf);
+	return reader->fp != NULL;
+}
+
+
+/*
+ * NextRunTerm - read the next record of a run file.
+ * @reader: open reader.
+ *
+ * Returns 1 if a word was read, 0 at the end of the run, -1 on error.
+ *
+ * Pseudocode:
+ *     1. Read the lengths of the record; a clean end of file ends the run.
+ *     2. Read the word, the encoded postings and the encoded positions into buffers grown as needed.
+ *     3. Decode the postings with DecodePostings, and the positions with DecodePositions.
+ */
+
+int NextRunTerm(RunReader *reader) {
+
+	uint32_t lengths[4];
+	size_t got = fread(lengths, 1, sizeof(lengths), reader->fp);
+	if (got == 0 && feof(reader->fp)) {
+		return 0;
+	}
+	if (got != sizeof(lengths) || lengths[1] == 0) {
+		return -1;
+	}
+
+	// Make room for the record.
+	if (!Reserve((unsigned char **)&reader->word, &reader->word_cap, lengths[0] + 1) ||
+			!Reserve(&reader->buf, &reader->buf_cap, (size_t)lengths[2] + lengths[3]) ||
+			!Reserve((unsigned char **)&reader->postings, &reader->postings_cap, lengths[1] * sizeof(Posting))) {
+		return -1;
+	}
+
+	// Read the word and its postings.
+	if (fread(reader->word, 1, lengths[0], reader->fp) != lengths[0] ||
+			fread(reader->buf, 1, (size_t)lengths[2] + lengths[3], reader->fp) != (size_t)lengths[2] + lengths[3]) {
+		return -1;
+	}
+	reader->word[lengths[0]] = '\0';
+	reader->df = lengths[1];
+
+	IndexTerm term = { reader->word, reader->df, reader->buf, lengths[2], reader->buf + lengths[2], lengths[3] };
+	DecodePostings(&term, reader->postings);
+	reader->num_positions = 0;
+	if (lengths[3] == 0) {
+		return 1;
+	}
+
+	// Decode the positions, freq of them per posting.
+	size_t total = 0;
+	for (int i = 0; i < reader->df; i++) {
+		total += reader->postings[i].freq;
+	}
+	if (!Reserve((unsigned char **)&reader->positions, &reader->positions_cap, total * sizeof(int)) ||
+			(reader->num_positions = DecodePositions(&term, reader->postings, reader->df, reader->positions)) < 0) {
+		return -1;
+	}
+	return 1;
+}
+
+
+void CloseRunReader(RunReader *reader) {
+	fclose(reader->fp);
+	free(reader->stdio_buf);
+	free(reader->word);
+	free(reader->postings);
+	free(reader->positions);
+	free(reader->buf);
+	memset(reader, 0, sizeof(RunReader));
+}
+
+
+/*
+ * OpenBuffered - open a file with a RUN_BUFFER_SIZE stdio buffer.
+ * @buf: set to the buffer, to be freed once the file is closed.
+ *
+ * Returns the stream, NULL if not successful. The buffer is allocated here,
+ * since stdio may ignore the size asked for when it allocates the buffer itself.
+ */
+
+static FILE *OpenBuffered(const char *file_name, const char *mode, char **buf) {
+	FILE *fp = fopen(file_name, mode);
+
+	*buf = NULL;
+	if (fp && (!(*buf = (char *)malloc(RUN_BUFFER_SIZE)) || setvbuf(fp, *buf, _IOFBF, RUN_BUFFER_SIZE) != 0)) {
+		fclose(fp);
+		free(*buf);
+		*buf = NULL;
+		return NULL;
+	}
+	return fp;
+}
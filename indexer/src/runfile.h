@@ -0,0 +1,130 @@
+/* ========================================================================== */
+/* File: runfile.h
+ *
+ * Project name: CS50 Tiny Search Engine
+ * Component name: Indexer
+ *
+ * This file contains the sorted run files written by the indexer when the
+ * InvertedIndex outgrows its memory budget. A run is a sequence of records,
+ * one per word in strcmp order:
+ *
+ *     uint32 word length, uint32 df, uint32 postings length, uint32 positions length,
+ *     word (not null terminated), postings (encoded as in postings.h),
+ *     positions (encoded as in indexfile.h; none when the index has no positions)
+ *
+ * Runs are only read front to back, once, so both the writer and the reader
+ * go through RUN_BUFFER_SIZE stdio buffers.
+ *
+ */
+/* ========================================================================== */
+#ifndef RUNFILE_H
+#define RUNFILE_H
+
+// ---------------- Prerequisites e.g., Requires "math.h"
+#include <stdio.h>                           // FILE
+#include <stdint.h>                          // fixed-width integers
+#include <stddef.h>                          // size_t
+
+#include "indexfile.h"                       // Posting, PostingScratch
+
+// ---------------- Constants
+#define RUN_BUFFER_SIZE (1 << 20)            // stdio buffer of each run file (1 MB)
+
+// ---------------- Structures/Types
+
+typedef struct RunWriter {
+  FILE *fp;                                  // run file being written
+  char *stdio_buf;                           // its RUN_BUFFER_SIZE stdio buffer
+  PostingScratch scratch;                    // space to encode one posting list
+} RunWriter;
+
+typedef struct RunReader {
+  FILE *fp;                                  // run file being read
+  char *stdio_buf;                           // its RUN_BUFFER_SIZE stdio buffer
+  char *word;                                // current word, null terminated
+  size_t word_cap;                           // bytes allocated for word
+  int df;                                    // number of postings of the current word
+  Posting *postings;                         // decoded postings of the current word
+  size_t postings_cap;                       // bytes allocated for postings
+  int *positions;                            // decoded positions of the current word, if the run has them
+  size_t positions_cap;                      // bytes allocated for positions
+  int num_positions;                         // number of positions of the current word
+  unsigned char *buf;                        // encoded postings and positions of the current word
+  size_t buf_cap;                            // bytes allocated for buf
+} RunReader;
+
+// ---------------- Public Variables
+
+// ---------------- Prototypes/Macros
+
+/*
+ * OpenRunWriter - start writing a run file
+ * @writer: writer to initialize
+ * @file_name: path of the run file, truncated if it exists
+ *
+ * Returns 1 if successful; otherwise, 0.
+ *
+ * Usage example:
+ * RunWriter writer;
+ * if (OpenRunWriter(&writer, "index.dat.run0")) {
+ *     AddRunTerm(&writer, "dog", postings, num, NULL);   // words in strcmp order
+ *     ...
+ *     CloseRunWriter(&writer);
+ * }
+ */
+int OpenRunWriter(RunWriter *writer, const char *file_name);
+
+/*
+ * AddRunTerm - append a word and its posting list
+ * @writer: open writer
+ * @word: the word; words must be added in strcmp order
+ * @postings: array of postings, sorted by doc_id
+ * @num: number of postings, at least 1
+ * @positions: positions of each posting in turn, as for AddIndexTerm; NULL if none
+ *
+ * Returns 1 if successful; otherwise, 0.
+ */
+int AddRunTerm(RunWriter *writer, const char *word, const Posting *postings, int num, const int *positions);
+
+/*
+ * CloseRunWriter - flush and close a run file
+ * @writer: open writer
+ *
+ * Returns 1 if successful; otherwise, 0. The writer is freed either way.
+ */
+int CloseRunWriter(RunWriter *writer);
+
+/*
+ * OpenRunReader - start reading a run file
+ * @reader: reader to initialize
+ * @file_name: path of the run file
+ *
+ * Returns 1 if successful; otherwise, 0.
+ *
+ * Usage example:
+ * RunReader reader;
+ * if (OpenRunReader(&reader, "index.dat.run0")) {
+ *     while (NextRunTerm(&reader) == 1) {
+ *         // use reader.word, reader.df, reader.postings, reader.positions
+ *     }
+ *     CloseRunReader(&reader);
+ * }
+ */
+int OpenRunReader(RunReader *reader, const char *file_name);
+
+/*
+ * NextRunTerm - read the next word of a run and decode its postings and positions
+ * @reader: open reader
+ *
+ * Returns 1 if a word was read, 0 at the end of the run, and -1 if the run
+ * is truncated or memory could not be allocated.
+ */
+int NextRunTerm(RunReader *reader);
+
+/*
+ * CloseRunReader - close a run file and free the reader
+ * @reader: open reader
+ */
+void CloseRunReader(RunReader *reader);
+
+#endif // RUNFILE_H
@@ -0,0 +1,331 @@
+/* ========================================================================== */
+/* File: segments.c
+ *
+ * Project name: CS50 Tiny Search Engine
+ * Component name: Indexer
+ *
+ * This file includes the manifest and the deletion bitmaps of a segmented index.
+ * Please go to the top of each function for more detailed descriptions.
+ */
+/* ========================================================================== */
+
+// ---------------- Open Issues
+
+// ---------------- System includes e.g., <stdio.h>
+#include <stdio.h>                           // FILE, fprintf, fscanf, rename
+#include <stdlib.h>                          // malloc, free
+#include <string.h>                          // memset, memmove, strlen, strcpy
+#include <inttypes.h>                        // PRIx64, SCNx64
+
+// ---------------- Local includes  e.g., "file.h"
+#include "segments.h"                        // manifest functionality
+#include "indexfile.h"                       // Reserve
+
+// ---------------- Constant definitions
+
+// ---------------- Macro definitions
+#define FNV_OFFSET 0xcbf29ce484222325ULL     // FNV-1a 64 bit offset basis
+#define FNV_PRIME 0x100000001b3ULL           // FNV-1a 64 bit prime
+
+// ---------------- Structures/Types
+
+// ---------------- Private variables
+
+// ---------------- Private prototypes
+static char *MakeName(const char *, const char *, int, const char *);
+
+
+void InitializeManifest(Manifest *manifest) {
+	memset(manifest, 0, sizeof(Manifest));
+	manifest->next_id = 1;
+}
+
+
+/*
+ * ReadManifest - read the manifest of an index.
+ * @index_file: path of index.dat.
+ * @manifest: manifest to fill in.
+ *
+ * Returns 1 if successful, 0 if not.
+ *
+ * Pseudocode:
+ *     1. Check the magic and the version.
+ *     2. Read the next segment id, then the segments, then the documents.
+ */
+
+int ReadManifest(const char *index_file, Manifest *manifest) {
+
+	InitializeManifest(manifest);
+
+	char *name = ManifestName(index_file);
+	FILE *fp = name ? fopen(name, "r") : NULL;
+	free(name);
+	if (!fp) {
+		return 0;
+	}
+
+	// Check the magic and the version.
+	char magic[16];
+	int version, num_docs;
+	int ok = fscanf(fp, "%15s %d next_segment %d segments %d", magic, &version, &manifest->next_id,
+			&manifest->num_segments) == 4 &&
+			strcmp(magic, MANIFEST_MAGIC) == 0 && version == MANIFEST_VERSION &&
+			manifest->num_segments >= 0 && manifest->num_segments <= MAX_SEGMENTS;
+
+	// Read the segments.
+	for (int i = 0; ok && i < manifest->num_segments; i++) {
+		Segment *segment = &manifest->segments[i];
+		ok = fscanf(fp, "%d %d %d %d", &segment->id, &segment->num_docs, &segment->num_deleted,
+				&segment->deleted_gen) == 4 && (segment->num_deleted == 0 || segment->deleted_gen > 0);
+	}
+
+	// Read the documents.
+	char url[MAX_URL_LENGTH + 1];
+	ok = ok && fscanf(fp, " docs %d", &num_docs) == 1 && num_docs >= 0 &&
+			Reserve((unsigned char **)&manifest->docs, &manifest->docs_cap, (num_docs ? num_docs : 1) * sizeof(DocEntry));
+	for (int i = 0; ok && i < num_docs; i++) {
+		DocEntry *doc = &manifest->docs[i];
+		memset(doc, 0, sizeof(DocEntry));
+		manifest->num_docs++;
+		ok = fscanf(fp, "%d %d %lld %lld %" SCNx64 " %d %d %4095s", &doc->doc_id, &doc->segment, &doc->mtime,
+				&doc->size, &doc->hash, &doc->length, &doc->depth, url) == 8;
+		if (ok && strcmp(url, "-") != 0) {
+			ok = (doc->url = malloc(strlen(url) + 1)) != NULL;
+			if (ok) {
+				strcpy(doc->url, url);
+			}
+		}
+	}
+
+	fclose(fp);
+	if (!ok) {
+		FreeManifest(manifest);
+	}
+	return ok;
+}
+
+
+/*
+ * WriteManifest - replace the manifest of an index.
+ * @index_file: path of index.dat.
+ * @manifest: manifest to write.
+ *
+ * Returns 1 if successful, 0 if not.
+ *
+ * Pseudocode:
+ *     1. Write the manifest to index_file.manifest.tmp.
+ *     2. Rename it over index_file.manifest.
+ */
+
+int WriteManifest(const char *index_file, const Manifest *manifest) {
+
+	char *name = ManifestName(index_file);
+	char *temp = MakeName(index_file, "", -1, ".manifest.tmp");
+	FILE *fp = (name && temp) ? fopen(temp, "w") : NULL;
+	int ok = fp != NULL;
+
+	if (ok) {
+		fprintf(fp, "%s %d\nnext_segment %d\nsegments %d\n", MANIFEST_MAGIC, MANIFEST_VERSION,
+				manifest->next_id, manifest->num_segments);
+		for (int i = 0; i < manifest->num_segments; i++) {
+			const Segment *segment = &manifest->segments[i];
+			fprintf(fp, "%d %d %d %d\n", segment->id, segment->num_docs, segment->num_deleted, segment->deleted_gen);
+		}
+		fprintf(fp, "docs %d\n", manifest->num_docs);
+		for (int i = 0; i < manifest->num_docs; i++) {
+			const DocEntry *doc = &manifest->docs[i];
+			fprintf(fp, "%d %d %lld %lld %016" PRIx64 " %d %d %s\n", doc->doc_id, doc->segment, doc->mtime,
+					doc->size, doc->hash, doc->length, doc->depth, (doc->url && doc->url[0]) ? doc->url : "-");
+		}
+		ok = (fclose(fp) == 0) && rename(temp, name) == 0;
+	}
+
+	free(name);
+	free(temp);
+	return ok;
+}
+
+
+void FreeManifest(Manifest *manifest) {
+	for (int i = 0; i < manifest->num_docs; i++) {
+		free(manifest->docs[i].url);
+	}
+	free(manifest->docs);
+	InitializeManifest(manifest);
+}
+
+
+DocEntry *FindDoc(const Manifest *manifest, int doc_id) {
+	int lo = 0, hi = manifest->num_docs - 1;
+
+	while (lo <= hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (manifest->docs[mid].doc_id == doc_id) {
+			return &manifest->docs[mid];
+		}
+		if (manifest->docs[mid].doc_id < doc_id) {
+			lo = mid + 1;
+		}
+		else {
+			hi = mid - 1;
+		}
+	}
+	return NULL;
+}
+
+
+/*
+ * AddDoc - add a document to a manifest.
+ * @manifest: manifest to add to.
+ * @doc_id: document to add; must not be in the manifest yet.
+ *
+ * Returns the zeroed entry of the document, NULL if not successful.
+ *
+ * New doc_ids are usually larger than all the others, so the entry is
+ * appended and moved down only as far as needed.
+ */
+
+DocEntry *AddDoc(Manifest *manifest, int doc_id) {
+
+	if (!Reserve((unsigned char **)&manifest->docs, &manifest->docs_cap, (manifest->num_docs + 1) * sizeof(DocEntry))) {
+		return NULL;
+	}
+
+	int pos = manifest->num_docs;
+	while (pos > 0 && manifest->docs[pos - 1].doc_id > doc_id) {
+		pos--;
+	}
+	memmove(&manifest->docs[pos + 1], &manifest->docs[pos], (manifest->num_docs - pos) * sizeof(DocEntry));
+	manifest->num_docs++;
+
+	DocEntry *doc = &manifest->docs[pos];
+	memset(doc, 0, sizeof(DocEntry));
+	doc->doc_id = doc_id;
+	return doc;
+}
+
+
+Segment *FindSegment(Manifest *manifest, int id) {
+	for (int i = 0; i < manifest->num_segments; i++) {
+		if (manifest->segments[i].id == id) {
+			return &manifest->segments[i];
+		}
+	}
+	return NULL;
+}
+
+
+char *SegmentName(const char *index_file, int id) {
+	return MakeName(index_file, ".seg", id, "");
+}
+
+
+char *DeletedName(const char *index_file, int id, int gen) {
+	char suffix[32];
+	sprintf(suffix, ".del%d", gen);
+	return MakeName(index_file, ".seg", id, suffix);
+}
+
+
+char *DocsName(const char *index_file) {
+	return MakeName(index_file, "", -1, ".docs");
+}
+
+
+char *ManifestName(const char *index_file) {
+	return MakeName(index_file, "", -1, ".manifest");
+}
+
+
+char *ShardName(const char *index_file, int n) {
+	char suffix[32]; // shards are numbered from 0, unlike segments.
+	sprintf(suffix, ".shard%d", n);
+	return MakeName(index_file, "", -1, suffix);
+}
+
+
+unsigned char *ReadDeleted(const char *index_file, int id, int gen, size_t *size) {
+	char *name = DeletedName(index_file, id, gen);
+	FILE *fp = name ? fopen(name, "rb") : NULL;
+	unsigned char *bits = NULL;
+	long len;
+
+	*size = 0;
+	free(name);
+	if (!fp) {
+		return NULL;
+	}
+
+	// Read in the whole bitmap.
+	if (fseek(fp, 0, SEEK_END) == 0 && (len = ftell(fp)) > 0 && fseek(fp, 0, SEEK_SET) == 0 &&
+			(bits = malloc(len)) != NULL) {
+		if (fread(bits, 1, len, fp) == (size_t)len) {
+			*size = len;
+		}
+		else {
+			free(bits);
+			bits = NULL;
+		}
+	}
+	fclose(fp);
+	return bits;
+}
+
+
+int WriteDeleted(const char *index_file, int id, int gen, const unsigned char *bits, size_t size) {
+	char *name = DeletedName(index_file, id, gen);
+	FILE *fp = name ? fopen(name, "wb") : NULL;
+	int ok = fp != NULL;
+
+	if (ok) {
+		ok = fwrite(bits, 1, size, fp) == size;
+		ok = (fclose(fp) == 0) && ok;
+	}
+	free(name);
+	return ok;
+}
+
+
+uint64_t HashFile(const char *path) {
+	FILE *fp = fopen(path, "rb");
+	unsigned char buf[65536];
+	uint64_t hash = FNV_OFFSET;
+	size_t len;
+
+	if (!fp) {
+		return 0;
+	}
+	while ((len = fread(buf, 1, sizeof(buf), fp)) > 0) {
+		for (size_t i = 0; i < len; i++) {
+			hash = (hash ^ buf[i]) * FNV_PRIME;
+		}
+	}
+	fclose(fp);
+	return hash;
+}
+
+
+/*
+ * MakeName - build a file name out of index_file.
+ * @index_file: path of index.dat.
+ * @infix: added after index_file, along with id, when id is positive.
+ * @id: segment id; segment 0 is index_file itself.
+ * @suffix: added at the end.
+ *
+ * Returns a string the caller must free, NULL if memory could not be allocated.
+ */
+
+static char *MakeName(const char *index_file, const char *infix, int id, const char *suffix) {
+	char *name = malloc(strlen(index_file) + strlen(infix) + strlen(suffix) + 16);
+
+	if (!name) {
+		return NULL;
+	}
+	if (id > 0) {
+		sprintf(name, "%s%s%d%s", index_file, infix, id, suffix);
+	}
+	else {
+		sprintf(name, "%s%s", index_file, suffix);
+	}
+	return name;
+}
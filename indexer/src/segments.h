@@ -0,0 +1,186 @@
+/* ========================================================================== */
+/* File: segments.h
+ *
+ * Project name: CS50 Tiny Search Engine
+ * Component name: Indexer
+ *
+ * This file contains the manifest of a segmented index. A full build writes
+ * index.dat as segment 0; every incremental build ("indexer -u") adds an
+ * immutable segment index.dat.seg<id> holding only the new and changed
+ * documents. Documents that were changed or removed are marked in the
+ * deletion bitmap of the segment that holds them (index.dat.del<gen> or
+ * index.dat.seg<id>.del<gen>, one bit per doc_id). A bitmap is never
+ * rewritten: each update writes the next generation and the manifest names
+ * the one in use, so replacing the manifest is the only step that changes
+ * what a reader sees.
+ *
+ * The manifest index.dat.manifest lists the live segments and, for every
+ * document, the segment holding it, the mtime, size and hash of its file,
+ * and its number of words, crawl depth and URL. It is a text file, replaced
+ * with rename() so readers never see half of it:
+ *
+ *     TSEMANIFEST 2
+ *     next_segment <id>
+ *     segments <count>
+ *     <id> <num_docs> <num_deleted> <deleted_gen>
+ *                                               one line per segment; generation 0 for no bitmap
+ *     docs <count>
+ *     <doc_id> <segment> <mtime> <size> <hash> <length> <depth> <url>
+ *                                               one line per document; "-" for no URL
+ *
+ * The document table index.dat.docs (see docfile.h) holds the same metadata
+ * in binary, for the query engine.
+ *
+ */
+/* ========================================================================== */
+#ifndef SEGMENTS_H
+#define SEGMENTS_H
+
+// ---------------- Prerequisites e.g., Requires "math.h"
+#include <stdint.h>                          // fixed-width integers
+#include <stddef.h>                          // size_t
+
+// ---------------- Constants
+#define MANIFEST_MAGIC "TSEMANIFEST"         // first word of every manifest
+#define MANIFEST_VERSION 3                   // bumped on every format change
+#define MAX_SEGMENTS 256                     // most live segments in a manifest
+#define MERGE_FACTOR 4                       // segments of one tier that trigger a merge
+#define MAX_URL_LENGTH 4095                  // longest URL kept for a document
+
+// ---------------- Structures/Types
+
+typedef struct Segment {
+  int id;                                    // 0 is index.dat, otherwise index.dat.seg<id>
+  int num_docs;                              // documents indexed in the segment
+  int num_deleted;                           // how many of them are marked deleted
+  int deleted_gen;                           // generation of its deletion bitmap, 0 if it has none
+} Segment;
+
+typedef struct DocEntry {
+  int doc_id;                                // document identifier
+  int segment;                               // id of the segment holding its live copy
+  long long mtime;                           // modification time of its file when indexed
+  long long size;                            // size of its file when indexed
+  uint64_t hash;                             // FNV-1a hash of its file when indexed
+  int length;                                // number of words in the document
+  int depth;                                 // crawl depth of the page
+  char *url;                                 // URL of the page, owned by the manifest; NULL if none
+} DocEntry;
+
+typedef struct Manifest {
+  int next_id;                               // id of the next segment to be written
+  int num_segments;                          // number of live segments
+  Segment segments[MAX_SEGMENTS];            // live segments, oldest first
+  DocEntry *docs;                            // documents, sorted by doc_id
+  int num_docs;                              // number of documents
+  size_t docs_cap;                           // bytes allocated for docs
+} Manifest;
+
+// ---------------- Public Variables
+
+// ---------------- Prototypes/Macros
+
+/*
+ * IsDeleted - whether doc_id is marked in a deletion bitmap of size bytes
+ */
+#define IsDeleted(bits, size, doc_id) \
+	((size_t)(doc_id) / 8 < (size) && (((bits)[(doc_id) / 8] >> ((doc_id) % 8)) & 1))
+
+/*
+ * InitializeManifest - make an empty manifest
+ */
+void InitializeManifest(Manifest *manifest);
+
+/*
+ * ReadManifest - read the manifest of an index
+ * @index_file: path of index.dat; the manifest is index_file.manifest
+ * @manifest: filled in; free it with FreeManifest
+ *
+ * Returns 1 if successful; 0 if there is no manifest or it is not valid.
+ *
+ * Usage example:
+ * Manifest manifest;
+ * if (ReadManifest("index.dat", &manifest)) {
+ *     for (int i = 0; i < manifest.num_segments; i++) {
+ *         char *name = SegmentName("index.dat", manifest.segments[i].id);
+ *         ...
+ *     }
+ *     FreeManifest(&manifest);
+ * }
+ */
+int ReadManifest(const char *index_file, Manifest *manifest);
+
+/*
+ * WriteManifest - replace the manifest of an index
+ * @index_file: path of index.dat
+ * @manifest: manifest to write
+ *
+ * Returns 1 if successful; otherwise, 0. The manifest is written to a
+ * temporary file and renamed over the old one.
+ */
+int WriteManifest(const char *index_file, const Manifest *manifest);
+
+void FreeManifest(Manifest *manifest);
+
+/*
+ * FindDoc - binary search the documents of a manifest
+ *
+ * Returns the entry of doc_id, or NULL if the manifest does not have it.
+ */
+DocEntry *FindDoc(const Manifest *manifest, int doc_id);
+
+/*
+ * AddDoc - add a document to a manifest, keeping the documents sorted
+ *
+ * Returns the new entry, or NULL if memory could not be allocated.
+ */
+DocEntry *AddDoc(Manifest *manifest, int doc_id);
+
+/*
+ * FindSegment - find a live segment by id
+ *
+ * Returns the segment, or NULL if it is not live.
+ */
+Segment *FindSegment(Manifest *manifest, int id);
+
+/*
+ * SegmentName - path of the index file of segment id
+ * DeletedName - path of generation gen of the deletion bitmap of segment id
+ * DocsName - path of the document table of the index
+ * ManifestName - path of the manifest of the index
+ * ShardName - path of the index file of shard n of a sharded build ("indexer -s")
+ *
+ * Return a string the caller must free, or NULL if memory could not be allocated.
+ */
+char *SegmentName(const char *index_file, int id);
+char *DeletedName(const char *index_file, int id, int gen);
+char *DocsName(const char *index_file);
+char *ManifestName(const char *index_file);
+char *ShardName(const char *index_file, int n);
+
+/*
+ * ReadDeleted - read generation gen of the deletion bitmap of segment id
+ * @size: set to the number of bytes of the bitmap, 0 if the segment has none
+ *
+ * Returns a bitmap the caller must free, or NULL if the segment has none.
+ */
+unsigned char *ReadDeleted(const char *index_file, int id, int gen, size_t *size);
+
+/*
+ * WriteDeleted - write generation gen of the deletion bitmap of segment id
+ *
+ * The generation must be one no published manifest names, so the bitmap
+ * readers use is never changed under them.
+ *
+ * Returns 1 if successful; otherwise, 0.
+ */
+int WriteDeleted(const char *index_file, int id, int gen, const unsigned char *bits, size_t size);
+
+/*
+ * HashFile - FNV-1a hash of the contents of a file
+ *
+ * Returns the hash, or 0 if the file cannot be read.
+ */
+uint64_t HashFile(const char *path);
+
+#endif // SEGMENTS_H
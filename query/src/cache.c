@@ -0,0 +1,310 @@
+/* ========================================================================== */
+/* File: cache.c
+ *
+ * Project name: CS50 Tiny Search Engine
+ * Component name: Query
+ *
+ * This file includes the LRU caches of query results and of pairs of words.
+ * Please go to the top of each function for more detailed descriptions.
+ */
+/* ========================================================================== */
+
+// ---------------- Open Issues
+
+// ---------------- System includes e.g., <stdio.h>
+#include <stdlib.h>                          // malloc, calloc, free
+#include <string.h>                          // strcmp, strlen, memcpy, memset
+
+// ---------------- Local includes  e.g., "file.h"
+#include "cache.h"                           // cache functionality
+
+// ---------------- Constant definitions
+
+// ---------------- Macro definitions
+
+// ---------------- Structures/Types
+
+// ---------------- Private variables
+
+// ---------------- Private prototypes
+static void Unlink(ResultCache *, CacheEntry *);
+static void PushFront(ResultCache *, CacheEntry *);
+static void RemoveEntry(ResultCache *, CacheEntry *);
+
+
+/*
+ * InitializeCache - prepare an empty cache.
+ * @cache: cache to initialize.
+ * @max_size: size limit in bytes, 0 to cache nothing.
+ */
+
+void InitializeCache(ResultCache *cache, size_t max_size) {
+	memset(cache, 0, sizeof(ResultCache));
+	cache->max_size = max_size;
+	pthread_mutex_init(&cache->lock, NULL);
+}
+
+
+/*
+ * FindCacheEntry - find the entry of a key.
+ * @cache: cache to look in.
+ * @key: key of the entry.
+ *
+ * Returns the entry, NULL if there is none.
+ *
+ * Pseudocode:
+ *     1. Look for the key in its bucket. If it is not there, count a miss.
+ *     2. If it is, count a hit, and move the entry to the front of the list.
+ */
+
+CacheEntry *FindCacheEntry(ResultCache *cache, const char *key) {
+
+	CacheEntry *entry = cache->buckets[JenkinsHash(key, CACHE_BUCKETS)];
+	while (entry != NULL && strcmp(entry->key, key) != 0) {
+		entry = entry->chain;
+	}
+
+	// Case of a miss.
+	if (entry == NULL) {
+		cache->misses++;
+		return NULL;
+	}
+
+	// Case of a hit.
+	cache->hits++;
+	Unlink(cache, entry);
+	PushFront(cache, entry);
+	return entry;
+}
+
+
+/*
+ * AddCacheEntry - make a new entry for a key.
+ * @cache: cache to add it to.
+ * @key: key of the entry, copied.
+ * @data_size: bytes of data of the entry.
+ * @num: number of items of the data.
+ *
+ * Returns the entry, NULL if it is not made.
+ *
+ * Pseudocode:
+ *     1. Give up the entry of the key, if there is one.
+ *     2. Work out the size of the new entry: the entry, its data and its key, all in
+ *        one block. If it is larger than the limit by itself, do not make it.
+ *     3. Give up the least recently used entries until it fits.
+ *     4. Put it into its bucket and at the front of the list.
+ */
+
+CacheEntry *AddCacheEntry(ResultCache *cache, const char *key, size_t data_size, int num) {
+
+	size_t key_size = strlen(key) + 1;
+	size_t size = sizeof(CacheEntry) + data_size + key_size;
+	unsigned long bucket = JenkinsHash(key, CACHE_BUCKETS);
+
+	// Give up the old entry of the key.
+	for (CacheEntry *entry = cache->buckets[bucket]; entry != NULL; entry = entry->chain) {
+		if (strcmp(entry->key, key) == 0) {
+			RemoveEntry(cache, entry);
+			break;
+		}
+	}
+	if (size > cache->max_size) {
+		return NULL;
+	}
+
+	// Make room for the new one.
+	while (cache->size + size > cache->max_size) {
+		RemoveEntry(cache, cache->tail);
+		cache->evictions++;
+	}
+	CacheEntry *entry = (CacheEntry *)malloc(size);
+	if (entry == NULL) {
+		return NULL;
+	}
+	entry->data = entry + 1;
+	entry->key = (char *)entry->data + data_size;
+	memcpy(entry->key, key, key_size);
+	entry->num = num;
+	entry->size = size;
+
+	// Put it into its bucket and at the front of the list.
+	entry->chain = cache->buckets[bucket];
+	cache->buckets[bucket] = entry;
+	PushFront(cache, entry);
+	cache->size += size;
+	return entry;
+}
+
+
+/*
+ * LookupCache - find the results of a query.
+ * @cache: cache to look in.
+ * @key: canonical form of the query.
+ * @found: set to 1 if the query is cached, 0 if not.
+ *
+ * Returns a new list of the results, in rank order, NULL if there are none.
+ *
+ * Pseudocode:
+ *     1. With the cache locked, find the entry of the query (see FindCacheEntry).
+ *     2. Copy its results into a list of DocumentNodes, before another thread can give
+ *        the entry up.
+ */
+
+DocumentNode *LookupCache(ResultCache *cache, const char *key, int *found) {
+
+	pthread_mutex_lock(&cache->lock);
+	CacheEntry *entry = FindCacheEntry(cache, key);
+	*found = (entry != NULL);
+	if (entry == NULL) {
+		pthread_mutex_unlock(&cache->lock);
+		return NULL;
+	}
+
+	CachedResult *results = (CachedResult *)entry->data;
+	DocumentNode *list = NULL, *tail = NULL;
+	for (int i=0; i < entry->num; i++) {
+		DocumentNode *dn = (DocumentNode *)calloc(1, sizeof(DocumentNode));
+		if (dn == NULL) {
+			break;
+		}
+		dn->doc_id = results[i].doc_id;
+		dn->freq = results[i].freq;
+		dn->score = results[i].score;
+		if (tail == NULL) {
+			list = dn;
+		}
+		else {
+			tail->next = dn;
+		}
+		tail = dn;
+	}
+	pthread_mutex_unlock(&cache->lock);
+	return list;
+}
+
+
+/*
+ * InsertCache - keep the results of a query.
+ * @cache: cache to keep them in.
+ * @key: canonical form of the query, copied.
+ * @list: results, in rank order.
+ *
+ * Returns 1 if they are kept, 0 if not.
+ *
+ * Pseudocode:
+ *     1. With the cache locked, make an entry with room for every result (see AddCacheEntry).
+ *     2. Copy the doc_id, frequency and score of each result into it.
+ */
+
+int InsertCache(ResultCache *cache, const char *key, const DocumentNode *list) {
+
+	int num = 0;
+	for (const DocumentNode *dn = list; dn != NULL; dn = dn->next) {
+		num++;
+	}
+	pthread_mutex_lock(&cache->lock);
+	CacheEntry *entry = AddCacheEntry(cache, key, num * sizeof(CachedResult), num);
+	if (entry == NULL) {
+		pthread_mutex_unlock(&cache->lock);
+		return 0;
+	}
+
+	CachedResult *results = (CachedResult *)entry->data;
+	num = 0;
+	for (const DocumentNode *dn = list; dn != NULL; dn = dn->next, num++) {
+		results[num].doc_id = dn->doc_id;
+		results[num].freq = dn->freq;
+		results[num].score = dn->score;
+	}
+	pthread_mutex_unlock(&cache->lock);
+	return 1;
+}
+
+
+/*
+ * ClearCache - give up every entry. The counters are kept.
+ */
+
+void ClearCache(ResultCache *cache) {
+	pthread_mutex_lock(&cache->lock);
+	while (cache->head != NULL) {
+		RemoveEntry(cache, cache->head);
+	}
+	pthread_mutex_unlock(&cache->lock);
+}
+
+
+/*
+ * InitializePairCache - prepare an empty PairCache.
+ * @pairs: cache to initialize.
+ * @max_size: size limit of the documents of pairs kept, in bytes, 0 to keep none.
+ */
+
+void InitializePairCache(PairCache *pairs, size_t max_size) {
+	InitializeCache(&pairs->pairs, max_size);
+	InitializeCache(&pairs->uses, max_size ? PAIR_USES_SIZE : 0);
+}
+
+
+/*
+ * ClearPairCache - give up every pair, and the counts of their uses.
+ */
+
+void ClearPairCache(PairCache *pairs) {
+	ClearCache(&pairs->pairs);
+	ClearCache(&pairs->uses);
+}
+
+
+/*
+ * Unlink - take an entry out of the list from the most recently used to the least.
+ */
+
+static void Unlink(ResultCache *cache, CacheEntry *entry) {
+	if (entry->prev) {
+		entry->prev->next = entry->next;
+	}
+	else {
+		cache->head = entry->next;
+	}
+	if (entry->next) {
+		entry->next->prev = entry->prev;
+	}
+	else {
+		cache->tail = entry->prev;
+	}
+}
+
+
+/*
+ * PushFront - put an entry at the front of the list, as the most recently used.
+ */
+
+static void PushFront(ResultCache *cache, CacheEntry *entry) {
+	entry->prev = NULL;
+	entry->next = cache->head;
+	if (cache->head) {
+		cache->head->prev = entry;
+	}
+	else {
+		cache->tail = entry;
+	}
+	cache->head = entry;
+}
+
+
+/*
+ * RemoveEntry - take an entry out of its bucket and of the list, and free it.
+ */
+
+static void RemoveEntry(ResultCache *cache, CacheEntry *entry) {
+	CacheEntry **link = &cache->buckets[JenkinsHash(entry->key, CACHE_BUCKETS)];
+	while (*link != entry) {
+		link = &(*link)->chain;
+	}
+	*link = entry->chain;
+
+	Unlink(cache, entry);
+	cache->size -= entry->size;
+	free(entry);
+}
@@ -0,0 +1,180 @@
+/* ========================================================================== */
+/* File: cache.h
+ *
+ * Project name: CS50 Tiny Search Engine
+ * Component name: Query
+ *
+ * This file contains the caches of the query engine. A ResultCache keeps
+ * blocks of data keyed by strings. The entries are kept in a hash table of
+ * CACHE_BUCKETS chains and in a list from the most recently used to the
+ * least. Once the entries take more than the size limit, the least recently
+ * used are given up first.
+ *
+ * Most query lines are asked again and again, so the ranked results of a line
+ * are kept, keyed by its canonical form (see CanonicalQuery), and shown again
+ * without parsing the posting lists, intersecting or sorting anything. Each
+ * entry holds the doc_id, frequency and score of each result, in rank order.
+ * The results depend on the index, the ranker and --top/--offset, which are
+ * the same for every query of a run.
+ *
+ * Longer queries often share an AND of the same two words, so a PairCache
+ * keeps the documents that two frequent words share, keyed by the two words
+ * (see PlanQuery for how it is filled and used).
+ *
+ * Threads that answer queries share one ResultCache of query results, so a
+ * query asked again hits whichever thread answers it: LookupCache, InsertCache
+ * and ClearCache take the lock of the cache, and copy the results in or out
+ * while they hold it. Each thread has a PairCache of its own, which takes no lock.
+ *
+ * Both caches must be cleared when the index is loaded again.
+ *
+ */
+/* ========================================================================== */
+#ifndef CACHE_H
+#define CACHE_H
+
+// ---------------- Prerequisites e.g., Requires "math.h"
+#include <stddef.h>                          // size_t
+#include <pthread.h>                         // pthread_mutex_t
+#include "qhashtable.h"                      // DocumentNode
+
+// ---------------- Constants
+#define CACHE_BUCKETS 1024                   // number of chains of the hash table
+#define CACHE_SIZE (16 << 20)                // default size limit, in bytes
+#define PAIR_CACHE_SIZE (4 << 20)            // size limit of the documents of pairs kept, in bytes
+#define PAIR_USES_SIZE (64 << 10)            // size limit of the counts of pairs not kept yet, in bytes
+#define PAIR_MIN_USES 2                      // times a pair is planned before its documents are kept
+#define PAIR_MIN_DF 128                      // rarest word of a pair kept; rarer is about as fast to intersect
+
+// ---------------- Structures/Types
+
+typedef struct CachedResult {
+  int doc_id;                               // document identifier
+  int freq;                                 // rank by frequency
+  float score;                              // BM25 score
+} CachedResult;
+
+typedef struct CacheEntry {
+  char *key;                                // key of the entry, eg the canonical form of a query
+  void *data;                               // data kept, eg the CachedResults of the query, in rank order
+  int num;                                  // number of items of the data
+  size_t size;                              // bytes taken by the entry, its data and its key
+  struct CacheEntry *chain;                 // next entry of the same bucket
+  struct CacheEntry *prev;                  // entry used more recently
+  struct CacheEntry *next;                  // entry used less recently
+} CacheEntry;
+
+typedef struct ResultCache {
+  CacheEntry *buckets[CACHE_BUCKETS];       // hash table of the entries
+  CacheEntry *head;                         // most recently used entry
+  CacheEntry *tail;                         // least recently used entry
+  size_t size;                              // bytes taken by the entries
+  size_t max_size;                          // size limit, 0 to cache nothing
+  long hits;                                // lookups that found their entry
+  long misses;                              // lookups that did not
+  long evictions;                           // entries given up to stay under the limit
+  pthread_mutex_t lock;                     // taken by LookupCache, InsertCache and ClearCache
+} ResultCache;
+
+typedef struct PairCache {
+  ResultCache pairs;                        // key "word1 word2": documents the two words share
+  ResultCache uses;                         // key "word1 word2": times a pair not kept yet was planned, an int
+} PairCache;
+
+// ---------------- Public Variables
+
+// ---------------- Prototypes/Macros
+
+/*
+ * InitializeCache - prepare an empty cache
+ * @cache: cache to initialize
+ * @max_size: size limit in bytes, 0 to cache nothing
+ *
+ * Usage example:
+ * ResultCache cache;
+ * InitializeCache(&cache, CACHE_SIZE);
+ * DocumentNode *list = LookupCache(&cache, key);
+ * if (list == NULL) {
+ *     ... find and rank the results into list ...
+ *     InsertCache(&cache, key, list);
+ * }
+ * ClearCache(&cache);
+ */
+void InitializeCache(ResultCache *cache, size_t max_size);
+
+/*
+ * FindCacheEntry - find the entry of a key
+ * @cache: cache to look in
+ * @key: key of the entry
+ *
+ * Returns the entry, or NULL if there is none. A key that is found is
+ * counted as a hit and becomes the most recently used; one that is not, as
+ * a miss.
+ */
+CacheEntry *FindCacheEntry(ResultCache *cache, const char *key);
+
+/*
+ * AddCacheEntry - make a new entry for a key
+ * @cache: cache to add it to
+ * @key: key of the entry, copied; its old entry is given up
+ * @data_size: bytes of data of the entry, to be filled in by the caller
+ * @num: number of items of the data
+ *
+ * Returns the entry, or NULL if it would take more than the size limit by
+ * itself or memory cannot be allocated. The least recently used entries are
+ * given up until the cache is under its size limit.
+ */
+CacheEntry *AddCacheEntry(ResultCache *cache, const char *key, size_t data_size, int num);
+
+/*
+ * LookupCache - find the results of a query
+ * @cache: cache to look in
+ * @key: canonical form of the query
+ * @found: set to 1 if the query is cached, 0 if not
+ *
+ * Returns a new list of the results, in rank order, for the caller to free;
+ * NULL if there are none. A query that is found is counted as a hit and
+ * becomes the most recently used; one that is not, as a miss. Takes the lock
+ * of the cache.
+ */
+DocumentNode *LookupCache(ResultCache *cache, const char *key, int *found);
+
+/*
+ * InsertCache - keep the results of a query
+ * @cache: cache to keep them in
+ * @key: canonical form of the query, copied
+ * @list: results, in rank order
+ *
+ * Returns 1 if they are kept, 0 if they would take more than the size limit
+ * by themselves or memory cannot be allocated. The least recently used
+ * entries are given up until the cache is under its size limit. Takes the
+ * lock of the cache.
+ */
+int InsertCache(ResultCache *cache, const char *key, const DocumentNode *list);
+
+/*
+ * ClearCache - give up every entry, eg when the index is loaded again
+ *
+ * The counters are kept. Takes the lock of the cache.
+ */
+void ClearCache(ResultCache *cache);
+
+/*
+ * InitializePairCache - prepare an empty PairCache
+ * @pairs: cache to initialize
+ * @max_size: size limit of the documents of pairs kept, in bytes, 0 to keep none
+ *
+ * Usage example:
+ * PairCache pairs;
+ * InitializePairCache(&pairs, PAIR_CACHE_SIZE);
+ * PlanNode *plan = PlanQuery(query, &Index, &pairs, &arena);
+ * ClearPairCache(&pairs);
+ */
+void InitializePairCache(PairCache *pairs, size_t max_size);
+
+/*
+ * ClearPairCache - give up every pair, and the counts of their uses
+ */
+void ClearPairCache(PairCache *pairs);
+
+#endif // CACHE_H
@@ -0,0 +1,206 @@
+/* ========================================================================== */
+/* File: intersect.c
+ *
+ * Project name: CS50 Tiny Search Engine
+ * Component name: Query
+ *
+ * This file includes the intersection of sorted lists of doc_ids.
+ * Please go to the top of each function for more detailed descriptions.
+ */
+/* ========================================================================== */
+
+// ---------------- Open Issues
+
+// ---------------- System includes e.g., <stdio.h>
+#ifdef __SSE2__
+#include <emmintrin.h>                       // SSE2 intrinsics
+#endif
+
+// ---------------- Local includes  e.g., "file.h"
+#include "intersect.h"                       // intersection functionality
+
+// ---------------- Constant definitions
+
+// ---------------- Macro definitions
+
+// ---------------- Structures/Types
+
+// ---------------- Private variables
+
+// ---------------- Private prototypes
+
+
+/*
+ * IntersectDocIds - find the doc_ids of a that are also in b.
+ * @a: sorted doc_ids.
+ * @num_a: number of doc_ids of a.
+ * @b: sorted doc_ids.
+ * @num_b: number of doc_ids of b.
+ * @match: index in b of each doc_id of a, -1 if none.
+ *
+ * Returns the number of doc_ids found.
+ *
+ * Pseudocode:
+ *     1. Gallop if b is much longer than a, compare blocks if it is longer,
+ *        and merge otherwise.
+ */
+
+int IntersectDocIds(const int *a, int num_a, const int *b, int num_b, int *match) {
+	if (num_b >= (long)GALLOP_RATIO * num_a) {
+		return IntersectGallop(a, num_a, b, num_b, match);
+	}
+	if (num_b >= (long)BLOCKS_RATIO * num_a) {
+		return IntersectBlocks(a, num_a, b, num_b, match);
+	}
+	return IntersectMerge(a, num_a, b, num_b, match);
+}
+
+
+/*
+ * IntersectMerge - intersect by walking both lists.
+ *
+ * Pseudocode:
+ *     1. Move along whichever list has the smaller doc_id, until one ends.
+ *     2. The doc_ids of a left over are not in b.
+ */
+
+int IntersectMerge(const int *a, int num_a, const int *b, int num_b, int *match) {
+	int i = 0, j = 0, found = 0;
+
+	while (i < num_a && j < num_b) {
+		if (a[i] < b[j]) {
+			match[i++] = -1;
+		}
+		else if (a[i] > b[j]) {
+			j++;
+		}
+		else {
+			match[i++] = j++;
+			found++;
+		}
+	}
+	while (i < num_a) {
+		match[i++] = -1;
+	}
+	return found;
+}
+
+
+/*
+ * IntersectBlocks - intersect by comparing four doc_ids of b at a time.
+ *
+ * Pseudocode:
+ *     1. For each doc_id of a, skip the blocks of four doc_ids of b that end before it.
+ *     2. Compare it with the four doc_ids of the next block at once.
+ *     3. Compare it with the last few doc_ids of b one by one.
+ */
+
+int IntersectBlocks(const int *a, int num_a, const int *b, int num_b, int *match) {
+	int j = 0, found = 0;
+
+	for (int i = 0; i < num_a; i++) {
+		match[i] = -1;
+
+		// Skip whole blocks.
+		while (j + 4 <= num_b && b[j + 3] < a[i]) {
+			j += 4;
+		}
+
+		// a[i] can only be in this block, if there is one.
+		if (j + 4 <= num_b) {
+			int k;
+#ifdef __SSE2__
+			__m128i block = _mm_loadu_si128((const __m128i *)(b + j));
+			int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(block, _mm_set1_epi32(a[i]))));
+			k = (mask & 1) ? 0 : (mask & 2) ? 1 : (mask & 4) ? 2 : (mask & 8) ? 3 : -1;
+#else
+			for (k = 0; k < 4 && b[j + k] != a[i]; k++);
+			k = (k < 4) ? k : -1;
+#endif
+			if (k >= 0) {
+				match[i] = j + k;
+				found++;
+				j += k + 1;
+			}
+			continue;
+		}
+
+		// Fewer than four doc_ids of b are left.
+		while (j < num_b && b[j] < a[i]) {
+			j++;
+		}
+		if (j < num_b && b[j] == a[i]) {
+			match[i] = j++;
+			found++;
+		}
+	}
+	return found;
+}
+
+
+/*
+ * IntersectGallop - intersect by galloping through b.
+ *
+ * Pseudocode:
+ *     1. For each doc_id of a, gallop from where the last one was found to the
+ *        first doc_id of b at least as large.
+ *     2. It is a match if they are equal.
+ */
+
+int IntersectGallop(const int *a, int num_a, const int *b, int num_b, int *match) {
+	int j = 0, found = 0;
+
+	for (int i = 0; i < num_a; i++) {
+		j = Gallop(b, num_b, j, a[i]);
+		if (j < num_b && b[j] == a[i]) {
+			match[i] = j++;
+			found++;
+		}
+		else {
+			match[i] = -1;
+		}
+	}
+	return found;
+}
+
+
+/*
+ * Gallop - find the first element from lo on that is at least target.
+ * @array: sorted array.
+ * @num: number of elements.
+ * @lo: index to start from.
+ * @target: value to look for.
+ *
+ * Returns the index of the first element from lo on that is at least target, num if none.
+ *
+ * Pseudocode:
+ *     1. Double the step from lo until an element is at least target.
+ *     2. Binary search between the last two steps.
+ */
+
+int Gallop(const int *array, int num, int lo, int target) {
+	int hi = lo;
+	int step = 1;
+
+	// Everything before lo is smaller than target, and so is everything before hi.
+	while (hi < num && array[hi] < target) {
+		lo = hi + 1;
+		hi += step;
+		step <<= 1;
+	}
+	if (hi > num) {
+		hi = num;
+	}
+
+	// Binary search in [lo, hi).
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (array[mid] < target) {
+			lo = mid + 1;
+		}
+		else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
@@ -0,0 +1,77 @@
+/* ========================================================================== */
+/* File: intersect.h
+ *
+ * Project name: CS50 Tiny Search Engine
+ * Component name: Query
+ *
+ * This file contains the intersection of sorted lists of doc_ids, for AND.
+ * The cost of intersecting a short list a with a long list b depends on how
+ * much longer b is, so IntersectDocIds picks one of three ways:
+ *
+ *     merge      walk both lists, for when b is shorter than a
+ *     blocks     for each doc_id of a, skip b four doc_ids at a time, then
+ *                compare the four with it at once (SSE2)
+ *     gallop     for each doc_id of a, double the step through b until past
+ *                it, then binary search; log of the gap per doc_id of a
+ *
+ * so the cost follows the shorter list once b is much longer. The thresholds
+ * come from intersect_bench (see ../test): skipping blocks has fewer
+ * mispredicted branches than a merge even for lists of the same length, and
+ * galloping wins once b is about 128 times longer than a.
+ *
+ */
+/* ========================================================================== */
+#ifndef INTERSECT_H
+#define INTERSECT_H
+
+// ---------------- Prerequisites e.g., Requires "math.h"
+
+// ---------------- Constants
+#define BLOCKS_RATIO 1                      // b at least this many times as long as a: blocks
+#define GALLOP_RATIO 128                    // b at least this many times as long as a: gallop
+
+// ---------------- Structures/Types
+
+// ---------------- Public Variables
+
+// ---------------- Prototypes/Macros
+
+/*
+ * IntersectDocIds - find the doc_ids of a that are also in b
+ * @a: sorted, distinct doc_ids, usually the shorter list
+ * @num_a: number of doc_ids of a
+ * @b: sorted, distinct doc_ids
+ * @num_b: number of doc_ids of b
+ * @match: set, for each doc_id of a, to its index in b, or -1 if b does not have it
+ *
+ * Returns the number of doc_ids of a that b has.
+ *
+ * Usage example:
+ * int match[3];
+ * int a[3] = {2, 5, 9}, b[4] = {1, 2, 3, 9};
+ * IntersectDocIds(a, 3, b, 4, match);   // 2, and match is {1, -1, 3}
+ */
+int IntersectDocIds(const int *a, int num_a, const int *b, int num_b, int *match);
+
+/*
+ * IntersectMerge, IntersectBlocks, IntersectGallop - the three ways of IntersectDocIds
+ *
+ * Same arguments and result as IntersectDocIds.
+ */
+int IntersectMerge(const int *a, int num_a, const int *b, int num_b, int *match);
+int IntersectBlocks(const int *a, int num_a, const int *b, int num_b, int *match);
+int IntersectGallop(const int *a, int num_a, const int *b, int num_b, int *match);
+
+/*
+ * Gallop - find the first element from lo on that is at least target
+ * @array: sorted array
+ * @num: number of elements
+ * @lo: index to start from
+ * @target: value to look for
+ *
+ * Returns the index of the first element from lo on that is at least target,
+ * num if none. Takes about 2 log(index - lo) steps.
+ */
+int Gallop(const int *array, int num, int lo, int target);
+
+#endif // INTERSECT_H
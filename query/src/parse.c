@@ -0,0 +1,560 @@
+/* ========================================================================== */
+/* File: parse.c
+ *
+ * Project name: CS50 Tiny Search Engine
+ * Component name: Query
+ *
+ * This file includes the recursive descent parser of query lines.
+ * Please go to the top of each function for more detailed descriptions.
+ */
+/* ========================================================================== */
+
+// ---------------- Open Issues
+
+// ---------------- System includes e.g., <stdio.h>
+#include <string.h>                          // strcmp, strchr
+#include <stdlib.h>                          // strtol
+#include <ctype.h>                           // isspace, isdigit
+#include <stdio.h>                           // snprintf
+
+// ---------------- Local includes  e.g., "file.h"
+#include "parse.h"                           // parser functionality
+#include "phrase.h"                          // MAX_PHRASE_WORDS, MAX_PHRASE_SLOP
+#include "qweb.h"                            // NormalizeWord
+
+// ---------------- Constant definitions
+
+// ---------------- Macro definitions
+
+// ---------------- Structures/Types
+
+typedef enum TokenType {
+  TOKEN_END,                                // end of the line
+  TOKEN_WORD,                               // a word, maybe with the quotes of a phrase
+  TOKEN_AND,
+  TOKEN_OR,
+  TOKEN_NOT,
+  TOKEN_OPEN,                               // (
+  TOKEN_CLOSE,                              // )
+  TOKEN_BAD                                 // anything else
+} TokenType;
+
+typedef struct Parser {
+  const char *pos;                          // rest of the line, after the current token
+  Arena *arena;                             // arena of the QueryNodes
+  TokenType type;                           // current token
+  char *word;                               // TOKEN_WORD: the word, lowered, without its quotes
+  int opens;                                // TOKEN_WORD: 1 if it starts a phrase
+  int slop;                                 // TOKEN_WORD: N if it ends a phrase, 0 with no ~N, -1 if it does not
+  int depth;                                // parentheses and NOTs around the current token
+} Parser;
+
+typedef struct Operand {
+  char *text;                               // canonical form of an operand of an AND or OR
+  int order;                                // ORs of an AND: position in the line, 0 for the others
+} Operand;
+
+// ---------------- Private variables
+
+// ---------------- Private prototypes
+static void NextToken(Parser *);
+static int ReadQuotes(char *, int *, int *);
+static QueryNode *ParseOr(Parser *);
+static QueryNode *ParseAnd(Parser *);
+static QueryNode *ParseUnary(Parser *);
+static QueryNode *ParsePhrase(Parser *);
+static QueryNode *NewNode(Parser *, QueryType, QueryNode *, int);
+static int CountOperands(const QueryNode *, QueryType);
+static int GatherOperands(const QueryNode *, QueryType, Operand *, int *, Arena *);
+static int CompareOperands(const void *, const void *);
+
+
+/*
+ * ParseQuery - read a query line into a tree of QueryNodes.
+ * @line: query line.
+ * @arena: arena the nodes are allocated from.
+ *
+ * Returns the root of the tree, NULL if the line is not valid.
+ *
+ * Pseudocode:
+ *     1. Read the first token, and parse an OR of ANDs from it.
+ *     2. The line is valid if that takes up the whole line.
+ */
+
+QueryNode *ParseQuery(const char *line, Arena *arena) {
+
+	Parser parser = {line, arena, TOKEN_END, NULL, 0, -1, 0};
+	NextToken(&parser);
+
+	QueryNode *root = ParseOr(&parser);
+	if (root == NULL || parser.type != TOKEN_END) {
+		return NULL;
+	}
+	return root;
+}
+
+
+/*
+ * NextToken - read the next token of the line.
+ * @parser: parser to move on.
+ *
+ * Pseudocode:
+ *     1. Skip whitespace. A parenthesis is a token by itself, and so is a - right before
+ *        anything but whitespace, which is a NOT.
+ *     2. Any other token runs up to the next whitespace or parenthesis. AND, OR and
+ *        NOT are operators.
+ *     3. Take the quotes of a phrase and the ~N off a word (see ReadQuotes), and lower it.
+ *        An operator in quotes, ie in a phrase, is not valid.
+ */
+
+static void NextToken(Parser *parser) {
+
+	const char *start = parser->pos;
+	while (isspace((unsigned char)*start)) {
+		start++;
+	}
+	parser->pos = start + 1;
+	if (*start == '\0') {
+		parser->type = TOKEN_END;
+		parser->pos = start;
+		return;
+	}
+	if (*start == '(' || *start == ')') {
+		parser->type = (*start == '(') ? TOKEN_OPEN : TOKEN_CLOSE;
+		return;
+	}
+	if (*start == '-' && start[1] != '\0' && !isspace((unsigned char)start[1])) { // Case of -word.
+		parser->type = TOKEN_NOT;
+		return;
+	}
+
+	// Copy the token.
+	const char *end = start;
+	while (*end != '\0' && !isspace((unsigned char)*end) && *end != '(' && *end != ')') {
+		end++;
+	}
+	parser->pos = end;
+	char *word = (char *)ArenaAlloc(parser->arena, end - start + 1);
+	if (word == NULL) {
+		parser->type = TOKEN_BAD;
+		return;
+	}
+	memcpy(word, start, end - start);
+
+	// Case of an operator.
+	parser->type = strcmp(word, "AND") == 0 ? TOKEN_AND : strcmp(word, "OR") == 0 ? TOKEN_OR :
+			strcmp(word, "NOT") == 0 ? TOKEN_NOT : TOKEN_WORD;
+	if (parser->type != TOKEN_WORD) {
+		return;
+	}
+
+	// Case of a word.
+	if (!ReadQuotes(word, &parser->opens, &parser->slop) ||
+			strcmp(word, "AND") == 0 || strcmp(word, "OR") == 0 || strcmp(word, "NOT") == 0) {
+		parser->type = TOKEN_BAD;
+		return;
+	}
+	NormalizeWord(word);
+	parser->word = word;
+}
+
+
+/*
+ * ReadQuotes - take the quotes of a phrase, and the ~N after it, off a word.
+ * @word: word of the query line, changed in place.
+ * @opens: set to 1 if the word starts with a quote, ie starts a phrase.
+ * @slop: set to N if the word ends a phrase, 0 if it ends one with no ~N, -1 if it does not.
+ *
+ * Returns 1 if successful.
+ * Returns 0 if the quotes or the ~N are not valid, or nothing is left of the word.
+ *
+ * Pseudocode:
+ *     1. Take off a quote at the start of the word.
+ *     2. Take off a quote in the rest of the word, which must be the last character or followed by ~N.
+ *     3. Check that no quote, ~, - or digit is left.
+ */
+
+static int ReadQuotes(char *word, int *opens, int *slop) {
+
+	char *quote;
+	*opens = (word[0] == '"');
+	*slop = -1;
+
+	// Take off the opening quote.
+	if (*opens) {
+		memmove(word, word + 1, strlen(word));
+	}
+
+	// Take off the closing quote, and read N of ~N.
+	if ((quote = strchr(word, '"'))) {
+		if (quote[1] == '~') {
+			char *end;
+			long n = isdigit((unsigned char)quote[2]) ? strtol(quote + 2, &end, 10) : -1;
+			if (n < 0 || *end != '\0' || n > MAX_PHRASE_SLOP) {
+				return 0;
+			}
+			*slop = (int)n;
+		}
+		else if (quote[1] == '\0') {
+			*slop = 0;
+		}
+		else {
+			return 0;
+		}
+		*quote = '\0';
+	}
+
+	// Check what is left of the word.
+	if (word[0] == '\0') {
+		return 0;
+	}
+	for (char *c = word; *c != '\0'; c++) {
+		if (*c == '"' || *c == '~' || *c == '-' || isdigit((unsigned char)*c)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+
+/*
+ * ParseOr - parse ANDs joined by OR.
+ *
+ * Returns the QUERY_OR of the ANDs, the AND itself if there is one, NULL if not valid.
+ */
+
+static QueryNode *ParseOr(Parser *parser) {
+
+	QueryNode *first = ParseAnd(parser);
+	QueryNode *last = first;
+	int num = 1;
+
+	while (last != NULL && parser->type == TOKEN_OR) {
+		NextToken(parser);
+		last->next = ParseAnd(parser);
+		last = last->next;
+		num++;
+	}
+	return last ? NewNode(parser, QUERY_OR, first, num) : NULL;
+}
+
+
+/*
+ * ParseAnd - parse operands joined by AND, or by nothing.
+ *
+ * Returns the QUERY_AND of the operands, the operand itself if there is one, NULL if
+ * not valid or if every operand is a NOT.
+ *
+ * Pseudocode:
+ *     1. Parse operands for as long as AND, or the start of an operand, follows.
+ *        An AND must be followed by an operand.
+ *     2. Check that one of them takes documents in, ie is not a NOT.
+ */
+
+static QueryNode *ParseAnd(Parser *parser) {
+
+	QueryNode *first = NULL, *last = NULL;
+	int num = 0;
+	int positive = 0; // operands that are not a NOT.
+
+	for (;;) {
+		QueryNode *node = ParseUnary(parser);
+		if (node == NULL) {
+			return NULL;
+		}
+		if (last == NULL) {
+			first = node;
+		}
+		else {
+			last->next = node;
+		}
+		last = node;
+		num++;
+		positive += (node->type != QUERY_NOT);
+
+		if (parser->type == TOKEN_AND) {
+			NextToken(parser);
+		}
+		else if (parser->type != TOKEN_WORD && parser->type != TOKEN_NOT && parser->type != TOKEN_OPEN) {
+			break;
+		}
+	}
+	return positive ? NewNode(parser, QUERY_AND, first, num) : NULL;
+}
+
+
+/*
+ * ParseUnary - parse a word, a phrase, a group in parentheses, or a NOT of one of those.
+ *
+ * Returns the QueryNode, NULL if not valid.
+ */
+
+static QueryNode *ParseUnary(Parser *parser) {
+
+	QueryNode *node = NULL;
+
+	switch (parser->type) {
+	case TOKEN_NOT:
+		if (++parser->depth > MAX_QUERY_DEPTH) {
+			return NULL;
+		}
+		NextToken(parser);
+		node = (QueryNode *)ArenaAlloc(parser->arena, sizeof(QueryNode));
+		if (node == NULL || (node->children = ParseUnary(parser)) == NULL) {
+			return NULL;
+		}
+		if (node->children->type == QUERY_NOT) { // A NOT has to take documents away from something.
+			return NULL;
+		}
+		node->type = QUERY_NOT;
+		node->num_children = 1;
+		parser->depth--;
+		return node;
+
+	case TOKEN_OPEN:
+		if (++parser->depth > MAX_QUERY_DEPTH) {
+			return NULL;
+		}
+		NextToken(parser);
+		node = ParseOr(parser);
+		if (node == NULL || parser->type != TOKEN_CLOSE) {
+			return NULL;
+		}
+		parser->depth--;
+		NextToken(parser);
+		return node;
+
+	case TOKEN_WORD:
+		if (parser->opens) {
+			return ParsePhrase(parser);
+		}
+		if (parser->slop >= 0) { // Case of a closing quote with no opening one.
+			return NULL;
+		}
+		node = (QueryNode *)ArenaAlloc(parser->arena, sizeof(QueryNode));
+		if (node) {
+			node->type = QUERY_WORD;
+			node->word = parser->word;
+		}
+		NextToken(parser);
+		return node;
+
+	default:
+		return NULL;
+	}
+}
+
+
+/*
+ * ParsePhrase - parse the words of a phrase, up to its closing quote.
+ *
+ * Returns the QUERY_PHRASE, NULL if it is not closed, holds anything but words, or
+ * has too many words.
+ */
+
+static QueryNode *ParsePhrase(Parser *parser) {
+
+	QueryNode *phrase = (QueryNode *)ArenaAlloc(parser->arena, sizeof(QueryNode));
+	QueryNode *last = NULL;
+	if (phrase == NULL) {
+		return NULL;
+	}
+	phrase->type = QUERY_PHRASE;
+
+	for (;;) {
+		if (parser->type != TOKEN_WORD || (last && parser->opens) || phrase->num_children == MAX_PHRASE_WORDS) {
+			return NULL;
+		}
+		QueryNode *word = (QueryNode *)ArenaAlloc(parser->arena, sizeof(QueryNode));
+		if (word == NULL) {
+			return NULL;
+		}
+		word->type = QUERY_WORD;
+		word->word = parser->word;
+		if (last == NULL) {
+			phrase->children = word;
+		}
+		else {
+			last->next = word;
+		}
+		last = word;
+		phrase->num_children++;
+
+		// Stop after the word with the closing quote.
+		int slop = parser->slop;
+		NextToken(parser);
+		if (slop >= 0) {
+			phrase->slop = slop;
+			return phrase;
+		}
+	}
+}
+
+
+/*
+ * NewNode - make a node of operands.
+ * @parser: parser of the line.
+ * @type: QUERY_AND or QUERY_OR.
+ * @children: first operand, linked to the others.
+ * @num: number of operands.
+ *
+ * Returns the node, or the operand itself if there is only one; NULL if memory cannot be allocated.
+ */
+
+static QueryNode *NewNode(Parser *parser, QueryType type, QueryNode *children, int num) {
+	if (num == 1) {
+		return children;
+	}
+	QueryNode *node = (QueryNode *)ArenaAlloc(parser->arena, sizeof(QueryNode));
+	if (node) {
+		node->type = type;
+		node->children = children;
+		node->num_children = num;
+	}
+	return node;
+}
+
+
+/*
+ * CanonicalQuery - write a tree of QueryNodes the same way for every line that means the same.
+ * @query: root of the tree.
+ * @arena: arena the string is allocated from.
+ *
+ * Returns the string, NULL if memory cannot be allocated.
+ *
+ * Pseudocode:
+ *     1. A word is itself, a phrase its words in quotes followed by ~N if N is not 0, and
+ *        a NOT a - followed by its operand.
+ *     2. The operands of an AND or an OR, with the operands of the ANDs nested in an AND (or
+ *        of the ORs nested in an OR) taken in, are sorted and joined in parentheses:
+ *        (a b) for an AND and (a OR b) for an OR.
+ *     3. The ORs of an AND are put last, in the order of the line, since the ranks of a document
+ *        are added up in that order when two ORs can match as many documents (see PlanQuery).
+ */
+
+char *CanonicalQuery(const QueryNode *query, Arena *arena) {
+
+	char *text, *child;
+	size_t len;
+
+	switch (query->type) {
+	case QUERY_WORD:
+		len = strlen(query->word) + 1;
+		if ((text = (char *)ArenaAlloc(arena, len))) {
+			memcpy(text, query->word, len);
+		}
+		return text;
+
+	case QUERY_PHRASE:
+		len = 16; // quotes, ~N and the terminating null.
+		for (const QueryNode *word = query->children; word != NULL; word = word->next) {
+			len += strlen(word->word) + 1;
+		}
+		if (!(text = (char *)ArenaAlloc(arena, len))) {
+			return NULL;
+		}
+		strcpy(text, "\"");
+		for (const QueryNode *word = query->children; word != NULL; word = word->next) {
+			strcat(text, word->word);
+			strcat(text, word->next ? " " : "\"");
+		}
+		if (query->slop > 0) {
+			snprintf(text + strlen(text), len - strlen(text), "~%d", query->slop);
+		}
+		return text;
+
+	case QUERY_NOT:
+		if (!(child = CanonicalQuery(query->children, arena)) ||
+				!(text = (char *)ArenaAlloc(arena, strlen(child) + 2))) {
+			return NULL;
+		}
+		text[0] = '-';
+		strcpy(text + 1, child);
+		return text;
+
+	default: // Case of an AND or an OR.
+		break;
+	}
+
+	// Gather the operands and sort them.
+	int num = CountOperands(query, query->type);
+	Operand *operands = (Operand *)ArenaAlloc(arena, num * sizeof(Operand));
+	if (operands == NULL) {
+		return NULL;
+	}
+	num = 0;
+	if (!GatherOperands(query, query->type, operands, &num, arena)) {
+		return NULL;
+	}
+	qsort(operands, num, sizeof(Operand), CompareOperands);
+
+	// Join them.
+	const char *separator = (query->type == QUERY_OR) ? " OR " : " ";
+	len = 3; // parentheses and the terminating null.
+	for (int i=0; i < num; i++) {
+		len += strlen(operands[i].text) + strlen(separator);
+	}
+	if (!(text = (char *)ArenaAlloc(arena, len))) {
+		return NULL;
+	}
+	strcpy(text, "(");
+	for (int i=0; i < num; i++) {
+		strcat(text, operands[i].text);
+		strcat(text, (i + 1 < num) ? separator : ")");
+	}
+	return text;
+}
+
+
+/*
+ * CountOperands - count the operands of an AND or an OR, taking in the nested ones of the same type.
+ */
+
+static int CountOperands(const QueryNode *query, QueryType type) {
+	int num = 0;
+
+	for (const QueryNode *child = query->children; child != NULL; child = child->next) {
+		num += (child->type == type) ? CountOperands(child, type) : 1;
+	}
+	return num;
+}
+
+
+/*
+ * GatherOperands - write the operands of an AND or an OR, taking in the nested ones of the same type.
+ *
+ * Returns 1 if successful, 0 if memory cannot be allocated.
+ */
+
+static int GatherOperands(const QueryNode *query, QueryType type, Operand *operands, int *num, Arena *arena) {
+
+	for (const QueryNode *child = query->children; child != NULL; child = child->next) {
+		if (child->type == type) {
+			if (!GatherOperands(child, type, operands, num, arena)) {
+				return 0;
+			}
+			continue;
+		}
+		Operand *operand = &operands[(*num)++];
+		if (!(operand->text = CanonicalQuery(child, arena))) {
+			return 0;
+		}
+		operand->order = (type == QUERY_AND && child->type == QUERY_OR) ? *num : 0;
+	}
+	return 1;
+}
+
+
+/*
+ * CompareOperands - compare function for qsort, ordering Operands by text, the ORs of an AND last.
+ */
+
+static int CompareOperands(const void *e1, const void *e2) {
+	const Operand *o1 = (const Operand *)e1;
+	const Operand *o2 = (const Operand *)e2;
+
+	if (o1->order || o2->order) {
+		return (o1->order > o2->order) - (o1->order < o2->order); // Keep the ORs in line order.
+	}
+	return strcmp(o1->text, o2->text);
+}
@@ -0,0 +1,90 @@
+/* ========================================================================== */
+/* File: parse.h
+ *
+ * Project name: CS50 Tiny Search Engine
+ * Component name: Query
+ *
+ * This file contains the parser of query lines. A line is read into a tree of
+ * QueryNodes (see plan.h for how it is run):
+ *
+ *     query   := or
+ *     or      := and { "OR" and }
+ *     and     := unary { ["AND"] unary }       at least one that is not a NOT
+ *     unary   := ( "NOT" | "-" ) unary | "(" or ")" | phrase | word
+ *     phrase  := '"' word { word } '"' [ "~" N ]
+ *
+ * so AND binds tighter than OR, and words with no operator between them are
+ * AND'ed. Operators are upper case; any other word is lowered. A - right
+ * before a word, a phrase or a group is a NOT, eg dog -"hot dog". A NOT only
+ * takes documents away from the other operands of its AND, so an AND (or a
+ * query) has to have an operand that is not a NOT.
+ *
+ */
+/* ========================================================================== */
+#ifndef PARSE_H
+#define PARSE_H
+
+// ---------------- Prerequisites e.g., Requires "math.h"
+#include "arena.h"                          // Arena
+
+// ---------------- Constants
+#define MAX_QUERY_DEPTH 64                  // parentheses and NOTs nested in one another
+
+// ---------------- Structures/Types
+
+typedef enum QueryType {
+  QUERY_WORD,                               // a word
+  QUERY_PHRASE,                             // words next to each other, children are QUERY_WORDs
+  QUERY_AND,                                // documents with every child
+  QUERY_OR,                                 // documents with any child
+  QUERY_NOT                                 // documents without its child, only under a QUERY_AND
+} QueryType;
+
+typedef struct QueryNode {
+  QueryType type;                           // kind of node
+  char *word;                               // QUERY_WORD: the word, lowered
+  int slop;                                 // QUERY_PHRASE: other words allowed between two of its words
+  struct QueryNode *children;               // first operand, in the order of the line
+  struct QueryNode *next;                   // next operand of the parent
+  int num_children;                         // number of operands
+} QueryNode;
+
+// ---------------- Public Variables
+
+// ---------------- Prototypes/Macros
+
+/*
+ * ParseQuery - read a query line into a tree of QueryNodes
+ * @line: query line
+ * @arena: arena the nodes are allocated from
+ *
+ * Returns the root of the tree, or NULL if the line is not a valid query (or
+ * memory cannot be allocated). An AND or OR with one operand is left out, so
+ * every QUERY_AND and QUERY_OR has at least two children.
+ *
+ * Usage example:
+ * Arena arena;
+ * InitializeArena(&arena);
+ * QueryNode *query = ParseQuery("(dog OR cat) AND NOT \"hot dog\"", &arena);
+ * // QUERY_AND of a QUERY_OR of dog and cat, and a QUERY_NOT of the phrase
+ * FreeArena(&arena);
+ */
+QueryNode *ParseQuery(const char *line, Arena *arena);
+
+/*
+ * CanonicalQuery - write a query the same way for every line that means the same
+ * @query: root of the tree of QueryNodes
+ * @arena: arena the string is allocated from
+ *
+ * Returns the string, or NULL if memory cannot be allocated. Nested ANDs and
+ * ORs are flattened and their operands sorted, so lines that only differ in
+ * spacing, case, grouping, or the order of operands get the same string when
+ * their results, ranks included, are the same.
+ *
+ * Usage example:
+ * QueryNode *query = ParseQuery("Cat AND (dog mouse) OR bird", &arena);
+ * char *key = CanonicalQuery(query, &arena);  // "((cat dog mouse) OR bird)"
+ */
+char *CanonicalQuery(const QueryNode *query, Arena *arena);
+
+#endif // PARSE_H
@@ -0,0 +1,142 @@
+/* ========================================================================== */
+/* File: phrase.c
+ *
+ * Project name: CS50 Tiny Search Engine
+ * Component name: Query
+ *
+ * This file includes the matching of phrase and proximity queries.
+ * Please go to the top of each function for more detailed descriptions.
+ */
+/* ========================================================================== */
+
+// ---------------- Open Issues
+
+// ---------------- System includes e.g., <stdio.h>
+#include <stdlib.h>                          // malloc, free
+
+// ---------------- Local includes  e.g., "file.h"
+#include "phrase.h"                          // phrase functionality
+#include "intersect.h"                       // Gallop
+
+// ---------------- Constant definitions
+#define STACK_SCRATCH 256                    // ints of scratch that MatchPhrase keeps on the stack
+
+// ---------------- Macro definitions
+
+// ---------------- Structures/Types
+
+// ---------------- Private variables
+
+// ---------------- Private prototypes
+
+
+/*
+ * MatchPhrase - check a document against a phrase.
+ * @phrase: phrase to be matched.
+ * @doc_id: document to be checked.
+ *
+ * Returns 1 if the document matches, 0 if not.
+ *
+ * Pseudocode:
+ *     1. Move the cursor of each word along its DocumentNodes up to doc_id. The
+ *        doc_ids only go up, so all the calls for a list walk each word once.
+ *     2. If a word does not have the document, it does not match. If a word has
+ *        no positions, it matches as for AND.
+ *     3. Check the positions of the words (see MatchPositions).
+ */
+
+int MatchPhrase(Phrase *phrase, int doc_id) {
+
+	const int *positions[MAX_PHRASE_WORDS];
+	int counts[MAX_PHRASE_WORDS];
+	int need = 0; // ints of scratch for MatchPositions
+
+	// Find the DocumentNode of each word for the document.
+	for (int i=0; i < phrase->num_words; i++) {
+		if (phrase->words[i] == NULL) {
+			return 0;
+		}
+		DocumentNode *dn = phrase->cursors[i] ? phrase->cursors[i] : phrase->words[i]->page;
+		while (dn != NULL && dn->doc_id < doc_id) {
+			dn = dn->next;
+		}
+		phrase->cursors[i] = dn;
+		if (dn == NULL || dn->doc_id != doc_id) {
+			return 0;
+		}
+		if (dn->positions == NULL) {
+			return 1;
+		}
+		positions[i] = dn->positions;
+		counts[i] = dn->freq;
+		if (i > 0 && 2 * dn->freq > need) {
+			need = 2 * dn->freq;
+		}
+	}
+
+	// Check the positions, with scratch on the stack unless a word is very frequent.
+	int stack[STACK_SCRATCH];
+	int *scratch = (need <= STACK_SCRATCH) ? stack : (int *)malloc(need * sizeof(int));
+	if (scratch == NULL) {
+		return 1;
+	}
+	int match = MatchPositions(positions, counts, phrase->num_words, phrase->slop, scratch);
+	if (scratch != stack) {
+		free(scratch);
+	}
+	return match;
+}
+
+
+/*
+ * MatchPositions - check the positions of the words of a phrase in one document.
+ * @positions: sorted positions of each word.
+ * @counts: number of positions of each word.
+ * @num_words: number of words.
+ * @slop: other words allowed between two words.
+ * @scratch: room for two sets of positions of any word after the first.
+ *
+ * Returns 1 if the positions match, 0 if not.
+ *
+ * Pseudocode:
+ *     1. Start with every position of the first word.
+ *     2. For each next word, keep its positions that come at most slop + 1 after
+ *        one of the positions kept for the word before. For each of those, gallop
+ *        to the first position of the word after it, then take the ones in range.
+ *     3. It matches if positions are left after the last word.
+ */
+
+int MatchPositions(const int *const *positions, const int *counts, int num_words, int slop, int *scratch) {
+
+	// The positions kept so far, and where to put the next ones.
+	const int *kept = positions[0];
+	int num_kept = counts[0];
+	int half = 0;
+	for (int i=1; i < num_words; i++) {
+		if (counts[i] > half) {
+			half = counts[i];
+		}
+	}
+	int *next = scratch;
+
+	for (int i=1; i < num_words && num_kept > 0; i++) {
+		const int *word = positions[i];
+		int num_next = 0;
+		int lo = 0;
+
+		for (int k=0; k < num_kept && lo < counts[i]; k++) {
+			// Positions up to lo were taken or are too early for this one.
+			lo = Gallop(word, counts[i], lo, kept[k] + 1);
+			while (lo < counts[i] && word[lo] - kept[k] <= slop + 1) {
+				next[num_next++] = word[lo++];
+			}
+		}
+
+		// Swap the halves of scratch.
+		kept = next;
+		num_kept = num_next;
+		next = (next == scratch) ? scratch + half : scratch;
+	}
+	return num_kept > 0;
+}
+
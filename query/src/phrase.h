@@ -0,0 +1,82 @@
+/* ========================================================================== */
+/* File: phrase.h
+ *
+ * Project name: CS50 Tiny Search Engine
+ * Component name: Query
+ *
+ * This file contains the matching of phrase and proximity queries against the
+ * positions of an index built with "indexer -p" (see LoadPositions).
+ *
+ *     "new york"        the words next to each other, in order
+ *     "new york"~N      in order, with at most N other words between two of them
+ *
+ * A document matches if there are positions p1 < p2 < ... of the words with
+ * p(i+1) - p(i) - 1 <= N. The positions of the first word that can start a
+ * match are narrowed down one word at a time: the ones of the next word that
+ * follow a position of the last set within N + 1 words. The positions of a
+ * word are sorted, so the next one after each position is found by galloping
+ * from the one found before, and a word that is much rarer than the one
+ * before it costs about log of the gap per position.
+ *
+ */
+/* ========================================================================== */
+#ifndef PHRASE_H
+#define PHRASE_H
+
+// ---------------- Prerequisites e.g., Requires "math.h"
+#include <stddef.h>                         // size_t
+#include "qhashtable.h"                     // WordNode, DocumentNode
+
+// ---------------- Constants
+#define MAX_PHRASE_WORDS 16                 // words of one phrase
+#define MAX_PHRASES 8                       // phrases between two ORs
+#define MAX_PHRASE_SLOP 1000                // largest N of "..."~N
+
+// ---------------- Structures/Types
+
+typedef struct Phrase {
+  WordNode *words[MAX_PHRASE_WORDS];        // words of the phrase, NULL if not in the index
+  DocumentNode *cursors[MAX_PHRASE_WORDS];  // DocumentNode of each word at the last doc_id matched
+  int num_words;                            // number of words
+  int slop;                                 // other words allowed between two words
+} Phrase;
+
+// ---------------- Public Variables
+
+// ---------------- Prototypes/Macros
+
+/*
+ * MatchPhrase - check a document against a phrase
+ * @phrase: phrase with its words filled in; cursors zeroed before the first call
+ * @doc_id: document, at least as large as on the call before
+ *
+ * Returns 1 if the document has the words of the phrase in order and close
+ * enough; 0 if not. A document that has every word but no positions for
+ * one of them matches, so without "indexer -p" a phrase is an AND.
+ *
+ * Usage example:
+ * Phrase phrase = {{0}};
+ * phrase.words[phrase.num_words++] = FindWord("new", &Index);
+ * phrase.words[phrase.num_words++] = FindWord("york", &Index);
+ * for (DocumentNode *dn = list; dn; dn = dn->next) {
+ *     if (MatchPhrase(&phrase, dn->doc_id)) {
+ *         ...
+ *     }
+ * }
+ */
+int MatchPhrase(Phrase *phrase, int doc_id);
+
+/*
+ * MatchPositions - check the positions of the words of a phrase in one document
+ * @positions: sorted positions of each word
+ * @counts: number of positions of each word
+ * @num_words: number of words, at least 1
+ * @slop: other words allowed between two words
+ * @scratch: room for twice the largest count of the words after the first
+ *
+ * Returns 1 if there are positions of the words in order, each at most slop + 1
+ * after the one before; 0 if not.
+ */
+int MatchPositions(const int *const *positions, const int *counts, int num_words, int slop, int *scratch);
+
+#endif // PHRASE_H
@@ -0,0 +1,1060 @@
+/* ========================================================================== */
+/* File: plan.c
+ *
+ * Project name: CS50 Tiny Search Engine
+ * Component name: Query
+ *
+ * This file includes the planning and running of parsed queries, and the list
+ * kernels they are run with.
+ * Please go to the top of each function for more detailed descriptions.
+ */
+/* ========================================================================== */
+
+// ---------------- Open Issues
+
+// ---------------- System includes e.g., <stdio.h>
+#include <stdio.h>                           // snprintf
+#include <stdlib.h>                          // malloc, calloc, free, qsort
+#include <stdint.h>                          // uint32_t
+#include <limits.h>                          // LONG_MAX
+#include <string.h>                          // strcmp, strlen, memcpy
+
+// ---------------- Local includes  e.g., "file.h"
+#include "plan.h"                            // planning functionality
+#include "intersect.h"                       // IntersectDocIds
+#include "topk.h"                            // BlockMaxTopK
+#include "postings.h"                        // PutVarint, GetVarint, MAX_VARINT
+
+// ---------------- Constant definitions
+
+// ---------------- Macro definitions
+#define MATH_MAX(X, Y) (((X) > (Y)) ? (X) : (Y)) // Returns max of the two numbers passed.
+#define HEAD_LESS(X, Y) ((X).node->doc_id < (Y).node->doc_id || \
+		((X).node->doc_id == (Y).node->doc_id && (X).list < (Y).list)) // Order of the heap of UnionLists.
+
+// ---------------- Structures/Types
+
+typedef enum PlanPass {
+  PASS_COUNT,                               // count the operands of an AND
+  PASS_WORDS,                               // look up its words and phrases
+  PASS_ORS,                                 // plan its ORs
+  PASS_NOTS                                 // plan its NOTs
+} PlanPass;
+
+typedef struct UnionHead {
+  DocumentNode *node;                       // next DocumentNode of a list
+  int list;                                 // list it is from
+} UnionHead;
+
+// ---------------- Private variables
+
+// ---------------- Private prototypes
+static PlanNode *PlanAnd(const QueryNode *, HashTable *, PairCache *, Arena *);
+static PlanNode *PlanOr(const QueryNode *, HashTable *, PairCache *, Arena *);
+static int AddOperand(const QueryNode *, PlanNode *, PlanPass, HashTable *, PairCache *, Arena *);
+static int UsePair(PlanNode *, PairCache *, Arena *);
+static CacheEntry *KeepPair(ResultCache *, const char *, WordNode *, WordNode *);
+static int CompareCost(const void *, const void *);
+static DocumentNode *Execute(PlanNode *, const Ranker *);
+static int IsWordGroups(const PlanNode *);
+
+
+/*
+ * PlanQuery - look up the words of a query and order its operands.
+ * @query: root of the tree of QueryNodes.
+ * @Index: InvertedIndex to look the words up in.
+ * @pairs: documents shared by pairs of words, NULL for none.
+ * @arena: arena the PlanNodes are allocated from.
+ *
+ * Returns the root of the plan, NULL if no document can match.
+ *
+ * Pseudocode:
+ *     1. A word, a phrase or an AND is planned as an AND (see PlanAnd), and an OR as an
+ *        OR (see PlanOr).
+ */
+
+PlanNode *PlanQuery(const QueryNode *query, HashTable *Index, PairCache *pairs, Arena *arena) {
+
+	switch (query->type) {
+	case QUERY_WORD:
+	case QUERY_PHRASE:
+	case QUERY_AND:
+		return PlanAnd(query, Index, pairs, arena);
+	case QUERY_OR:
+		return PlanOr(query, Index, pairs, arena);
+	default:
+		return NULL; // A NOT by itself is not valid (see ParseQuery).
+	}
+}
+
+
+/*
+ * PlanAnd - plan the operands of an AND.
+ * @query: QUERY_AND, or a word or phrase, ie an AND of one operand.
+ * @Index: InvertedIndex to look the words up in.
+ * @pairs: documents shared by pairs of words, NULL for none.
+ * @arena: arena the PlanNodes are allocated from.
+ *
+ * Returns the PLAN_AND, NULL if it can match nothing.
+ *
+ * Pseudocode:
+ *     1. Count the words, phrases, ORs and NOTs of the AND and of the ANDs nested in it.
+ *     2. Look up the words first, then plan the ORs, then the NOTs, so that a word that
+ *        is not in the index, or an OR that can match nothing, stops the planning at once.
+ *        A NOT that can match nothing takes nothing away, and is left out.
+ *     3. Order the words by document frequency, and the ORs by cost.
+ *     4. Look for the documents its two rarest words share (see UsePair). The AND can
+ *        match no more documents than those, or than its cheapest operand.
+ */
+
+static PlanNode *PlanAnd(const QueryNode *query, HashTable *Index, PairCache *pairs, Arena *arena) {
+
+	PlanNode *plan = (PlanNode *)ArenaAlloc(arena, sizeof(PlanNode));
+	if (plan == NULL) {
+		return NULL;
+	}
+	plan->type = PLAN_AND;
+
+	// Make room for the operands.
+	AddOperand(query, plan, PASS_COUNT, Index, pairs, arena);
+	if ((plan->num_words && !(plan->words = ArenaAlloc(arena, plan->num_words * sizeof(WordNode *)))) ||
+			(plan->num_phrases && !(plan->phrases = ArenaAlloc(arena, plan->num_phrases * sizeof(Phrase)))) ||
+			(plan->num_children && !(plan->children = ArenaAlloc(arena, plan->num_children * sizeof(PlanNode *)))) ||
+			(plan->num_excluded && !(plan->excluded = ArenaAlloc(arena, plan->num_excluded * sizeof(PlanNode *))))) {
+		return NULL;
+	}
+	plan->num_words = plan->num_phrases = plan->num_children = plan->num_excluded = 0;
+
+	// Plan them, cheapest first.
+	if (!AddOperand(query, plan, PASS_WORDS, Index, pairs, arena) || !AddOperand(query, plan, PASS_ORS, Index, pairs, arena) ||
+			!AddOperand(query, plan, PASS_NOTS, Index, pairs, arena)) {
+		return NULL;
+	}
+
+	// Order them.
+	if (plan->num_words > 1) {
+		qsort(plan->words, plan->num_words, sizeof(WordNode *), CompareDf);
+	}
+	if (plan->num_children > 1) {
+		qsort(plan->children, plan->num_children, sizeof(PlanNode *), CompareCost);
+	}
+	if (pairs != NULL && plan->num_words > 1 && !UsePair(plan, pairs, arena)) {
+		return NULL;
+	}
+	plan->cost = plan->num_words ? plan->words[0]->df : LONG_MAX;
+	if (plan->pair != NULL && plan->num_pair < plan->cost) {
+		plan->cost = plan->num_pair;
+	}
+	if (plan->num_children && plan->children[0]->cost < plan->cost) {
+		plan->cost = plan->children[0]->cost;
+	}
+	return plan;
+}
+
+
+/*
+ * AddOperand - add an operand to a PLAN_AND, for one pass of PlanAnd.
+ * @operand: QueryNode of the operand; the operands of a QUERY_AND are added one by one.
+ * @plan: PLAN_AND to add it to.
+ * @pass: what to add.
+ * @Index: InvertedIndex to look the words up in.
+ * @pairs: documents shared by pairs of words, NULL for none.
+ * @arena: arena the PlanNodes are allocated from.
+ *
+ * Returns 0 if the AND can match nothing, 1 if not.
+ */
+
+static int AddOperand(const QueryNode *operand, PlanNode *plan, PlanPass pass, HashTable *Index, PairCache *pairs, Arena *arena) {
+
+	const QueryNode *child;
+
+	switch (operand->type) {
+	case QUERY_AND:
+		for (child = operand->children; child != NULL; child = child->next) {
+			if (!AddOperand(child, plan, pass, Index, pairs, arena)) {
+				return 0;
+			}
+		}
+		return 1;
+
+	case QUERY_WORD:
+		if (pass == PASS_COUNT) {
+			plan->num_words++;
+		}
+		else if (pass == PASS_WORDS) {
+			WordNode *word = FindWord(operand->word, Index);
+			if (word == NULL) {
+				return 0;
+			}
+			plan->words[plan->num_words++] = word;
+		}
+		return 1;
+
+	case QUERY_PHRASE:
+		if (pass == PASS_COUNT) {
+			plan->num_words += operand->num_children;
+			plan->num_phrases++;
+		}
+		else if (pass == PASS_WORDS) {
+			// The words of a phrase are also words of the AND, and their positions are loaded.
+			Phrase *phrase = &plan->phrases[plan->num_phrases++];
+			phrase->slop = operand->slop;
+			for (child = operand->children; child != NULL; child = child->next) {
+				WordNode *word = FindWord(child->word, Index);
+				if (word == NULL) {
+					return 0;
+				}
+				LoadPositions(word, Index);
+				phrase->words[phrase->num_words++] = word;
+				plan->words[plan->num_words++] = word;
+			}
+		}
+		return 1;
+
+	case QUERY_OR:
+		if (pass == PASS_COUNT) {
+			plan->num_children++;
+		}
+		else if (pass == PASS_ORS) {
+			PlanNode *or = PlanOr(operand, Index, pairs, arena);
+			if (or == NULL) {
+				return 0;
+			}
+			plan->children[plan->num_children++] = or;
+		}
+		return 1;
+
+	case QUERY_NOT:
+		if (pass == PASS_COUNT) {
+			plan->num_excluded++;
+		}
+		else if (pass == PASS_NOTS) {
+			// A NOT is looked up in the documents left, not intersected, so it needs no pairs.
+			PlanNode *excluded = PlanQuery(operand->children, Index, NULL, arena);
+			if (excluded != NULL) {
+				plan->excluded[plan->num_excluded++] = excluded;
+			}
+		}
+		return 1;
+	}
+	return 1;
+}
+
+
+/*
+ * PlanOr - plan the operands of an OR.
+ * @query: QUERY_OR.
+ * @Index: InvertedIndex to look the words up in.
+ * @pairs: documents shared by pairs of words, NULL for none.
+ * @arena: arena the PlanNodes are allocated from.
+ *
+ * Returns the PLAN_OR, its operand if only one can match something, NULL if none can.
+ *
+ * Pseudocode:
+ *     1. Plan each operand, and leave out the ones that can match nothing.
+ *     2. Take the operands of a nested OR into this one.
+ *     3. The OR can match no more documents than all its operands.
+ */
+
+static PlanNode *PlanOr(const QueryNode *query, HashTable *Index, PairCache *pairs, Arena *arena) {
+
+	PlanNode **plans = (PlanNode **)ArenaAlloc(arena, query->num_children * sizeof(PlanNode *));
+	PlanNode *plan = (PlanNode *)ArenaAlloc(arena, sizeof(PlanNode));
+	int num = 0;
+	int total = 0; // operands once the nested ORs are taken in.
+	if (plans == NULL || plan == NULL) {
+		return NULL;
+	}
+
+	// Plan the operands.
+	for (const QueryNode *child = query->children; child != NULL; child = child->next) {
+		PlanNode *operand = PlanQuery(child, Index, pairs, arena);
+		if (operand != NULL) {
+			plans[num++] = operand;
+			total += (operand->type == PLAN_OR) ? operand->num_children : 1;
+		}
+	}
+	if (num <= 1) {
+		return num ? plans[0] : NULL;
+	}
+
+	// Take in the nested ORs.
+	plan->type = PLAN_OR;
+	plan->children = (PlanNode **)ArenaAlloc(arena, total * sizeof(PlanNode *));
+	if (plan->children == NULL) {
+		return NULL;
+	}
+	for (int i=0; i < num; i++) {
+		PlanNode **operands = (plans[i]->type == PLAN_OR) ? plans[i]->children : &plans[i];
+		int num_operands = (plans[i]->type == PLAN_OR) ? plans[i]->num_children : 1;
+		for (int j=0; j < num_operands; j++) {
+			plan->children[plan->num_children++] = operands[j];
+			plan->cost += operands[j]->cost;
+		}
+	}
+	return plan;
+}
+
+
+/*
+ * UsePair - find the documents the two rarest words of a PLAN_AND share.
+ * @plan: PLAN_AND, with its words ordered.
+ * @pairs: documents shared by pairs of words.
+ * @arena: arena the documents are copied into.
+ *
+ * Returns 0 if the two words share no document, 1 if not.
+ *
+ * Pseudocode:
+ *     1. Pairs whose rarer word is in fewer than PAIR_MIN_DF documents are intersected
+ *        about as fast as their documents are read back, and are left out.
+ *     2. If the documents of the pair are not kept yet, count the use of the pair. Once it
+ *        is used PAIR_MIN_USES times, intersect the two words and keep them (see KeepPair).
+ *     3. Copy the documents into the arena, as the PairCache may give them up while the
+ *        rest of the query is planned.
+ */
+
+static int UsePair(PlanNode *plan, PairCache *pairs, Arena *arena) {
+
+	WordNode *w0 = plan->words[0], *w1 = plan->words[1];
+	if (w0 == w1 || w0->df < PAIR_MIN_DF) {
+		return 1;
+	}
+	size_t key_size = strlen(w0->word) + strlen(w1->word) + 2;
+	char *key = (char *)ArenaAlloc(arena, key_size);
+	if (key == NULL) {
+		return 1;
+	}
+	snprintf(key, key_size, "%s %s", w0->word, w1->word);
+
+	// Case of a pair not kept yet: count the use.
+	CacheEntry *entry = FindCacheEntry(&pairs->pairs, key);
+	if (entry == NULL) {
+		CacheEntry *uses = FindCacheEntry(&pairs->uses, key);
+		if (uses == NULL && (uses = AddCacheEntry(&pairs->uses, key, sizeof(int), 1)) != NULL) {
+			*(int *)uses->data = 0;
+		}
+		if (uses == NULL || ++*(int *)uses->data < PAIR_MIN_USES) {
+			return 1;
+		}
+		if ((entry = KeepPair(&pairs->pairs, key, w0, w1)) == NULL) {
+			return 1;
+		}
+	}
+
+	// Copy its documents.
+	if (entry->num == 0) {
+		return 0;
+	}
+	size_t size = (unsigned char *)entry->key - (unsigned char *)entry->data; // the key follows the data.
+	if ((plan->pair = (unsigned char *)ArenaAlloc(arena, size)) != NULL) {
+		memcpy(plan->pair, entry->data, size);
+		plan->num_pair = entry->num;
+	}
+	return 1;
+}
+
+
+/*
+ * KeepPair - intersect two words and keep the documents they share.
+ * @cache: cache to keep them in.
+ * @key: the two words.
+ * @w0: WordNode of the rarer word.
+ * @w1: WordNode of the other word.
+ *
+ * Returns the entry of the pair, NULL if it is not kept.
+ *
+ * Pseudocode:
+ *     1. Look the doc_ids of w0 up in the doc_ids of w1 (see IntersectDocIds).
+ *     2. For each document they share, write the gaps between its index in the DocumentNodes
+ *        of each word and the one of the last document as varints: a few bytes a document,
+ *        rather than a DocumentNode.
+ */
+
+static CacheEntry *KeepPair(ResultCache *cache, const char *key, WordNode *w0, WordNode *w1) {
+
+	int *match = (int *)malloc(w0->df * sizeof(int));
+	unsigned char *buf = (unsigned char *)malloc(2 * MAX_VARINT * w0->df);
+	CacheEntry *entry = NULL;
+
+	if (match != NULL && buf != NULL) {
+		IntersectDocIds(w0->doc_ids, w0->df, w1->doc_ids, w1->df, match);
+		uint32_t last0 = 0, last1 = 0;
+		size_t size = 0;
+		int num = 0;
+		for (int i=0; i < w0->df; i++) {
+			if (match[i] >= 0) {
+				size += PutVarint(buf + size, i - last0);
+				size += PutVarint(buf + size, match[i] - last1);
+				last0 = i;
+				last1 = match[i];
+				num++;
+			}
+		}
+		if ((entry = AddCacheEntry(cache, key, size, num)) != NULL) {
+			memcpy(entry->data, buf, size);
+		}
+	}
+
+	// Cleanup.
+	free(match);
+	free(buf);
+	return entry;
+}
+
+
+/*
+ * CompareDf - compare function for qsort, ordering WordNodes by document frequency, then by word.
+ * Ties are broken by word so that the order, and the ranks added up in it, do not depend on the line.
+ */
+
+int CompareDf(const void *e1, const void *e2) {
+	const WordNode *w1 = *(WordNode *const *)e1;
+	const WordNode *w2 = *(WordNode *const *)e2;
+
+	if (w1->df != w2->df) {
+		return (w1->df > w2->df) - (w1->df < w2->df);
+	}
+	return strcmp(w1->word, w2->word);
+}
+
+
+/*
+ * CompareCost - compare function for qsort, ordering PlanNodes by cost.
+ */
+
+static int CompareCost(const void *e1, const void *e2) {
+	const PlanNode *p1 = *(PlanNode *const *)e1;
+	const PlanNode *p2 = *(PlanNode *const *)e2;
+
+	return (p1->cost > p2->cost) - (p1->cost < p2->cost);
+}
+
+
+/*
+ * ExecutePlan - find the documents of a plan.
+ * @plan: root of the plan, NULL for none.
+ * @ranker: BM25 ranker, NULL to rank by frequency.
+ * @top_k: number of documents wanted, 0 for all of them.
+ * @Index: InvertedIndex of the words.
+ *
+ * Returns the documents, in doc_id order, or the top_k highest ranked, in no order.
+ *
+ * Pseudocode:
+ *     1. If only the top_k documents are wanted, and the plan is an OR of ANDs of words,
+ *        find them with BlockMaxTopK.
+ *     2. If not, find every document of the plan (see Execute).
+ */
+
+DocumentNode *ExecutePlan(PlanNode *plan, const Ranker *ranker, int top_k, HashTable *Index) {
+
+	if (plan == NULL) {
+		return NULL;
+	}
+	if (top_k <= 0 || !IsWordGroups(plan)) {
+		return Execute(plan, ranker);
+	}
+
+	// Line up the words of each AND, one AND after the other.
+	PlanNode **groups = (plan->type == PLAN_OR) ? plan->children : &plan;
+	int num_groups = (plan->type == PLAN_OR) ? plan->num_children : 1;
+	int num_words = 0;
+	for (int g=0; g < num_groups; g++) {
+		num_words += groups[g]->num_words;
+	}
+	WordNode **words = (WordNode **)malloc(num_words * sizeof(WordNode *));
+	int *sizes = (int *)malloc(num_groups * sizeof(int));
+	if (words == NULL || sizes == NULL) {
+		free(words);
+		free(sizes);
+		return Execute(plan, ranker);
+	}
+	num_words = 0;
+	for (int g=0; g < num_groups; g++) {
+		for (int i=0; i < groups[g]->num_words; i++) {
+			words[num_words++] = groups[g]->words[i];
+		}
+		sizes[g] = groups[g]->num_words;
+	}
+
+	DocumentNode *list = BlockMaxTopK(words, sizes, num_groups, top_k, ranker, Index, NULL);
+	free(words);
+	free(sizes);
+	return list;
+}
+
+
+/*
+ * Execute - find every document of a plan.
+ * @plan: PlanNode to run.
+ * @ranker: BM25 ranker, NULL to rank by frequency.
+ *
+ * Returns the documents, in doc_id order.
+ *
+ * Pseudocode:
+ *     1. For an OR, find the documents of each operand, and merge them (see UnionLists).
+ *     2. For an AND, start from the cheapest of its words and ORs, and intersect the list
+ *        with the next cheapest until it is empty or every one is done. A word is looked up
+ *        in its doc_ids (see IntersectPostings), and an OR is run and merged. If the AND has
+ *        the documents of its two rarest words, and they come before its ORs, start from
+ *        those (see PairPostings); the ranks are added up in the same order.
+ *     3. Take away the documents of each NOT, then check the phrases, which cost the most
+ *        per document, on the documents left. A NOT of words only looks up the documents
+ *        left in their doc_ids (see ExcludeWords); any other NOT is run, unranked, and
+ *        taken away with a merge.
+ */
+
+static DocumentNode *Execute(PlanNode *plan, const Ranker *ranker) {
+
+	// Case of an OR.
+	if (plan->type == PLAN_OR) {
+		DocumentNode **lists = (DocumentNode **)malloc(plan->num_children * sizeof(DocumentNode *));
+		if (lists == NULL) { // Without memory, nothing can be matched.
+			return NULL;
+		}
+		for (int i=0; i < plan->num_children; i++) {
+			lists[i] = Execute(plan->children[i], ranker);
+		}
+		DocumentNode *list = UnionLists(lists, plan->num_children);
+		free(lists);
+		return list;
+	}
+
+	// Case of an AND: intersect its words and ORs, cheapest first.
+	DocumentNode *list = NULL;
+	int i = 0, j = 0;
+	if (plan->pair != NULL && (plan->num_children == 0 || plan->words[1]->df <= plan->children[0]->cost)) {
+		list = PairPostings(plan->words, plan->pair, plan->num_pair, ranker);
+		i = 2;
+	}
+	while ((i < plan->num_words || j < plan->num_children) && (i + j == 0 || list != NULL)) {
+		int first = (i + j == 0);
+		if (i < plan->num_words && (j == plan->num_children || plan->words[i]->df <= plan->children[j]->cost)) {
+			list = first ? CopyPostings(plan->words[i], ranker) : IntersectPostings(list, plan->words[i], ranker);
+			i++;
+		}
+		else {
+			DocumentNode *other = Execute(plan->children[j], ranker);
+			list = first ? other : IntersectLists(list, other);
+			j++;
+		}
+	}
+
+	// Take away its NOTs, then check its phrases.
+	for (int k=0; k < plan->num_excluded && list != NULL; k++) {
+		if (IsWordGroups(plan->excluded[k])) {
+			list = ExcludeWords(list, plan->excluded[k]);
+		}
+		else {
+			list = SubtractLists(list, Execute(plan->excluded[k], NULL));
+		}
+	}
+	if (list != NULL && plan->num_phrases > 0) {
+		list = FilterPhrases(list, plan->phrases, plan->num_phrases);
+	}
+	return list;
+}
+
+
+/*
+ * IsWordGroups - check if a plan is an AND of words, or an OR of those.
+ */
+
+static int IsWordGroups(const PlanNode *plan) {
+	PlanNode *const *groups = (plan->type == PLAN_OR) ? plan->children : (PlanNode *const *)&plan;
+	int num_groups = (plan->type == PLAN_OR) ? plan->num_children : 1;
+
+	for (int g=0; g < num_groups; g++) {
+		const PlanNode *group = groups[g];
+		if (group->type != PLAN_AND || group->num_children || group->num_phrases || group->num_excluded) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+
+/*
+ * CopyPostings - copy the DocumentNodes of a word into a new list.
+ * @word: WordNode of the word.
+ * @ranker: BM25 ranker, NULL to rank by frequency.
+ *
+ * Returns the list, in doc_id order.
+ *
+ * Pseudocode:
+ *     1. Loop through each DocumentNode, and append a copy to the list, with its BM25
+ *        score when ranking with BM25.
+ */
+
+DocumentNode *CopyPostings(WordNode *word, const Ranker *ranker) {
+
+	DocumentNode *list = NULL, *tail = NULL;
+	double idf = ranker ? WordWeight(ranker, word->word, word->df) : 0;
+
+	for (DocumentNode *ptr = word->page; ptr != NULL; ptr = ptr->next) {
+		DocumentNode *dn = (DocumentNode *)calloc(1, sizeof(DocumentNode));
+		if (dn == NULL) {
+			break;
+		}
+		dn->doc_id = ptr->doc_id;
+		dn->freq = ptr->freq;
+		if (ranker) {
+			dn->score = TermScore(ranker, idf, ptr->doc_id, ptr->freq);
+		}
+		if (tail == NULL) {
+			list = dn;
+		}
+		else {
+			tail->next = dn;
+		}
+		tail = dn;
+	}
+	return list;
+}
+
+
+/*
+ * IntersectPostings - keep the documents of a list that a word has.
+ * @list: list in doc_id order, taken over.
+ * @word: WordNode of the word.
+ * @ranker: BM25 ranker, NULL to rank by frequency.
+ *
+ * Returns the list.
+ *
+ * Pseudocode:
+ *     1. Gather the doc_ids of the list, and look each one up in the doc_ids of the word
+ *        (see IntersectDocIds). The cost depends on the shorter list when the other one is
+ *        much longer.
+ *     2. Keep the DocumentNodes found, adding the frequency, and the score when ranking with
+ *        BM25, of the word. Free the others.
+ */
+
+DocumentNode *IntersectPostings(DocumentNode *list, WordNode *word, const Ranker *ranker) {
+
+	DocumentNode *ptr, *next, *runner = NULL;
+	int num = 0;
+
+	// Gather the doc_ids of the list.
+	for (ptr = list; ptr != NULL; ptr = ptr->next) {
+		num++;
+	}
+	if (num == 0) {
+		return NULL;
+	}
+	int *doc_ids = (int *)malloc(2 * num * sizeof(int));
+	if (!doc_ids) { // Without memory, nothing can be matched.
+		FreeDocuments(list);
+		return NULL;
+	}
+	int *match = doc_ids + num; // index of each doc_id in the doc_ids of the word, -1 if none.
+	num = 0;
+	for (ptr = list; ptr != NULL; ptr = ptr->next) {
+		doc_ids[num++] = ptr->doc_id;
+	}
+	IntersectDocIds(doc_ids, num, word->doc_ids, word->df, match);
+
+	// Keep the matches, and free the others.
+	double idf = ranker ? WordWeight(ranker, word->word, word->df) : 0;
+	int i = 0;
+	for (ptr = list, list = NULL; ptr != NULL; ptr = next, i++) {
+		next = ptr->next;
+
+		// Case of no match.
+		if (match[i] < 0) {
+			free(ptr);
+			continue;
+		}
+
+		// Case of match.
+		DocumentNode *dn = &word->page[match[i]];
+		ptr->freq += dn->freq; // Add the frequencies.
+		if (ranker) {
+			ptr->score += TermScore(ranker, idf, dn->doc_id, dn->freq); // Add the scores.
+		}
+		if (runner == NULL) {
+			list = ptr;
+		}
+		else {
+			runner->next = ptr;
+		}
+		runner = ptr;
+	}
+	if (runner != NULL) {
+		runner->next = NULL;
+	}
+
+	// Cleanup.
+	free(doc_ids);
+	return list;
+}
+
+
+/*
+ * PairPostings - make a list of the documents two words share.
+ * @words: WordNodes of the two words.
+ * @pair: index in words[0] and words[1] of each document, varint coded.
+ * @num: number of documents.
+ * @ranker: BM25 ranker, NULL to rank by frequency.
+ *
+ * Returns the list, in doc_id order.
+ *
+ * Pseudocode:
+ *     1. Read the indexes of each document back (see KeepPair), and append a DocumentNode
+ *        with the frequency, and the score when ranking with BM25, of words[0], then of
+ *        words[1] added, as CopyPostings and IntersectPostings would.
+ */
+
+DocumentNode *PairPostings(WordNode **words, const unsigned char *pair, int num, const Ranker *ranker) {
+
+	DocumentNode *list = NULL, *tail = NULL;
+	double idf0 = ranker ? WordWeight(ranker, words[0]->word, words[0]->df) : 0;
+	double idf1 = ranker ? WordWeight(ranker, words[1]->word, words[1]->df) : 0;
+	uint32_t i0 = 0, i1 = 0;
+
+	for (int n=0; n < num; n++) {
+		i0 += GetVarint(&pair);
+		i1 += GetVarint(&pair);
+		DocumentNode *d0 = &words[0]->page[i0], *d1 = &words[1]->page[i1];
+		DocumentNode *dn = (DocumentNode *)calloc(1, sizeof(DocumentNode));
+		if (dn == NULL) {
+			break;
+		}
+		dn->doc_id = d0->doc_id;
+		dn->freq = d0->freq;
+		dn->freq += d1->freq;
+		if (ranker) {
+			dn->score = TermScore(ranker, idf0, d0->doc_id, d0->freq);
+			dn->score += TermScore(ranker, idf1, d1->doc_id, d1->freq);
+		}
+		if (tail == NULL) {
+			list = dn;
+		}
+		else {
+			tail->next = dn;
+		}
+		tail = dn;
+	}
+	return list;
+}
+
+
+/*
+ * IntersectLists - keep the documents of a list that another list has.
+ * @list: list in doc_id order, taken over.
+ * @other: list in doc_id order, freed.
+ *
+ * Returns the list.
+ *
+ * Pseudocode:
+ *     1. Walk both lists, moving along whichever has the smaller doc_id.
+ *     2. Keep the DocumentNodes of list found in other, adding the frequency and score
+ *        of other. Free every other DocumentNode.
+ */
+
+DocumentNode *IntersectLists(DocumentNode *list, DocumentNode *other) {
+
+	DocumentNode *ptr = list, *runner = NULL, *next;
+	list = NULL;
+
+	while (ptr != NULL && other != NULL) {
+		if (ptr->doc_id < other->doc_id) { // Case of a document other does not have.
+			next = ptr->next;
+			free(ptr);
+			ptr = next;
+			continue;
+		}
+		if (ptr->doc_id == other->doc_id) { // Case of match.
+			ptr->freq += other->freq;
+			ptr->score += other->score;
+			if (runner == NULL) {
+				list = ptr;
+			}
+			else {
+				runner->next = ptr;
+			}
+			runner = ptr;
+			ptr = ptr->next;
+		}
+		next = other->next;
+		free(other);
+		other = next;
+	}
+	if (runner != NULL) {
+		runner->next = NULL;
+	}
+	FreeDocuments(ptr);
+	FreeDocuments(other);
+	return list;
+}
+
+
+/*
+ * SubtractLists - take the documents of another list out of a list.
+ * @list: list in doc_id order, taken over.
+ * @other: list in doc_id order, freed.
+ *
+ * Returns what is left of the list.
+ *
+ * Pseudocode:
+ *     1. Walk both lists, moving along whichever has the smaller doc_id.
+ *     2. Free the DocumentNodes of list found in other, and every DocumentNode of other.
+ */
+
+DocumentNode *SubtractLists(DocumentNode *list, DocumentNode *other) {
+
+	DocumentNode **link = &list; // where the next DocumentNode kept goes.
+	DocumentNode *next;
+
+	while (*link != NULL && other != NULL) {
+		if ((*link)->doc_id < other->doc_id) { // Case of a document other does not have.
+			link = &(*link)->next;
+			continue;
+		}
+		if ((*link)->doc_id == other->doc_id) { // Case of a document to take out.
+			next = (*link)->next;
+			free(*link);
+			*link = next;
+		}
+		next = other->next;
+		free(other);
+		other = next;
+	}
+	FreeDocuments(other);
+	return list;
+}
+
+
+/*
+ * ExcludeWords - take out of a list the documents of an AND of words, or an OR of those.
+ * @list: list in doc_id order, taken over.
+ * @plan: PlanNode of the words (see IsWordGroups).
+ *
+ * Returns what is left of the list.
+ *
+ * Pseudocode:
+ *     1. Gather the doc_ids of the list.
+ *     2. For each AND of words, look the doc_ids not taken out yet up in its words, rarest
+ *        first, keeping only the ones found (see IntersectDocIds), and take out the ones
+ *        found in every word. Only the doc_ids of the list are looked up, so the cost
+ *        follows the list, not the posting lists of the words.
+ *     3. Free the DocumentNodes taken out.
+ */
+
+DocumentNode *ExcludeWords(DocumentNode *list, const PlanNode *plan) {
+
+	PlanNode *const *groups = (plan->type == PLAN_OR) ? plan->children : (PlanNode *const *)&plan;
+	int num_groups = (plan->type == PLAN_OR) ? plan->num_children : 1;
+	DocumentNode *ptr;
+	int num = 0;
+
+	// Gather the doc_ids of the list.
+	for (ptr = list; ptr != NULL; ptr = ptr->next) {
+		num++;
+	}
+	if (num == 0) {
+		return NULL;
+	}
+	int *doc_ids = (int *)malloc(5 * num * sizeof(int));
+	if (!doc_ids) { // Without memory, take them away with a merge.
+		return SubtractLists(list, Execute((PlanNode *)plan, NULL));
+	}
+	int *out = doc_ids + num; // 1 for each doc_id taken out.
+	int *left = out + num; // doc_ids still found in every word of the AND.
+	int *index = left + num; // index of each of those in doc_ids.
+	int *match = index + num;
+	num = 0;
+	for (ptr = list; ptr != NULL; ptr = ptr->next) {
+		out[num] = 0;
+		doc_ids[num++] = ptr->doc_id;
+	}
+
+	// Look the doc_ids up in each AND of words.
+	for (int g=0; g < num_groups; g++) {
+		int num_left = 0;
+		for (int i=0; i < num; i++) {
+			if (!out[i]) {
+				left[num_left] = doc_ids[i];
+				index[num_left++] = i;
+			}
+		}
+		for (int w=0; w < groups[g]->num_words && num_left > 0; w++) {
+			WordNode *word = groups[g]->words[w];
+			IntersectDocIds(left, num_left, word->doc_ids, word->df, match);
+			int kept = 0;
+			for (int i=0; i < num_left; i++) {
+				if (match[i] >= 0) {
+					left[kept] = left[i];
+					index[kept++] = index[i];
+				}
+			}
+			num_left = kept;
+		}
+		for (int i=0; i < num_left; i++) {
+			out[index[i]] = 1;
+		}
+	}
+
+	// Free the DocumentNodes taken out.
+	DocumentNode **link = &list; // where the next DocumentNode kept goes.
+	for (int i=0; i < num; i++) {
+		ptr = *link;
+		if (out[i]) {
+			*link = ptr->next;
+			free(ptr);
+		}
+		else {
+			link = &ptr->next;
+		}
+	}
+
+	// Cleanup.
+	free(doc_ids);
+	return list;
+}
+
+
+/*
+ * UnionLists - merge lists into one.
+ * @lists: lists in doc_id order, taken over.
+ * @num: number of lists.
+ *
+ * Returns the list of every document, in doc_id order.
+ *
+ * Pseudocode:
+ *     1. Put the first DocumentNode of each list in a min-heap by doc_id.
+ *     2. Take the smallest one out, and put the next one of its list in its place.
+ *     3. If it has the doc_id of the last DocumentNode kept, keep the higher frequency
+ *        (and score) and free it. If not, append it.
+ *     4. Continue until the heap is empty. Each DocumentNode costs log of the number of lists.
+ */
+
+DocumentNode *UnionLists(DocumentNode **lists, int num) {
+
+	UnionHead *heap = (UnionHead *)malloc((num ? num : 1) * sizeof(UnionHead));
+	int size = 0;
+	DocumentNode *list = NULL, *tail = NULL;
+	if (heap == NULL) { // Without memory, nothing can be matched.
+		for (int i=0; i < num; i++) {
+			FreeDocuments(lists[i]);
+		}
+		return NULL;
+	}
+
+	// Put the first DocumentNode of each list in the heap.
+	for (int l=0; l < num; l++) {
+		if (lists[l] == NULL) {
+			continue;
+		}
+
+		// Move it up past the larger ones.
+		int i = size++;
+		heap[i].node = lists[l];
+		heap[i].list = l;
+		while (i > 0 && HEAD_LESS(heap[i], heap[(i - 1) / 2])) {
+			UnionHead swap = heap[i];
+			heap[i] = heap[(i - 1) / 2];
+			heap[(i - 1) / 2] = swap;
+			i = (i - 1) / 2;
+		}
+	}
+
+	while (size > 0) {
+
+		// Take out the smallest DocumentNode, and put the next one of its list in its place.
+		DocumentNode *dn = heap[0].node;
+		if (dn->next != NULL) {
+			heap[0].node = dn->next;
+		}
+		else {
+			heap[0] = heap[--size];
+		}
+
+		// Move the new top down past the smaller ones.
+		for (int i = 0; 2 * i + 1 < size; ) {
+			int child = 2 * i + 1;
+			if (child + 1 < size && HEAD_LESS(heap[child + 1], heap[child])) {
+				child++;
+			}
+			if (!HEAD_LESS(heap[child], heap[i])) {
+				break;
+			}
+			UnionHead swap = heap[i];
+			heap[i] = heap[child];
+			heap[child] = swap;
+			i = child;
+		}
+
+		// Case of the same document as the last one, keep the higher frequency (and score).
+		if (tail != NULL && tail->doc_id == dn->doc_id) {
+			tail->freq = MATH_MAX(tail->freq, dn->freq);
+			tail->score = MATH_MAX(tail->score, dn->score);
+			free(dn);
+			continue;
+		}
+
+		// Case of a new document, append it.
+		if (tail == NULL) {
+			list = dn;
+		}
+		else {
+			tail->next = dn;
+		}
+		tail = dn;
+	}
+	if (tail != NULL) {
+		tail->next = NULL;
+	}
+	free(heap);
+	return list;
+}
+
+
+/*
+ * FilterPhrases - keep the documents of a list that match phrases.
+ * @list: list in doc_id order, taken over.
+ * @phrases: phrases to match.
+ * @num: number of phrases.
+ *
+ * Returns the documents that match every phrase.
+ *
+ * Pseudocode:
+ *     1. The list is in doc_id order, so each phrase is matched against its documents
+ *        in turn (see MatchPhrase).
+ *     2. Free each DocumentNode that does not match one of the phrases.
+ */
+
+DocumentNode *FilterPhrases(DocumentNode *list, Phrase *phrases, int num) {
+
+	DocumentNode **link = &list; // where the next DocumentNode kept goes.
+
+	while (*link != NULL) {
+		int match = 1;
+		for (int i=0; i < num && match; i++) {
+			match = MatchPhrase(&phrases[i], (*link)->doc_id);
+		}
+
+		// Case of match.
+		if (match) {
+			link = &(*link)->next;
+			continue;
+		}
+
+		// Case of no match: free the DocumentNode.
+		DocumentNode *no_need = *link;
+		*link = no_need->next;
+		free(no_need);
+	}
+	return list;
+}
+
+
+/*
+ * FreeDocuments - free a list of DocumentNodes.
+ */
+
+void FreeDocuments(DocumentNode *list) {
+	while (list != NULL) {
+		DocumentNode *next = list->next;
+		free(list);
+		list = next;
+	}
+}
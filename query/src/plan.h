@@ -0,0 +1,207 @@
+/* ========================================================================== */
+/* File: plan.h
+ *
+ * Project name: CS50 Tiny Search Engine
+ * Component name: Query
+ *
+ * This file contains the planning and running of parsed queries (see
+ * parse.h). PlanQuery looks up the words of a tree of QueryNodes and turns it
+ * into a tree of PlanNodes:
+ *
+ *     PLAN_AND   the words (and the words of the phrases) of an AND, its ORs,
+ *                and its NOTs, taken out of nested ANDs; the words ordered
+ *                rarest first and the ORs by the most documents they can match
+ *     PLAN_OR    its operands, taken out of nested ORs
+ *
+ * An AND with a word that is not in the index, or with an operand that can
+ * match nothing, matches nothing, and its other operands are not planned.
+ * An OR leaves out the operands that can match nothing.
+ *
+ * Given a PairCache (see cache.h), PlanQuery counts how often the two rarest
+ * words of each AND are planned together. Once a pair of frequent words has
+ * been planned PAIR_MIN_USES times, the documents they share are intersected
+ * once and kept, varint coded, and later ANDs of the pair start from them
+ * rather than from the posting list of the rarer word.
+ *
+ * ExecutePlan runs a plan with the kernels below, which only touch the lists
+ * they are passed: an AND starts from its cheapest operand and intersects it
+ * with the next cheapest until it is empty, takes away its NOTs, then checks
+ * its phrases; an OR merges its operands with a heap. An AND that has the
+ * documents of its pair starts from those instead. A NOT is only applied
+ * to the documents left by the other operands, so it narrows the results
+ * without adding work: a NOT of words looks those documents up in the doc_ids
+ * of its words rather than reading their posting lists. For --top, a plan
+ * that is an OR of ANDs of words is run with BlockMaxTopK (see topk.h) instead.
+ *
+ * A document of an AND gets the sum of the frequencies (and scores) of its
+ * operands, added up in plan order, and one of an OR the highest of them.
+ *
+ */
+/* ========================================================================== */
+#ifndef PLAN_H
+#define PLAN_H
+
+// ---------------- Prerequisites e.g., Requires "math.h"
+#include "qhashtable.h"                     // HashTable, WordNode, DocumentNode
+#include "cache.h"                          // PairCache
+#include "parse.h"                          // QueryNode
+#include "phrase.h"                         // Phrase
+#include "rank.h"                           // Ranker
+
+// ---------------- Constants
+
+// ---------------- Structures/Types
+
+typedef enum PlanType {
+  PLAN_AND,                                 // documents with every operand, and none of the excluded
+  PLAN_OR                                   // documents with any child
+} PlanType;
+
+typedef struct PlanNode {
+  PlanType type;                            // kind of node
+  WordNode **words;                         // PLAN_AND: words, rarest first
+  int num_words;                            // number of words
+  struct PlanNode **children;               // PLAN_AND: ORs, cheapest first; PLAN_OR: operands, in line order
+  int num_children;                         // number of children
+  Phrase *phrases;                          // PLAN_AND: phrases its documents have to match
+  int num_phrases;                          // number of phrases
+  struct PlanNode **excluded;               // PLAN_AND: operands of its NOTs, that can match something
+  int num_excluded;                         // number of excluded operands
+  unsigned char *pair;                      // PLAN_AND: index in words[0] and words[1] of each document they share, varint coded; NULL if not cached
+  int num_pair;                             // number of documents they share
+  long cost;                                // most documents it can match
+} PlanNode;
+
+// ---------------- Public Variables
+
+// ---------------- Prototypes/Macros
+
+/*
+ * PlanQuery - look up the words of a query and order its operands
+ * @query: root of the tree of QueryNodes
+ * @Index: InvertedIndex to look the words up in
+ * @pairs: documents shared by pairs of words, NULL for none; filled as pairs are used
+ * @arena: arena the PlanNodes are allocated from
+ *
+ * Returns the root of the plan, or NULL if no document can match (or memory
+ * cannot be allocated). The positions of the words of phrases are loaded.
+ * The documents of pairs are copied into the arena, so the plan does not
+ * depend on what the PairCache keeps afterwards.
+ *
+ * Usage example:
+ * Arena arena;
+ * InitializeArena(&arena);
+ * QueryNode *query = ParseQuery("dog AND (cat OR mouse)", &arena);
+ * if (query) {
+ *     PlanNode *plan = PlanQuery(query, &Index, NULL, &arena);
+ *     DocumentNode *list = ExecutePlan(plan, NULL, 0, &Index);
+ *     FreeDocuments(list);
+ * }
+ * FreeArena(&arena);
+ */
+PlanNode *PlanQuery(const QueryNode *query, HashTable *Index, PairCache *pairs, Arena *arena);
+
+/*
+ * ExecutePlan - find the documents of a plan
+ * @plan: root of the plan, NULL for none
+ * @ranker: BM25 ranker, NULL to rank by frequency
+ * @top_k: number of documents wanted, 0 for all of them
+ * @Index: InvertedIndex of the words
+ *
+ * Returns the documents, in doc_id order; or only the top_k highest ranked,
+ * in no order, if the plan is an OR of ANDs of words. Free it with FreeDocuments.
+ */
+DocumentNode *ExecutePlan(PlanNode *plan, const Ranker *ranker, int top_k, HashTable *Index);
+
+/*
+ * CompareDf - compare function for qsort, ordering WordNodes by document frequency, then by word
+ */
+int CompareDf(const void *e1, const void *e2);
+
+/*
+ * CopyPostings - copy the DocumentNodes of a word into a new list
+ * @word: WordNode of the word
+ * @ranker: BM25 ranker, NULL to rank by frequency
+ *
+ * Returns the list, in doc_id order, with the BM25 score of each document.
+ */
+DocumentNode *CopyPostings(WordNode *word, const Ranker *ranker);
+
+/*
+ * IntersectPostings - keep the documents of a list that a word has
+ * @list: list in doc_id order, taken over
+ * @word: WordNode of the word
+ * @ranker: BM25 ranker, NULL to rank by frequency
+ *
+ * Returns the list, with the frequency and score of the word added. The
+ * documents are looked up in the doc_ids of the word (see IntersectDocIds).
+ */
+DocumentNode *IntersectPostings(DocumentNode *list, WordNode *word, const Ranker *ranker);
+
+/*
+ * PairPostings - make a list of the documents two words share
+ * @words: WordNodes of the two words
+ * @pair: index in words[0] and words[1] of each document, varint coded (see PlanNode)
+ * @num: number of documents
+ * @ranker: BM25 ranker, NULL to rank by frequency
+ *
+ * Returns the list, in doc_id order, with the frequency and score of
+ * words[0], then words[1], added up as IntersectPostings would.
+ */
+DocumentNode *PairPostings(WordNode **words, const unsigned char *pair, int num, const Ranker *ranker);
+
+/*
+ * IntersectLists - keep the documents of a list that another list has
+ * @list: list in doc_id order, taken over
+ * @other: list in doc_id order, freed
+ *
+ * Returns the list, with the frequency and score of other added.
+ */
+DocumentNode *IntersectLists(DocumentNode *list, DocumentNode *other);
+
+/*
+ * SubtractLists - take the documents of another list out of a list
+ * @list: list in doc_id order, taken over
+ * @other: list in doc_id order, freed
+ *
+ * Returns what is left of the list.
+ */
+DocumentNode *SubtractLists(DocumentNode *list, DocumentNode *other);
+
+/*
+ * ExcludeWords - take out of a list the documents of an AND of words, or an OR of those
+ * @list: list in doc_id order, taken over
+ * @plan: PLAN_AND of words only, or a PLAN_OR of those
+ *
+ * Returns what is left of the list. The doc_ids of the list are looked up in
+ * the doc_ids of the words (see IntersectDocIds), so a NOT of a frequent word
+ * costs about as much as the list, not as its posting list.
+ */
+DocumentNode *ExcludeWords(DocumentNode *list, const PlanNode *plan);
+
+/*
+ * UnionLists - merge lists into one
+ * @lists: lists in doc_id order, taken over
+ * @num: number of lists
+ *
+ * Returns the list of every document, in doc_id order, with its highest
+ * frequency (and score). The DocumentNode kept is the one of the earliest list.
+ */
+DocumentNode *UnionLists(DocumentNode **lists, int num);
+
+/*
+ * FilterPhrases - keep the documents of a list that match phrases
+ * @list: list in doc_id order, taken over
+ * @phrases: phrases to match (see MatchPhrase), with no document matched yet
+ * @num: number of phrases
+ *
+ * Returns the documents that match every phrase.
+ */
+DocumentNode *FilterPhrases(DocumentNode *list, Phrase *phrases, int num);
+
+/*
+ * FreeDocuments - free a list of DocumentNodes
+ */
+void FreeDocuments(DocumentNode *list);
+
+#endif // PLAN_H
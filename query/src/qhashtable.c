@@ -18,16 +18,27 @@
 #include <string.h>                          // strlen
 #include <stdlib.h>
 #include <stdio.h>
+#include <limits.h>                          // INT_MAX
 
 // ---------------- Local includes  e.g., "file.h"
 #include "qhashtable.h"                       // hashtable functionality
+#include "indexfile.h"                        // binary index functionality
+#include "segments.h"                         // segment manifest functionality
+#include "postings.h"                         // DecodeBlock
 
 // ---------------- Constant definitions
 
 // ---------------- Macro definitions
-#define MAX 100000
 // ---------------- Structures/Types
 
+typedef struct SegmentPositions {
+    Posting *postings;                      // postings of the word in a segment
+    int *positions;                         // their positions, one posting after the other
+    int num;                                // number of postings
+    int next;                               // next posting to match with a DocumentNode
+    int offset;                             // positions of the postings before next
+} SegmentPositions;
+
 // ---------------- Private variables
 
 // ---------------- Private prototypes
@@ -38,6 +49,19 @@ int InitializeHashTable(HashTable *);
 int FreeHashTable(HashTable *);
 void NormalizeWord(char *);
 HashTable *ReadFile(char *, HashTable *);
+HashTable *ReadSegment(char *, HashTable *, unsigned char *, size_t);
+HashTable *ReadIndex(char *, HashTable *);
+HashTable *MapIndex(char *, HashTable *);
+WordNode *FindWord(char *, HashTable *);
+int LoadPositions(WordNode *, HashTable *);
+int LoadBlockMax(WordNode *, HashTable *);
+static int NewDocuments(const IndexTerm *, const unsigned char *, size_t, HashTable *, DocumentNode **);
+static DocumentNode *MergeDocuments(DocumentNode *, DocumentNode *);
+static int FlattenDocuments(WordNode *, HashTable *);
+static void UnmapIndex(HashTable *);
+static WordNode *DecodeWord(char *, HashTable *);
+static int DecodeWordPositions(WordNode *, HashTable *);
+static int DecodeWordBlocks(WordNode *, HashTable *);
 
 // Function to compute the hash code for a given string.
 unsigned long JenkinsHash(const char *str, unsigned long mod)
@@ -119,7 +143,10 @@ int AddWord(char *WORD, int doc_ID, HashTable *Index) {
 		
 		// There is no matching DocumentNode, so create a new DocumentNode.
 		DocumentNode *doc_node;
-		doc_node = (DocumentNode *)calloc(1, sizeof(DocumentNode));
+		doc_node = (DocumentNode *)ArenaAlloc(&Index->arena, sizeof(DocumentNode));
+		if (!doc_node) {
+			return 0;
+		}
 		doc_node->doc_id = doc_ID;
 		doc_node->freq = 1;
 		
@@ -130,18 +157,20 @@ int AddWord(char *WORD, int doc_ID, HashTable *Index) {
 	// Word does not exist in the Index.
 	
 	// Create and initialize a new WordNode.
-	node = (WordNode *)calloc(1, sizeof(WordNode));
+	node = (WordNode *)ArenaAlloc(&Index->arena, sizeof(WordNode));
 	if (!node) {
 		return 0;
 	}
-	node->word = (char *)malloc(strlen(WORD)+1);
+	node->word = ArenaStrdup(&Index->arena, WORD);
 	if (!node->word) {
 		return 0;
 	}
-	strcpy(node->word, WORD);
 	
 	// Add a DocumentNode to the WordNode. 
-	node->page = (DocumentNode *)calloc(1, sizeof(DocumentNode));
+	node->page = (DocumentNode *)ArenaAlloc(&Index->arena, sizeof(DocumentNode));
+	if (!node->page) {
+		return 0;
+	}
 	node->page->doc_id = doc_ID;
 	node->page->freq = 1;
 	
@@ -205,61 +234,21 @@ int InHashTable(char *WORD, HashTable *Index) {
  *     1. InvertedIndex has been initialized.
  *
  * Pseudocode:
- *     1. Loop through the entire InvertedIndex.
- *     2. Add WordNode and word pointers to arrays of WordNode and word pointers.
- *     3. Add DocumentNode pointers of each WordNode to array of DocumentNode pointers.
- *     4. Looping backwards through the three arrays, free the content in them.
+ *     1. Empty every bin of the InvertedIndex.
+ *     2. Free the arena, which owns all the nodes and words.
+ *     3. Unmap the segments mapped by MapIndex.
  *
  */
 
 int CleanHashTable(HashTable *Index) {
 	
-	// Variable for traversal.
-	WordNode *current; 
-	
-	// Loop through the entire InvertedIndex.
+	// Make sure no bin points into the arena anymore.
 	for (int index=0; index < MAX_HASH_SLOT; index++) {
-		WordNode *wn_ptr[100] = {0}; // Array to hold pointers to WordNodes.
-		char *word_ptr[100] = {0}; // Array to hold pointers to words of WordNodes.
-		DocumentNode *dn_ptr[MAX] = {0}; // Array to hold pointers to DocumentNodes.
-		
-		int i=0; // counter for wn_ptr and word_ptr.
-		
-		// Check that the bin is not empty.
-		if (Index->table[index]->data != NULL) {
-			DocumentNode *ptr;
-			// Loop through each WordNode of the bin.
-			for(current = Index->table[index]->data; current != NULL; current = current->next) {
-			
-				// Add WordNode and its word pointer to the respective arrays.
-				wn_ptr[i] = current;
-				word_ptr[i] = current->word;
-				
-				int j = 0; // counter for dn_ptr.
-				// Loop through each document node of the word node.
-				for (ptr = current->page; ptr != NULL; ptr = ptr->next) {
-					dn_ptr[j] = ptr;
-					j++;
-				}
-				j--; // Decrement to account for the increment when program exits the for loop.
-				
-				// Loop through the dn_ptr backwards.
-				for (int k=j; k >=0; k--) {
-					free(dn_ptr[k]); // Free memory allocated to the document nodes.
-				}
-				i++;
-			}
-			i--; // Offset the final i increment.
-		}
-		
-		// Loop through the word_ptr, wn_ptr arrays backwards.
-		for (int m=i; m>=0; m--) {
-			free(word_ptr[m]); // Free memory allocated to char *word in the WordNode.
-			free(wn_ptr[m]); // Free memory allocated to the WordNode.
-		}
-		
-		Index->table[index]->data = NULL; // Make sure the data isn't pointing to any WordNode.
+		Index->table[index]->data = NULL;
 	}
+	
+	FreeArena(&Index->arena); // One munmap per arena block.
+	UnmapIndex(Index);
 	return 0;
 }
 
@@ -276,6 +265,7 @@ int CleanHashTable(HashTable *Index) {
  * Pseudocode:
  *     1. Loop through each bin of the InvertedIndex.
  *     2. Free HashTableNode.
+ *     3. Destroy the lock of the InvertedIndex.
  */
 
 // Function to clear all the HashTableNodes allocated.
@@ -285,6 +275,7 @@ int FreeHashTable(HashTable *Index) {
 		free(Index->table[i]); // Free the HashTableNode.
 		Index->table[i] = NULL;
 	}
+	pthread_mutex_destroy(&Index->lock);
 	return 0;
 
 }
@@ -302,6 +293,8 @@ int FreeHashTable(HashTable *Index) {
  * Pseudocode:
  *     1. Loop through each bin of the InvertedIndex.
  *     2. Declare and initialize empty HashTableNodes.
+ *     3. Initialize the arena the nodes will be allocated from, with no segment mapped.
+ *     4. Initialize the lock threads take to look words up.
  */
  
 int InitializeHashTable(HashTable *Index) {
@@ -310,114 +303,674 @@ int InitializeHashTable(HashTable *Index) {
 		Index->table[i] = (HashTableNode *)calloc(1, sizeof(HashTableNode)); // Initialize the hash table node.
 		Index->table[i]->data = NULL; // Set the void * data to NULL for the node.
 	}
+	InitializeArena(&Index->arena);
+	Index->segments = NULL;
+	Index->num_segments = 0;
+	pthread_mutex_init(&Index->lock, NULL);
 	return 0;
 }
 
 
 /*
- * ReadFile - Read from a file to create an InvertedIndex.
- * @file_name: file to be read.
+ * ReadIndex - Read all the live segments of an index to create an InvertedIndex.
+ * @file_name: index file, ie index.dat.
  * @New_Index: pointer to an InvertedIndex to be created.
  *
- * Returns a pointer to an InvertedIndex.
+ * Returns a pointer to an InvertedIndex, NULL if a segment is not a valid index.
  *
  * Pseudocode:
- *     1. Read each line of file_name.
- *     2. Parse for the word and the number of docs the word appears in.
- *     3. Create a WordNode and add to the InvertedIndex.
- *     4. Loop through the rest of the line, parsing for doc_id and freq.
- *     5. Create a DocumentNode and add to the InvertedIndex.
+ *     1. Without a manifest, the index is the single file file_name.
+ *     2. Otherwise, read each live segment of the manifest with its deletion bitmap.
  */
 
-HashTable *ReadFile(char *file_name, HashTable *New_Index) {
+HashTable *ReadIndex(char *file_name, HashTable *New_Index) {
 	
-	// Declare variables.
-	FILE *fp;
-	char *buf;
-	char *WORD; // word
-	char *num; // number of docs the word appears in.
-	char *ptr; // pointer referencing position in the current line.
-	
-	// Initialize variables.
-	fp = fopen(file_name, "r");
-	buf = (char *)malloc(MAX);
-	WORD = (char *)malloc(100);
-	num = (char *)malloc(10);
-	
-	// Read each line of file_name.
-	while (fgets(buf, MAX, fp) != NULL) {
+	Manifest manifest;
+	if (!ReadManifest(file_name, &manifest)) {
+		return ReadFile(file_name, New_Index);
+	}
+	
+	// Read each live segment, leaving out its deleted documents.
+	HashTable *ptr = New_Index;
+	for (int i=0; i < manifest.num_segments && ptr; i++) {
+		Segment *segment = &manifest.segments[i];
+		char *name = SegmentName(file_name, segment->id);
+		size_t size = 0;
+		unsigned char *deleted = segment->num_deleted ? ReadDeleted(file_name, segment->id, segment->deleted_gen, &size) : NULL;
 		
-		sscanf(buf, "%s %s", WORD, num);
-		ptr = buf + strlen(WORD) + strlen(num) + 2; // Update position.
+		if (!name || (segment->num_deleted && !deleted)) {
+			ptr = NULL;
+		}
+		else {
+			ptr = ReadSegment(name, New_Index, deleted, size);
+		}
+		free(deleted);
+		free(name);
+	}
+	
+	FreeManifest(&manifest);
+	return ptr;
+}
+
+
+/*
+ * MapIndex - Map all the live segments of an index, to be decoded word by word.
+ * @file_name: index file, ie index.dat.
+ * @Index: pointer to an empty InvertedIndex.
+ *
+ * Returns Index, NULL if a segment is not a valid index.
+ *
+ * Pseudocode:
+ *     1. Without a manifest, the index is the single file file_name.
+ *     2. Otherwise, map each live segment of the manifest and read its deletion bitmap.
+ */
+
+HashTable *MapIndex(char *file_name, HashTable *Index) {
+	
+	Manifest manifest;
+	int segmented = ReadManifest(file_name, &manifest);
+	int num = segmented ? manifest.num_segments : 1;
+	int ok = (Index->segments = (MappedSegment *)calloc(num ? num : 1, sizeof(MappedSegment))) != NULL;
+	
+	// Map each segment.
+	for (int i=0; i < num && ok; i++) {
+		Segment *segment = segmented ? &manifest.segments[i] : NULL;
+		MappedSegment *mapped = &Index->segments[i];
+		char *name = segment ? SegmentName(file_name, segment->id) : NULL;
 		
-		// Create and initialize new word node.
-		WordNode *wn;
-		wn = (WordNode *)calloc(1, sizeof(WordNode)); // Initialize a new WordNode.
-		wn->word = (char *)malloc(strlen(WORD) + 1);
-		strcpy(wn->word, WORD);
+		ok = OpenIndexFile(&mapped->file, segment ? name : file_name);
+		if (ok) {
+			Index->num_segments++;
+		}
+		if (ok && segment && segment->num_deleted) {
+			ok = (mapped->deleted = ReadDeleted(file_name, segment->id, segment->deleted_gen, &mapped->deleted_size)) != NULL;
+		}
+		free(name);
+	}
+	
+	if (segmented) {
+		FreeManifest(&manifest);
+	}
+	if (!ok) {
+		UnmapIndex(Index);
+		return NULL;
+	}
+	return Index;
+}
+
+
+/*
+ * FindWord - Find the WordNode of a word, decoding it from the mapped segments if needed.
+ * @word: word to be searched.
+ * @Index: pointer to the InvertedIndex.
+ *
+ * Returns the WordNode, NULL if the word is not in the InvertedIndex.
+ *
+ * Pseudocode:
+ *     1. Look for the word in its bin without the lock. A WordNode is only added to a bin,
+ *        and given its doc_ids, with a release store once it is complete, so a WordNode
+ *        with doc_ids can be used as it is.
+ *     2. Otherwise, take the lock of the InvertedIndex, so only one thread decodes words
+ *        at a time, decode the word (see DecodeWord), and give the lock back.
+ */
+
+WordNode *FindWord(char *word, HashTable *Index) {
+	
+	// Look for a WordNode that is already decoded.
+	unsigned long index = JenkinsHash(word, MAX_HASH_SLOT);
+	WordNode *wn;
+	for (wn = __atomic_load_n(&Index->table[index]->data, __ATOMIC_ACQUIRE); wn != NULL; wn = wn->next) {
+		if (strcmp(wn->word, word) == 0 && __atomic_load_n(&wn->doc_ids, __ATOMIC_ACQUIRE) != NULL) {
+			return wn;
+		}
+	}
+	
+	// Decode it.
+	pthread_mutex_lock(&Index->lock);
+	wn = DecodeWord(word, Index);
+	pthread_mutex_unlock(&Index->lock);
+	return wn;
+}
+
+
+/*
+ * LoadPositions - Give every DocumentNode of a word the positions of the word in its document.
+ * @wn: WordNode of the word.
+ * @Index: pointer to an InvertedIndex filled in by MapIndex.
+ *
+ * Returns 1 if successful, 0 if a segment has no positions or memory could not be allocated.
+ *
+ * Pseudocode:
+ *     1. If the first DocumentNode has its positions, every one has: return without the lock.
+ *     2. Otherwise, take the lock of the InvertedIndex, load the positions (see
+ *        DecodeWordPositions), and give the lock back.
+ */
+
+int LoadPositions(WordNode *wn, HashTable *Index) {
+	if (wn->page != NULL && __atomic_load_n(&wn->page->positions, __ATOMIC_ACQUIRE) != NULL) {
+		return 1;
+	}
+	pthread_mutex_lock(&Index->lock);
+	int ok = DecodeWordPositions(wn, Index);
+	pthread_mutex_unlock(&Index->lock);
+	return ok;
+}
+
+
+/*
+ * LoadBlockMax - Work out the bounds of each block of POSTING_BLOCK DocumentNodes of a word.
+ * @wn: WordNode of the word.
+ * @Index: pointer to an InvertedIndex.
+ *
+ * Returns 1 if successful, 0 if memory could not be allocated.
+ *
+ * Pseudocode:
+ *     1. If the word has its bounds, return without the lock.
+ *     2. Otherwise, take the lock of the InvertedIndex, work out the bounds (see
+ *        DecodeWordBlocks), and give the lock back.
+ */
+
+int LoadBlockMax(WordNode *wn, HashTable *Index) {
+	if (__atomic_load_n(&wn->blocks, __ATOMIC_ACQUIRE) != NULL) {
+		return 1;
+	}
+	pthread_mutex_lock(&Index->lock);
+	int ok = DecodeWordBlocks(wn, Index);
+	pthread_mutex_unlock(&Index->lock);
+	return ok;
+}
+
+
+/*
+ * DecodeWord - Find the WordNode of a word, decoding it from the mapped segments if needed.
+ * @word: word to be searched.
+ * @Index: pointer to the InvertedIndex.
+ *
+ * Returns the WordNode, NULL if the word is not in the InvertedIndex.
+ *
+ * Pseudocode:
+ *     1. Look for the word in its bin.
+ *     2. If it is not there, look it up in every mapped segment, and decode its
+ *        postings without the deleted documents.
+ *     3. Merge the postings of all the segments, and add a WordNode for them to the bin.
+ *     4. Lay out its DocumentNodes in one array the first time it is found (see FlattenDocuments).
+ *        A new WordNode is added to the bin with a release store only once it is laid out, as
+ *        FindWord walks the bins without the lock.
+ */
+
+static WordNode *DecodeWord(char *word, HashTable *Index) {
+	
+	unsigned long index = JenkinsHash(word, MAX_HASH_SLOT); // Get the hash code.
+	WordNode *wn;
+	
+	// Look for a WordNode that is already in the bin.
+	for (wn = Index->table[index]->data; wn != NULL; wn = wn->next) {
+		if (strcmp(wn->word, word) == 0) {
+			return (wn->doc_ids || FlattenDocuments(wn, Index)) ? wn : NULL;
+		}
+	}
+	
+	// Decode the word from every segment that has it.
+	DocumentNode *page = NULL;
+	for (int i=0; i < Index->num_segments; i++) {
+		MappedSegment *mapped = &Index->segments[i];
+		IndexTerm term;
+		DocumentNode *part;
+		
+		if (FindIndexTerm(&mapped->file, word, &term)) {
+			if (!NewDocuments(&term, mapped->deleted, mapped->deleted_size, Index, &part)) {
+				return NULL;
+			}
+			page = MergeDocuments(page, part);
+		}
+	}
+	if (page == NULL) {
+		return NULL;
+	}
+	
+	// Keep the WordNode for the next lookup.
+	wn = (WordNode *)ArenaAlloc(&Index->arena, sizeof(WordNode));
+	if (!wn || !(wn->word = ArenaStrdup(&Index->arena, word))) {
+		return NULL;
+	}
+	wn->page = page;
+	if (!FlattenDocuments(wn, Index)) {
+		return NULL;
+	}
+	wn->next = Index->table[index]->data;
+	__atomic_store_n(&Index->table[index]->data, wn, __ATOMIC_RELEASE);
+	return wn;
+}
+
+
+/*
+ * DecodeWordPositions - Give every DocumentNode of a word the positions of the word in its document.
+ * @wn: WordNode of the word.
+ * @Index: pointer to an InvertedIndex filled in by MapIndex.
+ *
+ * Returns 1 if successful, 0 if a segment has no positions or memory could not be allocated.
+ *
+ * Pseudocode:
+ *     1. Decode the postings of the word and their positions from every mapped segment that has it.
+ *     2. Allocate one array for the positions of all the DocumentNodes.
+ *     3. Walk the DocumentNodes in doc_id order. Each one is the next posting, that is not
+ *        deleted, of one of the segments, so copy the positions of that posting.
+ *     4. Only once every DocumentNode has its positions, point each one at them, the first
+ *        one last with a release store. Threads sharing the InvertedIndex never see a word
+ *        with part of its positions (see LoadPositions).
+ */
+
+static int DecodeWordPositions(WordNode *wn, HashTable *Index) {
+	
+	if (wn->page == NULL || wn->page->positions != NULL) {
+		return wn->page != NULL;
+	}
+	if (Index->num_segments == 0) {
+		return 0;
+	}
+	
+	// Decode the word from every segment that has it.
+	SegmentPositions *parts = (SegmentPositions *)calloc(Index->num_segments, sizeof(SegmentPositions));
+	int ok = parts != NULL;
+	for (int i=0; i < Index->num_segments && ok; i++) {
+		MappedSegment *mapped = &Index->segments[i];
+		IndexTerm term;
 		
-		unsigned long index = JenkinsHash(WORD, MAX_HASH_SLOT); // Get the hash code.
+		if (!FindIndexTerm(&mapped->file, wn->word, &term)) {
+			continue;
+		}
+		if (!(mapped->file.header.flags & INDEX_POSITIONS)) {
+			ok = 0;
+			break;
+		}
 		
-		// Check that the bin is empty.
-		if (New_Index->table[index]->data == NULL) {
-			New_Index->table[index]->data = wn;
+		// Count the positions, then decode them.
+		parts[i].postings = (Posting *)malloc(term.df * sizeof(Posting));
+		ok = parts[i].postings != NULL;
+		if (ok) {
+			parts[i].num = DecodePostings(&term, parts[i].postings);
+			size_t total = 0;
+			for (int k=0; k < parts[i].num; k++) {
+				total += parts[i].postings[k].freq;
+			}
+			parts[i].positions = (int *)malloc((total ? total : 1) * sizeof(int));
+			ok = parts[i].positions != NULL &&
+					DecodePositions(&term, parts[i].postings, parts[i].num, parts[i].positions) == (int)total;
 		}
-		else { // The bin is not empty.
-			WordNode *wn_ptr; // pointer for traversal.
+	}
+	
+	// Count the positions of the DocumentNodes.
+	size_t total = 0;
+	DocumentNode *dn;
+	for (dn = wn->page; dn != NULL; dn = dn->next) {
+		total += dn->freq;
+	}
+	int *positions = ok ? (int *)ArenaAlloc(&Index->arena, total * sizeof(int)) : NULL;
+	int *next_positions = positions;
+	ok = positions != NULL;
+	
+	// Match each DocumentNode with the next live posting of its segment.
+	for (dn = wn->page; dn != NULL && ok; dn = dn->next) {
+		int i;
+		for (i=0; i < Index->num_segments; i++) {
+			SegmentPositions *part = &parts[i];
+			MappedSegment *mapped = &Index->segments[i];
 			
-			// Loop until the last wordnode.
-			for(wn_ptr = New_Index->table[index]->data; wn_ptr->next != NULL; wn_ptr = wn_ptr->next);
-			wn_ptr->next = wn; // Set the new WordNode as the last element of the WordNode list.
+			// Skip the deleted postings, which have no DocumentNode.
+			while (part->next < part->num && mapped->deleted &&
+					IsDeleted(mapped->deleted, mapped->deleted_size, part->postings[part->next].doc_id)) {
+				part->offset += part->postings[part->next].freq;
+				part->next++;
+			}
+			if (part->next < part->num && (int)part->postings[part->next].doc_id == dn->doc_id) {
+				break;
+			}
+		}
+		if (i == Index->num_segments || parts[i].postings[parts[i].next].freq != dn->freq) {
+			ok = 0;
+			break;
+		}
+		memcpy(next_positions, parts[i].positions + parts[i].offset, dn->freq * sizeof(int));
+		next_positions += dn->freq;
+		parts[i].offset += dn->freq;
+		parts[i].next++;
+	}
+	
+	// Point the DocumentNodes at their positions, unless one could not get them; the first one last.
+	int *first = positions;
+	for (dn = wn->page; dn != NULL && ok; dn = dn->next) {
+		if (dn != wn->page) {
+			dn->positions = positions;
 		}
+		positions += dn->freq;
+	}
+	if (ok) {
+		__atomic_store_n(&wn->page->positions, first, __ATOMIC_RELEASE);
+	}
+	
+	// Cleanup.
+	for (int i=0; parts && i < Index->num_segments; i++) {
+		free(parts[i].postings);
+		free(parts[i].positions);
+	}
+	free(parts);
+	return ok;
+}
 
-		// Loop while position in the line is less than or equal to the end of the line.
-		while (ptr <= buf + strlen(buf) - 2) { // -2 is to account for whitespace and newline char at the end.
-			
-			// Variables used for parsing to get the doc_id and freq.
-			char *number1, *number2;
-			int doc_id, freq;
-			
-			// Read in doc_id and freq as char *.
-			number1 = calloc(1, 10);
-			number2 = calloc(1, 10);
-			sscanf(ptr, "%s %s", number1, number2);
-			
-			// update position in the line.
-			ptr += strlen(number1) + strlen(number2) + 2;
-			
-			// Convert doc_id and freq from char* to int.
-			sscanf(number1, "%d", &doc_id);
-			sscanf(number2, "%d", &freq);
-			
-			// Create and initialize a DocumentNode.
-			DocumentNode *dn;
-			dn = (DocumentNode *)calloc(1, sizeof(DocumentNode));
-			dn->doc_id = doc_id;
-			dn->freq = freq;
+
+/*
+ * DecodeWordBlocks - Work out the bounds of each block of POSTING_BLOCK DocumentNodes of a word.
+ * @wn: WordNode of the word.
+ * @Index: pointer to an InvertedIndex.
+ *
+ * Returns 1 if successful, 0 if memory could not be allocated.
+ *
+ * Pseudocode:
+ *     1. For each block, take its last doc_id and its largest frequency from its DocumentNodes.
+ *     2. For the length of its shortest document, take the shortest of the blocks of postings,
+ *        of every mapped segment that has the word, that overlap its doc_ids. The indexer wrote
+ *        those in their headers, so no posting is decoded. A deleted document can only make it
+ *        shorter. Without mapped segments, the length is 0, ie unknown.
+ */
+
+static int DecodeWordBlocks(WordNode *wn, HashTable *Index) {
+	
+	if (wn->blocks != NULL) {
+		return 1;
+	}
+	int num_blocks = NumBlocks(wn->df);
+	BlockMax *blocks = (BlockMax *)ArenaAlloc(&Index->arena, (num_blocks ? num_blocks : 1) * sizeof(BlockMax));
+	if (!blocks) {
+		return 0;
+	}
+	
+	// Take the last doc_id and the largest frequency of each block.
+	for (int c=0; c < num_blocks; c++) {
+		int end = (c + 1) * POSTING_BLOCK < wn->df ? (c + 1) * POSTING_BLOCK : wn->df;
+		blocks[c].last_doc_id = wn->doc_ids[end - 1];
+		for (int i = c * POSTING_BLOCK; i < end; i++) {
+			if (wn->page[i].freq > blocks[c].max_freq) {
+				blocks[c].max_freq = wn->page[i].freq;
+			}
+		}
+		blocks[c].min_length = Index->num_segments ? INT_MAX : 0;
+	}
+	
+	// Take the shortest lengths from the headers of the blocks of postings of each segment.
+	for (int i=0; i < Index->num_segments; i++) {
+		IndexTerm term;
+		if (!FindIndexTerm(&Index->segments[i].file, wn->word, &term)) {
+			continue;
+		}
+		int num = NumBlocks(term.df);
+		int k = 0; // first block of postings that does not end before the current block
+		long long after = -1; // last doc_id of the block of postings before k
+		PostingBlock header;
+		
+		for (int c=0; c < num_blocks; c++) {
+			int first = wn->doc_ids[c * POSTING_BLOCK];
 			
-			DocumentNode *dn_ptr; // pointer for traversal.
+			// Skip the blocks of postings that end before the block.
+			for (; k < num; k++) {
+				GetPostingBlock(term.postings, k, &header);
+				if (header.last_doc_id >= (uint32_t)first) {
+					break;
+				}
+				after = header.last_doc_id;
+			}
 			
-			// Check if there is no document node associated with the word node.
-			if (wn->page == NULL) {
-				wn->page = dn;
+			// The blocks of postings from k on that start before the end of the block overlap it.
+			long long start = after;
+			for (int j = k; j < num && start < blocks[c].last_doc_id; j++) {
+				GetPostingBlock(term.postings, j, &header);
+				if ((int)header.min_length < blocks[c].min_length) {
+					blocks[c].min_length = header.min_length;
+				}
+				start = header.last_doc_id;
 			}
-			else {
-				// Loop to the end of the DocumentNode list.
-				for (dn_ptr = wn->page; dn_ptr->next != NULL; dn_ptr = dn_ptr->next);
-				dn_ptr->next = dn;
+		}
+	}
+	for (int c=0; c < num_blocks; c++) {
+		if (blocks[c].min_length == INT_MAX) {
+			blocks[c].min_length = 0;
+		}
+	}
+	__atomic_store_n(&wn->blocks, blocks, __ATOMIC_RELEASE);
+	return 1;
+}
+
+
+/*
+ * ReadFile - Read from a binary index file to create an InvertedIndex.
+ * @file_name: file to be read.
+ * @New_Index: pointer to an InvertedIndex to be created.
+ *
+ * Returns a pointer to an InvertedIndex, NULL if the file is not a valid index.
+ */
+
+HashTable *ReadFile(char *file_name, HashTable *New_Index) {
+	return ReadSegment(file_name, New_Index, NULL, 0);
+}
+
+
+/*
+ * ReadSegment - Read a segment of an index into an InvertedIndex, leaving out deleted documents.
+ * @file_name: file to be read.
+ * @New_Index: pointer to an InvertedIndex, possibly holding other segments already.
+ * @deleted: deletion bitmap of the segment, NULL if none.
+ * @deleted_size: bytes of the deletion bitmap.
+ *
+ * Returns a pointer to an InvertedIndex, NULL if the file is not a valid index.
+ *
+ * Pseudocode:
+ *     1. Map and validate the whole index file.
+ *     2. For each word of the dictionary, decode the postings that are not deleted (see NewDocuments).
+ *     3. If the word is already in the InvertedIndex, merge the DocumentNodes into its list.
+ *        Otherwise, create a WordNode and add to the InvertedIndex.
+ */
+
+HashTable *ReadSegment(char *file_name, HashTable *New_Index, unsigned char *deleted, size_t deleted_size) {
+	
+	// Declare variables.
+	IndexFile index_file;
+	TermCursor cursor = {0};
+	IndexTerm term;
+	int first = (New_Index->arena.head == NULL); // 1 if no segment was read into New_Index yet
+	
+	if (!OpenIndexFile(&index_file, file_name)) {
+		return NULL;
+	}
+	if (!VerifyIndexFile(&index_file)) {
+		CloseIndexFile(&index_file);
+		return NULL;
+	}
+	
+	// Loop through each word of the dictionary.
+	while (NextIndexTerm(&index_file, &cursor, &term)) {
+		
+		// Decode the postings of the word that are not deleted.
+		DocumentNode *page;
+		if (!NewDocuments(&term, deleted, deleted_size, New_Index, &page)) {
+			CloseIndexFile(&index_file);
+			return NULL;
+		}
+		if (page == NULL) {
+			continue;
+		}
+		
+		// Look for the word in its bin, in case an earlier segment has it.
+		// The words of one segment are distinct, so the first one skips the search.
+		unsigned long index = JenkinsHash(term.word, MAX_HASH_SLOT); // Get the hash code.
+		WordNode *wn;
+		for (wn = first ? NULL : New_Index->table[index]->data; wn != NULL; wn = wn->next) {
+			if (strcmp(wn->word, term.word) == 0) {
+				break;
 			}
-			
-			// Cleanup.
-			free(number1);
-			free(number2);
 		}
+		if (wn != NULL) {
+			wn->page = MergeDocuments(wn->page, page);
+			continue;
+		}
+		
+		// Create and initialize new word node.
+		wn = (WordNode *)ArenaAlloc(&New_Index->arena, sizeof(WordNode)); // Initialize a new WordNode.
+		if (!wn || !(wn->word = ArenaStrdup(&New_Index->arena, term.word))) {
+			CloseIndexFile(&index_file);
+			return NULL;
+		}
+		wn->page = page;
+		
+		// Add the WordNode to the front of its bin.
+		wn->next = New_Index->table[index]->data;
+		New_Index->table[index]->data = wn;
 	}
 	
 	// Cleanup.
-	free(WORD);
-	free(num);
-	free(buf);
-	fclose(fp);
+	CloseIndexFile(&index_file);
 
 	return New_Index;
 }
+
+
+/*
+ * NewDocuments - Decode the postings of a word into DocumentNodes, leaving out deleted documents.
+ * @term: word of a mapped index file.
+ * @deleted: deletion bitmap of the index file, NULL if none.
+ * @deleted_size: bytes of the deletion bitmap.
+ * @Index: InvertedIndex whose arena holds the DocumentNodes.
+ * @page: set to the list of DocumentNodes, NULL if every posting is deleted.
+ *
+ * Returns 1 if successful, 0 if memory could not be allocated.
+ *
+ * Pseudocode:
+ *     1. Allocate one array of DocumentNodes for all the postings of the word.
+ *     2. Decode the postings one block at a time, straight into the array, skipping deleted documents.
+ *     3. Link the DocumentNodes in doc_id order.
+ */
+
+static int NewDocuments(const IndexTerm *term, const unsigned char *deleted, size_t deleted_size, HashTable *Index,
+		DocumentNode **page) {
+	
+	uint32_t doc_ids[POSTING_BLOCK], freqs[POSTING_BLOCK];
+	DocumentNode *dn = (DocumentNode *)ArenaAlloc(&Index->arena, term->df * sizeof(DocumentNode));
+	int num = 0;
+	
+	*page = NULL;
+	if (!dn) {
+		return 0;
+	}
+	
+	// Decode each block into the array.
+	for (int b=0; b < NumBlocks(term->df); b++) {
+		int n = DecodeBlock(term->postings, term->df, b, doc_ids, freqs);
+		for (int i=0; i < n; i++) {
+			if (deleted && IsDeleted(deleted, deleted_size, doc_ids[i])) {
+				continue;
+			}
+			dn[num].doc_id = doc_ids[i];
+			dn[num].freq = freqs[i];
+			num++;
+		}
+	}
+	
+	// Link the DocumentNodes.
+	for (int i=0; i < num; i++) {
+		dn[i].next = (i + 1 < num) ? &dn[i + 1] : NULL;
+	}
+	*page = num ? dn : NULL;
+	return 1;
+}
+
+
+/*
+ * MergeDocuments - merges two lists of DocumentNodes sorted by doc_id into one.
+ */
+
+static DocumentNode *MergeDocuments(DocumentNode *a, DocumentNode *b) {
+	DocumentNode head = {0};
+	DocumentNode *tail = &head;
+	
+	while (a != NULL && b != NULL) {
+		if (a->doc_id < b->doc_id) {
+			tail->next = a;
+			a = a->next;
+		}
+		else {
+			tail->next = b;
+			b = b->next;
+		}
+		tail = tail->next;
+	}
+	tail->next = (a != NULL) ? a : b;
+	return head.next;
+}
+
+
+/*
+ * FlattenDocuments - Lay out the DocumentNodes of a word in one array, and list their doc_ids.
+ * @wn: WordNode of the word.
+ * @Index: InvertedIndex whose arena holds the arrays.
+ *
+ * Returns 1 if successful, 0 if memory could not be allocated.
+ *
+ * Pseudocode:
+ *     1. Count the DocumentNodes, and check whether each one follows the one before in memory.
+ *        The postings of one segment are decoded into one array, so they usually do.
+ *     2. If not, as for a word merged from several segments, copy them into one array.
+ *     3. Copy their doc_ids into an array of their own, for the intersections of AND. Set
+ *        doc_ids last, with a release store, as FindWord takes a WordNode with doc_ids as it is.
+ */
+
+static int FlattenDocuments(WordNode *wn, HashTable *Index) {
+	DocumentNode *dn;
+	int num = 0;
+	int in_order = 1; // 1 if the DocumentNodes are already one array
+	
+	for (dn = wn->page; dn != NULL; dn = dn->next) {
+		if (dn->next != NULL && dn->next != dn + 1) {
+			in_order = 0;
+		}
+		num++;
+	}
+	
+	// Copy the DocumentNodes into one array, linked in order.
+	DocumentNode *page = wn->page;
+	if (!in_order) {
+		if (!(page = (DocumentNode *)ArenaAlloc(&Index->arena, num * sizeof(DocumentNode)))) {
+			return 0;
+		}
+		int i = 0;
+		for (dn = wn->page; dn != NULL; dn = dn->next, i++) {
+			page[i] = *dn;
+			page[i].next = (i + 1 < num) ? &page[i + 1] : NULL;
+		}
+	}
+	
+	// List their doc_ids.
+	int *doc_ids = (int *)ArenaAlloc(&Index->arena, (num ? num : 1) * sizeof(int));
+	if (!doc_ids) {
+		return 0;
+	}
+	for (int i=0; i < num; i++) {
+		doc_ids[i] = page[i].doc_id;
+	}
+	wn->page = page;
+	wn->df = num;
+	__atomic_store_n(&wn->doc_ids, doc_ids, __ATOMIC_RELEASE);
+	return 1;
+}
+
+
+/*
+ * UnmapIndex - unmaps the segments mapped by MapIndex.
+ */
+
+static void UnmapIndex(HashTable *Index) {
+	for (int i=0; i < Index->num_segments; i++) {
+		CloseIndexFile(&Index->segments[i].file);
+		free(Index->segments[i].deleted);
+	}
+	free(Index->segments);
+	Index->segments = NULL;
+	Index->num_segments = 0;
+}
@@ -12,6 +12,9 @@
 #define HASHTABLE_H
 
 // ---------------- Prerequisites e.g., Requires "math.h"
+#include <pthread.h>                        // pthread_mutex_t
+#include "arena.h"                          // arena functionality
+#include "indexfile.h"                      // IndexFile
 
 // ---------------- Constants
 #define MAX_HASH_SLOT 10000                 // number of "buckets"
@@ -22,20 +25,41 @@ typedef struct DocumentNode {
   struct DocumentNode *next;                // pointer to the next member of the list.
   int doc_id;                               // document identifier
   int freq;                                 // number of occurrences of the word
+  float score;                              // BM25 score of a query result
+  int *positions;                           // freq positions of the word, NULL until LoadPositions
 } DocumentNode;
 
+typedef struct BlockMax {
+  int last_doc_id;                          // doc_id of the last DocumentNode of the block
+  int max_freq;                             // largest freq of the block
+  int min_length;                           // words in the shortest document of the block, 0 if unknown
+} BlockMax;
+
 typedef struct WordNode {
   struct WordNode *next;            	    // pointer to the next word (for collisions)
   char *word;                       	    // the word
   DocumentNode *page;               	    // pointer to the first element of the page list.
+  int df;                                   // number of DocumentNodes, set by FindWord
+  int *doc_ids;                             // doc_id of each DocumentNode, set by FindWord
+  BlockMax *blocks;                         // bounds of each POSTING_BLOCK DocumentNodes, NULL until LoadBlockMax
 } WordNode;
 
 typedef struct HashTableNode {
     void *data;                             // generic pointer for any type of node
 } HashTableNode;
 
+typedef struct MappedSegment {
+    IndexFile file;                         // segment, mapped read-only
+    unsigned char *deleted;                 // deletion bitmap, NULL if none
+    size_t deleted_size;                    // bytes of the deletion bitmap
+} MappedSegment;
+
 typedef struct HashTable {
     HashTableNode *table[MAX_HASH_SLOT];    // actual index
+    Arena arena;                            // owns every WordNode, word and DocumentNode
+    MappedSegment *segments;                // segments mapped by MapIndex, NULL if none
+    int num_segments;                       // number of mapped segments
+    pthread_mutex_t lock;                   // held while a word is decoded, so threads can share the index
 } HashTable;
 
 // ---------------- Public Variables
@@ -49,6 +73,99 @@ int FreeHashTable(HashTable *);
 void NormalizeWord(char *);
 HashTable *ReadFile(char *, HashTable *);
 
+/*
+ * ReadIndex - load an index, along with the segments added by "indexer -u"
+ * @file_name: index file, ie index.dat
+ * @New_Index: initialized InvertedIndex to fill in
+ *
+ * Returns New_Index, or NULL if a segment is not a valid index. Without a
+ * manifest (see segments.h) this is ReadFile.
+ *
+ * Usage example:
+ * HashTable Index;
+ * InitializeHashTable(&Index);
+ * if (ReadIndex("index.dat", &Index)) {
+ *     ...
+ * }
+ */
+HashTable *ReadIndex(char *, HashTable *);
+
+/*
+ * MapIndex - map an index and its segments read-only, without decoding them
+ * @file_name: index file, ie index.dat
+ * @Index: initialized, empty InvertedIndex
+ *
+ * Returns Index, or NULL if a segment is not a valid index. The index files
+ * are shared with every other process that maps them; FindWord decodes the
+ * posting list of a word the first time it is looked up. CleanHashTable
+ * unmaps the segments.
+ *
+ * Usage example:
+ * HashTable Index;
+ * InitializeHashTable(&Index);
+ * if (MapIndex("index.dat", &Index)) {
+ *     WordNode *wn = FindWord("dog", &Index);
+ *     ...
+ * }
+ */
+HashTable *MapIndex(char *, HashTable *);
+
+/*
+ * FindWord - look up a word of an InvertedIndex
+ * @word: normalized word
+ * @Index: InvertedIndex filled in by ReadFile, ReadIndex or MapIndex
+ *
+ * Returns the WordNode of the word, or NULL if the index does not have it.
+ * With MapIndex, the WordNode is decoded from the mapped segments on the
+ * first lookup and kept in Index until CleanHashTable. Threads can share Index:
+ * a word already decoded is found without a lock, and they take turns decoding
+ * the others. Nothing decoded is changed again. The DocumentNodes of the
+ * WordNode are one array in doc_id order, page[0] to page[df - 1], and doc_ids
+ * has their doc_ids, for IntersectDocIds.
+ */
+WordNode *FindWord(char *, HashTable *);
+
+/*
+ * LoadPositions - give every DocumentNode of a word its positions
+ * @wn: WordNode returned by FindWord
+ * @Index: InvertedIndex filled in by MapIndex
+ *
+ * Returns 1 if successful; 0 if the index was not mapped, was built without
+ * "indexer -p" or memory cannot be allocated, and then no DocumentNode of the
+ * word has positions. The positions are kept for the next lookup. Like
+ * FindWord, it can be called by threads sharing Index.
+ *
+ * Usage example:
+ * WordNode *wn = FindWord("dog", &Index);
+ * if (wn && LoadPositions(wn, &Index)) {
+ *     for (int i = 0; i < wn->page->freq; i++) {
+ *         printf("%d ", wn->page->positions[i]);
+ *     }
+ * }
+ */
+int LoadPositions(WordNode *, HashTable *);
+
+/*
+ * LoadBlockMax - work out the bounds of each block of DocumentNodes of a word
+ * @wn: WordNode returned by FindWord
+ * @Index: InvertedIndex filled in by ReadFile, ReadIndex or MapIndex
+ *
+ * Returns 1 if successful; 0 if memory cannot be allocated. Block b of wn->blocks
+ * covers page[b * POSTING_BLOCK] up to POSTING_BLOCK DocumentNodes on. With
+ * MapIndex, min_length comes from the headers the indexer wrote for the postings
+ * (see postings.h); otherwise it is 0. The bounds are kept for the next lookup.
+ * Like FindWord, it can be called by threads sharing Index.
+ *
+ * Usage example:
+ * WordNode *wn = FindWord("dog", &Index);
+ * if (wn && LoadBlockMax(wn, &Index)) {
+ *     for (int b = 0; b < NumBlocks(wn->df); b++) {
+ *         printf("%d ", wn->blocks[b].max_freq);
+ *     }
+ * }
+ */
+int LoadBlockMax(WordNode *, HashTable *);
+
 
 /*
  * jenkins_hash - Bob Jenkins' one_at_a_time hash function
@@ -5,10 +5,16 @@
  * Date: August 12, 2015
  *
  * Input: An INDEX_FILE containing the InvertedIndex, and an HTML_DIRECTORY of crawled webpages.
- * 		     The program also asks for user input from stdin to perform a query search.
+ * 		     The program also asks for user input from stdin to perform a query search,
+ * 		     or with --batch, reads every query line of a file, or with --serve,
+ * 		     reads query lines sent over a local TCP port or Unix socket.
+ * 		     With --shards, there is no INDEX_FILE: each query line is sent to the
+ * 		     --serve of every shard of a sharded index ("indexer -s"), and their results merged.
  *
  * Output: Outputs error messages if boundary cases are reached. Otherwise, a list of 
- * 	             URLs containing the user input will be printed.
+ * 	             URLs containing the user input will be printed; with --batch, one
+ * 	             line per result, QUERY_NUMBER<TAB>DOC_ID<TAB>RANK; with --serve, DOC_ID<TAB>RANK
+ * 	             lines, then an empty line, sent back for each query line.
  *
  * Error Conditions: 1) Command line arguments are invalid.
  * 		     2) Memory cannot be allocated sufficiently.
@@ -18,6 +24,7 @@
  */
 /* ========================================================================== */
 // ---------------- Open Issues
+#define _POSIX_C_SOURCE 200809L              // st_mtim, getline, open_memstream, sockets
 
 // ---------------- System includes e.g., <stdio.h>
 #include <stdio.h>                           // printf
@@ -27,36 +34,178 @@
 #include <unistd.h>			     // sleep functionality
 #include <stdlib.h> 			     // memory functionality
 #include <math.h> 			     // math functionality
+#include <limits.h> 			     // INT_MAX
+#include <pthread.h> 			     // threads of --batch and --serve
+#include <errno.h> 			     // errno
+#include <signal.h> 			     // sigaction
+#include <time.h> 			     // time
+#include <sys/socket.h> 		     // socket functionality
+#include <sys/un.h> 			     // Unix sockets
+#include <netinet/in.h> 		     // TCP sockets
+#include <arpa/inet.h> 			     // htons, htonl
+#include <sys/epoll.h> 			     // epoll functionality
+#include <sys/uio.h> 			     // writev
+#include <fcntl.h> 			     // O_NONBLOCK
 
 // ---------------- Local includes  e.g., "file.h"
 #include "qhashtable.h" 		     // hashtable functionality
 #include "file.h" 			     // file functionality
 #include "qweb.h" 			     // web/html functionality
+#include "docfile.h" 			     // document table functionality
+#include "rank.h" 			     // BM25 ranking
+#include "phrase.h" 			     // phrase and proximity matching
+#include "parse.h" 			     // query parser
+#include "plan.h" 			     // query planning and list kernels
+#include "cache.h" 			     // query result cache
+#include "segments.h" 			     // DocsName, ManifestName
+#include "shards.h" 			     // scatter-gather over shards
 
 // ---------------- Constant definitions
-char *operator1 = "AND";
-char *operator2 = "OR";
 
 // ---------------- Macro definitions
 #define MAX 1000 // Max number of characters for a single query search.
-#define MATH_MAX(X, Y) (((X) > (Y)) ? (X) : (Y)) // Returns max of the two numbers passed.
+#define MAX_THREADS 64 // Max number of threads of --batch or --serve.
+#define BATCH_LINES 1024 // Number of query lines answered by --batch between two writes.
+#define BATCH_BUFFER (1 << 20) // Size of the stdout buffer of --batch, in bytes.
+#define SERVER_THREADS 4 // Default number of threads of --serve.
+#define CLIENT_BUFFER 4096 // Size of the buffer of the query lines read from a client of --serve, over SHARD_LINE.
+#define MAX_PIPELINE 64 // Max number of query lines of a client of --serve waiting for their replies.
+#define MAX_EVENTS 256 // Max number of events taken by one epoll_wait.
+#define WRITEV_MAX 64 // Max number of replies sent by one writev.
 
 // ---------------- Structures/Types
+typedef struct IndexStamp {
+	long long mtime[3]; // last change of the index file, its manifest and its document table, in ns.
+	long long size[3]; // their sizes.
+	unsigned long long inode[3]; // their inodes; the manifest is replaced with rename().
+} IndexStamp;
+
+typedef struct Batch {
+	char *lines[BATCH_LINES]; // query lines read, reused from one chunk of lines to the next.
+	size_t line_sizes[BATCH_LINES]; // sizes of their buffers, for getline.
+	char *results[BATCH_LINES]; // results written for each line.
+	size_t result_sizes[BATCH_LINES]; // their lengths.
+	int num_lines; // lines of the chunk.
+	int first; // number of its first line in the file, from 1.
+	int next; // next line to answer.
+	pthread_mutex_t lock; // lock of next.
+	int offset; // --offset.
+	int limit; // --top, 0 for every result.
+	int lost; // 1 once a shard of --shards cannot be reached.
+	ResultCache cache; // result cache shared by every thread.
+} Batch;
+
+typedef struct BatchWorker {
+	HashTable *Index; // index shared by every thread, NULL with --shards.
+	ShardSet *shards; // its own connections to the shards of --shards, NULL for none.
+	PairCache pair_cache; // its share of the pair cache.
+	Batch *batch; // lines to answer.
+} BatchWorker;
+
+typedef struct Request {
+	struct Request *next; // next query line of the same client, in line order.
+	struct Request *next_job; // next Request of the queue of the workers, or of the replies.
+	struct Client *client; // client that sent it, only touched by main.
+	char *line; // query line, kept right after the Request.
+	char *reply; // reply written by a worker, NULL if memory ran out.
+	size_t reply_size; // its length.
+	int done; // 1 once main collected the reply.
+} Request;
+
+typedef struct Client {
+	int fd; // connection, -1 once closed.
+	char buffer[CLIENT_BUFFER]; // bytes read and not made into Requests yet.
+	size_t used; // bytes of the buffer.
+	int skipping; // 1 while the rest of a line too long is thrown away.
+	int eof; // 1 once the client closed its side.
+	int blocked; // 1 while the socket cannot take more of the replies.
+	unsigned int events; // events epoll watches the socket for.
+	Request *first; // first query line waiting for its reply, or to be sent it.
+	Request *last; // last one.
+	int num_requests; // query lines waiting.
+	size_t sent; // bytes of the reply of first already sent.
+	int noted; // 1 while on the list of clients of CollectReplies.
+	struct Client *next_noted; // next client of that list.
+	int freed; // 1 once on the list of clients to free.
+	struct Client *prev; // previous client of the list of clients.
+	struct Client *next; // next client of the list of clients, or of the clients to free.
+} Client;
+
+typedef struct Server {
+	HashTable *Index; // index shared by every worker.
+	int bm25; // 1 to rank with BM25.
+	Ranker *bm25_ranker; // ranker of OpenIndex.
+	HashTable *spare; // second InvertedIndex, empty; a new index is mapped into it before it takes the place of Index.
+	int offset; // --offset.
+	int limit; // --top, 0 for every result.
+	int listener; // listening socket.
+	int accepting; // 1 while epoll watches the listening socket.
+	int epoll; // epoll instance of main.
+	int wake[2]; // pipe written to wake main up.
+	Client *clients; // open clients, and closed ones with Requests left.
+	Client *closed; // clients to free.
+	long num_clients; // clients accepted.
+	Request *jobs; // Requests queued for the workers, in line order.
+	Request *last_job; // last one.
+	Request *replies; // Requests answered, for main to collect.
+	int stop; // 1 once the workers have to stop.
+	pthread_mutex_t lock; // lock of jobs, last_job, replies and stop.
+	pthread_cond_t ready; // signaled when Requests are queued, or the workers have to stop.
+	pthread_rwlock_t index_lock; // read while a query is answered, written while the index is mapped again.
+	pthread_mutex_t stamp_lock; // lock of stamp, checked and spare, held by the thread checking the index.
+	IndexStamp stamp; // index at the last check.
+	time_t checked; // time of the last check.
+	long generation; // times the index was mapped again.
+	ResultCache cache; // result cache shared by every worker, cleared when the index is mapped again.
+} Server;
+
+typedef struct ServerWorker {
+	Server *server; // server of the worker.
+	PairCache pair_cache; // its share of the pair cache.
+	long generation; // generation of the index its pair cache is for.
+	long queries; // query lines answered.
+	Ranker shard_ranker; // ranker with the statistics of the collection of the last #search, norms NULL if none.
+	double shard_length; // words of the collection it was made with.
+} ServerWorker;
 
 // ---------------- Private variables
 char *file; 				      // passed file path
 char *dir_path; 		              // passed directory path
-DocumentNode *temp_list;		      // temp_list
-DocumentNode *final_list;		      // final list
+DocFile doc_file; 			      // document table of the index, zeroed if there is none
+Ranker *ranker; 			      // BM25 ranker, NULL to rank by frequency
+int top_k; 				      // documents wanted by --top and --offset, 0 for all of them
+volatile sig_atomic_t stopping; 	      // 1 once --serve has to stop
+int wake_pipe = -1; 			      // write end of the wake pipe of --serve
 
 // ---------------- Private prototypes
-int GetLinks(char *, HashTable *);
-void And(char *, HashTable *);
-int Or();
-void Sort();
 int key_compare(const void *, const void *);
-int FreeList(int);
-int Display();
+int Display(const DocumentNode *);
+HashTable *OpenIndex(HashTable *, DocFile *, int, Ranker *);
+void CloseIndex(HashTable *, DocFile *, Ranker *);
+int IndexChanged(char *, IndexStamp *);
+int FindDocuments(char *, HashTable *, PairCache *, DocumentNode **);
+int RankDocuments(DocumentNode **, int, int);
+const char *CheckLine(const char *);
+int AnswerQuery(char *, HashTable *, ResultCache *, PairCache *, int, int, DocumentNode **);
+int RunBatch(char *, HashTable *, char *, int, long, int, int);
+void *AnswerLines(void *);
+void WriteResults(FILE *, int, int, const DocumentNode *);
+int OpenListener(const char *);
+int RunServer(char *, HashTable *, int, Ranker *, int, long, int, int);
+void StopServer(int);
+void AcceptClients(Server *);
+void ReadRequests(Server *, Client *);
+void QueueLines(Server *, Client *);
+void *ServeRequests(void *);
+void CollectReplies(Server *);
+void FlushClient(Server *, Client *);
+void FreeRequest(Client *);
+void UpdateClient(Server *, Client *);
+void CloseClient(Server *, Client *);
+void AnswerRequest(ServerWorker *, char *, char **, size_t *);
+int AnswerShardRequest(ServerWorker *, char *, FILE *);
+void WriteWordStats(FILE *, const QueryNode *, HashTable *);
+void ReloadIndex(Server *);
 
 /* ========================================================================== */
 
@@ -64,133 +213,266 @@ int main (int argc, char *argv[]) {
 	
 	// Check arguments
 	
-	// Check that there are two arguments passed.
-	if (argc != 3) {
-		printf("Please input exactly two arguments.\n");
-		printf("Usage: ./query [INDEX_FILE] [HTML_DIRECTORY]\n");
+	// Read in the options, then shift them out so argv[1] is the INDEX_FILE.
+	int bm25 = 0;
+	int limit = 0; // number of results shown by --top, 0 to show them all.
+	int offset = 0; // number of best results skipped by --offset.
+	long cache_size = CACHE_SIZE; // size limit of the result cache, in bytes.
+	char *batch_file = NULL; // file of query lines of --batch, "-" for stdin; NULL to ask for them.
+	char *serve_address = NULL; // port or socket path of --serve; NULL to ask for query lines.
+	int threads = 0; // number of threads of --batch or --serve, 0 for the default.
+	char *shard_addresses = NULL; // ports or socket paths of the shards of --shards; NULL to map INDEX_FILE.
+	int arg = 1;
+	while (arg < argc && argv[arg][0] == '-') {
+		char *end = NULL;
+		if (strcmp(argv[arg], "-b") == 0) {
+			bm25 = 1;
+			arg++;
+		}
+		else if (strcmp(argv[arg], "--top") == 0 && arg + 1 < argc &&
+				(limit = strtol(argv[arg + 1], &end, 10)) > 0 && *end == '\0') {
+			arg += 2;
+		}
+		else if (strcmp(argv[arg], "--offset") == 0 && arg + 1 < argc &&
+				(offset = strtol(argv[arg + 1], &end, 10)) >= 0 && *end == '\0') {
+			arg += 2;
+		}
+		else if (strcmp(argv[arg], "--cache") == 0 && arg + 1 < argc &&
+				(cache_size = strtol(argv[arg + 1], &end, 10)) >= 0 && *end == '\0') {
+			arg += 2;
+		}
+		else if (strcmp(argv[arg], "--batch") == 0 && arg + 1 < argc) {
+			batch_file = argv[arg + 1];
+			arg += 2;
+		}
+		else if (strcmp(argv[arg], "--serve") == 0 && arg + 1 < argc) {
+			serve_address = argv[arg + 1];
+			arg += 2;
+		}
+		else if (strcmp(argv[arg], "--shards") == 0 && arg + 1 < argc) {
+			shard_addresses = argv[arg + 1];
+			arg += 2;
+		}
+		else if (strcmp(argv[arg], "--threads") == 0 && arg + 1 < argc &&
+				(threads = strtol(argv[arg + 1], &end, 10)) > 0 && threads <= MAX_THREADS && *end == '\0') {
+			arg += 2;
+		}
+		else {
+			printf("Usage: ./query [-b] [--top K] [--offset N] [--cache BYTES] [--batch FILE | --serve PORT|PATH] [--threads N] [--shards PORT|PATH,...] [INDEX_FILE] [HTML_DIRECTORY]\n");
+			return 1;
+		}
+	}
+	if (batch_file && serve_address) {
+		printf("Please input only one of --batch and --serve.\n");
+		return 1;
+	}
+	if (shard_addresses && serve_address) {
+		printf("Please input only one of --shards and --serve.\n");
+		return 1;
+	}
+	if (threads == 0) {
+		threads = serve_address ? SERVER_THREADS : 1;
+	}
+	if (offset > 0 && limit == 0) { // --offset alone shows every result after the first N.
+		limit = INT_MAX - offset;
+	}
+	if (limit > 0 && limit < INT_MAX - offset) { // Only the best offset + limit documents are needed.
+		top_k = offset + limit;
+	}
+	argc -= arg - 1;
+	argv += arg - 1;
+	
+	// Check that there are two arguments passed, or only HTML_DIRECTORY with --shards.
+	if (argc != (shard_addresses ? 2 : 3)) {
+		printf(shard_addresses ? "Please input only [HTML_DIRECTORY] with --shards.\n" : "Please input exactly two arguments.\n");
+		printf("Usage: ./query [-b] [--top K] [--offset N] [--cache BYTES] [--batch FILE | --serve PORT|PATH] [--threads N] [--shards PORT|PATH,...] [INDEX_FILE] [HTML_DIRECTORY]\n");
 		return 1;
 	}
 	
 	// Check that the index file exists.
-	if (!IsFile(argv[1])) {
+	if (!shard_addresses && !IsFile(argv[1])) {
 		printf("Please input an existing [INDEX_FILE].\n");
 		return 1;
 	} 
 	
-	// Since the index file is valid, copy file name to file.
-	file = calloc(1, strlen(argv[1]) + 1);
-	strcpy(file, argv[1]);
-	
 	// Check that the html directory exists.
-	if (!IsDir(argv[2])) {
+	if (!IsDir(argv[argc - 1])) {
 		printf("Please input an existing [HTML_DIRECTORY].\n");
 		return 1;
 	}
 	
+	// Since the index file is valid, copy file name to file.
+	if (!shard_addresses) {
+		file = calloc(1, strlen(argv[1]) + 1);
+		strcpy(file, argv[1]);
+	}
+	
 	// Since the directory is valid, copy path to dir_path.
-	dir_path = calloc(1, strlen(argv[2]) + 1);
-	strcpy(dir_path, argv[2]);
+	dir_path = calloc(1, strlen(argv[argc - 1]) + 1);
+	strcpy(dir_path, argv[argc - 1]);
 
 	
 	// Declare variables.
 	HashTable Index;
-	HashTable *ptr;
+	HashTable *ptr = NULL;
 	char *query;
+	Ranker bm25_ranker;
+	IndexStamp stamp;
+	memset(&stamp, 0, sizeof(IndexStamp));
+	
+	// With --shards, the shards have the index and rank the results; ranker only tells they have scores.
+	if (shard_addresses) {
+		memset(&bm25_ranker, 0, sizeof(Ranker));
+		ranker = bm25 ? &bm25_ranker : NULL;
+		cache_size = 0;
+	}
 	
-	// Load and recreate an InvertedIndex from index file.
-	InitializeHashTable(&Index);
-	ptr = ReadFile(file, &Index);
+	// Otherwise, map the index, and note when the indexer last changed it.
+	else {
+		IndexChanged(file, &stamp);
+		InitializeHashTable(&Index);
+		if (!(ptr = OpenIndex(&Index, &doc_file, bm25, &bm25_ranker))) {
+			printf("[INDEX_FILE] is not a valid index. Please rebuild it with the indexer.\n");
+			FreeHashTable(&Index);
+			return 1;
+		}
+		ranker = bm25_ranker.norms ? &bm25_ranker : NULL;
+	}
+	
+	// With --batch, answer every line of the file, and exit.
+	if (batch_file) {
+		int ok = RunBatch(batch_file, ptr, shard_addresses, threads, cache_size, offset, limit);
+		if (ok == 0) {
+			fprintf(stderr, "Please input a readable --batch FILE.\n");
+		}
+		else if (ok < 0) {
+			fprintf(stderr, "Please input the --shards of running \"query --serve\", started with the same -b.\n");
+		}
+		if (ptr) {
+			CloseIndex(ptr, &doc_file, &bm25_ranker);
+			FreeHashTable(ptr);
+		}
+		free(file);
+		free(dir_path);
+		return (ok == 1) ? 0 : 1;
+	}
+	
+	// With --shards, connect to every shard.
+	ShardSet shards;
+	if (shard_addresses && !ConnectShards(&shards, shard_addresses, bm25)) {
+		printf("Please input the --shards of running \"query --serve\", started with the same -b.\n");
+		CloseShards(&shards);
+		free(dir_path);
+		return 1;
+	}
+	
+	// With --serve, answer query lines sent over a socket, until SIGINT or SIGTERM.
+	if (serve_address) {
+		int ok = RunServer(serve_address, ptr, bm25, &bm25_ranker, threads, cache_size, offset, limit);
+		if (!ok) {
+			fprintf(stderr, "Please input a free --serve PORT or PATH.\n");
+		}
+		CloseIndex(ptr, &doc_file, &bm25_ranker);
+		FreeHashTable(ptr);
+		free(file);
+		free(dir_path);
+		return ok ? 0 : 1;
+	}
+	
+	// Keep the results of the queries, to show them again when they are asked again.
+	ResultCache cache;
+	InitializeCache(&cache, cache_size);
+	
+	// Keep the documents shared by the pairs of words most ANDed together.
+	PairCache pair_cache;
+	InitializePairCache(&pair_cache, cache_size ? PAIR_CACHE_SIZE : 0);
+	PairCache *pairs = cache_size ? &pair_cache : NULL;
 	
 	printf("Query:> ");
 	
 	// Receive user queries from input.
 	while ((query = (char *)calloc(1, MAX)) && fgets(query, MAX, stdin)) {
 		
-		// Check query line.
-		
-		// If the query line is empty, ask for input again.
-		if (strcmp(query, "\n") == 0) {
-			printf("Please input words.\n\n");
-			printf("Query:> ");
-			free(query);
-			continue;
-		}
-		
-		// Check that only ASCII characters, or whitespace in between is passed.
-		int i;
-		for (i=0; i<strlen(query); i++) {
-			if (!isalpha(query[i]) && !isspace(query[i])) {
-				break;				
-			}
-		}
-		if (i != strlen(query)) {
-			printf("Please input only ASCII characters, whitespace, or logical operators.\n\n");
+		// Check query line: only ASCII characters, or whitespace in between, and at least one word.
+		const char *message = CheckLine(query);
+		if (message) {
+			printf("%s\n\n", message);
 			printf("Query:> ");
 			free(query);
 			continue;
 		}
 		
-		// Check that at least one word is passed, ie the query is not just whitespace.
-		for (i=0; i<strlen(query); i++) {
-			if (!isspace(query[i])) {
-				break;
+		// If the indexer changed the index, map it again, and forget the results kept.
+		if (ptr && IndexChanged(file, &stamp)) {
+			CloseIndex(ptr, &doc_file, &bm25_ranker);
+			ClearCache(&cache);
+			ClearPairCache(&pair_cache);
+			if (!OpenIndex(ptr, &doc_file, bm25, &bm25_ranker)) {
+				printf("[INDEX_FILE] is not a valid index. Please rebuild it with the indexer.\n");
+				memset(&stamp, 0, sizeof(IndexStamp)); // Try again at the next query.
 			}
-		}
-		if (i == strlen(query)) {
-			printf("Please input only ASCII characters, whitespace, or logical operators.\n\n");
-			printf("Query:> ");
-			free(query);
-			continue;
+			ranker = bm25_ranker.norms ? &bm25_ranker : NULL;
 		}
 		
-		// Check that no two successive logical operators are passed.
-		if (strstr(query, "AND OR") || strstr(query, "AND AND") || strstr(query, "OR AND") || strstr(query, "OR OR")) {
-			printf("Please input a valid query line.\n\n");
-			printf("Query:> ");
+		// Get the list of DocumentNodes containing the query, ranked, from the index or from the shards.
+		DocumentNode *list;
+		int valid = ptr ? AnswerQuery(query, ptr, &cache, pairs, offset, limit, &list) :
+				SearchShards(&shards, query, offset, limit, &list);
+		if (valid < 0) {
+			printf("Error reaching the --shards.\n");
 			free(query);
-			continue;
+			query = NULL;
+			break;
 		}
-		
-		
-		// Get the list of DocumentNodes containing the query.
-		if (!GetLinks(query, ptr)) {
+		if (!valid) {
 			printf("Please input a valid query line.\n\n");
 			printf("Query:> ");
 			
 			// Cleanup.
 			free(query);
-			FreeList(0);
-			FreeList(1);
+			FreeDocuments(list);
 			
 			continue;
 		}
 		
-		// Sort only if there are two are more documents in the list.
-		if (final_list != NULL && final_list->next != NULL) {
-			Sort(); // Sort by rank.
-		}
-		
-		
 		// Display results to stdout.
-		if (!Display()) {
+		if (!Display(list)) {
 			printf("Error retrieving url from directory. Please check HTML_DIRECTORY.\n\n");
 			// Cleanup.
-			FreeList(0);
-			FreeList(1);
+			FreeDocuments(list);
 			break;
 		}
+		if (limit > 0 && list != NULL) {
+			int shown = 0;
+			for (DocumentNode *dn = list; dn != NULL; dn = dn->next) {
+				shown++;
+			}
+			printf("Results %d to %d.\n", offset + 1, offset + shown);
+		}
 		printf("\n\n");
 		printf("Query:> ");
 		
 		// Cleanup.
-		FreeList(1);
+		FreeDocuments(list);
 		free(query);
 	}
 	
 	// Cleanup.
 	free(query);
-	CleanHashTable(ptr);
-	FreeHashTable(ptr);
+	if (cache.max_size > 0) {
+		fprintf(stderr, "Result cache: %ld hits, %ld misses, %ld evictions.\n", cache.hits, cache.misses, cache.evictions);
+		fprintf(stderr, "Pair cache: %ld hits, %ld misses, %ld evictions.\n", pair_cache.pairs.hits,
+				pair_cache.pairs.misses, pair_cache.pairs.evictions);
+	}
+	ClearCache(&cache);
+	ClearPairCache(&pair_cache);
+	if (ptr) {
+		CloseIndex(ptr, &doc_file, &bm25_ranker);
+		FreeHashTable(ptr);
+	}
+	else {
+		CloseShards(&shards);
+	}
 	free(file);
 	free(dir_path);
 	
@@ -203,434 +485,1575 @@ int main (int argc, char *argv[]) {
 
 
 /*
- * GetLinks - get all matched DocumentNodes for a given query.
- * @line: query line to be searched for.
- * @Index: InvertedIndex containing all word-document pairs.
- * 
- * Returns 1 if successful.
- * Returns 0 if not successful.
+ * OpenIndex - map the index, its document table and its BM25 ranker.
+ * @Index: InvertedIndex to map the index into, empty.
+ * @docs: document table to fill in, zeroed if the indexer wrote none.
+ * @bm25: 1 to rank with BM25.
+ * @bm25_ranker: ranker to fill in, its norms NULL unless ranking with BM25.
+ *
+ * Returns Index if successful.
+ * Returns NULL if the index is not valid, and then nothing is left mapped.
+ *
+ * Only what is passed is changed, so --serve can map a new index while its workers answer
+ * queries with the one that ranker and doc_file are for (see ReloadIndex).
  *
  * Pseudocode:
- *     1. Read in each word of the query.
- *     2. Save all matched DocumentNodes in temp_list.
- *     2. If an AND is passed, or there is no logical operator between two words, intersection operation is done on temp_list.
- *     3. If an OR is passed, data in temp_list is flushed out to final_list using the union operation.
- *     4. Continue until end of line. 
+ *     1. Map the index file; posting lists are decoded as words are looked up.
+ *     2. Map the document table, if the indexer wrote one, for the URLs of the results.
+ *     3. Rank with BM25 if asked to. The document lengths come from the document table.
  */
 
-int GetLinks(char *line, HashTable *Index) {
-	
-	// Declare variables.
-	char *buf;
-	char word[MAX];
-	int flag; // flag to do union or intersection operations.
-	int count; // variable to count the position of a word in the line.
-	
-	// Initialize variables.
-	buf = line;
-	flag = 1;
-	count = 0;
-	temp_list = NULL;
-	final_list = NULL;
-	
-	// Loop through the line and do the appropriate operations.
-	while (sscanf(buf, "%s", word) == 1) {
-		
-		count++;
-		
-		// If word is AND, then ignore and read in new word.
-		if (strcmp(word, operator1) == 0) {
-			if (count == 1) { // If there is no previous word, then throw an error.
-				return 0;
-			}
-			
-			// Increment position in line.
-			buf = strstr(buf, word) + strlen(word);
-			continue;
-		}
-		
-		// If word is OR, then tell the program to do OR operation.
-		if (strcmp(word, operator2) == 0) {
-			flag = 2; // Set flag to union operation.
-			if (count == 1) { // If there is no previous word, then throw an error.
-				return 0;
-			}
-		}
-		
-		// Hold onto original copy of word in case NormalizeWord() changes its content.
-		char *word_old = (char *)calloc(1, strlen(word) + 1);
-		strcpy(word_old, word);
-		
-		// Change word to lowercase.
-		if (strcmp(word, operator1) != 0 && strcmp(word, operator2) != 0) {
-			NormalizeWord(word); // Normalize if word is not an operator.
-		}
-		
-		// Add list of docs to temp_list.
-		// Case when it is the first word of the block.
-		if (count == 1) {
-			
-			// Declare variables.
-			WordNode *current; // variable for traversal.
-			DocumentNode *ptr, *ptr2; // variables for traversal.
-			int num;
-			
-			// Case when the word is in the InvertedIndex.
-			if ((num = InHashTable(word, Index))) {
-				unsigned long index = JenkinsHash(word, MAX_HASH_SLOT); // Get the hash code.
-				current = Index->table[index]->data;
-				
-				// Loop until we get the matching WordNode.
-				for (int i=1; i < num; i++) {
-					current = current->next;
-				}
-				
-				// Loop through each DocumentNode and add to temp_list.
-				for (ptr = current->page; ptr != NULL; ptr = ptr->next) {
-					
-					// Declare and initialize a DocumentNode with the same values as ptr.
-					DocumentNode *dn;
-					dn = (DocumentNode *)calloc(1, sizeof(DocumentNode));
-					dn->doc_id = ptr->doc_id;
-					dn->freq = ptr->freq;
-					
-					// Add the new DocumentNode to temp_list.
-					if (temp_list == NULL) { // Case when temp_list is empty.
-						temp_list = dn;
-						ptr2 = temp_list;
-					}
-					else { // Case when temp_list is nonempty.
-						ptr2->next = dn;
-						ptr2 = ptr2->next;
-					}
-				}
-			}
-		}
-		else { // If not first word of the block, then do the operation.
-		
-			// Check if the current operation is "AND".
-			if (flag == 1) {
-				And(word, Index);
-			}
-			
-			// Check if the current operation is "OR".
-			if (flag == 2) {
-				if (temp_list != NULL) {
-					Or();
-				}
-				flag = 1; // Set flag back to "AND" operation.
-				count = 0; // Set word count to 0 to signal the start of a new block of words.
-			}
-		}
-		
-		// Increment position in the query line to read in next word.
-		buf = strstr(buf, word_old) + strlen(word_old);
-		
-		free(word_old); // Cleanup.
-	}
+HashTable *OpenIndex(HashTable *Index, DocFile *docs, int bm25, Ranker *bm25_ranker) {
 	
-	// If the last word of the query line is an operator, throw an error.
-	if (strcmp(word, operator1) == 0 || strcmp(word, operator2) == 0) {
-		return 0;
+	memset(docs, 0, sizeof(DocFile));
+	memset(bm25_ranker, 0, sizeof(Ranker));
 	
+	// Map the index file.
+	if (!MapIndex(file, Index)) {
+		return NULL;
 	}
 	
-	// If nonempty, flush out temp_list to final_list.
-	if (temp_list != NULL) { 
-		Or();
+	// Map the document table.
+	char *docs_name = DocsName(file);
+	if (docs_name) {
+		OpenDocFile(docs, docs_name);
 	}
+	free(docs_name);
 	
-	return 1; // Return 1 if successful.
-}	
+	// Make the ranker.
+	if (bm25 && !InitializeRanker(bm25_ranker, docs)) {
+		printf("[INDEX_FILE] has no document table. Ranking by frequency instead.\n");
+	}
+	return Index;
+}
 
 
 /*
- * And - Perform intersection operation.
- * @word: word to get new list of matching DocumentNodes from.
- * @Index: InvertedIndex containing all word-document pairs.
- * 
- * Pseudocode:
- *     1. Find the start of the list of matching DocumentNodes for the word.
- *     2. For each DocumentNode in temp_list, go through the new list looking for doc_id matches.
- *     2. If there is a match, keep that DocumentNode in temp_list and increment frequency.
- *     3. If there is no match, delete that DocumentNode from temp_list.
- *     4. Continue until end of temp_list.
+ * CloseIndex - unmap what OpenIndex mapped, leaving Index empty.
+ * @Index: InvertedIndex mapped by OpenIndex.
+ * @docs: its document table.
+ * @bm25_ranker: its ranker.
  */
 
-void And(char *word, HashTable *Index) {
+void CloseIndex(HashTable *Index, DocFile *docs, Ranker *bm25_ranker) {
+	FreeRanker(bm25_ranker);
+	CloseDocFile(docs);
+	CleanHashTable(Index);
+}
+
+
+/*
+ * IndexChanged - check if the indexer changed the index since the last check.
+ * @file_name: path of the index file.
+ * @stamp: mtime, size and inode of the index file, its manifest and its document table
+ *         at the last check; updated.
+ *
+ * Returns 1 if one of them changed, appeared or went away.
+ * Returns 0 if not.
+ *
+ * Pseudocode:
+ *     1. stat the index file, its manifest and its document table. A full build rewrites the
+ *        index file, and "indexer -u" replaces the manifest with rename(), so its inode changes.
+ *     2. Compare with the stamp, and keep the new one.
+ */
 
-	unsigned long index = JenkinsHash(word, MAX_HASH_SLOT); // Get the hash code.
+int IndexChanged(char *file_name, IndexStamp *stamp) {
 	
-	// Declare variables for traversal.
-	WordNode *current;
-	DocumentNode *ptr, *ptr2, *runner, *no_need;
-	int num;
+	char *names[3] = {file_name, ManifestName(file_name), DocsName(file_name)};
+	IndexStamp now;
+	memset(&now, 0, sizeof(IndexStamp));
 	
-	// Get matching WordNode of word if it is in the InvertedIndex.
-	if ((num = InHashTable(word, Index))) {
-		current = Index->table[index]->data;
-		// Loop until we get the matching WordNode.
-		for (int i=1; i < num; i++) {
-			current = current->next;
+	for (int i=0; i < 3; i++) {
+		struct stat statbuf;
+		if (names[i] && stat(names[i], &statbuf) == 0) {
+			now.mtime[i] = (long long)statbuf.st_mtim.tv_sec * 1000000000 + statbuf.st_mtim.tv_nsec;
+			now.size[i] = statbuf.st_size;
+			now.inode[i] = statbuf.st_ino;
 		}
-		ptr2 = current->page; // Set to start of the list of document nodes for the current word.
-	}
-	else {
-		ptr2 = NULL;
 	}
+	free(names[1]);
+	free(names[2]);
 	
-	// Initialize variables. 
-	ptr = temp_list;
+	int changed = (memcmp(&now, stamp, sizeof(IndexStamp)) != 0);
+	memcpy(stamp, &now, sizeof(IndexStamp));
+	return changed;
+}
+
+
+/*
+ * CheckLine - check that a query line can be searched for.
+ * @line: query line read.
+ *
+ * Returns NULL if it can.
+ * Returns the message to show if not.
+ *
+ * Pseudocode:
+ *     1. An empty line asks for words.
+ *     2. Walk the line once: only letters, digits, whitespace, quotes, ~, parentheses and -
+ *        are taken, as quotes, ~ and digits are for phrases, parentheses for groups, and
+ *        - for NOT; ParseQuery checks where they are. At least one of them is not whitespace.
+ */
+
+const char *CheckLine(const char *line) {
 	
-	while (ptr != NULL) {
+	if (strcmp(line, "\n") == 0) {
+		return "Please input words.";
+	}
 	
-		// Check that the word is in the InvertedIndex.
-		if (num) {
-			ptr2 = current->page; // Set to start of the list of document nodes for the current word.
-			
-			// Loop until the end of the new list of matching DocumentNodes.
-			while (ptr2 != NULL) {
-				// Check for a match in doc_id.
-				if (ptr->doc_id == ptr2->doc_id) {
-					ptr->freq += ptr2->freq; // Add the frequencies.
-					break;
-				}
-				ptr2 = ptr2->next;
-			}
-			
-			// Case of no match.
-			if (ptr2 == NULL) {
-			
-				// Check if we need to delete the first node of temp_list.
-				if (ptr == temp_list) { 
-					temp_list = temp_list->next;
-				}
-				else { // All other cases.
-					runner->next = runner->next->next;
-				}
-				no_need = ptr;
-				ptr = ptr->next;
-				
-				// Free the node to be deleted.
-				no_need->next = NULL;
-				free(no_need);
-				no_need = NULL;
-				
-			}
-			else { // Case of match.
-				runner = ptr;
-				ptr = ptr->next;
-			}
-		}
-		else { // Word is not in the InvertedIndex.
-			ptr = NULL;
-			FreeList(0);
+	int word = 0; // 1 once a character that is not whitespace is found.
+	for (const unsigned char *c = (const unsigned char *)line; *c != '\0'; c++) {
+		if (!isalpha(*c) && !isspace(*c) && *c != '"' && *c != '~' && !isdigit(*c) &&
+				*c != '(' && *c != ')' && *c != '-') {
+			return "Please input only ASCII characters, whitespace, or logical operators.";
 		}
+		word |= !isspace(*c);
 	}
+	return word ? NULL : "Please input only ASCII characters, whitespace, or logical operators.";
 }
 
 
 /*
- * Or - Perform union operation.
- * 
- * Returns 0 and terminates.
- * 
+ * AnswerQuery - get the ranked results of a query line.
+ * @line: query line, checked with CheckLine.
+ * @Index: InvertedIndex containing all word-document pairs.
+ * @cache: ranked results of the queries answered before.
+ * @pair_cache: documents shared by pairs of words, NULL for none.
+ * @offset: number of best results to skip (--offset).
+ * @limit: number of results to keep after those (--top), 0 for all of them.
+ * @list: set to the results, best first, NULL if none.
+ *
+ * Returns 1 if successful.
+ * Returns 0 if the line is not a valid query.
+ *
  * Pseudocode:
- *     1. If final_list is NULL, set final_list to temp_list, temp_list to NULL, and return.
- *     2. For each DocumentNode in temp_list, go through final_list looking for doc_id matches.
- *     2. If there is a match, keep that DocumentNode in final_list and increment frequency.
- *     3. If there is no match, create a copy DocumentNode and add to end of final_list.
- *     4. Continue until end of temp_list.
+ *     1. Look the query up in the cache, by its canonical form (see CanonicalQuery).
+ *     2. If it is not there, find its documents (see FindDocuments), rank them (see
+ *        RankDocuments), and keep the results in the cache.
  */
 
-int Or() {
-
-	// Case of empty final_list, set final_list to temp_list.
-	if (final_list == NULL) {
-		final_list = temp_list;
-		temp_list = NULL;
-
-		return 0;
+int AnswerQuery(char *line, HashTable *Index, ResultCache *cache, PairCache *pair_cache, int offset, int limit,
+		DocumentNode **list) {
+	
+	Arena arena; // QueryNodes and the canonical form.
+	InitializeArena(&arena);
+	QueryNode *parsed = (cache->max_size > 0) ? ParseQuery(line, &arena) : NULL;
+	char *key = parsed ? CanonicalQuery(parsed, &arena) : NULL;
+	int cached = 0;
+	int valid = 1;
+	*list = NULL;
+	
+	// Look the query up in the cache.
+	if (key) {
+		*list = LookupCache(cache, key, &cached);
 	}
-
-	// Declare variables.
-	DocumentNode *ptr, *ptr2, *runner; // variables for traversal.
 	
-	// For each DocumentNode of temp_list, loop through all DocumentNodes of final_list.
-	for (ptr = temp_list; ptr != NULL; ptr = ptr->next) {
-		for (ptr2 = final_list; ptr2 != NULL; ptr2 = ptr2->next) {
-			
-			// Check for a match in doc_id.
-			if (ptr->doc_id == ptr2->doc_id) {
-				ptr2->freq = MATH_MAX(ptr->freq, ptr2->freq); // Set freq as the maximum of the two.
-				break;
-			}
-			if (ptr2->next == NULL) {
-				runner = ptr2; // variable for appending DocumentNode to final_list.
-			}
+	if (!cached && (valid = FindDocuments(line, Index, pair_cache, list))) {
+		// With --top or --offset, keep only the page of results asked for, ranked.
+		if (limit > 0) {
+			RankDocuments(list, offset, limit);
 		}
 		
-		// If there is no match in doc_id, then append a DocumentNode to final_list.
-		if (ptr2 == NULL) {
-			DocumentNode *dn = (DocumentNode *)calloc(1, sizeof(DocumentNode));
-			dn->doc_id = ptr->doc_id;
-			dn->freq = ptr->freq;
-			
-			runner->next = dn;
+		// Sort only if there are two are more documents in the list.
+		else if (*list != NULL && (*list)->next != NULL) {
+			RankDocuments(list, 0, INT_MAX); // Sort by rank.
+		}
+		
+		// Keep the ranked results.
+		if (key) {
+			InsertCache(cache, key, *list);
 		}
 	}
 	
-	// Cleanup.
-	FreeList(0);
-
-	return 0;
-
+	FreeArena(&arena); // Cleanup.
+	return valid;
 }
 
 
 /*
- * Sort - Sort the list of DocumentNodes by rank, from highest to lowest.
- * 
+ * RunBatch - answer every query line of a file, and write the results to stdout.
+ * @batch_file: file of query lines, "-" for stdin.
+ * @Index: InvertedIndex mapped by OpenIndex, NULL with --shards.
+ * @shard_addresses: addresses of the shards of --shards, NULL for none.
+ * @threads: number of threads answering lines.
+ * @cache_size: size limit of the result cache, which every thread shares.
+ * @offset: number of best results to skip (--offset).
+ * @limit: number of results to keep after those (--top), 0 for all of them.
+ *
+ * Returns 1 if successful.
+ * Returns 0 if the file cannot be read.
+ * Returns -1 if a shard of --shards cannot be reached.
+ *
+ * For each result, a line QUERY_NUMBER<TAB>DOC_ID<TAB>RANK is written, best first; the
+ * query lines are numbered from 1. A line that is not a valid query gets
+ * QUERY_NUMBER<TAB>invalid, and one without results no line.
+ *
  * Pseudocode:
- *     1. Put DocumentNodes into an array.
- *     2. Sort the array by rank.
- *     2. Refactor sorted array into list of DocumentNodes.
+ *     1. Give each thread its own share of the pair cache; the threads share Index, the
+ *        lines and the result cache (see LookupCache), so a query asked again is found
+ *        whichever thread answered it first. The first thread is main. With --shards,
+ *        give each thread its own connections to the shards instead.
+ *     2. Read BATCH_LINES lines at a time. Each thread takes the next line not answered
+ *        yet (see AnswerLines), and writes its results into memory.
+ *     3. Once every line is answered, write their results in line order, through a
+ *        BATCH_BUFFER buffer.
  */
 
-void Sort() {
-
-	DocumentNode *ptr; // variable for traversal.
-	int i=0;
+int RunBatch(char *batch_file, HashTable *Index, char *shard_addresses, int threads, long cache_size, int offset,
+		int limit) {
 	
-	// Loop through the list to get its size.
-	for (ptr = final_list; ptr != NULL; ptr = ptr->next) {
-		i++;
+	FILE *in = (strcmp(batch_file, "-") == 0) ? stdin : fopen(batch_file, "r");
+	Batch *batch = (Batch *)calloc(1, sizeof(Batch));
+	BatchWorker *workers = (BatchWorker *)calloc(threads, sizeof(BatchWorker));
+	ShardSet *shards = shard_addresses ? (ShardSet *)calloc(threads, sizeof(ShardSet)) : NULL;
+	pthread_t ids[MAX_THREADS];
+	if (!in || !batch || !workers || (shard_addresses && !shards)) {
+		if (in && in != stdin) {
+			fclose(in);
+		}
+		free(batch);
+		free(workers);
+		free(shards);
+		return 0;
 	}
+	pthread_mutex_init(&batch->lock, NULL);
+	batch->offset = offset;
+	batch->limit = limit;
+	batch->first = 1;
+	InitializeCache(&batch->cache, cache_size);
 	
-	// Declare and initialize an array of DocumentNode*.
-	DocumentNode *arr[i];
-	memset(arr, 0, i);
-	
-	i=0;
-	
-	// Loop through the list and add DocumentNode* to array.
-	for (ptr = final_list; ptr != NULL; ptr = ptr->next) {
-		arr[i] = ptr;
-		i++;
+	for (int w=0; w < threads; w++) {
+		workers[w].Index = Index;
+		InitializePairCache(&workers[w].pair_cache, cache_size ? PAIR_CACHE_SIZE / threads : 0);
+		workers[w].batch = batch;
+		if (shards) {
+			workers[w].shards = &shards[w];
+			batch->lost |= !ConnectShards(&shards[w], shard_addresses, ranker != NULL);
+		}
 	}
-
-	qsort((void *)arr, i, sizeof(DocumentNode *), key_compare); // Sort array by rank.
+	setvbuf(stdout, NULL, _IOFBF, BATCH_BUFFER);
 	
-	// Recreate the list of DocumentNodes from the sorted array.
-	for (int j = 0; j < i; j++) {
-		if (j == 0) {
-			final_list = arr[j];
-			ptr = final_list;
+	long queries = 0;
+	while (!batch->lost) {
+		
+		// Read the next lines.
+		batch->num_lines = 0;
+		while (batch->num_lines < BATCH_LINES &&
+				getline(&batch->lines[batch->num_lines], &batch->line_sizes[batch->num_lines], in) != -1) {
+			batch->num_lines++;
 		}
-		else {
-			ptr->next = arr[j];
-			ptr = ptr->next;
+		if (batch->num_lines == 0) {
+			break;
+		}
+		
+		// Answer them.
+		batch->next = 0;
+		int started = 1;
+		while (started < threads && pthread_create(&ids[started], NULL, AnswerLines, &workers[started]) == 0) {
+			started++;
+		}
+		AnswerLines(&workers[0]);
+		for (int w=1; w < started; w++) {
+			pthread_join(ids[w], NULL);
+		}
+		
+		// Write their results, in line order; none of a chunk some lines of which were not answered.
+		for (int i=0; i < batch->num_lines; i++) {
+			if (batch->results[i]) {
+				if (!batch->lost) {
+					fwrite(batch->results[i], 1, batch->result_sizes[i], stdout);
+				}
+				free(batch->results[i]);
+				batch->results[i] = NULL;
+			}
+		}
+		batch->first += batch->num_lines;
+		queries += batch->num_lines;
+	}
+	fflush(stdout);
+	
+	// Cleanup.
+	for (int w=0; w < threads; w++) {
+		ClearPairCache(&workers[w].pair_cache);
+		if (shards) {
+			CloseShards(&shards[w]);
 		}
 	}
-	ptr->next = NULL;
+	fprintf(stderr, "Batch: %ld queries, %d threads, %ld result cache hits, %ld misses.\n", queries, threads,
+			batch->cache.hits, batch->cache.misses);
+	ClearCache(&batch->cache);
+	int lost = batch->lost;
+	for (int i=0; i < BATCH_LINES; i++) {
+		free(batch->lines[i]);
+	}
+	pthread_mutex_destroy(&batch->lock);
+	pthread_mutex_destroy(&batch->cache.lock);
+	free(batch);
+	free(workers);
+	free(shards);
+	if (in != stdin) {
+		fclose(in);
+	}
+	return lost ? -1 : 1;
 }
 
 
 /*
- * key_compare - key compare function for qsort.
- * @e1: element to compare.
- * @e2: element to compare.
+ * AnswerLines - answer the lines of a Batch, with one thread.
+ * @arg: BatchWorker of the thread.
  *
- * Returns -1 if e1>e2, 1 if e1<e2, 0 if e1==e2.
+ * Returns NULL.
  *
  * Pseudocode:
- *     1. Get the frequency of the two passed DocumentNodes.
- *     2. Return appropriate comparison value.
+ *     1. Take the next line not answered yet, until there are none left. Taking lines
+ *        one by one keeps every thread busy whatever the lines cost.
+ *     2. Answer it (see AnswerQuery) with the caches of the thread, or with --shards
+ *        from the shards (see SearchShards), and write its results into memory (see
+ *        WriteResults). Once a shard cannot be reached, the lines left are not answered.
  */
 
-int key_compare(const void *e1, const void *e2) {
+void *AnswerLines(void *arg) {
+	
+	BatchWorker *worker = (BatchWorker *)arg;
+	Batch *batch = worker->batch;
+	
+	while (1) {
+		pthread_mutex_lock(&batch->lock);
+		int i = batch->next++;
+		pthread_mutex_unlock(&batch->lock);
+		if (i >= batch->num_lines) {
+			break;
+		}
+		
+		DocumentNode *list = NULL;
+		int valid = (CheckLine(batch->lines[i]) == NULL);
+		if (valid && worker->shards) {
+			if ((valid = SearchShards(worker->shards, batch->lines[i], batch->offset, batch->limit, &list)) < 0) {
+				pthread_mutex_lock(&batch->lock);
+				batch->lost = 1;
+				batch->next = batch->num_lines;
+				pthread_mutex_unlock(&batch->lock);
+				break;
+			}
+		}
+		else if (valid) {
+			valid = AnswerQuery(batch->lines[i], worker->Index, &batch->cache, &worker->pair_cache, batch->offset,
+					batch->limit, &list);
+		}
+		FILE *out = open_memstream(&batch->results[i], &batch->result_sizes[i]);
+		if (out) {
+			WriteResults(out, batch->first + i, valid, list);
+			fclose(out);
+		}
+		FreeDocuments(list);
+	}
+	return NULL;
+}
 
-	DocumentNode *ia = *(DocumentNode **)e1;
-	DocumentNode *ib = *(DocumentNode **)e2;
-	int f1 = ia->freq;
-	int f2 = ib->freq;
 
-	if (f1 > f2) {
-		return -1;
-	}
-	else if (f1 < f2) {
-		return 1;
+/*
+ * WriteResults - write the results of a query line for --batch or --serve.
+ * @out: stream to write to.
+ * @number: number of the query line, from 1; 0 to leave the number out, for --serve.
+ * @valid: 0 if the line is not a valid query.
+ * @list: results, best first.
+ */
+
+void WriteResults(FILE *out, int number, int valid, const DocumentNode *list) {
+	
+	if (!valid) {
+		if (number > 0) {
+			fprintf(out, "%d\t", number);
+		}
+		fprintf(out, "invalid\n");
+		return;
 	}
-	else {
-		return 0;
+	for (const DocumentNode *dn = list; dn != NULL; dn = dn->next) {
+		if (number > 0) {
+			fprintf(out, "%d\t", number);
+		}
+		if (ranker) {
+			fprintf(out, "%d\t%.3f\n", dn->doc_id, dn->score);
+		}
+		else {
+			fprintf(out, "%d\t%d\n", dn->doc_id, dn->freq);
+		}
 	}
 }
 
 
 /*
- * FreeList - free memory of DocumentNode lists.
- * @choice: the type of list to free. If 0, free temp_list, and if 1, free final_list.
+ * OpenListener - open the socket of --serve.
+ * @address: TCP port on 127.0.0.1 if it is all digits, otherwise the path of a Unix socket.
  *
- * Returns 0 and terminates.
+ * Returns the listening socket if successful.
+ * Returns -1 if the address cannot be bound.
  *
  * Pseudocode:
- *     1. For the appropriate list, loop through each DocumentNode.
- *     2. Free DocumentNode and move on to the next one.
- *     3. Free until list is empty.
+ *     1. For a port, bind a TCP socket to it on the loopback address only.
+ *     2. For a path, remove the socket a server left there, if any, and bind a Unix
+ *        socket to it. A path that is not a socket is left alone, and not bound.
  */
- 
-int FreeList(int choice) {
 
-	DocumentNode *ptr; // variable for traversal.
+int OpenListener(const char *address) {
 	
-	// Free temp_list.
-	if (choice == 0) {
-		ptr = temp_list;
+	int fd;
 	
-		while (ptr != NULL) {
-			DocumentNode *ptr2 = ptr;
-			ptr = ptr->next;
-			free(ptr2);
+	// Case of a TCP port.
+	if (address[0] != '\0' && strspn(address, "0123456789") == strlen(address)) {
+		long port = strtol(address, NULL, 10);
+		struct sockaddr_in in;
+		memset(&in, 0, sizeof(in));
+		in.sin_family = AF_INET;
+		in.sin_port = htons((unsigned short)port);
+		in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		if (port == 0 || port > 65535 || (fd = socket(AF_INET, SOCK_STREAM, 0)) == -1) {
+			return -1;
+		}
+		int on = 1; // Bind again right away after a restart.
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+		if (bind(fd, (struct sockaddr *)&in, sizeof(in)) == -1 || listen(fd, SOMAXCONN) == -1) {
+			close(fd);
+			return -1;
 		}
-		temp_list = NULL;
+		return fd;
 	}
 	
-	else { // Free final_list.
-		ptr = final_list;
-	
-		while (ptr!= NULL) {
-			DocumentNode *ptr2 = ptr;
-			ptr = ptr->next;
-			free(ptr2);
-		}
-		final_list = NULL;
+	// Case of a Unix socket.
+	struct sockaddr_un un;
+	struct stat statbuf;
+	memset(&un, 0, sizeof(un));
+	un.sun_family = AF_UNIX;
+	if (strlen(address) >= sizeof(un.sun_path) || (fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
+		return -1;
 	}
-
-	return 0;
+	strcpy(un.sun_path, address);
+	if (stat(address, &statbuf) == 0 && S_ISSOCK(statbuf.st_mode)) {
+		unlink(address);
+	}
+	if (bind(fd, (struct sockaddr *)&un, sizeof(un)) == -1 || listen(fd, SOMAXCONN) == -1) {
+		close(fd);
+		return -1;
+	}
+	return fd;
 }
 
 
 /*
- * Display - display query matches to output.
+ * RunServer - answer query lines sent over a socket, until SIGINT or SIGTERM.
+ * @address: TCP port on 127.0.0.1, or path of a Unix socket (see OpenListener).
+ * @Index: InvertedIndex mapped by OpenIndex, shared by every worker. If the index was mapped
+ *         again (see ReloadIndex), it is left empty, but doc_file and bm25_ranker are always
+ *         those of the index mapped last, for CloseIndex.
+ * @bm25: 1 to rank with BM25, for when the index is mapped again.
+ * @bm25_ranker: ranker of OpenIndex.
+ * @threads: number of workers answering queries.
+ * @cache_size: size limit of the result cache, which every worker shares.
+ * @offset: number of best results to skip (--offset).
+ * @limit: number of results to keep after those (--top), 0 for all of them.
  *
  * Returns 1 if successful.
- * Returns 0 if not.
+ * Returns 0 if the address cannot be bound.
+ *
+ * A client sends query lines, and may send the next before reading the reply to the last.
+ * Each one gets a line DOC_ID<TAB>RANK per result, best first, then an empty line; a line
+ * that is not a valid query gets "invalid", then an empty line. The replies come back in
+ * line order.
  *
  * Pseudocode:
- *     1. Get each DocumentNode of final_list.
- *     2. Get filename and open a stream to that file.
- *     3. Read in the URL address from stream.
- *     4. Output doc_id and url to stdout.
+ *     1. Start the workers (see ServeRequests), each with its own share of the pair cache,
+ *        and all of them with the one result cache of the server.
+ *        Only main takes SIGINT and SIGTERM, and a client that goes away does not raise
+ *        SIGPIPE.
+ *     2. In main, wait with epoll for any of the non-blocking sockets to be ready, or for
+ *        the wake pipe, that the workers and StopServer write to:
+ *        - the listening socket: accept the new clients (see AcceptClients).
+ *        - a client: read its query lines, and queue them for the workers (see
+ *          ReadRequests); send the replies it could not take before (see FlushClient);
+ *          close it if it is gone both ways.
+ *        - the wake pipe: send the replies the workers wrote (see CollectReplies).
+ *        No thread ever waits for a client, so a few threads serve any number of them.
+ *     3. Once stopped, wait for the workers, and close every connection.
+ */
+
+int RunServer(char *address, HashTable *Index, int bm25, Ranker *bm25_ranker, int threads, long cache_size,
+		int offset, int limit) {
+	
+	Server *server = (Server *)calloc(1, sizeof(Server));
+	ServerWorker *workers = (ServerWorker *)calloc(threads, sizeof(ServerWorker));
+	HashTable *spare = (HashTable *)malloc(sizeof(HashTable));
+	pthread_t ids[MAX_THREADS];
+	int listener = OpenListener(address);
+	int epoll = epoll_create1(0);
+	if (!server || !workers || !spare || listener == -1 || epoll == -1 || pipe(server->wake) == -1) {
+		if (listener != -1) {
+			close(listener);
+		}
+		if (epoll != -1) {
+			close(epoll);
+		}
+		free(server);
+		free(workers);
+		free(spare);
+		return 0;
+	}
+	InitializeHashTable(spare);
+	server->Index = Index;
+	server->spare = spare;
+	server->bm25 = bm25;
+	server->bm25_ranker = bm25_ranker;
+	server->offset = offset;
+	server->limit = limit;
+	server->listener = listener;
+	server->epoll = epoll;
+	IndexChanged(file, &server->stamp);
+	server->checked = time(NULL);
+	pthread_mutex_init(&server->lock, NULL);
+	pthread_cond_init(&server->ready, NULL);
+	pthread_rwlock_init(&server->index_lock, NULL);
+	pthread_mutex_init(&server->stamp_lock, NULL);
+	InitializeCache(&server->cache, cache_size);
+	
+	// Watch the listening socket and the wake pipe, without ever blocking on them.
+	struct epoll_event event;
+	memset(&event, 0, sizeof(event));
+	fcntl(listener, F_SETFL, fcntl(listener, F_GETFL) | O_NONBLOCK);
+	fcntl(server->wake[0], F_SETFL, fcntl(server->wake[0], F_GETFL) | O_NONBLOCK);
+	fcntl(server->wake[1], F_SETFL, fcntl(server->wake[1], F_GETFL) | O_NONBLOCK);
+	event.events = EPOLLIN;
+	event.data.ptr = &server->listener;
+	epoll_ctl(epoll, EPOLL_CTL_ADD, listener, &event);
+	server->accepting = 1;
+	event.data.ptr = server->wake;
+	epoll_ctl(epoll, EPOLL_CTL_ADD, server->wake[0], &event);
+	
+	// Stop on SIGINT or SIGTERM, and keep going when a client goes away.
+	wake_pipe = server->wake[1];
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = StopServer;
+	sigemptyset(&action.sa_mask);
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+	signal(SIGPIPE, SIG_IGN);
+	
+	// Start the workers, with both signals blocked, so only main takes them.
+	sigset_t signals, old;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &signals, &old);
+	int started = 0;
+	while (started < threads) {
+		ServerWorker *worker = &workers[started];
+		worker->server = server;
+		InitializePairCache(&worker->pair_cache, cache_size ? PAIR_CACHE_SIZE / threads : 0);
+		if (pthread_create(&ids[started], NULL, ServeRequests, worker) != 0) {
+			ClearPairCache(&worker->pair_cache);
+			break;
+		}
+		started++;
+	}
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	fprintf(stderr, "Serving on %s with %d threads.\n", address, started);
+	
+	// Wait for the sockets, and serve whichever are ready.
+	struct epoll_event events[MAX_EVENTS];
+	while (!stopping && started > 0) {
+		int num = epoll_wait(epoll, events, MAX_EVENTS, -1);
+		for (int i=0; i < num; i++) {
+			if (events[i].data.ptr == &server->listener) {
+				AcceptClients(server);
+			}
+			else if (events[i].data.ptr == server->wake) {
+				CollectReplies(server);
+			}
+			else {
+				Client *client = (Client *)events[i].data.ptr;
+				if (client->fd != -1 && (events[i].events & (EPOLLHUP | EPOLLERR))) {
+					CloseClient(server, client); // Gone both ways, so it cannot have its replies.
+				}
+				if (client->fd != -1 && (events[i].events & EPOLLIN)) {
+					ReadRequests(server, client);
+				}
+				if (client->fd != -1 && (events[i].events & EPOLLOUT)) {
+					FlushClient(server, client);
+				}
+				UpdateClient(server, client);
+			}
+		}
+		
+		// Free the clients closed, now that no event can point to them.
+		while (server->closed) {
+			Client *client = server->closed;
+			server->closed = client->next;
+			free(client);
+		}
+	}
+	
+	// Stop the workers. The queries they are answering are finished, the others dropped.
+	pthread_mutex_lock(&server->lock);
+	server->stop = 1;
+	pthread_cond_broadcast(&server->ready);
+	pthread_mutex_unlock(&server->lock);
+	
+	// Cleanup.
+	long queries = 0;
+	for (int w=0; w < started; w++) {
+		pthread_join(ids[w], NULL);
+		queries += workers[w].queries;
+		ClearPairCache(&workers[w].pair_cache);
+		FreeRanker(&workers[w].shard_ranker);
+	}
+	fprintf(stderr, "Server: %ld queries, %ld clients, %d threads, %ld result cache hits, %ld misses.\n", queries,
+			server->num_clients, started, server->cache.hits, server->cache.misses);
+	ClearCache(&server->cache);
+	while (server->clients) {
+		Client *client = server->clients;
+		server->clients = client->next;
+		while (client->first) {
+			Request *request = client->first;
+			client->first = request->next;
+			free(request->reply);
+			free(request);
+		}
+		if (client->fd != -1) {
+			close(client->fd);
+		}
+		free(client);
+	}
+	wake_pipe = -1;
+	close(server->wake[0]);
+	close(server->wake[1]);
+	close(epoll);
+	close(listener);
+	struct stat statbuf;
+	if (stat(address, &statbuf) == 0 && S_ISSOCK(statbuf.st_mode)) {
+		unlink(address);
+	}
+	pthread_mutex_destroy(&server->lock);
+	pthread_cond_destroy(&server->ready);
+	pthread_rwlock_destroy(&server->index_lock);
+	pthread_mutex_destroy(&server->stamp_lock);
+	pthread_mutex_destroy(&server->cache.lock);
+	
+	// Free the InvertedIndex that main did not pass, whether it has the index mapped last or not.
+	HashTable *other = (server->Index == Index) ? server->spare : server->Index;
+	CleanHashTable(other);
+	FreeHashTable(other);
+	free(other);
+	free(server);
+	free(workers);
+	return 1;
+}
+
+
+/*
+ * StopServer - signal handler of SIGINT and SIGTERM for --serve.
+ * @signum: signal taken.
+ *
+ * Pseudocode:
+ *     1. Note that the server is stopping, and write to the wake pipe, so that main
+ *        stops waiting in epoll_wait.
+ */
+
+void StopServer(int signum) {
+	(void)signum;
+	stopping = 1;
+	if (write(wake_pipe, "s", 1) == -1) {
+		// The pipe is full, so main wakes up anyway.
+	}
+}
+
+
+/*
+ * AcceptClients - accept the new connections of the listening socket.
+ * @server: Server of the socket.
+ *
+ * Pseudocode:
+ *     1. Accept connections until there are none left. Make each one non-blocking, and
+ *        watch it for query lines.
+ *     2. Out of file descriptors, stop watching the listening socket until a client is
+ *        closed (see CloseClient), rather than being woken up for it again and again.
+ */
+
+void AcceptClients(Server *server) {
+	
+	while (1) {
+		int fd = accept(server->listener, NULL, NULL);
+		if (fd == -1) {
+			if ((errno == EMFILE || errno == ENFILE) && server->accepting) {
+				epoll_ctl(server->epoll, EPOLL_CTL_DEL, server->listener, NULL);
+				server->accepting = 0;
+			}
+			if (errno == EINTR || errno == ECONNABORTED) {
+				continue;
+			}
+			return;
+		}
+		
+		Client *client = (Client *)calloc(1, sizeof(Client));
+		struct epoll_event event;
+		memset(&event, 0, sizeof(event));
+		event.events = EPOLLIN;
+		event.data.ptr = client;
+		if (client == NULL || fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) == -1 ||
+				epoll_ctl(server->epoll, EPOLL_CTL_ADD, fd, &event) == -1) {
+			free(client);
+			close(fd);
+			continue;
+		}
+		client->fd = fd;
+		client->events = EPOLLIN;
+		client->next = server->clients;
+		if (server->clients) {
+			server->clients->prev = client;
+		}
+		server->clients = client;
+		server->num_clients++;
+	}
+}
+
+
+/*
+ * ReadRequests - read what a client sent, and queue its query lines for the workers.
+ * @server: Server of the client.
+ * @client: client with something to read.
+ *
+ * Pseudocode:
+ *     1. Read into the buffer of the client until the socket has nothing left, the buffer
+ *        is full, or the client sent its last line.
+ *     2. Queue each whole line read (see QueueLines).
+ *     3. If the socket fails, close the client.
+ */
+
+void ReadRequests(Server *server, Client *client) {
+	
+	while (client->fd != -1 && !client->eof && client->used < CLIENT_BUFFER && client->num_requests < MAX_PIPELINE) {
+		ssize_t n = read(client->fd, client->buffer + client->used, CLIENT_BUFFER - client->used);
+		if (n > 0) {
+			client->used += n;
+			QueueLines(server, client);
+		}
+		else if (n == 0) {
+			client->eof = 1;
+		}
+		else if (errno == EINTR) {
+			continue;
+		}
+		else {
+			if (errno != EAGAIN && errno != EWOULDBLOCK) {
+				CloseClient(server, client);
+			}
+			return;
+		}
+	}
+}
+
+
+/*
+ * QueueLines - queue the whole lines of the buffer of a client for the workers.
+ * @server: Server of the client.
+ * @client: client whose buffer to take the lines from.
+ *
+ * Pseudocode:
+ *     1. While the client has fewer than MAX_PIPELINE lines waiting for their replies,
+ *        make a Request of the next line of the buffer, and put it at the end of the lines
+ *        of the client and of the queue of the workers.
+ *     2. The rest of the last line sent before the client closed its side is a line too.
+ *        A line longer than SHARD_LINE, the longest request of --shards, is cut to
+ *        SHARD_LINE characters, which is not a valid query, and the rest of it is thrown away.
+ *     3. Keep the bytes of the line not sent in full yet at the start of the buffer.
+ */
+
+void QueueLines(Server *server, Client *client) {
+	
+	size_t start = 0; // first byte not queued.
+	Request *first = NULL, *last = NULL; // Requests for the queue.
+	
+	while (client->num_requests < MAX_PIPELINE && start < client->used) {
+		char *end = memchr(client->buffer + start, '\n', client->used - start);
+		size_t length = end ? (size_t)(end - (client->buffer + start)) + 1 : client->used - start;
+		
+		// Case of the rest of a line too long.
+		if (client->skipping) {
+			client->skipping = (end == NULL);
+			start += length;
+			continue;
+		}
+		
+		// Case of a line not sent in full yet.
+		if (end == NULL && !client->eof && length <= SHARD_LINE) {
+			break;
+		}
+		
+		// Make the Request, with the line after it.
+		size_t kept = (length > SHARD_LINE) ? SHARD_LINE : length;
+		Request *request = (Request *)malloc(sizeof(Request) + kept + 1);
+		if (request == NULL) {
+			CloseClient(server, client);
+			break;
+		}
+		memset(request, 0, sizeof(Request));
+		request->client = client;
+		request->line = (char *)(request + 1);
+		memcpy(request->line, client->buffer + start, kept);
+		request->line[kept] = '\0';
+		client->skipping = (length > SHARD_LINE && end == NULL);
+		start += length;
+		
+		// Put it after the other lines of the client, and after the others queued.
+		if (client->last) {
+			client->last->next = request;
+		}
+		else {
+			client->first = request;
+		}
+		client->last = request;
+		client->num_requests++;
+		if (last) {
+			last->next_job = request;
+		}
+		else {
+			first = request;
+		}
+		last = request;
+	}
+	
+	// Keep the rest of the buffer, unless the client was closed.
+	if (client->fd != -1) {
+		memmove(client->buffer, client->buffer + start, client->used - start);
+		client->used -= start;
+	}
+	
+	// Hand the Requests over to the workers all at once.
+	if (first) {
+		pthread_mutex_lock(&server->lock);
+		if (server->last_job) {
+			server->last_job->next_job = first;
+		}
+		else {
+			server->jobs = first;
+		}
+		server->last_job = last;
+		pthread_cond_broadcast(&server->ready);
+		pthread_mutex_unlock(&server->lock);
+	}
+}
+
+
+/*
+ * ServeRequests - answer the Requests queued by main, with one worker thread.
+ * @arg: ServerWorker of the thread.
+ *
+ * Returns NULL.
+ *
+ * Pseudocode:
+ *     1. Wait for a Request to be queued, or for the server to stop.
+ *     2. Answer it (see AnswerRequest). The worker only touches the Request, never its
+ *        client, which belongs to main.
+ *     3. Put it on the list of replies for main to collect, and write to the wake pipe
+ *        if the list was empty, so main is woken up once for all the replies it finds.
+ */
+
+void *ServeRequests(void *arg) {
+	
+	ServerWorker *worker = (ServerWorker *)arg;
+	Server *server = worker->server;
+	
+	while (1) {
+		pthread_mutex_lock(&server->lock);
+		while (server->jobs == NULL && !server->stop) {
+			pthread_cond_wait(&server->ready, &server->lock);
+		}
+		if (server->stop) {
+			pthread_mutex_unlock(&server->lock);
+			break;
+		}
+		Request *request = server->jobs;
+		server->jobs = request->next_job;
+		if (server->jobs == NULL) {
+			server->last_job = NULL;
+		}
+		pthread_mutex_unlock(&server->lock);
+		
+		AnswerRequest(worker, request->line, &request->reply, &request->reply_size);
+		worker->queries++;
+		
+		pthread_mutex_lock(&server->lock);
+		request->next_job = server->replies;
+		server->replies = request;
+		int wake = (request->next_job == NULL);
+		pthread_mutex_unlock(&server->lock);
+		if (wake && write(server->wake[1], "r", 1) == -1) {
+			// The pipe is full, so main wakes up anyway.
+		}
+	}
+	return NULL;
+}
+
+
+/*
+ * CollectReplies - send the replies the workers wrote since the last time.
+ * @server: Server of the workers.
+ *
+ * Pseudocode:
+ *     1. Empty the wake pipe, and take the list of replies.
+ *     2. Mark each Request as replied, and note its client once.
+ *     3. Send each client noted the replies it can have so far (see FlushClient).
+ */
+
+void CollectReplies(Server *server) {
+	
+	char bytes[64];
+	while (read(server->wake[0], bytes, sizeof(bytes)) > 0) {
+	}
+	
+	pthread_mutex_lock(&server->lock);
+	Request *request = server->replies;
+	server->replies = NULL;
+	pthread_mutex_unlock(&server->lock);
+	
+	Client *noted = NULL; // clients with new replies.
+	for ( ; request != NULL; request = request->next_job) {
+		request->done = 1;
+		if (!request->client->noted) {
+			request->client->noted = 1;
+			request->client->next_noted = noted;
+			noted = request->client;
+		}
+	}
+	while (noted) {
+		Client *client = noted;
+		noted = client->next_noted;
+		client->noted = 0;
+		FlushClient(server, client);
+		UpdateClient(server, client);
+	}
+}
+
+
+/*
+ * FlushClient - send a client the replies it can have so far.
+ * @server: Server of the client.
+ * @client: client to send them to.
+ *
+ * Pseudocode:
+ *     1. Take the replies of its first lines, in line order, up to the first line not
+ *        replied yet, and send up to WRITEV_MAX of them with one writev.
+ *     2. Free the Requests whose replies were sent in full, and note how much of the next
+ *        one was sent. Repeat until the socket cannot take more, then wait for it.
+ *     3. If the client was closed, its replies are only freed. If the socket fails, or a
+ *        worker had no memory for a reply, close the client.
+ */
+
+void FlushClient(Server *server, Client *client) {
+	
+	while (client->first && client->first->done) {
+		
+		// Case of a closed client, or of a reply without memory.
+		if (client->fd == -1) {
+			FreeRequest(client);
+			continue;
+		}
+		if (client->first->reply == NULL) {
+			CloseClient(server, client);
+			return;
+		}
+		
+		// Send the replies up to the first line not replied yet.
+		struct iovec iov[WRITEV_MAX];
+		int num = 0;
+		size_t skip = client->sent;
+		for (Request *request = client->first; request && request->done && request->reply && num < WRITEV_MAX;
+				request = request->next) {
+			iov[num].iov_base = request->reply + skip;
+			iov[num].iov_len = request->reply_size - skip;
+			skip = 0;
+			num++;
+		}
+		ssize_t sent = writev(client->fd, iov, num);
+		if (sent == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				client->blocked = 1;
+			}
+			else {
+				CloseClient(server, client);
+			}
+			return;
+		}
+		client->blocked = 0;
+		
+		// Free the Requests sent in full.
+		while (sent > 0) {
+			size_t left = client->first->reply_size - client->sent;
+			if ((size_t)sent < left) {
+				client->sent += sent;
+				break;
+			}
+			sent -= left;
+			FreeRequest(client);
+		}
+	}
+}
+
+
+/*
+ * FreeRequest - free the first Request of a client.
+ * @client: client of the Request.
+ */
+
+void FreeRequest(Client *client) {
+	Request *request = client->first;
+	client->first = request->next;
+	if (client->first == NULL) {
+		client->last = NULL;
+	}
+	client->num_requests--;
+	client->sent = 0;
+	free(request->reply);
+	free(request);
+}
+
+
+/*
+ * UpdateClient - watch a client for what it can do next, or let it go once done.
+ * @server: Server of the client.
+ * @client: client whose state changed.
+ *
+ * Pseudocode:
+ *     1. Queue the lines left in its buffer (see QueueLines), that MAX_PIPELINE may have
+ *        held back, or that it sent before closing its side.
+ *     2. Once a client closed its side has every reply, close it.
+ *     3. Watch a client for query lines while it has fewer than MAX_PIPELINE lines waiting
+ *        for their replies, and for room to send while its socket cannot take its replies.
+ *     4. Once a client is closed and no worker answers one of its lines anymore, put it on
+ *        the list of clients to free.
+ */
+
+void UpdateClient(Server *server, Client *client) {
+	
+	if (client->fd != -1 && client->used > 0 && client->num_requests < MAX_PIPELINE) {
+		QueueLines(server, client);
+	}
+	if (client->fd != -1 && client->eof && client->num_requests == 0 && client->used == 0) {
+		CloseClient(server, client);
+	}
+	
+	// Case of an open client.
+	if (client->fd != -1) {
+		unsigned int events = ((!client->eof && client->num_requests < MAX_PIPELINE) ? EPOLLIN : 0) |
+				(client->blocked ? EPOLLOUT : 0);
+		if (events != client->events) {
+			struct epoll_event event;
+			memset(&event, 0, sizeof(event));
+			event.events = events;
+			event.data.ptr = client;
+			epoll_ctl(server->epoll, EPOLL_CTL_MOD, client->fd, &event);
+			client->events = events;
+		}
+		return;
+	}
+	
+	// Case of a closed client with no Request left.
+	if (client->num_requests == 0 && !client->freed) {
+		if (client->prev) {
+			client->prev->next = client->next;
+		}
+		else {
+			server->clients = client->next;
+		}
+		if (client->next) {
+			client->next->prev = client->prev;
+		}
+		client->freed = 1;
+		client->next = server->closed;
+		server->closed = client;
+	}
+}
+
+
+/*
+ * CloseClient - close the connection of a client.
+ * @server: Server of the client.
+ * @client: client to close.
+ *
+ * Pseudocode:
+ *     1. Close the socket, which takes it out of epoll, and forget the bytes read.
+ *     2. Free the replies already written (see FlushClient). The Requests workers still
+ *        have are freed as their replies are collected.
+ *     3. If the listening socket was left for lack of file descriptors, watch it again.
+ */
+
+void CloseClient(Server *server, Client *client) {
+	
+	close(client->fd);
+	client->fd = -1;
+	client->used = 0;
+	client->blocked = 0;
+	FlushClient(server, client);
+	
+	if (!server->accepting) {
+		struct epoll_event event;
+		memset(&event, 0, sizeof(event));
+		event.events = EPOLLIN;
+		event.data.ptr = &server->listener;
+		epoll_ctl(server->epoll, EPOLL_CTL_ADD, server->listener, &event);
+		server->accepting = 1;
+	}
+}
+
+
+/*
+ * AnswerRequest - answer a query line sent to the server.
+ * @worker: ServerWorker answering it.
+ * @line: query line.
+ * @reply: set to the reply, for the caller to free; NULL if memory cannot be allocated.
+ * @reply_size: set to the length of the reply.
+ *
+ * Pseudocode:
+ *     1. Check the line (see CheckLine). A line longer than the interactive prompt takes is
+ *        not a valid query.
+ *     2. Map the index again if the indexer changed it (see ReloadIndex).
+ *     3. With the index read-locked, forget the pairs the worker kept if the index was
+ *        mapped again since, then answer the line (see AnswerQuery) and write the reply
+ *        (see WriteResults), followed by an empty line. A line starting with # is a request
+ *        of --shards (see AnswerShardRequest).
+ */
+
+void AnswerRequest(ServerWorker *worker, char *line, char **reply, size_t *reply_size) {
+	
+	Server *server = worker->server;
+	const char *message = (strlen(line) < MAX) ? CheckLine(line) : "Please input a shorter query line.";
+	DocumentNode *list = NULL;
+	
+	ReloadIndex(server);
+	pthread_rwlock_rdlock(&server->index_lock);
+	if (worker->generation != server->generation) {
+		ClearPairCache(&worker->pair_cache);
+		FreeRanker(&worker->shard_ranker);
+		worker->generation = server->generation;
+	}
+	
+	int shard = (line[0] == '#');
+	int valid = !shard && (message == NULL) && AnswerQuery(line, server->Index, &server->cache, &worker->pair_cache,
+			server->offset, server->limit, &list);
+	FILE *out = open_memstream(reply, reply_size);
+	if (out) {
+		if (!shard || !AnswerShardRequest(worker, line, out)) {
+			WriteResults(out, 0, valid, list);
+		}
+		fputc('\n', out);
+		fclose(out);
+	}
+	else {
+		*reply = NULL;
+	}
+	pthread_rwlock_unlock(&server->index_lock);
+	
+	FreeDocuments(list); // Cleanup.
+}
+
+
+/*
+ * AnswerShardRequest - answer a request of --shards, sent to the --serve of a shard.
+ * @worker: ServerWorker answering it, with the index read-locked.
+ * @line: request, #rank, #stats or #search (see shards.h); cut up in place.
+ * @out: stream to write the reply to, but its empty line.
+ *
+ * Returns 1 if successful.
+ * Returns 0 if the request is not valid, with nothing written.
+ *
+ * Pseudocode:
+ *     1. For #rank, write how the server ranks: with BM25 if it was started with -b.
+ *     2. For #stats, write the number of documents and of words of the document table,
+ *        then the df of each word of the query line (see WriteWordStats).
+ *     3. For #search, read the statistics sent (see ReadShardSearch). With them, rank with
+ *        the N and the average length of the collection, making the ranker of the worker
+ *        again only when they change, and with the df sent for each word.
+ *     4. Find the documents of the query line, rank them, and write the K best, with
+ *        their exact scores so they merge with those of the other shards as if one index
+ *        had ranked them all. These are not kept in the result cache, as their scores
+ *        depend on the statistics sent.
+ */
+
+int AnswerShardRequest(ServerWorker *worker, char *line, FILE *out) {
+	
+	HashTable *Index = worker->server->Index;
+	line[strcspn(line, "\n")] = '\0';
+	
+	// Case of #rank.
+	if (strcmp(line, "#rank") == 0) {
+		fprintf(out, "%s\n", ranker ? "bm25" : "frequency");
+		return 1;
+	}
+	
+	// Case of #stats.
+	if (strncmp(line, "#stats\t", 7) == 0) {
+		Arena arena; // QueryNodes of the query.
+		InitializeArena(&arena);
+		QueryNode *query = (strlen(line + 7) < MAX && CheckLine(line + 7) == NULL) ? ParseQuery(line + 7, &arena) : NULL;
+		int ok = (query != NULL && doc_file.header != NULL);
+		if (ok) {
+			fprintf(out, "%u\t%llu\n", doc_file.header->num_docs, (unsigned long long)doc_file.header->total_length);
+			WriteWordStats(out, query, Index);
+		}
+		FreeArena(&arena);
+		return ok;
+	}
+	
+	// Case of #search, with the statistics of every shard for BM25.
+	int k;
+	ShardStats stats;
+	char *query_line;
+	if (!ReadShardSearch(line, &k, &stats, &query_line) || (stats.num_docs > 0) != (ranker != NULL) ||
+			strlen(query_line) >= MAX || CheckLine(query_line) != NULL) {
+		return 0;
+	}
+	Ranker query_ranker;
+	if (ranker) {
+		if (worker->shard_ranker.num_docs != stats.num_docs || worker->shard_length != stats.total_length) {
+			FreeRanker(&worker->shard_ranker);
+			worker->shard_length = stats.total_length;
+			if (!InitializeShardRanker(&worker->shard_ranker, &doc_file, stats.num_docs, stats.total_length)) {
+				return 0;
+			}
+		}
+		query_ranker = worker->shard_ranker;
+		query_ranker.words = stats.words;
+		query_ranker.dfs = stats.dfs;
+		query_ranker.num_words = stats.num_words;
+	}
+	
+	// Find the documents, and keep the K best.
+	Arena arena; // QueryNodes and PlanNodes of the query.
+	InitializeArena(&arena);
+	QueryNode *query = ParseQuery(query_line, &arena);
+	if (query == NULL) {
+		FreeArena(&arena);
+		return 0;
+	}
+	PlanNode *plan = PlanQuery(query, Index, &worker->pair_cache, &arena);
+	DocumentNode *list = ExecutePlan(plan, ranker ? &query_ranker : NULL, k, Index);
+	FreeArena(&arena);
+	RankDocuments(&list, 0, k ? k : INT_MAX);
+	for (DocumentNode *dn = list; dn != NULL; dn = dn->next) {
+		if (ranker) {
+			fprintf(out, "%d\t%.9g\n", dn->doc_id, dn->score);
+		}
+		else {
+			fprintf(out, "%d\t%d\n", dn->doc_id, dn->freq);
+		}
+	}
+	FreeDocuments(list);
+	return 1;
+}
+
+
+/*
+ * WriteWordStats - write the df of each word of a query, for #stats.
+ * @out: stream to write to.
+ * @query: QueryNode of the query, or of one of its operands.
+ * @Index: InvertedIndex to look the words up in.
+ *
+ * A WORD<TAB>DF line is written for every word, in phrases and NOTs too, 0 for
+ * a word the index does not have. A word may be written more than once.
+ */
+
+void WriteWordStats(FILE *out, const QueryNode *query, HashTable *Index) {
+	
+	if (query->type == QUERY_WORD) {
+		WordNode *wn = FindWord(query->word, Index);
+		fprintf(out, "%s\t%d\n", query->word, wn ? wn->df : 0);
+		return;
+	}
+	for (const QueryNode *child = query->children; child != NULL; child = child->next) {
+		WriteWordStats(out, child, Index);
+	}
+}
+
+
+/*
+ * ReloadIndex - map the index of the server again if the indexer changed it.
+ * @server: Server of the index.
+ *
+ * Pseudocode:
+ *     1. At most once a second, check if the indexer changed the index (see IndexChanged).
+ *        One thread checks at a time; the others do not wait for it, and answer with the
+ *        index mapped, as they do while it maps the new one.
+ *     2. If it did, map the new index into the spare InvertedIndex (see OpenIndex), while
+ *        the workers keep answering with the old one. If it is not valid, keep the old one,
+ *        and check again the next second.
+ *     3. Otherwise, wait for the queries being answered, and swap the new index in with its
+ *        document table and ranker. Forget the results of the result cache, and start a new
+ *        generation, so that each worker forgets the pairs it kept before it answers its next
+ *        query. Then unmap the old index.
+ */
+
+void ReloadIndex(Server *server) {
+	
+	if (pthread_mutex_trylock(&server->stamp_lock) != 0) {
+		return; // Another thread is checking, or mapping the new index.
+	}
+	time_t now = time(NULL);
+	if (now != server->checked) {
+		server->checked = now;
+		if (IndexChanged(file, &server->stamp)) {
+			
+			// Map the new index beside the old one.
+			DocFile docs;
+			Ranker bm25_ranker;
+			if (!OpenIndex(server->spare, &docs, server->bm25, &bm25_ranker)) {
+				fprintf(stderr, "[INDEX_FILE] is not a valid index. Please rebuild it with the indexer. "
+						"Answering with the last valid one.\n");
+				memset(&server->stamp, 0, sizeof(IndexStamp)); // Try again at the next check.
+			}
+			
+			// Swap it in.
+			else {
+				pthread_rwlock_wrlock(&server->index_lock);
+				HashTable *old = server->Index;
+				DocFile old_docs = doc_file;
+				Ranker old_ranker = *server->bm25_ranker;
+				server->Index = server->spare;
+				server->spare = old;
+				doc_file = docs;
+				*server->bm25_ranker = bm25_ranker;
+				ranker = bm25_ranker.norms ? server->bm25_ranker : NULL;
+				ClearCache(&server->cache);
+				server->generation++;
+				pthread_rwlock_unlock(&server->index_lock);
+				CloseIndex(old, &old_docs, &old_ranker);
+			}
+		}
+	}
+	pthread_mutex_unlock(&server->stamp_lock);
+}
+
+
+/*
+ * FindDocuments - get all matched DocumentNodes for a given query into a list.
+ * @line: query line to be searched for.
+ * @Index: InvertedIndex containing all word-document pairs.
+ * @pair_cache: documents shared by pairs of words, NULL for none.
+ * @list: set to the DocumentNodes found, in doc_id order, NULL if none.
+ * 
+ * Returns 1 if successful.
+ * Returns 0 if not successful.
+ *
+ * Only the list and the caches passed are changed, so threads with their own caches can
+ * find documents at the same time, sharing Index (see FindWord).
+ *
+ * Pseudocode:
+ *     1. Parse the query line into a tree of words, phrases, groups in parentheses and
+ *        AND, OR and NOT operators (see ParseQuery). Words with no operator between them
+ *        are AND'ed, and AND binds tighter than OR.
+ *     2. Look up its words, and order the operands of each AND from the cheapest one
+ *        (see PlanQuery). An AND with a word that is not in the InvertedIndex matches nothing,
+ *        and one of a pair of words kept in pair_cache starts from the documents they share.
+ *     3. Run the plan into the list, in doc_id order (see ExecutePlan). If only the top_k
+ *        documents are wanted, the list may get only those, unsorted.
+ */
+
+int FindDocuments(char *line, HashTable *Index, PairCache *pair_cache, DocumentNode **list) {
+	
+	Arena arena; // QueryNodes and PlanNodes of the query.
+	InitializeArena(&arena);
+	*list = NULL;
+	
+	// Parse the query line.
+	QueryNode *query = ParseQuery(line, &arena);
+	if (query == NULL) {
+		FreeArena(&arena);
+		return 0;
+	}
+	
+	// Plan it and run it.
+	PlanNode *plan = PlanQuery(query, Index, pair_cache, &arena);
+	*list = ExecutePlan(plan, ranker, top_k, Index);
+	
+	FreeArena(&arena); // Cleanup.
+	return 1; // Return 1 if successful.
+}	
+
+
+/*
+ * RankDocuments - Keep a page of the best ranked DocumentNodes of a list.
+ * @list: list of DocumentNodes, in any order.
+ * @offset: number of best ranked DocumentNodes to skip.
+ * @limit: number of DocumentNodes to keep after those.
+ *
+ * Returns the number of DocumentNodes the list had.
+ *
+ * The list is left with the DocumentNodes ranked offset + 1 to offset + limit, from
+ * highest to lowest rank, and the others are freed. Only offset + limit DocumentNodes
+ * are held at a time, so ranking n of them costs n log (offset + limit).
+ *
+ * Pseudocode:
+ *     1. Put DocumentNodes into a min-heap by rank, whose top is the worst one kept,
+ *        until it has offset + limit of them.
+ *     2. For each other DocumentNode, if it ranks higher than the top, replace the top
+ *        with it. Free the one left out.
+ *     3. Take the DocumentNodes out of the heap, worst first, onto the front of the list.
+ *     4. Free the first offset DocumentNodes of the list.
+ */
+
+int RankDocuments(DocumentNode **list, int offset, int limit) {
+
+	DocumentNode *ptr, *next; // variables for traversal.
+	int n = 0;
+	
+	// Loop through the list to get its size.
+	for (ptr = *list; ptr != NULL; ptr = ptr->next) {
+		n++;
+	}
+	int k = ((long)offset + limit < n) ? offset + limit : n;
+	DocumentNode **heap = (DocumentNode **)malloc((k ? k : 1) * sizeof(DocumentNode *));
+	if (!heap) { // Without memory, leave the list as it is.
+		return n;
+	}
+	int size = 0;
+	
+	for (ptr = *list; ptr != NULL; ptr = next) {
+		next = ptr->next;
+		int i;
+		
+		// Case of a heap that is not full, add ptr and move it up past the better ones.
+		if (size < k) {
+			for (i = size++; i > 0 && key_compare(&ptr, &heap[(i - 1) / 2]) > 0; i = (i - 1) / 2) {
+				heap[i] = heap[(i - 1) / 2];
+			}
+			heap[i] = ptr;
+			continue;
+		}
+		
+		// Case of a full heap, ptr is left out unless it ranks higher than the top.
+		if (k == 0 || key_compare(&ptr, &heap[0]) >= 0) {
+			free(ptr);
+			continue;
+		}
+		free(heap[0]);
+		
+		// Put ptr at the top, and move it down past the worse ones.
+		for (i = 0; 2 * i + 1 < size; ) {
+			int child = 2 * i + 1;
+			if (child + 1 < size && key_compare(&heap[child + 1], &heap[child]) > 0) {
+				child++;
+			}
+			if (key_compare(&heap[child], &ptr) <= 0) {
+				break;
+			}
+			heap[i] = heap[child];
+			i = child;
+		}
+		heap[i] = ptr;
+	}
+	
+	// Take the DocumentNodes out worst first, so the list ends up best first.
+	*list = NULL;
+	while (size > 0) {
+		DocumentNode *worst = heap[0];
+		DocumentNode *last = heap[--size];
+		int i;
+		for (i = 0; 2 * i + 1 < size; ) {
+			int child = 2 * i + 1;
+			if (child + 1 < size && key_compare(&heap[child + 1], &heap[child]) > 0) {
+				child++;
+			}
+			if (key_compare(&heap[child], &last) <= 0) {
+				break;
+			}
+			heap[i] = heap[child];
+			i = child;
+		}
+		heap[i] = last;
+		
+		worst->next = *list;
+		*list = worst;
+	}
+	free(heap);
+	
+	// Skip the first offset DocumentNodes.
+	for (int i = 0; i < offset && *list != NULL; i++) {
+		next = (*list)->next;
+		free(*list);
+		*list = next;
+	}
+	
+	return n;
+}
+
+
+/*
+ * key_compare - key compare function for ranking.
+ * @e1: element to compare.
+ * @e2: element to compare.
+ *
+ * Returns -1 if e1 ranks higher than e2, 1 if lower, 0 if they are the same DocumentNode.
+ *
+ * Pseudocode:
+ *     1. Get the frequency of the two passed DocumentNodes, or their score when
+ *        ranking with BM25.
+ *     2. Return appropriate comparison value. On a tie, the lower doc_id ranks higher,
+ *        so every page of results is the same whatever order the list was in.
+ */
+
+int key_compare(const void *e1, const void *e2) {
+
+	DocumentNode *ia = *(DocumentNode **)e1;
+	DocumentNode *ib = *(DocumentNode **)e2;
+	double f1 = ranker ? ia->score : ia->freq;
+	double f2 = ranker ? ib->score : ib->freq;
+
+	if (f1 > f2) {
+		return -1;
+	}
+	else if (f1 < f2) {
+		return 1;
+	}
+	else {
+		return (ia->doc_id > ib->doc_id) - (ia->doc_id < ib->doc_id);
+	}
+}
+
+
+/*
+ * Display - display query matches to output.
+ * @list: DocumentNodes of the matches, best first.
+ *
+ * Returns 1 if successful.
+ * Returns 0 if not.
+ *
+ * Pseudocode:
+ *     1. Get each DocumentNode of the list.
+ *     2. Look up its URL in the document table.
+ *     3. If the table does not have it, get filename, open a stream to that file,
+ *        and read in the URL address from stream.
+ *     4. Output doc_id and url to stdout.
  *     5. Cleanup memory and close stream.
  */
 
-int Display() {
+int Display(const DocumentNode *list) {
 	
-	DocumentNode *dn_ptr; // variable for traversal.
+	const DocumentNode *dn_ptr; // variable for traversal.
 	
 	// Loop through each DocumentNode of the query match.
-	for (dn_ptr = final_list; dn_ptr != NULL; dn_ptr = dn_ptr->next) {
+	for (dn_ptr = list; dn_ptr != NULL; dn_ptr = dn_ptr->next) {
 	
+		// The document table has the URL, so no file has to be opened.
+		const DocRecord *record = GetDocRecord(&doc_file, dn_ptr->doc_id);
+		if (record) {
+			if (ranker) {
+				printf("DOCUMENT ID: %d Rank: %.3f URL: %s\n", dn_ptr->doc_id, dn_ptr->score, DocURL(&doc_file, record));
+			}
+			else {
+				printf("DOCUMENT ID: %d Rank: %d URL: %s\n", dn_ptr->doc_id, dn_ptr->freq, DocURL(&doc_file, record));
+			}
+			continue;
+		}
+		
 		// Create and get the filename to read from.
 		char *filename;
 		filename = (char *)calloc(1, MAX);
@@ -643,18 +2066,23 @@ int Display() {
 		
 		// Read in the html address from the file.
 		char *line = (char *)calloc(1, MAX);
-		if (!fgets(line, MAX, fp)) {
+		if (!fp || !fgets(line, MAX, fp)) {
 			free(filename);
 			free(line);
-			free(fp);
+			if (fp) {
+				fclose(fp);
+			}
 			return 0;
 		}
 		line = realloc(line, strlen(line) + 1);
 		
 		// Write the doc_id and the url for each match.
-		printf("DOCUMENT ID: %d ", dn_ptr->doc_id);
-		printf("Rank: %d ", dn_ptr->freq);
-		printf("URL: %s", line);
+		if (ranker) {
+			printf("DOCUMENT ID: %d Rank: %.3f URL: %s", dn_ptr->doc_id, dn_ptr->score, line);
+		}
+		else {
+			printf("DOCUMENT ID: %d Rank: %d URL: %s", dn_ptr->doc_id, dn_ptr->freq, line);
+		}
 		
 		// Cleanup.
 		free(filename);
@@ -22,28 +22,35 @@
 #include <unistd.h>			     // sleep functionality
 #include <stdlib.h> 			     // memory functionality
 #include <math.h> 			     // math functionality
+#include <limits.h> 			     // INT_MAX
 
 // ---------------- Local includes  e.g., "file.h"
 #include "qhashtable.h" 		     // hashtable functionality
 #include "file.h" 			     // file functionality
 #include "qweb.h" 			     // web/html functionality
+#include "docfile.h" 			     // document table functionality
+#include "rank.h" 			     // BM25 ranking
+#include "phrase.h" 			     // phrase and proximity matching
+#include "parse.h" 			     // query parser
+#include "plan.h" 			     // query planning and list kernels
 #include "query.h"
 
 // ---------------- Constant definitions
-char *operator1 = "AND";
-char *operator2 = "OR";
 
 // ---------------- Macro definitions
 #define MAX 1000 // Max number of characters for a single query search.
-#define MATH_MAX(X, Y) (((X) > (Y)) ? (X) : (Y)) // Returns max of the two numbers passed.
+#define MAX_LISTS 64 // Max number of lists merged by Union.
 
 // ---------------- Structures/Types
 
 // ---------------- Private variables
-char *file; 								 // passed file path
-char *dir_path; 							 // passed directory path
-// DocumentNode *temp_list;					 // temp_list
-// DocumentNode *final_list;					 // final list
+extern char *dir_path; 						 // passed directory path, set by the caller
+extern DocFile doc_file; 					 // document table, set by the caller; zeroed if none
+extern Ranker *ranker; 						 // BM25 ranker, set by the caller; NULL to rank by frequency
+extern int top_k; 						 // documents wanted, set by the caller; 0 for all of them
+extern PairCache *pairs; 					 // documents shared by pairs of words, set by the caller; NULL for none
+DocumentNode *temp_list;					 // temp_list
+DocumentNode *final_list;					 // final list
 
 // ---------------- Private prototypes
 
@@ -56,135 +63,56 @@ char *dir_path; 							 // passed directory path
  * Returns 0 if not successful.
  *
  * Pseudocode:
- *     1. Read in each word of the query.
- *     2. Save all matched DocumentNodes in temp_list.
- *     2. If an AND is passed, or there is no logical operator between two words, intersection operation is done on temp_list.
- *     3. If an OR is passed, data in temp_list is flushed out to final_list using the union operation.
- *     4. Continue until end of line. 
+ *     1. Find the documents of the line into final_list (see FindDocuments).
  */
 
 int GetLinks(char *line, HashTable *Index) {
+	return FindDocuments(line, Index, pairs, &final_list);
+}
+
+
+/*
+ * FindDocuments - get all matched DocumentNodes for a given query into a list.
+ * @line: query line to be searched for.
+ * @Index: InvertedIndex containing all word-document pairs.
+ * @pair_cache: documents shared by pairs of words, NULL for none.
+ * @list: set to the DocumentNodes found, in doc_id order, NULL if none.
+ * 
+ * Returns 1 if successful.
+ * Returns 0 if not successful.
+ *
+ * Only the list and the caches passed are changed, so threads with their own Index and
+ * caches can find documents at the same time.
+ *
+ * Pseudocode:
+ *     1. Parse the query line into a tree of words, phrases, groups in parentheses and
+ *        AND, OR and NOT operators (see ParseQuery). Words with no operator between them
+ *        are AND'ed, and AND binds tighter than OR.
+ *     2. Look up its words, and order the operands of each AND from the cheapest one
+ *        (see PlanQuery). An AND with a word that is not in the InvertedIndex matches nothing,
+ *        and one of a pair of words kept in pair_cache starts from the documents they share.
+ *     3. Run the plan into the list, in doc_id order (see ExecutePlan). If only the top_k
+ *        documents are wanted, the list may get only those, unsorted.
+ */
+
+int FindDocuments(char *line, HashTable *Index, PairCache *pair_cache, DocumentNode **list) {
 	
-	// Declare variables.
-	char *buf;
-	char word[MAX];
-	int flag; // flag to do union or intersection operations.
-	int count; // variable to count the position of a word in the line.
-	
-	// Initialize variables.
-	buf = line;
-	flag = 1;
-	count = 0;
-	temp_list = NULL;
-	final_list = NULL;
-	
-	// Loop through the line and do the appropriate operations.
-	while (sscanf(buf, "%s", word) == 1) {
-		
-		count++;
-		
-		// If word is AND, then ignore and read in new word.
-		if (strcmp(word, operator1) == 0) {
-			if (count == 1) { // If there is no previous word, then throw an error.
-				return 0;
-			}
-			
-			// Increment position in line.
-			buf = strstr(buf, word) + strlen(word);
-			continue;
-		}
-		
-		// If word is OR, then tell the program to do OR operation.
-		if (strcmp(word, operator2) == 0) {
-			flag = 2; // Set flag to union operation.
-			if (count == 1) { // If there is no previous word, then throw an error.
-				return 0;
-			}
-		}
-		
-		// Hold onto original copy of word in case NormalizeWord() changes its content.
-		char *word_old = (char *)calloc(1, strlen(word) + 1);
-		strcpy(word_old, word);
-		
-		// Change word to lowercase.
-		if (strcmp(word, operator1) != 0 && strcmp(word, operator2) != 0) {
-			NormalizeWord(word); // Normalize if word is not an operator.
-		}
-		
-		// Add list of docs to temp_list.
-		// Case when it is the first word of the block.
-		if (count == 1) {
-			
-			// Declare variables.
-			WordNode *current; // variable for traversal.
-			DocumentNode *ptr, *ptr2; // variables for traversal.
-			int num;
-			
-			// Case when the word is in the InvertedIndex.
-			if ((num = InHashTable(word, Index))) {
-				unsigned long index = JenkinsHash(word, MAX_HASH_SLOT); // Get the hash code.
-				current = Index->table[index]->data;
-				
-				// Loop until we get the matching WordNode.
-				for (int i=1; i < num; i++) {
-					current = current->next;
-				}
-				
-				// Loop through each DocumentNode and add to temp_list.
-				for (ptr = current->page; ptr != NULL; ptr = ptr->next) {
-					
-					// Declare and initialize a DocumentNode with the same values as ptr.
-					DocumentNode *dn;
-					dn = (DocumentNode *)calloc(1, sizeof(DocumentNode));
-					dn->doc_id = ptr->doc_id;
-					dn->freq = ptr->freq;
-					
-					// Add the new DocumentNode to temp_list.
-					if (temp_list == NULL) { // Case when temp_list is empty.
-						temp_list = dn;
-						ptr2 = temp_list;
-					}
-					else { // Case when temp_list is nonempty.
-						ptr2->next = dn;
-						ptr2 = ptr2->next;
-					}
-				}
-			}
-		}
-		else { // If not first word of the block, then do the operation.
-		
-			// Check if the current operation is "AND".
-			if (flag == 1) {
-				And(word, Index);
-			}
-			
-			// Check if the current operation is "OR".
-			if (flag == 2) {
-				if (temp_list != NULL) {
-					Or();
-				}
-				flag = 1; // Set flag back to "AND" operation.
-				count = 0; // Set word count to 0 to signal the start of a new block of words.
-			}
-		}
-		
-		// Increment position in the query line to read in next word.
-		buf = strstr(buf, word_old) + strlen(word_old);
-		
-		free(word_old); // Cleanup.
-	}
+	Arena arena; // QueryNodes and PlanNodes of the query.
+	InitializeArena(&arena);
+	*list = NULL;
 	
-	// If the last word of the query line is an operator, throw an error.
-	if (strcmp(word, operator1) == 0 || strcmp(word, operator2) == 0) {
+	// Parse the query line.
+	QueryNode *query = ParseQuery(line, &arena);
+	if (query == NULL) {
+		FreeArena(&arena);
 		return 0;
-	
 	}
 	
-	// If nonempty, flush out temp_list to final_list.
-	if (temp_list != NULL) { 
-		Or();
-	}
+	// Plan it and run it.
+	PlanNode *plan = PlanQuery(query, Index, pair_cache, &arena);
+	*list = ExecutePlan(plan, ranker, top_k, Index);
 	
+	FreeArena(&arena); // Cleanup.
 	return 1; // Return 1 if successful.
 }	
 
@@ -195,83 +123,46 @@ int GetLinks(char *line, HashTable *Index) {
  * @Index: InvertedIndex containing all word-document pairs.
  * 
  * Pseudocode:
- *     1. Find the start of the list of matching DocumentNodes for the word.
- *     2. For each DocumentNode in temp_list, go through the new list looking for doc_id matches.
- *     2. If there is a match, keep that DocumentNode in temp_list and increment frequency.
- *     3. If there is no match, delete that DocumentNode from temp_list.
- *     4. Continue until end of temp_list.
+ *     1. Find the WordNode of the word. If it is not in the InvertedIndex, no document matches.
+ *     2. Intersect temp_list with its DocumentNodes (see IntersectWord).
  */
 
 void And(char *word, HashTable *Index) {
+	IntersectWord(FindWord(word, Index));
+}
 
-	unsigned long index = JenkinsHash(word, MAX_HASH_SLOT); // Get the hash code.
-	
-	// Declare variables for traversal.
-	WordNode *current;
-	DocumentNode *ptr, *ptr2, *runner, *no_need;
-	int num;
-	
-	// Get matching WordNode of word if it is in the InvertedIndex.
-	if ((num = InHashTable(word, Index))) {
-		current = Index->table[index]->data;
-		// Loop until we get the matching WordNode.
-		for (int i=1; i < num; i++) {
-			current = current->next;
-		}
-		ptr2 = current->page; // Set to start of the list of document nodes for the current word.
-	}
-	else {
-		ptr2 = NULL;
-	}
-	
-	// Initialize variables. 
-	ptr = temp_list;
-	
-	while (ptr != NULL) {
-	
-		// Check that the word is in the InvertedIndex.
-		if (num) {
-			ptr2 = current->page; // Set to start of the list of document nodes for the current word.
-			
-			// Loop until the end of the new list of matching DocumentNodes.
-			while (ptr2 != NULL) {
-				// Check for a match in doc_id.
-				if (ptr->doc_id == ptr2->doc_id) {
-					ptr->freq += ptr2->freq; // Add the frequencies.
-					break;
-				}
-				ptr2 = ptr2->next;
-			}
-			
-			// Case of no match.
-			if (ptr2 == NULL) {
-			
-				// Check if we need to delete the first node of temp_list.
-				if (ptr == temp_list) { 
-					temp_list = temp_list->next;
-				}
-				else { // All other cases.
-					runner->next = runner->next->next;
-				}
-				no_need = ptr;
-				ptr = ptr->next;
-				
-				// Free the node to be deleted.
-				no_need->next = NULL;
-				free(no_need);
-				no_need = NULL;
-				
-			}
-			else { // Case of match.
-				runner = ptr;
-				ptr = ptr->next;
-			}
-		}
-		else { // Word is not in the InvertedIndex.
-			ptr = NULL;
-			FreeList(0);
-		}
+
+/*
+ * StartList - Copy the DocumentNodes of a word into an empty temp_list.
+ * @current: WordNode of the word.
+ *
+ * Pseudocode:
+ *     1. Copy each DocumentNode, with its BM25 score when ranking with BM25 (see CopyPostings).
+ */
+
+void StartList(WordNode *current) {
+	temp_list = CopyPostings(current, ranker);
+}
+
+
+/*
+ * IntersectWord - Intersect temp_list with the DocumentNodes of a word.
+ * @current: WordNode of the word, NULL if it is not in the InvertedIndex.
+ *
+ * Pseudocode:
+ *     1. If there is no word, no document matches, so free temp_list.
+ *     2. Keep the DocumentNodes the word has, adding its frequency, and its score when
+ *        ranking with BM25 (see IntersectPostings).
+ */
+
+void IntersectWord(WordNode *current) {
+
+	// Word is not in the InvertedIndex.
+	if (current == NULL) {
+		FreeList(0);
+		return;
 	}
+	temp_list = IntersectPostings(temp_list, current, ranker);
 }
 
 
@@ -281,55 +172,37 @@ void And(char *word, HashTable *Index) {
  * Returns 0 and terminates.
  * 
  * Pseudocode:
- *     1. If final_list is NULL, set final_list to temp_list, temp_list to NULL, and return.
- *     2. For each DocumentNode in temp_list, go through final_list looking for doc_id matches.
- *     2. If there is a match, keep that DocumentNode in final_list and increment frequency.
- *     3. If there is no match, create a copy DocumentNode and add to end of final_list.
- *     4. Continue until end of temp_list.
+ *     1. Merge temp_list into final_list (see Union), and set temp_list to NULL.
  */
 
 int Or() {
+	Union(&temp_list, 1);
+	temp_list = NULL;
 
-	// Case of empty final_list, set final_list to temp_list.
-	if (final_list == NULL) {
-		final_list = temp_list;
-		temp_list = NULL;
-
-		return 0;
-	}
+	return 0;
+}
 
-	// Declare variables.
-	DocumentNode *ptr, *ptr2, *runner; // variables for traversal.
-	
-	// For each DocumentNode of temp_list, loop through all DocumentNodes of final_list.
-	for (ptr = temp_list; ptr != NULL; ptr = ptr->next) {
-		for (ptr2 = final_list; ptr2 != NULL; ptr2 = ptr2->next) {
-			
-			// Check for a match in doc_id.
-			if (ptr->doc_id == ptr2->doc_id) {
-				ptr2->freq = MATH_MAX(ptr->freq, ptr2->freq); // Set freq as the maximum of the two.
-				break;
-			}
-			if (ptr2->next == NULL) {
-				runner = ptr2; // variable for appending DocumentNode to final_list.
-			}
-		}
-		
-		// If there is no match in doc_id, then append a DocumentNode to final_list.
-		if (ptr2 == NULL) {
-			DocumentNode *dn = (DocumentNode *)calloc(1, sizeof(DocumentNode));
-			dn->doc_id = ptr->doc_id;
-			dn->freq = ptr->freq;
-			
-			runner->next = dn;
-		}
-	}
-	
-	// Cleanup.
-	FreeList(0);
 
-	return 0;
+/*
+ * Union - Merge lists of DocumentNodes into final_list.
+ * @lists: lists of DocumentNodes in doc_id order, each freed or moved into final_list.
+ * @num: number of lists, at most MAX_LISTS.
+ *
+ * final_list, also in doc_id order, is merged in as one more list. The frequency (and score)
+ * of a document is the highest of its lists, and the DocumentNode kept is the one of the
+ * earliest list, final_list first.
+ *
+ * Pseudocode:
+ *     1. Merge final_list and the lists with a min-heap by doc_id (see UnionLists). Each
+ *        DocumentNode costs log of the number of lists.
+ */
 
+void Union(DocumentNode **lists, int num) {
+	DocumentNode *all[MAX_LISTS + 1];
+	
+	all[0] = final_list;
+	memcpy(all + 1, lists, num * sizeof(DocumentNode *));
+	final_list = UnionLists(all, num + 1);
 }
 
 
@@ -337,68 +210,157 @@ int Or() {
  * Sort - Sort the list of DocumentNodes by rank, from highest to lowest.
  * 
  * Pseudocode:
- *     1. Put DocumentNodes into an array.
- *     2. Sort the array by rank.
- *     2. Refactor sorted array into list of DocumentNodes.
+ *     1. Keep every DocumentNode of final_list, ranked (see TopK).
  */
 
 void Sort() {
+	TopK(0, INT_MAX);
+}
 
-	DocumentNode *ptr; // variable for traversal.
-	int i=0;
+
+/*
+ * TopK - Keep a page of the best ranked DocumentNodes of final_list.
+ * @offset: number of best ranked DocumentNodes to skip.
+ * @limit: number of DocumentNodes to keep after those.
+ *
+ * Returns the number of DocumentNodes final_list had.
+ *
+ * Pseudocode:
+ *     1. Rank final_list (see RankDocuments).
+ */
+
+int TopK(int offset, int limit) {
+	return RankDocuments(&final_list, offset, limit);
+}
+
+
+/*
+ * RankDocuments - Keep a page of the best ranked DocumentNodes of a list.
+ * @list: list of DocumentNodes, in any order.
+ * @offset: number of best ranked DocumentNodes to skip.
+ * @limit: number of DocumentNodes to keep after those.
+ *
+ * Returns the number of DocumentNodes the list had.
+ *
+ * The list is left with the DocumentNodes ranked offset + 1 to offset + limit, from
+ * highest to lowest rank, and the others are freed. Only offset + limit DocumentNodes
+ * are held at a time, so ranking n of them costs n log (offset + limit).
+ *
+ * Pseudocode:
+ *     1. Put DocumentNodes into a min-heap by rank, whose top is the worst one kept,
+ *        until it has offset + limit of them.
+ *     2. For each other DocumentNode, if it ranks higher than the top, replace the top
+ *        with it. Free the one left out.
+ *     3. Take the DocumentNodes out of the heap, worst first, onto the front of the list.
+ *     4. Free the first offset DocumentNodes of the list.
+ */
+
+int RankDocuments(DocumentNode **list, int offset, int limit) {
+
+	DocumentNode *ptr, *next; // variables for traversal.
+	int n = 0;
 	
 	// Loop through the list to get its size.
-	for (ptr = final_list; ptr != NULL; ptr = ptr->next) {
-		i++;
+	for (ptr = *list; ptr != NULL; ptr = ptr->next) {
+		n++;
 	}
-	
-	// Declare and initialize an array of DocumentNode*.
-	DocumentNode *arr[i];
-	memset(arr, 0, i);
-	
-	i=0;
-	
-	// Loop through the list and add DocumentNode* to array.
-	for (ptr = final_list; ptr != NULL; ptr = ptr->next) {
-		arr[i] = ptr;
-		i++;
+	int k = ((long)offset + limit < n) ? offset + limit : n;
+	DocumentNode **heap = (DocumentNode **)malloc((k ? k : 1) * sizeof(DocumentNode *));
+	if (!heap) { // Without memory, leave the list as it is.
+		return n;
 	}
-
-	qsort((void *)arr, i, sizeof(DocumentNode *), key_compare); // Sort array by rank.
+	int size = 0;
 	
-	// Recreate the list of DocumentNodes from the sorted array.
-	for (int j = 0; j < i; j++) {
-		if (j == 0) {
-			final_list = arr[j];
-			ptr = final_list;
+	for (ptr = *list; ptr != NULL; ptr = next) {
+		next = ptr->next;
+		int i;
+		
+		// Case of a heap that is not full, add ptr and move it up past the better ones.
+		if (size < k) {
+			for (i = size++; i > 0 && key_compare(&ptr, &heap[(i - 1) / 2]) > 0; i = (i - 1) / 2) {
+				heap[i] = heap[(i - 1) / 2];
+			}
+			heap[i] = ptr;
+			continue;
 		}
-		else {
-			ptr->next = arr[j];
-			ptr = ptr->next;
+		
+		// Case of a full heap, ptr is left out unless it ranks higher than the top.
+		if (k == 0 || key_compare(&ptr, &heap[0]) >= 0) {
+			free(ptr);
+			continue;
 		}
+		free(heap[0]);
+		
+		// Put ptr at the top, and move it down past the worse ones.
+		for (i = 0; 2 * i + 1 < size; ) {
+			int child = 2 * i + 1;
+			if (child + 1 < size && key_compare(&heap[child + 1], &heap[child]) > 0) {
+				child++;
+			}
+			if (key_compare(&heap[child], &ptr) <= 0) {
+				break;
+			}
+			heap[i] = heap[child];
+			i = child;
+		}
+		heap[i] = ptr;
+	}
+	
+	// Take the DocumentNodes out worst first, so the list ends up best first.
+	*list = NULL;
+	while (size > 0) {
+		DocumentNode *worst = heap[0];
+		DocumentNode *last = heap[--size];
+		int i;
+		for (i = 0; 2 * i + 1 < size; ) {
+			int child = 2 * i + 1;
+			if (child + 1 < size && key_compare(&heap[child + 1], &heap[child]) > 0) {
+				child++;
+			}
+			if (key_compare(&heap[child], &last) <= 0) {
+				break;
+			}
+			heap[i] = heap[child];
+			i = child;
+		}
+		heap[i] = last;
+		
+		worst->next = *list;
+		*list = worst;
 	}
-	ptr->next = NULL;
+	free(heap);
+	
+	// Skip the first offset DocumentNodes.
+	for (int i = 0; i < offset && *list != NULL; i++) {
+		next = (*list)->next;
+		free(*list);
+		*list = next;
+	}
+	
+	return n;
 }
 
 
 /*
- * key_compare - key compare function for qsort.
+ * key_compare - key compare function for ranking.
  * @e1: element to compare.
  * @e2: element to compare.
  *
- * Returns -1 if e1>e2, 1 if e1<e2, 0 if e1==e2.
+ * Returns -1 if e1 ranks higher than e2, 1 if lower, 0 if they are the same DocumentNode.
  *
  * Pseudocode:
- *     1. Get the frequency of the two passed DocumentNodes.
- *     2. Return appropriate comparison value.
+ *     1. Get the frequency of the two passed DocumentNodes, or their score when
+ *        ranking with BM25.
+ *     2. Return appropriate comparison value. On a tie, the lower doc_id ranks higher,
+ *        so every page of results is the same whatever order final_list was in.
  */
 
 int key_compare(const void *e1, const void *e2) {
 
 	DocumentNode *ia = *(DocumentNode **)e1;
 	DocumentNode *ib = *(DocumentNode **)e2;
-	int f1 = ia->freq;
-	int f2 = ib->freq;
+	double f1 = ranker ? ia->score : ia->freq;
+	double f2 = ranker ? ib->score : ib->freq;
 
 	if (f1 > f2) {
 		return -1;
@@ -407,7 +369,7 @@ int key_compare(const void *e1, const void *e2) {
 		return 1;
 	}
 	else {
-		return 0;
+		return (ia->doc_id > ib->doc_id) - (ia->doc_id < ib->doc_id);
 	}
 }
 
@@ -463,8 +425,9 @@ int FreeList(int choice) {
  *
  * Pseudocode:
  *     1. Get each DocumentNode of final_list.
- *     2. Get filename and open a stream to that file.
- *     3. Read in the URL address from stream.
+ *     2. Look up its URL in the document table.
+ *     3. If the table does not have it, get filename, open a stream to that file,
+ *        and read in the URL address from stream.
  *     4. Output doc_id and url to stdout.
  *     5. Cleanup memory and close stream.
  */
@@ -476,6 +439,14 @@ int Display() {
 	// Loop through each DocumentNode of the query match.
 	for (dn_ptr = final_list; dn_ptr != NULL; dn_ptr = dn_ptr->next) {
 	
+		// The document table has the URL, so no file has to be opened.
+		const DocRecord *record = GetDocRecord(&doc_file, dn_ptr->doc_id);
+		if (record) {
+			printf("DOCUMENT ID: %d ", dn_ptr->doc_id);
+			printf("URL: %s\n", DocURL(&doc_file, record));
+			continue;
+		}
+		
 		// Create and get the filename to read from.
 		char *filename;
 		filename = (char *)calloc(1, MAX);
@@ -488,10 +459,12 @@ int Display() {
 		
 		// Read in the html address from the file.
 		char *line = (char *)calloc(1, MAX);
-		if (!fgets(line, MAX, fp)) {
+		if (!fp || !fgets(line, MAX, fp)) {
 			free(filename);
 			free(line);
-			free(fp);
+			if (fp) {
+				fclose(fp);
+			}
 			return 0;
 		}
 		line = realloc(line, strlen(line) + 1);
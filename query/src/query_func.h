@@ -18,14 +18,20 @@
 // ---------------- Structures/Types
 
 // ---------------- Public Variables
-DocumentNode *temp_list;					 // temp_list
-DocumentNode *final_list;					 // final list
+extern DocumentNode *temp_list;			 // temp_list
+extern DocumentNode *final_list;			 // final list
 
 // ---------------- Prototypes/Macros
 int GetLinks(char *, HashTable *);
+int FindDocuments(char *, HashTable *, PairCache *, DocumentNode **);
 void And(char *, HashTable *);
+void StartList(WordNode *);
+void IntersectWord(WordNode *);
 int Or();
+void Union(DocumentNode **, int);
 void Sort();
+int TopK(int, int);
+int RankDocuments(DocumentNode **, int, int);
 int key_compare(const void *, const void *);
 int FreeList(int);
 int Display();
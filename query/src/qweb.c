@@ -22,6 +22,7 @@
 
 // ---------------- Local includes  e.g., "file.h"
 #include "qweb.h"                             // web functionality
+#include "indexfile.h"                        // MAX_TERM_LENGTH
 
 // ---------------- Constant definitions
 
@@ -118,9 +119,12 @@ int GetNextWord(const char* doc, int pos, char **word)
  *
  * Pseudocode:
  *     1. scan each letter of word, try to lowercase it
+ *     2. cut the word after MAX_TERM_LENGTH letters, the longest word an index holds
  */
 void NormalizeWord(char *word)
 {
-    for(char *ptr = word; *ptr; ++ptr)
+    char *ptr = word;
+    for(; *ptr && ptr - word < MAX_TERM_LENGTH; ++ptr)
         *ptr = tolower(*ptr);
+    *ptr = '\0';
 }
@@ -0,0 +1,123 @@
+/* ========================================================================== */
+/* File: rank.c
+ *
+ * Project name: CS50 Tiny Search Engine
+ * Component name: Query
+ *
+ * This file includes the BM25 ranking of query results.
+ * Please go to the top of each function for more detailed descriptions.
+ */
+/* ========================================================================== */
+
+// ---------------- Open Issues
+
+// ---------------- System includes e.g., <stdio.h>
+#include <stdlib.h>                          // malloc, free
+#include <string.h>                          // memset, strcmp
+#include <math.h>                            // log
+#include <limits.h>                          // INT_MAX
+
+// ---------------- Local includes  e.g., "file.h"
+#include "rank.h"                            // ranking functionality
+
+// ---------------- Constant definitions
+
+// ---------------- Macro definitions
+
+// ---------------- Structures/Types
+
+// ---------------- Private variables
+
+// ---------------- Private prototypes
+
+
+/*
+ * InitializeRanker - work out the norm of every document of a document table.
+ * @ranker: ranker to fill in.
+ * @docs: open document table.
+ *
+ * Returns 1 if successful, 0 if not.
+ *
+ * Pseudocode:
+ *     1. Get the average length from the total length and the number of documents.
+ *     2. Allocate a norm for every doc_id up to the largest one.
+ *     3. Work out the norm of every document from its length. A doc_id with
+ *        no document gets the norm of the average length.
+ */
+
+int InitializeRanker(Ranker *ranker, const DocFile *docs) {
+
+	if (!docs->header) {
+		memset(ranker, 0, sizeof(Ranker));
+		return 0;
+	}
+	return InitializeShardRanker(ranker, docs, docs->header->num_docs, docs->header->total_length);
+}
+
+
+/*
+ * InitializeShardRanker - work out the norm of every document of a shard with the statistics of the collection.
+ * @ranker: ranker to fill in.
+ * @docs: open document table of the shard.
+ * @num_docs: number of documents of every shard.
+ * @total_length: number of words of every shard.
+ *
+ * Returns 1 if successful, 0 if not.
+ *
+ * Pseudocode:
+ *     1. Get the average length from the total length and the number of documents
+ *        of the collection.
+ *     2. Allocate a norm for every doc_id of the shard up to the largest one.
+ *     3. Work out the norm of every document from its length. A doc_id with
+ *        no document gets the norm of the average length.
+ */
+
+int InitializeShardRanker(Ranker *ranker, const DocFile *docs, long num_docs, double total_length) {
+
+	memset(ranker, 0, sizeof(Ranker));
+	if (!docs->header || num_docs <= 0 || num_docs > INT_MAX || total_length <= 0) {
+		return 0;
+	}
+
+	ranker->max_doc_id = docs->header->max_doc_id;
+	ranker->num_docs = (int)num_docs;
+	ranker->avg_length = total_length / num_docs;
+
+	ranker->norms = (float *)malloc(((size_t)ranker->max_doc_id + 1) * sizeof(float));
+	if (!ranker->norms) {
+		return 0;
+	}
+	for (uint32_t doc_id = 0; doc_id <= ranker->max_doc_id; doc_id++) {
+		const DocRecord *record = &docs->records[doc_id];
+		double length = record->url != NO_URL ? record->length : ranker->avg_length;
+		ranker->norms[doc_id] = BM25_K1 * (1 - BM25_B + BM25_B * length / ranker->avg_length);
+	}
+	return 1;
+}
+
+
+void FreeRanker(Ranker *ranker) {
+	free(ranker->norms);
+	memset(ranker, 0, sizeof(Ranker));
+}
+
+
+double TermWeight(const Ranker *ranker, int df) {
+	return log(1 + (ranker->num_docs - df + 0.5) / (df + 0.5));
+}
+
+
+double WordWeight(const Ranker *ranker, const char *word, int df) {
+	for (int i=0; i < ranker->num_words; i++) {
+		if (strcmp(ranker->words[i], word) == 0) {
+			return TermWeight(ranker, ranker->dfs[i]);
+		}
+	}
+	return TermWeight(ranker, df);
+}
+
+
+float TermScore(const Ranker *ranker, double idf, int doc_id, int freq) {
+	double norm = doc_id >= 0 && (uint32_t)doc_id <= ranker->max_doc_id ? ranker->norms[doc_id] : BM25_K1;
+	return idf * freq * (BM25_K1 + 1) / (freq + norm);
+}
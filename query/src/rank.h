@@ -0,0 +1,108 @@
+/* ========================================================================== */
+/* File: rank.h
+ *
+ * Project name: CS50 Tiny Search Engine
+ * Component name: Query
+ *
+ * This file contains the BM25 ranking of query results. The document lengths
+ * and the collection statistics come from the document table (see docfile.h);
+ * the document frequency of a word is the length of its posting list.
+ *
+ *     score(doc) = sum over the words of idf * tf * (k1 + 1) / (tf + norm[doc])
+ *     idf        = log(1 + (N - df + 0.5) / (df + 0.5))
+ *     norm[doc]  = k1 * (1 - b + b * length(doc) / average length)
+ *
+ * norm only depends on the document, so it is worked out once for every
+ * doc_id when the ranker is made. Scoring a posting is then one lookup in a
+ * float array, which stays in the cache.
+ *
+ * A shard of a sharded index (see "indexer -s") only has some of the
+ * documents, so the ranker of a shard is made with the N and the average
+ * length of the whole collection, and given the df of the words of each query
+ * over every shard. Each shard then scores its documents as one index of the
+ * whole collection would.
+ *
+ */
+/* ========================================================================== */
+#ifndef RANK_H
+#define RANK_H
+
+// ---------------- Prerequisites e.g., Requires "math.h"
+#include <stdint.h>                         // fixed-width integers
+#include "docfile.h"                        // DocFile
+
+// ---------------- Constants
+#define BM25_K1 1.2                         // saturation of the term frequency
+#define BM25_B 0.75                         // weight of the document length
+
+// ---------------- Structures/Types
+
+typedef struct Ranker {
+  float *norms;                             // norm of every doc_id, from 0 to max_doc_id
+  uint32_t max_doc_id;                      // largest doc_id of the document table
+  int num_docs;                             // number of documents, N
+  double avg_length;                        // average number of words in a document
+  char **words;                             // words whose df is given, eg over every shard; NULL for none
+  int *dfs;                                 // df of each of the words
+  int num_words;                            // number of words
+} Ranker;
+
+// ---------------- Public Variables
+
+// ---------------- Prototypes/Macros
+
+/*
+ * InitializeRanker - work out the norm of every document of a document table
+ * @ranker: ranker to fill in
+ * @docs: open document table
+ *
+ * Returns 1 if successful; 0 if the table is not open, is empty or memory
+ * cannot be allocated. Free it with FreeRanker.
+ *
+ * Usage example:
+ * Ranker ranker;
+ * if (InitializeRanker(&ranker, &docs)) {
+ *     double idf = TermWeight(&ranker, df);
+ *     for (DocumentNode *dn = wn->page; dn; dn = dn->next) {
+ *         dn->score = TermScore(&ranker, idf, dn->doc_id, dn->freq);
+ *     }
+ *     FreeRanker(&ranker);
+ * }
+ */
+int InitializeRanker(Ranker *ranker, const DocFile *docs);
+
+/*
+ * InitializeShardRanker - work out the norm of every document of a shard with the statistics of the collection
+ * @ranker: ranker to fill in
+ * @docs: open document table of the shard
+ * @num_docs: number of documents of every shard, N
+ * @total_length: number of words of every shard
+ *
+ * Returns 1 if successful; 0 if the table is not open, the collection is
+ * empty or memory cannot be allocated. Free it with FreeRanker.
+ */
+int InitializeShardRanker(Ranker *ranker, const DocFile *docs, long num_docs, double total_length);
+
+void FreeRanker(Ranker *ranker);
+
+/*
+ * TermWeight - idf of a word found in df documents
+ */
+double TermWeight(const Ranker *ranker, int df);
+
+/*
+ * WordWeight - idf of a word found in df documents of the index
+ *
+ * The df given to the ranker for the word is used instead, if there is one.
+ */
+double WordWeight(const Ranker *ranker, const char *word, int df);
+
+/*
+ * TermScore - BM25 score of a word found freq times in a document
+ * @idf: TermWeight of the word
+ *
+ * A doc_id the document table does not have gets the average length.
+ */
+float TermScore(const Ranker *ranker, double idf, int doc_id, int freq);
+
+#endif // RANK_H
@@ -0,0 +1,530 @@
+/* ========================================================================== */
+/* File: shards.c
+ *
+ * Project name: CS50 Tiny Search Engine
+ * Component name: Query
+ *
+ * This file includes the scatter-gather of queries over the shards of a sharded index.
+ * Please go to the top of each function for more detailed descriptions.
+ */
+/* ========================================================================== */
+
+// ---------------- Open Issues
+#define _POSIX_C_SOURCE 200809L              // getline, fdopen, strndup, open_memstream, MSG_NOSIGNAL
+
+// ---------------- System includes e.g., <stdio.h>
+#include <stdio.h>                           // fdopen, getline, open_memstream
+#include <stdlib.h>                          // calloc, free, strtol, strtod, strtof
+#include <string.h>                          // strchr, strcmp, strndup, memset
+#include <limits.h>                          // INT_MAX, LONG_MAX
+#include <errno.h>                           // errno
+#include <unistd.h>                          // close
+#include <sys/socket.h>                      // socket functionality
+#include <sys/un.h>                          // Unix sockets
+#include <netinet/in.h>                      // TCP sockets
+#include <arpa/inet.h>                       // htons, htonl
+
+// ---------------- Local includes  e.g., "file.h"
+#include "shards.h"                          // shard functionality
+#include "plan.h"                            // FreeDocuments
+
+// ---------------- Constant definitions
+
+// ---------------- Macro definitions
+
+// ---------------- Structures/Types
+
+// ---------------- Private variables
+
+// ---------------- Private prototypes
+static int ConnectShard(Shard *);
+static int SendShards(ShardSet *, const char *, size_t);
+static int ReadReply(Shard *);
+static int GatherStats(ShardSet *, ShardStats *);
+static DocumentNode *GatherResults(Shard *, int, int *);
+static int RanksHigher(const DocumentNode *, const DocumentNode *, int);
+
+
+/*
+ * ConnectShards - connect to the shards of a sharded index.
+ * @set: ShardSet to fill in.
+ * @addresses: addresses of the shards, separated by commas.
+ * @bm25: 1 to rank with BM25.
+ *
+ * Returns 1 if successful, 0 if not.
+ *
+ * Pseudocode:
+ *     1. Connect to each address, in order.
+ *     2. Ask every shard how it ranks (#rank), and check that it is the way bm25 asks,
+ *        as a shard only scores with BM25 if it was started with -b.
+ */
+
+int ConnectShards(ShardSet *set, const char *addresses, int bm25) {
+
+	memset(set, 0, sizeof(ShardSet));
+	set->bm25 = bm25;
+
+	// Connect to each address.
+	int ok = 1;
+	const char *start = addresses;
+	while (ok) {
+		const char *end = strchr(start, ',');
+		size_t length = end ? (size_t)(end - start) : strlen(start);
+		if (length == 0 || set->num_shards == MAX_SHARDS) {
+			return 0;
+		}
+		Shard *shard = &set->shards[set->num_shards++];
+		shard->fd = -1;
+		shard->address = strndup(start, length);
+		ok = shard->address && ConnectShard(shard);
+		if (end == NULL) {
+			break;
+		}
+		start = end + 1;
+	}
+
+	// Check how every shard ranks.
+	ok = ok && SendShards(set, "#rank\n", 6);
+	for (int i=0; i < set->num_shards && ok; i++) {
+		Shard *shard = &set->shards[i];
+		ok = ReadReply(shard) > 0 && strcmp(shard->reply, bm25 ? "bm25" : "frequency") == 0 && ReadReply(shard) == 0;
+	}
+	return ok;
+}
+
+
+/*
+ * CloseShards - close the connections of a ShardSet.
+ */
+
+void CloseShards(ShardSet *set) {
+	for (int i=0; i < set->num_shards; i++) {
+		Shard *shard = &set->shards[i];
+		if (shard->in) {
+			fclose(shard->in); // Closes fd too.
+		}
+		else if (shard->fd != -1) {
+			close(shard->fd);
+		}
+		free(shard->address);
+		free(shard->reply);
+	}
+	memset(set, 0, sizeof(ShardSet));
+}
+
+
+/*
+ * SearchShards - get the ranked results of a query line from every shard.
+ * @set: connected ShardSet.
+ * @line: query line, checked with CheckLine.
+ * @offset: number of best results to skip (--offset).
+ * @limit: number of results to keep after those (--top), 0 for all of them.
+ * @list: set to the results, best first, NULL if none.
+ *
+ * Returns 1 if successful, 0 if the line is not a valid query, -1 if a shard cannot be reached.
+ *
+ * Pseudocode:
+ *     1. With BM25, send #stats to every shard, then add up their N, their total lengths
+ *        and the df of each word (see GatherStats).
+ *     2. Send #search to every shard, with those statistics, asking for the offset + limit
+ *        best results of each.
+ *     3. Read the results of every shard, and merge them (see MergeShardResults).
+ *
+ * Every reply is read, even after a shard found the line not valid, so the next
+ * replies of each shard are read for the right request.
+ */
+
+int SearchShards(ShardSet *set, const char *line, int offset, int limit, DocumentNode **list) {
+
+	int k = (limit > 0 && limit < INT_MAX - offset) ? offset + limit : 0;
+	int length = (int)strcspn(line, "\n");
+	ShardStats stats;
+	memset(&stats, 0, sizeof(ShardStats));
+	int status = 1;
+	*list = NULL;
+
+	// Add up the statistics of every shard.
+	char *request = NULL;
+	size_t size = 0;
+	if (set->bm25) {
+		FILE *out = open_memstream(&request, &size);
+		if (out == NULL) {
+			return 0;
+		}
+		fprintf(out, "#stats\t%.*s\n", length, line);
+		fclose(out);
+		status = SendShards(set, request, size) ? GatherStats(set, &stats) : -1;
+		free(request);
+		request = NULL;
+	}
+
+	// Ask every shard for its best results.
+	FILE *out = (status == 1) ? open_memstream(&request, &size) : NULL;
+	if (out) {
+		fprintf(out, "#search %d", k);
+		if (set->bm25) {
+			fprintf(out, " %ld %.0f", stats.num_docs, stats.total_length);
+			for (int i=0; i < stats.num_words; i++) {
+				fprintf(out, " %s=%d", stats.words[i], stats.dfs[i]);
+			}
+		}
+		fprintf(out, "\t%.*s\n", length, line);
+		fclose(out);
+	}
+	int sent = 0;
+	if (status == 1) {
+		status = (out == NULL || size >= SHARD_LINE) ? 0 : (sent = SendShards(set, request, size)) ? 1 : -1;
+	}
+
+	// Merge their results.
+	DocumentNode *lists[MAX_SHARDS] = {NULL};
+	for (int i=0; i < set->num_shards && sent && status != -1; i++) {
+		lists[i] = GatherResults(&set->shards[i], set->bm25, &status);
+	}
+	if (status == 1) {
+		*list = MergeShardResults(lists, set->num_shards, set->bm25, offset, limit);
+	}
+	else {
+		for (int i=0; i < set->num_shards; i++) {
+			FreeDocuments(lists[i]);
+		}
+	}
+
+	// Cleanup.
+	free(request);
+	for (int i=0; i < stats.num_words; i++) {
+		free(stats.words[i]);
+	}
+	return status;
+}
+
+
+/*
+ * ReadShardSearch - read a #search request.
+ * @request: the request, cut up in place.
+ * @k: set to the number of results asked for.
+ * @stats: set to the statistics sent, num_docs 0 if there are none.
+ * @line: set to the query line.
+ *
+ * Returns 1 if successful, 0 if not.
+ *
+ * Pseudocode:
+ *     1. Cut the request at its first tab: the query line comes after it.
+ *     2. Read K, then N and the total length if they are there, then a WORD=DF for
+ *        each word.
+ */
+
+int ReadShardSearch(char *request, int *k, ShardStats *stats, char **line) {
+
+	memset(stats, 0, sizeof(ShardStats));
+	char *tab = strchr(request, '\t');
+	if (strncmp(request, "#search ", 8) != 0 || tab == NULL) {
+		return 0;
+	}
+	*tab = '\0';
+	*line = tab + 1;
+
+	char *save, *end;
+	char *token = strtok_r(request + 8, " ", &save);
+	long number = token ? strtol(token, &end, 10) : -1;
+	if (number < 0 || number > INT_MAX || *end != '\0') {
+		return 0;
+	}
+	*k = (int)number;
+
+	// Case of ranking by frequency.
+	if ((token = strtok_r(NULL, " ", &save)) == NULL) {
+		return 1;
+	}
+
+	// Case of BM25, with the statistics of every shard.
+	stats->num_docs = strtol(token, &end, 10);
+	token = (*end == '\0') ? strtok_r(NULL, " ", &save) : NULL;
+	stats->total_length = token ? strtod(token, &end) : 0;
+	if (stats->num_docs <= 0 || stats->total_length <= 0 || *end != '\0') {
+		return 0;
+	}
+	while ((token = strtok_r(NULL, " ", &save)) != NULL) {
+		char *equals = strchr(token, '=');
+		if (equals == NULL || stats->num_words == MAX_SHARD_WORDS) {
+			return 0;
+		}
+		*equals = '\0';
+		number = strtol(equals + 1, &end, 10);
+		if (number < 0 || number > INT_MAX || *end != '\0') {
+			return 0;
+		}
+		stats->words[stats->num_words] = token;
+		stats->dfs[stats->num_words++] = (int)number;
+	}
+	return 1;
+}
+
+
+/*
+ * MergeShardResults - merge the ranked results of the shards.
+ * @lists: results of each shard, best first, taken over.
+ * @num: number of lists.
+ * @by_score: 1 to rank by score, 0 by frequency.
+ * @offset: number of best results to skip.
+ * @limit: number of results to keep after those, 0 for all of them.
+ *
+ * Returns the results kept, best first.
+ *
+ * Pseudocode:
+ *     1. Take the best of the first results of the lists, offset + limit times. There
+ *        are few shards, so they are compared one by one.
+ *     2. Free the first offset results taken, and what is left of the lists.
+ */
+
+DocumentNode *MergeShardResults(DocumentNode **lists, int num, int by_score, int offset, int limit) {
+
+	DocumentNode *merged = NULL, *tail = NULL;
+	long wanted = (limit > 0) ? (long)offset + limit : LONG_MAX;
+
+	for (long rank = 0; rank < wanted; rank++) {
+		int best = -1;
+		for (int i=0; i < num; i++) {
+			if (lists[i] != NULL && (best == -1 || RanksHigher(lists[i], lists[best], by_score))) {
+				best = i;
+			}
+		}
+		if (best == -1) {
+			break;
+		}
+		DocumentNode *dn = lists[best];
+		lists[best] = dn->next;
+		dn->next = NULL;
+
+		// Case of a result before the page asked for.
+		if (rank < offset) {
+			free(dn);
+			continue;
+		}
+		if (tail == NULL) {
+			merged = dn;
+		}
+		else {
+			tail->next = dn;
+		}
+		tail = dn;
+	}
+
+	// Cleanup.
+	for (int i=0; i < num; i++) {
+		FreeDocuments(lists[i]);
+		lists[i] = NULL;
+	}
+	return merged;
+}
+
+
+/*
+ * ConnectShard - connect to the "query --serve" of a shard.
+ * @shard: Shard with its address.
+ *
+ * Returns 1 if successful, 0 if not.
+ */
+
+static int ConnectShard(Shard *shard) {
+
+	const char *address = shard->address;
+	int fd;
+	if (strspn(address, "0123456789") == strlen(address)) {
+		long port = strtol(address, NULL, 10);
+		struct sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons((unsigned short)port);
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		if (port < 1 || port > 65535 || (fd = socket(AF_INET, SOCK_STREAM, 0)) == -1) {
+			return 0;
+		}
+		if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+			close(fd);
+			return 0;
+		}
+	}
+	else {
+		struct sockaddr_un addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		if (strlen(address) >= sizeof(addr.sun_path) || (fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
+			return 0;
+		}
+		strcpy(addr.sun_path, address);
+		if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+			close(fd);
+			return 0;
+		}
+	}
+
+	shard->fd = fd;
+	shard->in = fdopen(fd, "r");
+	return shard->in != NULL;
+}
+
+
+/*
+ * SendShards - send the same request to every shard.
+ *
+ * Returns 1 if successful, 0 if a shard cannot be reached. A shard that went away
+ * does not raise SIGPIPE.
+ */
+
+static int SendShards(ShardSet *set, const char *request, size_t size) {
+	for (int i=0; i < set->num_shards; i++) {
+		size_t sent = 0;
+		while (sent < size) {
+			ssize_t n = send(set->shards[i].fd, request + sent, size - sent, MSG_NOSIGNAL);
+			if (n == -1 && errno != EINTR) {
+				return 0;
+			}
+			sent += (n > 0) ? n : 0;
+		}
+	}
+	return 1;
+}
+
+
+/*
+ * ReadReply - read the next line of the replies of a shard into its reply buffer.
+ *
+ * Returns the length of the line, without its newline; -1 if the shard went away.
+ */
+
+static int ReadReply(Shard *shard) {
+	ssize_t n = getline(&shard->reply, &shard->reply_size, shard->in);
+	if (n <= 0 || shard->reply[n - 1] != '\n') {
+		return -1;
+	}
+	shard->reply[--n] = '\0';
+	return (int)n;
+}
+
+
+/*
+ * GatherStats - add up the replies of every shard to #stats.
+ * @set: ShardSet sent #stats.
+ * @stats: statistics to add to, empty; its words are allocated.
+ *
+ * Returns 1 if successful, 0 if a shard found the line not valid, -1 if a shard
+ * cannot be reached or sent something else.
+ */
+
+static int GatherStats(ShardSet *set, ShardStats *stats) {
+
+	int status = 1;
+	int seen[MAX_SHARD_WORDS]; // last shard that sent each word, as a word is sent once per time it is in the line.
+	for (int i=0; i < set->num_shards; i++) {
+		Shard *shard = &set->shards[i];
+
+		// The documents and words of the shard.
+		long num_docs;
+		double total_length;
+		if (ReadReply(shard) < 0) {
+			return -1;
+		}
+		else if (strcmp(shard->reply, "invalid") == 0) {
+			status = 0;
+		}
+		else if (sscanf(shard->reply, "%ld\t%lf", &num_docs, &total_length) == 2) {
+			stats->num_docs += num_docs;
+			stats->total_length += total_length;
+		}
+		else {
+			return -1;
+		}
+
+		// The df of each word, added to that of the other shards.
+		int n;
+		while ((n = ReadReply(shard)) > 0) {
+			char *tab = strchr(shard->reply, '\t');
+			if (tab == NULL) {
+				return -1;
+			}
+			*tab = '\0';
+			int w = 0;
+			while (w < stats->num_words && strcmp(stats->words[w], shard->reply) != 0) {
+				w++;
+			}
+			if (w == stats->num_words) {
+				if (w == MAX_SHARD_WORDS || (stats->words[w] = strdup(shard->reply)) == NULL) {
+					status = (status == 1) ? 0 : status;
+					continue;
+				}
+				stats->num_words++;
+			}
+			else if (seen[w] == i) {
+				continue;
+			}
+			seen[w] = i;
+			stats->dfs[w] += atoi(tab + 1);
+		}
+		if (n < 0) {
+			return -1;
+		}
+	}
+	return status;
+}
+
+
+/*
+ * GatherResults - read the reply of a shard to #search.
+ * @shard: Shard sent #search.
+ * @by_score: 1 if the ranks are scores, 0 if frequencies.
+ * @status: set to 0 if the shard found the line not valid, -1 if it cannot be reached
+ *          or sent something else; left alone if not.
+ *
+ * Returns the results, best first, NULL if none.
+ */
+
+static DocumentNode *GatherResults(Shard *shard, int by_score, int *status) {
+
+	DocumentNode *list = NULL, *tail = NULL;
+	int n;
+	while ((n = ReadReply(shard)) > 0) {
+		if (strcmp(shard->reply, "invalid") == 0) {
+			*status = (*status == 1) ? 0 : *status;
+			continue;
+		}
+		char *tab = strchr(shard->reply, '\t');
+		DocumentNode *dn = tab ? (DocumentNode *)calloc(1, sizeof(DocumentNode)) : NULL;
+		if (dn == NULL) {
+			*status = -1;
+			break;
+		}
+		dn->doc_id = atoi(shard->reply);
+		if (by_score) {
+			dn->score = strtof(tab + 1, NULL);
+		}
+		else {
+			dn->freq = atoi(tab + 1);
+		}
+		if (tail == NULL) {
+			list = dn;
+		}
+		else {
+			tail->next = dn;
+		}
+		tail = dn;
+	}
+	if (n < 0) {
+		*status = -1;
+	}
+	return list;
+}
+
+
+/*
+ * RanksHigher - check if a result ranks higher than another, as RankDocuments ranks them.
+ */
+
+static int RanksHigher(const DocumentNode *a, const DocumentNode *b, int by_score) {
+	double fa = by_score ? a->score : a->freq;
+	double fb = by_score ? b->score : b->freq;
+	if (fa != fb) {
+		return fa > fb;
+	}
+	return a->doc_id < b->doc_id;
+}
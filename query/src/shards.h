@@ -0,0 +1,138 @@
+/* ========================================================================== */
+/* File: shards.h
+ *
+ * Project name: CS50 Tiny Search Engine
+ * Component name: Query
+ *
+ * This file contains the scatter-gather of queries over a sharded index.
+ * "indexer -s N" splits the doc_ids into N ranges and builds an independent
+ * index for each; each shard is answered by its own "query --serve" and
+ * "query --shards" sends every query line to all of them and merges their
+ * results.
+ *
+ * On top of query lines, a shard answers these requests, each ended by an
+ * empty line like the results of a query line:
+ *
+ *     #rank                    "bm25" if it ranks with BM25, else "frequency"
+ *     #stats<TAB>LINE          "N<TAB>TOTAL_LENGTH", the documents and words of the
+ *                              shard, then a "WORD<TAB>DF" line for each word of
+ *                              the query line
+ *     #search K[ N TOTAL_LENGTH WORD=DF ...]<TAB>LINE
+ *                              the K best results of the query line, 0 for all of
+ *                              them, "DOC_ID<TAB>RANK" with the exact score; with N,
+ *                              ranked with the statistics given (see InitializeShardRanker)
+ *
+ * and "invalid" if the line is not a valid query. With BM25, SearchShards
+ * first sends #stats to every shard and adds their answers up, so every shard
+ * scores with the N, the average length and the df of the whole collection,
+ * then sends #search. As the doc_ids of the shards do not overlap, the best
+ * results of the collection are among the K best of each shard. Both rounds
+ * are sent to every shard before any answer is read, so the shards work at
+ * the same time.
+ *
+ */
+/* ========================================================================== */
+#ifndef SHARDS_H
+#define SHARDS_H
+
+// ---------------- Prerequisites e.g., Requires "math.h"
+#include <stdio.h>                          // FILE
+#include "qhashtable.h"                     // DocumentNode
+
+// ---------------- Constants
+#define MAX_SHARDS 64                       // shards of --shards
+#define MAX_SHARD_WORDS 512                 // distinct words of a query line whose df is sent
+#define SHARD_LINE 4000                     // longest request a shard takes, a query line and its statistics
+
+// ---------------- Structures/Types
+
+typedef struct Shard {
+  char *address;                            // TCP port on 127.0.0.1 if all digits, else path of a Unix socket
+  int fd;                                   // connection, -1 if not connected
+  FILE *in;                                 // stream the replies are read from
+  char *reply;                              // line of a reply, for getline
+  size_t reply_size;                        // size of its buffer
+} Shard;
+
+typedef struct ShardSet {
+  Shard shards[MAX_SHARDS];                 // shards, in doc_id order
+  int num_shards;                           // number of shards
+  int bm25;                                 // 1 if they rank with BM25
+} ShardSet;
+
+typedef struct ShardStats {
+  long num_docs;                            // documents of every shard, N; 0 to rank by frequency
+  double total_length;                      // words of every shard
+  char *words[MAX_SHARD_WORDS];             // distinct words of the query line
+  int dfs[MAX_SHARD_WORDS];                 // documents of every shard with each word
+  int num_words;                            // number of words
+} ShardStats;
+
+// ---------------- Public Variables
+
+// ---------------- Prototypes/Macros
+
+/*
+ * ConnectShards - connect to the shards of a sharded index
+ * @set: ShardSet to fill in
+ * @addresses: addresses of the "query --serve" of each shard, separated by commas
+ * @bm25: 1 to rank with BM25
+ *
+ * Returns 1 if successful; 0 if an address cannot be reached, there are more
+ * than MAX_SHARDS, or a shard does not rank the way bm25 asks (see #rank).
+ * Close it with CloseShards, even if not successful.
+ *
+ * Usage example:
+ * ShardSet shards;
+ * if (ConnectShards(&shards, "/tmp/shard0,/tmp/shard1", 1)) {
+ *     DocumentNode *list;
+ *     if (SearchShards(&shards, "dog AND cat\n", 0, 10, &list) == 1) {
+ *         ... show the 10 best results ...
+ *     }
+ *     FreeDocuments(list);
+ * }
+ * CloseShards(&shards);
+ */
+int ConnectShards(ShardSet *set, const char *addresses, int bm25);
+
+void CloseShards(ShardSet *set);
+
+/*
+ * SearchShards - get the ranked results of a query line from every shard
+ * @set: connected ShardSet
+ * @line: query line, checked with CheckLine
+ * @offset: number of best results to skip (--offset)
+ * @limit: number of results to keep after those (--top), 0 for all of them
+ * @list: set to the results, best first, NULL if none
+ *
+ * Returns 1 if successful; 0 if the line is not a valid query; -1 if a shard
+ * cannot be reached any more.
+ */
+int SearchShards(ShardSet *set, const char *line, int offset, int limit, DocumentNode **list);
+
+/*
+ * ReadShardSearch - read a #search request
+ * @request: the request, cut up in place
+ * @k: set to the number of results asked for, 0 for all of them
+ * @stats: set to the statistics sent, with words pointing into the request;
+ *         num_docs is 0 if there are none
+ * @line: set to the query line, in the request
+ *
+ * Returns 1 if successful; 0 if the request is not well formed.
+ */
+int ReadShardSearch(char *request, int *k, ShardStats *stats, char **line);
+
+/*
+ * MergeShardResults - merge the ranked results of the shards
+ * @lists: results of each shard, best first, taken over
+ * @num: number of lists
+ * @by_score: 1 to rank by score, 0 by frequency
+ * @offset: number of best results to skip
+ * @limit: number of results to keep after those, 0 for all of them
+ *
+ * Returns the results ranked offset + 1 to offset + limit, best first; ties go
+ * to the lower doc_id, as for one index. The others are freed.
+ */
+DocumentNode *MergeShardResults(DocumentNode **lists, int num, int by_score, int offset, int limit);
+
+#endif // SHARDS_H
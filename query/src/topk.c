@@ -0,0 +1,339 @@
+/* ========================================================================== */
+/* File: topk.c
+ *
+ * Project name: CS50 Tiny Search Engine
+ * Component name: Query
+ *
+ * This file includes the top-k evaluation of queries with Block-Max WAND pruning.
+ * Please go to the top of each function for more detailed descriptions.
+ */
+/* ========================================================================== */
+
+// ---------------- Open Issues
+
+// ---------------- System includes e.g., <stdio.h>
+#include <stdlib.h>                          // malloc, calloc, free
+#include <limits.h>                          // INT_MAX
+
+// ---------------- Local includes  e.g., "file.h"
+#include "topk.h"                            // top-k functionality
+#include "intersect.h"                       // Gallop
+#include "postings.h"                        // POSTING_BLOCK
+
+// ---------------- Constant definitions
+
+// ---------------- Macro definitions
+#define KEY(ranker, dn) ((ranker) ? (double)(dn).score : (double)(dn).freq)
+
+// ---------------- Structures/Types
+
+typedef struct Cursor {
+  WordNode *word;                           // word of the cursor
+  double idf;                               // WordWeight of the word, with BM25
+  int pos;                                  // index of the current DocumentNode of the word
+} Cursor;
+
+typedef struct Group {
+  Cursor *cursors;                          // cursors of the words of a block, rarest first
+  int num;                                  // number of words
+  double bound;                             // highest rank any document can get from the block
+  int doc_id;                               // next document with every word, INT_MAX once done
+} Group;
+
+// ---------------- Private variables
+
+// ---------------- Private prototypes
+static double BlockBound(const Ranker *, const Cursor *, int);
+static int NextMatch(Group *, int, double, const Ranker *);
+static int Worse(const Ranker *, const DocumentNode *, const DocumentNode *);
+static void SiftDown(const Ranker *, DocumentNode *, int);
+
+
+/*
+ * BlockMaxTopK - find the k highest ranked documents of a query.
+ * @words: WordNodes of the words of every block, each block rarest word first.
+ * @sizes: number of words of each block.
+ * @num_blocks: number of blocks.
+ * @k: number of documents to find.
+ * @ranker: BM25 ranker, NULL to rank by frequency.
+ * @Index: InvertedIndex of the words.
+ * @stats: filled in with the postings scored, or NULL.
+ *
+ * Returns a list of the k highest ranked documents, in no order, NULL if none.
+ *
+ * Pseudocode:
+ *     1. Load the bounds of the blocks of DocumentNodes of every word, and work out
+ *        the bound of each block of words from the best block of each of its words.
+ *     2. Find the first document of each block of words past the last one. A block of
+ *        words that cannot beat theta is done (see NextMatch).
+ *     3. Take the smallest doc_id, and rank it by the best of the blocks of words that
+ *        have it, adding up the frequencies and scores of their words rarest first, as
+ *        ExecutePlan does (see plan.h), so the ranks are the same to the bit.
+ *     4. Put it into a min-heap of the k best documents found so far, whose top is the
+ *        worst one, theta, if it ranks higher than theta or the heap is not full yet.
+ *     5. Continue until every block of words is done, and link the heap into a list.
+ */
+
+DocumentNode *BlockMaxTopK(WordNode **words, const int *sizes, int num_blocks, int k,
+		const Ranker *ranker, HashTable *Index, TopKStats *stats) {
+
+	TopKStats local;
+	stats = stats ? stats : &local;
+	stats->postings = stats->scored = 0;
+	if (num_blocks <= 0 || k <= 0) {
+		return NULL;
+	}
+
+	int num_words = 0;
+	for (int g=0; g < num_blocks; g++) {
+		num_words += sizes[g];
+	}
+	Group *groups = (Group *)malloc(num_blocks * sizeof(Group));
+	Cursor *cursors = (Cursor *)malloc(num_words * sizeof(Cursor));
+	if (!groups || !cursors) {
+		free(groups);
+		free(cursors);
+		return NULL;
+	}
+
+	// Bound each block of words. No more documents match than its rarest word has.
+	long most = 0;
+	for (int g=0, w=0; g < num_blocks; w += sizes[g++]) {
+		Group *group = &groups[g];
+		group->cursors = &cursors[w];
+		group->num = sizes[g];
+		group->bound = 0;
+		group->doc_id = -1;
+		for (int i=0; i < group->num; i++) {
+			Cursor *cursor = &group->cursors[i];
+			cursor->word = words[w + i];
+			cursor->idf = ranker ? WordWeight(ranker, cursor->word->word, cursor->word->df) : 0;
+			cursor->pos = 0;
+			if (!LoadBlockMax(cursor->word, Index)) {
+				free(groups);
+				free(cursors);
+				return NULL;
+			}
+			double best = 0;
+			for (int b=0; b < NumBlocks(cursor->word->df); b++) {
+				double bound = BlockBound(ranker, cursor, b);
+				best = (bound > best) ? bound : best;
+			}
+			group->bound += best;
+			stats->postings += cursor->word->df;
+		}
+		most += group->num ? group->cursors[0].word->df : 0;
+	}
+	if (k > most) {
+		k = (int)most;
+	}
+	DocumentNode *heap = (DocumentNode *)malloc((k ? k : 1) * sizeof(DocumentNode));
+	if (!heap) {
+		free(groups);
+		free(cursors);
+		return NULL;
+	}
+
+	int size = 0;
+	double theta = -1; // rank to beat, once the heap is full
+	int doc_id = -1; // last document ranked
+	while (k > 0) {
+
+		// Find the next document of each block of words.
+		int next = INT_MAX;
+		for (int g=0; g < num_blocks; g++) {
+			Group *group = &groups[g];
+			if (group->doc_id != INT_MAX && group->bound * BOUND_SLACK <= theta) {
+				group->doc_id = INT_MAX; // No document of the block can get in.
+			}
+			if (group->doc_id <= doc_id) {
+				group->doc_id = NextMatch(group, doc_id + 1, theta, ranker);
+			}
+			next = (group->doc_id < next) ? group->doc_id : next;
+		}
+		if (next == INT_MAX) {
+			break;
+		}
+		doc_id = next;
+
+		// Rank it by the best block of words that has it.
+		DocumentNode dn = {NULL, doc_id, 0, 0, NULL};
+		for (int g=0; g < num_blocks; g++) {
+			if (groups[g].doc_id != doc_id) {
+				continue;
+			}
+			int freq = 0;
+			float score = 0;
+			for (int i=0; i < groups[g].num; i++) {
+				Cursor *cursor = &groups[g].cursors[i];
+				DocumentNode *posting = &cursor->word->page[cursor->pos];
+				freq += posting->freq;
+				if (ranker) {
+					score += TermScore(ranker, cursor->idf, doc_id, posting->freq);
+				}
+			}
+			stats->scored += groups[g].num;
+			dn.freq = (freq > dn.freq) ? freq : dn.freq;
+			dn.score = (score > dn.score) ? score : dn.score;
+		}
+
+		// Keep it if the heap is not full, or if it ranks higher than the worst one kept.
+		// A later document ranks lower on a tie.
+		if (size < k) {
+			int i = size++;
+			heap[i] = dn;
+			while (i > 0 && Worse(ranker, &heap[i], &heap[(i - 1) / 2])) {
+				DocumentNode swap = heap[i];
+				heap[i] = heap[(i - 1) / 2];
+				heap[(i - 1) / 2] = swap;
+				i = (i - 1) / 2;
+			}
+		}
+		else if (KEY(ranker, dn) > KEY(ranker, heap[0])) {
+			heap[0] = dn;
+			SiftDown(ranker, heap, size);
+		}
+		if (size == k) {
+			theta = KEY(ranker, heap[0]);
+		}
+	}
+
+	// Link the documents kept.
+	DocumentNode *list = NULL;
+	for (int i=0; i < size; i++) {
+		DocumentNode *node = (DocumentNode *)calloc(1, sizeof(DocumentNode));
+		if (!node) {
+			break;
+		}
+		*node = heap[i];
+		node->next = list;
+		list = node;
+	}
+
+	// Cleanup.
+	free(heap);
+	free(groups);
+	free(cursors);
+	return list;
+}
+
+
+/*
+ * BlockBound - highest rank any DocumentNode of a block of a word can get.
+ * @ranker: BM25 ranker, NULL to rank by frequency.
+ * @cursor: cursor of the word.
+ * @b: block number.
+ *
+ * Returns the bound.
+ *
+ * Pseudocode:
+ *     1. Without BM25, it is the largest freq of the block.
+ *     2. With BM25, the score grows with freq and shrinks with the length of the
+ *        document, so take the largest freq with the norm of the shortest document.
+ *        A length of 0, ie unknown, gets the smallest norm there is. A doc_id the
+ *        document table does not have is scored with the average length, so the
+ *        norm is not taken above that of the average length.
+ */
+
+static double BlockBound(const Ranker *ranker, const Cursor *cursor, int b) {
+	const BlockMax *block = &cursor->word->blocks[b];
+	if (!ranker) {
+		return block->max_freq;
+	}
+	double norm = BM25_K1 * (1 - BM25_B + BM25_B * block->min_length / ranker->avg_length);
+	norm = (norm < BM25_K1) ? norm : BM25_K1;
+	return cursor->idf * block->max_freq * (BM25_K1 + 1) / (block->max_freq + norm);
+}
+
+
+/*
+ * NextMatch - find the next document with every word of a block of words that could beat theta.
+ * @group: block of words.
+ * @target: smallest doc_id to look at.
+ * @theta: rank to beat, -1 if any will do.
+ * @ranker: BM25 ranker, NULL to rank by frequency.
+ *
+ * Returns the doc_id of the document, with the cursors of the words on it; INT_MAX if none.
+ *
+ * Pseudocode:
+ *     1. Gallop the cursor of each word to its first doc_id of at least target.
+ *        If a word has none left, the block of words is done.
+ *     2. Add up the bounds of the blocks of DocumentNodes the cursors are in. If they
+ *        cannot beat theta, no document up to the end of the first of those blocks can,
+ *        so start again past it.
+ *     3. If every cursor is on the same doc_id, it is the one. If not, start again at
+ *        the largest, which the others must reach.
+ */
+
+static int NextMatch(Group *group, int target, double theta, const Ranker *ranker) {
+
+	for (;;) {
+		double bound = 0;
+		int end = INT_MAX; // last doc_id of the first block of DocumentNodes to end
+		int largest = target;
+		int same = 1;
+
+		for (int i=0; i < group->num; i++) {
+			Cursor *cursor = &group->cursors[i];
+			WordNode *word = cursor->word;
+			cursor->pos = Gallop(word->doc_ids, word->df, cursor->pos, target);
+			if (cursor->pos == word->df) {
+				return INT_MAX;
+			}
+			int b = cursor->pos / POSTING_BLOCK;
+			bound += BlockBound(ranker, cursor, b);
+			end = (word->blocks[b].last_doc_id < end) ? word->blocks[b].last_doc_id : end;
+
+			int doc_id = word->doc_ids[cursor->pos];
+			same = same && (i == 0 || doc_id == largest);
+			largest = (doc_id > largest) ? doc_id : largest;
+		}
+
+		if (bound * BOUND_SLACK <= theta) {
+			if (end == INT_MAX) {
+				return INT_MAX;
+			}
+			target = end + 1; // Skip the blocks.
+		}
+		else if (same) {
+			return largest;
+		}
+		else {
+			target = largest;
+		}
+	}
+}
+
+
+/*
+ * Worse - check if a document ranks lower than another one.
+ *
+ * Returns 1 if a ranks lower than b, 0 if not. On a tie, the higher doc_id ranks lower.
+ */
+
+static int Worse(const Ranker *ranker, const DocumentNode *a, const DocumentNode *b) {
+	double ka = KEY(ranker, *a);
+	double kb = KEY(ranker, *b);
+	return (ka < kb) || (ka == kb && a->doc_id > b->doc_id);
+}
+
+
+/*
+ * SiftDown - move the top of a min-heap of documents down past the worse ones.
+ */
+
+static void SiftDown(const Ranker *ranker, DocumentNode *heap, int size) {
+	for (int i = 0; 2 * i + 1 < size; ) {
+		int child = 2 * i + 1;
+		if (child + 1 < size && Worse(ranker, &heap[child + 1], &heap[child])) {
+			child++;
+		}
+		if (!Worse(ranker, &heap[child], &heap[i])) {
+			break;
+		}
+		DocumentNode swap = heap[i];
+		heap[i] = heap[child];
+		heap[child] = swap;
+		i = child;
+	}
+}
@@ -0,0 +1,75 @@
+/* ========================================================================== */
+/* File: topk.h
+ *
+ * Project name: CS50 Tiny Search Engine
+ * Component name: Query
+ *
+ * This file contains the top-k evaluation of queries with Block-Max WAND
+ * pruning, for --top. A query is an OR of blocks of words AND'ed together,
+ * and the rank of a document is the best over the blocks that have it of the
+ * sum of the ranks of their words (BM25 score, or frequency).
+ *
+ * The documents are visited in doc_id order, all the words at once, keeping
+ * the k best found so far in a heap. Once the heap is full, a document only
+ * gets in if it ranks higher than the worst one, theta. The indexer keeps in
+ * the header of each block of POSTING_BLOCK postings its last doc_id, its
+ * largest freq and the length of its shortest document (see postings.h), so
+ * without decoding anything, a block bounds the rank of any of its postings:
+ *
+ *     bound(block) = idf * max_freq * (k1 + 1) / (max_freq + norm(min_length))
+ *
+ * (max_freq without BM25). A block of words whose bounds add up to at most
+ * theta is given up at once, and if the bounds of the blocks the cursors of
+ * the words are in add up to at most theta, every doc_id up to the first of
+ * those blocks to end is skipped. Only the documents left are scored, so a
+ * query over frequent words touches a small fraction of their postings.
+ *
+ */
+/* ========================================================================== */
+#ifndef TOPK_H
+#define TOPK_H
+
+// ---------------- Prerequisites e.g., Requires "math.h"
+#include "qhashtable.h"                     // WordNode, DocumentNode
+#include "rank.h"                           // Ranker
+
+// ---------------- Constants
+#define BOUND_SLACK 1.0001                  // room for the rounding of the float scores over their bounds
+
+// ---------------- Structures/Types
+
+typedef struct TopKStats {
+  long postings;                            // DocumentNodes of the words of the query
+  long scored;                              // DocumentNodes whose rank was worked out
+} TopKStats;
+
+// ---------------- Public Variables
+
+// ---------------- Prototypes/Macros
+
+/*
+ * BlockMaxTopK - find the k highest ranked documents of a query
+ * @words: WordNodes of the words of every block of the query, one block after
+ *         the other, each block ordered rarest word first (see CompareDf)
+ * @sizes: number of words of each block
+ * @num_blocks: number of blocks
+ * @k: number of documents to find
+ * @ranker: BM25 ranker, NULL to rank by frequency
+ * @Index: InvertedIndex of the words, for LoadBlockMax
+ * @stats: filled in with the postings scored, or NULL
+ *
+ * Returns a list of the k highest ranked documents (fewer if fewer match), in
+ * no order, with the rank that the exhaustive evaluation would give them; NULL
+ * if none, or if memory cannot be allocated. On a tie, the lower doc_id ranks
+ * higher. Free each DocumentNode with free.
+ *
+ * Usage example:
+ * WordNode *words[3] = {FindWord("turing", Index), FindWord("computer", Index),
+ *                       FindWord("science", Index)};
+ * int sizes[2] = {2, 1};                // turing AND computer OR science
+ * DocumentNode *list = BlockMaxTopK(words, sizes, 2, 10, ranker, Index, NULL);
+ */
+DocumentNode *BlockMaxTopK(WordNode **words, const int *sizes, int num_blocks, int k,
+		const Ranker *ranker, HashTable *Index, TopKStats *stats);
+
+#endif // TOPK_H
@@ -0,0 +1,129 @@
+/* ========================================================================== */
+/* File: intersect_bench.c
+ *
+ * Project name: CS50 Tiny Search Engine
+ * Component name: Query Engine
+ *
+ * Intersection microbenchmark for the doc_id lists of AND queries. For each
+ * ratio of the length of the long list to the short one, intersects random
+ * sorted lists with the merge, the block and the galloping intersections,
+ * checks that they agree, and shows which one IntersectDocIds picks. The
+ * thresholds of intersect.h are where the fastest one changes.
+ *
+ * Usage: ./intersect_bench [long list length] [rounds]
+ */
+/* ========================================================================== */
+#define _POSIX_C_SOURCE 199309L              // clock_gettime
+
+// ---------------- Open Issues
+
+// ---------------- System includes e.g., <stdio.h>
+#include <stdio.h>                           // printf
+#include <stdlib.h>                          // malloc, rand
+#include <string.h>                          // memcmp
+#include <time.h>                            // clock_gettime
+
+// ---------------- Local includes  e.g., "file.h"
+#include "../src/intersect.h"                // intersection functionality
+
+// ---------------- Constant definitions
+#define NUM_METHODS 3
+
+// ---------------- Macro definitions
+
+// ---------------- Structures/Types
+typedef int (*IntersectFunc)(const int *, int, const int *, int, int *);
+
+// ---------------- Private variables
+static volatile int sink;                    // keeps the intersections from being optimized away
+static const IntersectFunc methods[NUM_METHODS] = {IntersectMerge, IntersectBlocks, IntersectGallop};
+static const char *names[NUM_METHODS] = {"merge", "blocks", "gallop"};
+
+// ---------------- Private prototypes
+static double Now(void);
+static void RandomList(int *, int, int);
+
+
+int main(int argc, char *argv[]) {
+
+	int num_b = (argc > 1) ? atoi(argv[1]) : 100000;
+	int rounds = (argc > 2) ? atoi(argv[2]) : 50;
+	int ratios[] = {1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024};
+	int num_ratios = sizeof(ratios) / sizeof(ratios[0]);
+
+	if (num_b <= 0 || rounds <= 0) {
+		printf("Usage: ./intersect_bench [long list length] [rounds]\n");
+		return 1;
+	}
+
+	// The doc_ids are spread over 4 times the long list, so about a quarter of a is in b.
+	int *b = malloc(num_b * sizeof(int));
+	int *a = malloc(num_b * sizeof(int));
+	int *match = malloc(num_b * sizeof(int));
+	int *expected = malloc(num_b * sizeof(int));
+	srand(1);
+	RandomList(b, num_b, 4 * num_b);
+
+	printf("|b| = %d, %d rounds%s\n", num_b, rounds,
+#ifdef __SSE2__
+			", blocks with SSE2"
+#else
+			", blocks without SSE2"
+#endif
+	);
+	printf("\n|b|/|a|      ns per doc_id of a\n");
+	printf("           merge   blocks   gallop   picked\n");
+	for (int r = 0; r < num_ratios; r++) {
+		int num_a = num_b / ratios[r];
+		RandomList(a, num_a, 4 * num_b);
+		IntersectMerge(a, num_a, b, num_b, expected);
+
+		printf("%6d ", ratios[r]);
+		for (int m = 0; m < NUM_METHODS; m++) {
+			int found = 0;
+			double start = Now();
+			for (int k = 0; k < rounds; k++) {
+				found += methods[m](a, num_a, b, num_b, match);
+			}
+			double ns = (Now() - start) * 1e9 / ((double)rounds * num_a);
+			sink = found;
+			if (memcmp(match, expected, num_a * sizeof(int)) != 0) {
+				printf("\n%s disagrees with merge!\n", names[m]);
+				return 1;
+			}
+			printf("%8.2f ", ns);
+		}
+		printf("  %s\n", num_b >= GALLOP_RATIO * num_a ? "gallop" : num_b >= BLOCKS_RATIO * num_a ? "blocks" : "merge");
+	}
+
+	free(a);
+	free(b);
+	free(match);
+	free(expected);
+	return 0;
+}
+
+
+static double Now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/*
+ * RandomList - fill list with num distinct doc_ids below range, in order.
+ *
+ * Pseudocode:
+ *     1. Walk the doc_ids below range and take each one with probability num / range,
+ *        as long as there are enough left.
+ */
+
+static void RandomList(int *list, int num, int range) {
+	int n = 0;
+	for (int doc_id = 0; doc_id < range && n < num; doc_id++) {
+		if (range - doc_id <= num - n || rand() % (range - doc_id) < num - n) {
+			list[n++] = doc_id;
+		}
+	}
+}
@@ -0,0 +1,226 @@
+/* ========================================================================== */
+/* File: postings_bench.c
+ *
+ * Project name: CS50 Tiny Search Engine
+ * Component name: Query Engine
+ *
+ * Decode throughput microbenchmark for the block posting lists of the index file.
+ * Decodes every posting list of ../../indexer/index.dat with the SSE2 and the
+ * scalar bit-unpacking, checks that both agree, and compares them with plain
+ * varint decoding of the same postings.
+ *
+ * Usage: ./postings_bench [index.dat] [rounds]
+ */
+/* ========================================================================== */
+#define _POSIX_C_SOURCE 199309L              // clock_gettime
+
+// ---------------- Open Issues
+
+// ---------------- System includes e.g., <stdio.h>
+#include <stdio.h>                           // printf
+#include <stdlib.h>                          // malloc, atoi
+#include <string.h>                          // memcmp
+#include <time.h>                            // clock_gettime
+
+// ---------------- Local includes  e.g., "file.h"
+#include "indexfile.h"                       // binary index functionality
+#include "postings.h"                        // posting codec functionality
+
+// ---------------- Constant definitions
+
+// ---------------- Macro definitions
+
+// ---------------- Structures/Types
+
+// ---------------- Private variables
+static volatile uint32_t sink;               // keeps the decode loops from being optimized away
+
+// ---------------- Private prototypes
+static double Now(void);
+static double DecodeAll(const IndexFile *, int, int, int);
+static double DecodeVarint(const unsigned char *, size_t, uint64_t, int);
+static int CheckScalar(const IndexFile *);
+
+
+int main(int argc, char *argv[]) {
+
+	const char *file_name = (argc > 1) ? argv[1] : "../../indexer/index.dat";
+	int rounds = (argc > 2) ? atoi(argv[2]) : 20;
+	IndexFile index;
+
+	if (!OpenIndexFile(&index, file_name) || rounds <= 0) {
+		printf("Usage: ./postings_bench [index.dat] [rounds]\n");
+		return 1;
+	}
+
+	uint64_t num_postings = index.header.num_postings;
+	uint64_t num_packed = 0;
+	printf("%u terms, %llu postings, %llu bytes of postings\n", index.header.num_terms,
+			(unsigned long long)num_postings, (unsigned long long)index.header.postings_size);
+
+	if (!CheckScalar(&index)) {
+		printf("SIMD and scalar decoding disagree!\n");
+		CloseIndexFile(&index);
+		return 1;
+	}
+
+	// Re-encode the postings as plain varints for the baseline.
+	unsigned char *varints = malloc(num_postings * 2 * MAX_VARINT);
+	size_t varint_size = 0;
+	TermCursor cursor = {0};
+	IndexTerm term;
+	uint32_t doc_ids[POSTING_BLOCK], freqs[POSTING_BLOCK];
+	while (NextIndexTerm(&index, &cursor, &term)) {
+		uint32_t prev = 0;
+		num_packed += term.df / POSTING_BLOCK * POSTING_BLOCK;
+		for (int b = 0; b < NumBlocks(term.df); b++) {
+			int n = DecodeBlock(term.postings, term.df, b, doc_ids, freqs);
+			for (int i = 0; i < n; i++) {
+				varint_size += PutVarint(varints + varint_size, doc_ids[i] - prev);
+				varint_size += PutVarint(varints + varint_size, freqs[i]);
+				prev = doc_ids[i];
+			}
+		}
+	}
+
+	double simd = DecodeAll(&index, rounds, 1, 0);
+	double scalar = DecodeAll(&index, rounds, 0, 0);
+	double simd_packed = DecodeAll(&index, rounds, 1, 1);
+	double scalar_packed = DecodeAll(&index, rounds, 0, 1);
+	double varint = DecodeVarint(varints, varint_size, num_postings, rounds);
+	double total = (double)num_postings * rounds / 1e6;
+	double packed = (double)num_packed * rounds / 1e6;
+
+	printf("\nall postings              M postings/s\n");
+#ifdef __SSE2__
+	printf("  block, SSE2             %8.1f\n", total / simd);
+#endif
+	printf("  block, scalar           %8.1f\n", total / scalar);
+	printf("  varint (%llu bytes)   %8.1f\n", (unsigned long long)varint_size, total / varint);
+	printf("\nfull blocks only (%llu postings)\n", (unsigned long long)num_packed);
+#ifdef __SSE2__
+	printf("  block, SSE2             %8.1f\n", packed / simd_packed);
+#endif
+	printf("  block, scalar           %8.1f\n", packed / scalar_packed);
+
+	free(varints);
+	CloseIndexFile(&index);
+	return 0;
+}
+
+
+static double Now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/*
+ * DecodeAll - decode every posting list of the index rounds times.
+ * @index: open index file.
+ * @rounds: number of passes over the index.
+ * @simd: 1 to decode with DecodeBlock, 0 to unpack with UnpackBitsScalar.
+ * @full_only: 1 to skip the short last blocks, which are varints.
+ *
+ * Returns the seconds taken.
+ */
+
+static double DecodeAll(const IndexFile *index, int rounds, int simd, int full_only) {
+	uint32_t doc_ids[POSTING_BLOCK], freqs[POSTING_BLOCK];
+	uint32_t sum = 0;
+	double start = Now();
+
+	for (int r = 0; r < rounds; r++) {
+		TermCursor cursor = {0};
+		IndexTerm term;
+		while (NextIndexTerm(index, &cursor, &term)) {
+			int num_blocks = NumBlocks(term.df);
+			int end = full_only ? term.df / POSTING_BLOCK : num_blocks;
+			for (int b = 0; b < end; b++) {
+				PostingBlock block;
+				GetPostingBlock(term.postings, b, &block);
+
+				// Short last blocks are varints either way.
+				if (simd || term.df - b * POSTING_BLOCK < POSTING_BLOCK) {
+					DecodeBlock(term.postings, term.df, b, doc_ids, freqs);
+				}
+				else {
+					const unsigned char *data = term.postings + num_blocks * sizeof(PostingBlock) + block.offset;
+					uint32_t prev = 0;
+					if (b > 0) {
+						PostingBlock before;
+						GetPostingBlock(term.postings, b - 1, &before);
+						prev = before.last_doc_id;
+					}
+					UnpackBitsScalar(data, block.doc_bits, doc_ids);
+					UnpackBitsScalar(data + 16 * block.doc_bits, block.freq_bits, freqs);
+					for (int i = 0; i < POSTING_BLOCK; i++) {
+						prev += doc_ids[i] + 1;
+						doc_ids[i] = prev;
+						freqs[i]++;
+					}
+				}
+				sum += doc_ids[0] + freqs[0];
+			}
+		}
+	}
+	sink = sum;
+	return Now() - start;
+}
+
+
+/*
+ * DecodeVarint - decode a stream of varint (doc_id gap, freq) pairs rounds times.
+ *
+ * Returns the seconds taken.
+ */
+
+static double DecodeVarint(const unsigned char *buf, size_t size, uint64_t num, int rounds) {
+	uint32_t sum = 0;
+	double start = Now();
+
+	for (int r = 0; r < rounds; r++) {
+		const unsigned char *pos = buf;
+		for (uint64_t i = 0; i < num; i++) {
+			sum += GetVarint(&pos);
+			sum += GetVarint(&pos);
+		}
+	}
+	sink = sum;
+	return Now() - start;
+}
+
+
+/*
+ * CheckScalar - check that UnpackBits and UnpackBitsScalar agree on every block.
+ *
+ * Returns 1 if they do; otherwise, 0.
+ */
+
+static int CheckScalar(const IndexFile *index) {
+	TermCursor cursor = {0};
+	IndexTerm term;
+	uint32_t fast[POSTING_BLOCK], slow[POSTING_BLOCK];
+
+	while (NextIndexTerm(index, &cursor, &term)) {
+		int num_blocks = NumBlocks(term.df);
+		for (int b = 0; b < term.df / POSTING_BLOCK; b++) {
+			PostingBlock block;
+			GetPostingBlock(term.postings, b, &block);
+			const unsigned char *data = term.postings + num_blocks * sizeof(PostingBlock) + block.offset;
+
+			UnpackBits(data, block.doc_bits, fast);
+			UnpackBitsScalar(data, block.doc_bits, slow);
+			if (memcmp(fast, slow, sizeof(fast)) != 0) {
+				return 0;
+			}
+			UnpackBits(data + 16 * block.doc_bits, block.freq_bits, fast);
+			UnpackBitsScalar(data + 16 * block.doc_bits, block.freq_bits, slow);
+			if (memcmp(fast, slow, sizeof(fast)) != 0) {
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
@@ -20,9 +20,23 @@
 //  It tests the following functions:
 //
 //  int GetLinks(char *, HashTable *);
+//  int FindDocuments(char *, HashTable *, PairCache *, DocumentNode **);
 //  void And(char *, HashTable *);
 //  int Or();
+//  void Union(DocumentNode **, int);
 //  void Sort();
+//  int TopK(int, int);
+//  int RankDocuments(DocumentNode **, int, int);
+//  int MatchPositions(const int *const *, const int *, int, int, int *);
+//  int IntersectDocIds(const int *, int, const int *, int, int *);
+//  DocumentNode *BlockMaxTopK(WordNode **, const int *, int, int, const Ranker *, HashTable *, TopKStats *);
+//  QueryNode *ParseQuery(const char *, Arena *);
+//  PlanNode *PlanQuery(const QueryNode *, HashTable *, PairCache *, Arena *);
+//  DocumentNode *ExcludeWords(DocumentNode *, const PlanNode *);
+//  char *CanonicalQuery(const QueryNode *, Arena *);
+//  DocumentNode *LookupCache(ResultCache *, const char *, int *);
+//  int InsertCache(ResultCache *, const char *, const DocumentNode *);
+//  DocumentNode *PairPostings(WordNode **, const unsigned char *, int, const Ranker *);
 //  int Display();
 //
 //  If any of the tests fail it prints status 
@@ -43,7 +57,7 @@
 // 
 //
 //
-//  The following test cases  (1-7) are for function:
+//  The following test cases  (1-8) are for function:
 //
 //  int GetLinks(char *, HashTable *);
 //
@@ -62,7 +76,7 @@
 //  Test case: GETLINKS:4
 //  This test case calls GetLinks() where the query contains "OR", ie libation OR hindrance.
 //  Libation appears once in doc #1467, and hindrance appears once in doc #259 and in doc #891.
-//  GetLinks() should return 1 and final_list should contain the above three nodes.
+//  GetLinks() should return 1 and final_list should contain the above three nodes, in doc_id order.
 //
 //  Test case: GETLINKS:5
 //  This test case calls GetLinks() where the query contains "AND", ie squash AND whale.
@@ -78,6 +92,11 @@
 // This test case calls GetLinks() where the query contains multiple AND and OR operators.
 // GetLinks() should return 1 and final_list should not be NULL.
 //
+// Test case: GETLINKS:8
+// This test case calls GetLinks() with phrases, ie "squash whale". The index is read without
+// its positions, so a phrase is an AND, and GetLinks() should return the node of GETLINKS:6.
+// A phrase that is not closed, or that holds an operator, is not valid and GetLinks() should return 0.
+//
 //
 //  The following test cases (1-3) for function:
 //
@@ -98,9 +117,10 @@
 //  "libation" appears in one document #1467 once.
 //
 //
-//  The following test cases (1) for function:
+//  The following test cases (1-3) for functions:
 //
 //  int Or();
+//  void Union(DocumentNode **, int);
 //
 //  Test case: OR:1
 //  This test case calls Or() for the condition where the temp_list is NULL.
@@ -111,24 +131,164 @@
 //  Then, the rank should be the higher of the two.
 //  temp_list will be NULL.
 //
+//  Test case: OR:3
+//  This test case calls Union() with three lists and final_list, all in doc_id order.
+//  final_list should have each doc_id once, in doc_id order, with the highest frequency.
 //
-//  The following test cases (1) for function:
+//
+//  The following test cases (1-4) for functions:
 //
 //  void Sort();
+//  int TopK(int, int);
+//  int FindDocuments(char *, HashTable *, PairCache *, DocumentNode **);
+//  int RankDocuments(DocumentNode **, int, int);
 //
 //  Test case: SORT:1
 //  This test case calls Sort() where final_list contains a list of DocumentNodes.
 //  final_list will be sorted by rank from highest to lowest.
 //
+//  Test case: SORT:2
+//  This test case ranks squash OR whale with BM25, the ranker made from the document table.
+//  Every result should have a positive score, and final_list should be sorted by score.
+//
+//  Test case: SORT:3
+//  This test case calls TopK() for pages of a list of ten DocumentNodes with tied frequencies.
+//  Each page should be the same as that part of the sorted list, ties broken by doc_id.
+//
+//  Test case: SORT:4
+//  This test case calls FindDocuments() and RankDocuments() for whale into a list of its own, as
+//  --batch does. The page should be the same as with GetLinks() and TopK(), and final_list untouched.
+//
+//
+//  The following test cases (1-2) for function:
+//
+//  int MatchPositions(const int *const *, const int *, int, int, int *);
+//
+//  Test case: PHRASE:1
+//  This test case calls MatchPositions() for "a b" with hand-made positions.
+//  a b match next to each other only in order, and with slop 1 when one word is between them.
+//
+//  Test case: PHRASE:2
+//  This test case calls MatchPositions() for "a b c"~1, where the first b after a cannot
+//  be followed by c but the second one can. It should match, and not with slop 0.
+//
+//
+//  The following test cases (1) for function:
+//
+//  int IntersectDocIds(const int *, int, const int *, int, int *);
+//
+//  Test case: INTERSECT:1
+//  This test case intersects hand-made doc_ids with IntersectDocIds() and each of its three ways.
+//  They should all find the same doc_ids, at the same indexes.
+//
 //
 //  The following test cases (1) for function:
 //
+//  DocumentNode *BlockMaxTopK(WordNode **, const int *, int, int, const Ranker *, HashTable *, TopKStats *);
+//
+//  Test case: TOPK:1
+//  This test case calls GetLinks() for "history OR computer AND science OR world" in full, then
+//  with top_k set to 5, so the documents are found by BlockMaxTopK().
+//  Both should give the same 5 best documents, and only 5 with top_k.
+//
+//
+//  The following test cases (1) for function:
+//
+//  QueryNode *ParseQuery(const char *, Arena *);
+//
+//  Test case: PARSE:1
+//  This test case calls ParseQuery() for dog Cat OR (mouse AND NOT "hot dog"~1), which should be an OR
+//  of an AND of dog and cat, and an AND of mouse and a NOT of the phrase, its words lowered.
+//  Lines with an operator missing its operand, parentheses not matched, or only NOTs are not valid.
+//
+//
+//  The following test cases (1) for function:
+//
+//  PlanNode *PlanQuery(const QueryNode *, HashTable *, PairCache *, Arena *);
+//
+//  Test case: PLAN:1
+//  This test case plans squash whale libation, whose words should be ordered rarest first: libation, whale, squash.
+//  An AND with a word not in the InvertedIndex should be left out of its OR.
+//  GetLinks() of (squash OR libation) AND whale should find doc #1130 only, and of whale NOT squash
+//  the 10 other documents with whale.
+//
+//
+//  The following test cases (1) for function:
+//
+//  DocumentNode *ExcludeWords(DocumentNode *, const PlanNode *);
+//
+//  Test case: EXCLUDE:1
+//  This test case calls ExcludeWords() on the documents of whale with the plan of squash, and of
+//  squash OR libation. Both should leave the 10 documents with whale other than doc #1130.
+//  GetLinks() of whale -squash should find the same documents, and -whale, whale - squash and
+//  whale --squash are not valid.
+//
+//
+//  The following test cases (1-2) for functions:
+//
+//  char *CanonicalQuery(const QueryNode *, Arena *);
+//  DocumentNode *LookupCache(ResultCache *, const char *, int *);
+//  int InsertCache(ResultCache *, const char *, const DocumentNode *);
+//
+//  Test case: CACHE:1
+//  This test case calls CanonicalQuery() for lines that only differ in case, spacing, grouping and
+//  the order of operands. They should all get ((squash whale) OR libation), and whale -squash should not.
+//
+//  Test case: CACHE:2
+//  This test case keeps the results of squash AND whale, then of two more queries, in a cache with room
+//  for two of them. The first should be given up, as the least recently used, unless it is looked up
+//  in between. Results found should be the ones kept, and the hits, misses and evictions counted.
+//
+//
+//  The following test cases (1) for functions:
+//
+//  PlanNode *PlanQuery(const QueryNode *, HashTable *, PairCache *, Arena *);
+//  DocumentNode *PairPostings(WordNode **, const unsigned char *, int, const Ranker *);
+//
+//  Test case: PAIRS:1
+//  This test case plans computer science with a PairCache. The pair should only be kept the second
+//  time, then used by computer AND science AND the too, with the same documents, frequencies
+//  and BM25 scores as without the cache. Pairs with a rare word, like squash whale, are never kept.
+//
+//
+//  The following test cases (1) for functions:
+//
+//  int FindDocuments(char *, HashTable *, PairCache *, DocumentNode **);
+//  WordNode *FindWord(char *, HashTable *);
+//
+//  Test case: THREADS:1
+//  This test case runs FindDocuments() from THREADS threads at once on one mapped index, whose
+//  words are decoded as the threads look them up. Each thread should find the same documents,
+//  with the same frequencies, as one thread on an index of its own.
+//
+//
+//  The following test cases (1) for functions:
+//
+//  DocumentNode *MergeShardResults(DocumentNode **, int, int, int, int);
+//  int ReadShardSearch(char *, int *, ShardStats *, char **);
+//  int InitializeShardRanker(Ranker *, const DocFile *, long, double);
+//  double WordWeight(const Ranker *, const char *, int);
+//
+//  Test case: SHARDS:1
+//  This test case merges hand-made results of three shards, best first with ties to the lower doc_id,
+//  and skips and keeps pages of them. A #search request should be read into its K, statistics and line.
+//  A ranker given the table's own statistics should score like InitializeRanker(), and WordWeight()
+//  should use the df given for a word over the one of the shard.
+//
+//
+//  The following test cases (1-2) for function:
+//
 //  int Display();
 //
 //  Test case: DISPLAY:1
 //  This test case calls Display() where final_list contains a list of DocumentNodes.
 //  Each DocumentNode of final_list will be printed in "DOCUMENT ID:  URL:  " format.
 //  Returns 1 upon completion.
+//
+//  Test case: DISPLAY:2
+//  This test case calls Display() with the document table of the index mapped.
+//  The URLs come from the table, and a doc_id not in the table has no DocRecord.
+//  Returns 1 upon completion.
 
 
 
@@ -140,10 +300,20 @@
 #include <ctype.h>
 #include <unistd.h>
 #include <math.h> 				 // math functionality
+#include <pthread.h> 				 // threads of THREADS:1
 #include "../src/qhashtable.h" 						 // hashtable functionality
 #include "../src/file.h" 							 // file functionality
 #include "../src/qweb.h" 								// web/html functionality
+#include "../src/phrase.h" 							 // phrase matching
+#include "../src/intersect.h" 						 // doc_id list intersection
+#include "../src/topk.h" 							 // Block-Max WAND top-k
+#include "../src/parse.h" 							 // query parser
+#include "../src/plan.h" 							 // query planning
+#include "../src/cache.h" 							 // query result cache
 #include "../src/query_func.h" 							 // query functionality
+#include "docfile.h" 								 // document table functionality
+#include "../src/rank.h" 							 // BM25 ranking
+#include "../src/shards.h" 							 // scatter-gather over shards
 
 // Useful MACROS for controlling the unit tests.
 
@@ -190,6 +360,10 @@ HashTable Index;
 HashTable *ptr;
 char *file = "../../indexer/index.dat";
 char *dir_path = "../../crawler/data";
+DocFile doc_file; 								 // zeroed, so Display reads the files
+Ranker *ranker; 								 // NULL, so results are ranked by frequency
+int top_k; 									 // 0, so GetLinks finds every document
+PairCache *pairs; 								 // NULL, so GetLinks keeps no pairs
 
 
 // Test case: GETLINKS:1
@@ -271,7 +445,7 @@ int TestGETLINKS3() {
 // Test case: GETLINKS:4
 // This test case calls GetLinks() where the query contains "OR", ie libation OR hindrance.
 // Libation appears once in doc #1467, and hindrance appears once in doc #259 and in doc #891.
-// GetLinks() should return 1 and final_list should contain the above three nodes.
+// GetLinks() should return 1 and final_list should contain the above three nodes, in doc_id order.
 
 int TestGETLINKS4() {
   START_TEST_CASE;
@@ -284,7 +458,7 @@ int TestGETLINKS4() {
   
   DocumentNode *ptr;
   int i = 0;
-  int arr[3] = {1467, 259, 891};
+  int arr[3] = {259, 891, 1467}; // final_list is in doc_id order.
   for (ptr = final_list; ptr != NULL; ptr = ptr->next) {
   	SHOULD_BE(ptr->doc_id == arr[i] && ptr->freq == 1);
   	i++;
@@ -363,6 +537,36 @@ int TestGETLINKS7() {
 }
 
 
+// Test case: GETLINKS:8
+// This test case calls GetLinks() with phrases, ie "squash whale". The index is read without
+// its positions, so a phrase is an AND, and GetLinks() should return the node of GETLINKS:6.
+// A phrase that is not closed, or that holds an operator, is not valid and GetLinks() should return 0.
+
+int TestGETLINKS8() {
+  START_TEST_CASE;
+  
+  char *query = "\"squash whale\"~2 OR \"bumble\""; // The query we want to test with.
+  
+  int result = GetLinks(query, ptr);
+  SHOULD_BE(temp_list == NULL);
+  SHOULD_BE(final_list != NULL);
+  SHOULD_BE(final_list->doc_id == 1130);
+  SHOULD_BE(final_list->next == NULL);
+  SHOULD_BE(result == 1);
+  FreeList(1);
+  
+  // Phrases that are not valid.
+  char *bad[4] = {"\"squash whale", "squash whale\"", "\"squash AND whale\"", "\"squash whale\"~x"};
+  for (int i = 0; i < 4; i++) {
+    SHOULD_BE(GetLinks(bad[i], ptr) == 0);
+    FreeList(0);
+    FreeList(1);
+  }
+  
+  END_TEST_CASE;
+}
+
+
 // Test case: AND:1
 // This test case calls And() for the condition where the temp_list is NULL.
 // temp_list will be NULL.
@@ -484,6 +688,42 @@ int TestOR2() {
 }
 
 
+// Test case: OR:3
+// This test case calls Union() with three lists and final_list, all in doc_id order.
+// final_list should have each doc_id once, in doc_id order, with the highest frequency.
+
+int TestOR3() {
+  START_TEST_CASE;
+  
+  // Lists of {doc_id, freq}, final_list first.
+  int docs[4][3][2] = {{{2, 1}, {9, 1}}, {{1, 5}, {2, 3}}, {{9, 4}}, {{3, 1}, {7, 2}, {9, 2}}};
+  int sizes[4] = {2, 2, 1, 3};
+  DocumentNode *lists[4] = {NULL};
+  for (int l = 0; l < 4; l++) {
+    for (int i = sizes[l] - 1; i >= 0; i--) {
+      DocumentNode *dn = (DocumentNode *)calloc(1, sizeof(DocumentNode));
+      dn->doc_id = docs[l][i][0];
+      dn->freq = docs[l][i][1];
+      dn->next = lists[l];
+      lists[l] = dn;
+    }
+  }
+  final_list = lists[0];
+  
+  Union(lists + 1, 3);
+  
+  int expected[5][2] = {{1, 5}, {2, 3}, {3, 1}, {7, 2}, {9, 4}};
+  int i = 0;
+  for (DocumentNode *dn = final_list; dn != NULL; dn = dn->next, i++) {
+    SHOULD_BE(i < 5 && dn->doc_id == expected[i][0] && dn->freq == expected[i][1]);
+  }
+  SHOULD_BE(i == 5);
+  
+  FreeList(1); // Cleanup.
+  END_TEST_CASE;
+}
+
+
 // Test case: SORT:1
 // This test case calls Sort() where final_list contains a list of DocumentNodes.
 // final_list will be sorted by rank from highest to lowest.
@@ -519,6 +759,638 @@ int TestSORT1() {
 }
 
 
+// Test case: SORT:2
+// This test case ranks squash OR whale with BM25, the ranker made from the document table.
+// Every result should have a positive score, and final_list should be sorted by score.
+
+int TestSORT2() {
+  START_TEST_CASE;
+  
+  DocFile docs;
+  Ranker bm25;
+  SHOULD_BE(OpenDocFile(&docs, "../../indexer/index.dat.docs") == 1);
+  SHOULD_BE(InitializeRanker(&bm25, &docs) == 1);
+  SHOULD_BE(bm25.avg_length > 0);
+  ranker = &bm25;
+  
+  char query[] = "squash OR whale";
+  SHOULD_BE(GetLinks(query, ptr) == 1);
+  SHOULD_BE(final_list != NULL && final_list->next != NULL);
+  Sort();
+  
+  for (DocumentNode *dn = final_list; dn != NULL; dn = dn->next) {
+    SHOULD_BE(dn->score > 0);
+    SHOULD_BE(dn->next == NULL || dn->score >= dn->next->score);
+  }
+  
+  FreeList(1); // Cleanup.
+  ranker = NULL;
+  FreeRanker(&bm25);
+  CloseDocFile(&docs);
+  
+  END_TEST_CASE;
+}
+
+
+// Test case: SORT:3
+// This test case calls TopK() for pages of a list of ten DocumentNodes with tied frequencies.
+// Each page should be the same as that part of the sorted list, ties broken by doc_id.
+
+int TestSORT3() {
+  START_TEST_CASE;
+  
+  // doc_ids 1 to 10 with these frequencies, and their ranking.
+  int freqs[10] = {3, 1, 3, 2, 1, 3, 2, 1, 3, 2};
+  int ranked[10] = {1, 3, 6, 9, 4, 7, 10, 2, 5, 8};
+  int pages[4][2] = {{0, 3}, {3, 4}, {8, 5}, {12, 2}}; // {offset, limit}
+  
+  for (int p = 0; p < 4; p++) {
+    final_list = NULL;
+    for (int doc_id = 10; doc_id >= 1; doc_id--) {
+      DocumentNode *dn = (DocumentNode *)calloc(1, sizeof(DocumentNode));
+      dn->doc_id = doc_id;
+      dn->freq = freqs[doc_id - 1];
+      dn->next = final_list;
+      final_list = dn;
+    }
+    
+    int offset = pages[p][0], limit = pages[p][1];
+    SHOULD_BE(TopK(offset, limit) == 10);
+    int i = offset;
+    for (DocumentNode *dn = final_list; dn != NULL; dn = dn->next, i++) {
+      SHOULD_BE(i < 10 && i < offset + limit && dn->doc_id == ranked[i]);
+    }
+    int end = (offset + limit < 10) ? offset + limit : 10; // Past the end, the page is empty.
+    SHOULD_BE(i == ((end > offset) ? end : offset));
+    FreeList(1);
+  }
+  
+  END_TEST_CASE;
+}
+
+
+// Test case: SORT:4
+// This test case calls FindDocuments() and RankDocuments() for whale into a list of its own, as
+// --batch does. The page should be the same as with GetLinks() and TopK(), and final_list untouched.
+
+int TestSORT4() {
+  START_TEST_CASE;
+  
+  char line[] = "whale";
+  DocumentNode *list = NULL;
+  final_list = NULL;
+  SHOULD_BE(FindDocuments(line, ptr, NULL, &list) == 1);
+  SHOULD_BE(final_list == NULL);
+  SHOULD_BE(RankDocuments(&list, 2, 5) == 11);
+  SHOULD_BE(final_list == NULL);
+  
+  // Same page with the globals.
+  SHOULD_BE(GetLinks(line, ptr) == 1);
+  SHOULD_BE(TopK(2, 5) == 11);
+  DocumentNode *dn = list, *fn = final_list;
+  int n = 0;
+  for ( ; dn != NULL && fn != NULL; dn = dn->next, fn = fn->next, n++) {
+    SHOULD_BE(dn->doc_id == fn->doc_id && dn->freq == fn->freq);
+  }
+  SHOULD_BE(dn == NULL && fn == NULL && n == 5);
+  
+  // Not a valid query.
+  char bad[] = "whale AND";
+  SHOULD_BE(FindDocuments(bad, ptr, NULL, &dn) == 0 && dn == NULL);
+  
+  FreeDocuments(list); // Cleanup.
+  FreeList(1);
+  
+  END_TEST_CASE;
+}
+
+
+// Test case: PHRASE:1
+// This test case calls MatchPositions() for "a b" with hand-made positions.
+// a b match next to each other only in order, and with slop 1 when one word is between them.
+
+int TestPHRASE1() {
+  START_TEST_CASE;
+  
+  int a[3] = {0, 7, 20};
+  int b[2] = {5, 9};
+  int counts[2] = {3, 2};
+  int scratch[4];
+  const int *positions[2] = {a, b};
+  
+  SHOULD_BE(MatchPositions(positions, counts, 2, 0, scratch) == 0); // b is 2 words after a at best.
+  SHOULD_BE(MatchPositions(positions, counts, 2, 1, scratch) == 1); // 7 and 9.
+  
+  // b a does not match until b is far enough before a.
+  const int *reversed[2] = {b, a};
+  int counts2[2] = {2, 3};
+  SHOULD_BE(MatchPositions(reversed, counts2, 2, 0, scratch) == 0);
+  SHOULD_BE(MatchPositions(reversed, counts2, 2, 1, scratch) == 1); // 5 and 7.
+  
+  END_TEST_CASE;
+}
+
+
+// Test case: PHRASE:2
+// This test case calls MatchPositions() for "a b c"~1, where the first b after a cannot
+// be followed by c but the second one can. It should match, and not with slop 0.
+
+int TestPHRASE2() {
+  START_TEST_CASE;
+  
+  int a[1] = {0};
+  int b[2] = {1, 2};
+  int c[1] = {4};
+  int counts[3] = {1, 2, 1};
+  int scratch[4];
+  const int *positions[3] = {a, b, c};
+  
+  SHOULD_BE(MatchPositions(positions, counts, 3, 1, scratch) == 1); // 0, 2 and 4.
+  SHOULD_BE(MatchPositions(positions, counts, 3, 0, scratch) == 0);
+  
+  END_TEST_CASE;
+}
+
+
+// Test case: INTERSECT:1
+// This test case intersects hand-made doc_ids with IntersectDocIds() and each of its three ways.
+// They should all find the same doc_ids, at the same indexes.
+
+int TestINTERSECT1() {
+  START_TEST_CASE;
+  
+  int a[3] = {2, 5, 9};
+  int b[12] = {1, 2, 3, 4, 6, 7, 8, 9, 10, 11, 12, 13};
+  int expected[3] = {1, -1, 7};
+  int match[3];
+  
+  SHOULD_BE(IntersectDocIds(a, 3, b, 12, match) == 2);
+  SHOULD_BE(memcmp(match, expected, sizeof(match)) == 0);
+  SHOULD_BE(IntersectMerge(a, 3, b, 12, match) == 2);
+  SHOULD_BE(memcmp(match, expected, sizeof(match)) == 0);
+  SHOULD_BE(IntersectBlocks(a, 3, b, 12, match) == 2);
+  SHOULD_BE(memcmp(match, expected, sizeof(match)) == 0);
+  SHOULD_BE(IntersectGallop(a, 3, b, 12, match) == 2);
+  SHOULD_BE(memcmp(match, expected, sizeof(match)) == 0);
+  
+  // Nothing past the end of b is found.
+  int c[2] = {13, 20};
+  SHOULD_BE(IntersectBlocks(c, 2, b, 12, match) == 1 && match[0] == 11 && match[1] == -1);
+  SHOULD_BE(IntersectGallop(c, 2, b, 12, match) == 1 && match[0] == 11 && match[1] == -1);
+  
+  END_TEST_CASE;
+}
+
+
+// Test case: TOPK:1
+// This test case calls GetLinks() for "history OR computer AND science OR world" in full, then
+// with top_k set to 5, so the documents are found by BlockMaxTopK().
+// Both should give the same 5 best documents, and only 5 with top_k.
+
+int TestTOPK1() {
+  START_TEST_CASE;
+  
+  char *query = "history OR computer AND science OR world";
+  int best[5];
+  
+  SHOULD_BE(GetLinks(query, ptr) == 1);
+  SHOULD_BE(TopK(0, 5) > 5);
+  int i = 0;
+  for (DocumentNode *dn = final_list; dn != NULL && i < 5; dn = dn->next) {
+    best[i++] = dn->doc_id;
+  }
+  FreeList(1);
+  
+  top_k = 5;
+  SHOULD_BE(GetLinks(query, ptr) == 1);
+  top_k = 0;
+  SHOULD_BE(TopK(0, 5) == 5);
+  i = 0;
+  for (DocumentNode *dn = final_list; dn != NULL && i < 5; dn = dn->next, i++) {
+    SHOULD_BE(dn->doc_id == best[i]);
+  }
+  FreeList(1);
+  
+  END_TEST_CASE;
+}
+
+
+// Test case: PARSE:1
+// This test case calls ParseQuery() for dog Cat OR (mouse AND NOT "hot dog"~1), which should be an OR
+// of an AND of dog and cat, and an AND of mouse and a NOT of the phrase, its words lowered.
+// Lines with an operator missing its operand, parentheses not matched, or only NOTs are not valid.
+
+int TestPARSE1() {
+  START_TEST_CASE;
+  
+  Arena arena;
+  InitializeArena(&arena);
+  
+  QueryNode *query = ParseQuery("dog Cat OR (mouse AND NOT \"hot dog\"~1)", &arena);
+  SHOULD_BE(query != NULL && query->type == QUERY_OR && query->num_children == 2);
+  
+  QueryNode *first = query->children;
+  SHOULD_BE(first->type == QUERY_AND && first->num_children == 2);
+  SHOULD_BE(strcmp(first->children->word, "dog") == 0);
+  SHOULD_BE(strcmp(first->children->next->word, "cat") == 0);
+  
+  QueryNode *second = first->next;
+  SHOULD_BE(second->type == QUERY_AND && second->num_children == 2);
+  SHOULD_BE(strcmp(second->children->word, "mouse") == 0);
+  QueryNode *not = second->children->next;
+  SHOULD_BE(not->type == QUERY_NOT && not->children->type == QUERY_PHRASE);
+  SHOULD_BE(not->children->num_children == 2 && not->children->slop == 1);
+  
+  // Lines that are not valid.
+  char *bad[8] = {"", "dog AND", "OR dog", "(dog", "dog)", "()", "NOT dog", "dog OR NOT cat"};
+  for (int i = 0; i < 8; i++) {
+    SHOULD_BE(ParseQuery(bad[i], &arena) == NULL);
+  }
+  
+  FreeArena(&arena); // Cleanup.
+  END_TEST_CASE;
+}
+
+
+// Test case: PLAN:1
+// This test case plans squash whale libation, whose words should be ordered rarest first: libation, whale, squash.
+// An AND with a word not in the InvertedIndex should be left out of its OR.
+// GetLinks() of (squash OR libation) AND whale should find doc #1130 only, and of whale NOT squash
+// the 10 other documents with whale.
+
+int TestPLAN1() {
+  START_TEST_CASE;
+  
+  Arena arena;
+  InitializeArena(&arena);
+  
+  PlanNode *plan = PlanQuery(ParseQuery("squash whale libation", &arena), ptr, NULL, &arena);
+  SHOULD_BE(plan != NULL && plan->type == PLAN_AND && plan->num_words == 3);
+  SHOULD_BE(strcmp(plan->words[0]->word, "libation") == 0);
+  SHOULD_BE(strcmp(plan->words[1]->word, "whale") == 0);
+  SHOULD_BE(strcmp(plan->words[2]->word, "squash") == 0);
+  SHOULD_BE(plan->cost == 1);
+  
+  plan = PlanQuery(ParseQuery("whale bumblearhr OR libation", &arena), ptr, NULL, &arena);
+  SHOULD_BE(plan != NULL && plan->type == PLAN_AND && plan->num_words == 1);
+  SHOULD_BE(strcmp(plan->words[0]->word, "libation") == 0);
+  FreeArena(&arena);
+  
+  SHOULD_BE(GetLinks("(squash OR libation) AND whale", ptr) == 1);
+  SHOULD_BE(final_list != NULL && final_list->doc_id == 1130 && final_list->next == NULL);
+  FreeList(1);
+  
+  SHOULD_BE(GetLinks("whale NOT squash", ptr) == 1);
+  int n = 0;
+  for (DocumentNode *dn = final_list; dn != NULL; dn = dn->next) {
+    SHOULD_BE(dn->doc_id != 1130);
+    n++;
+  }
+  SHOULD_BE(n == 10);
+  FreeList(1);
+  
+  END_TEST_CASE;
+}
+
+
+// Test case: EXCLUDE:1
+// This test case calls ExcludeWords() on the documents of whale with the plan of squash, and of
+// squash OR libation. Both should leave the 10 documents with whale other than doc #1130.
+// GetLinks() of whale -squash should find the same documents, and -whale, whale - squash and
+// whale --squash are not valid.
+
+int TestEXCLUDE1() {
+  START_TEST_CASE;
+  
+  Arena arena;
+  InitializeArena(&arena);
+  char *excluded[2] = {"squash", "squash OR libation"};
+  
+  for (int i = 0; i < 2; i++) {
+    PlanNode *plan = PlanQuery(ParseQuery(excluded[i], &arena), ptr, NULL, &arena);
+    DocumentNode *list = ExcludeWords(CopyPostings(FindWord("whale", ptr), NULL), plan);
+    int n = 0;
+    for (DocumentNode *dn = list; dn != NULL; dn = dn->next) {
+      SHOULD_BE(dn->doc_id != 1130);
+      n++;
+    }
+    SHOULD_BE(n == 10);
+    FreeDocuments(list);
+  }
+  FreeArena(&arena);
+  
+  SHOULD_BE(GetLinks("whale -squash", ptr) == 1);
+  int n = 0;
+  for (DocumentNode *dn = final_list; dn != NULL; dn = dn->next) {
+    SHOULD_BE(dn->doc_id != 1130);
+    n++;
+  }
+  SHOULD_BE(n == 10);
+  FreeList(1);
+  
+  // Lines that are not valid.
+  char *bad[3] = {"-whale", "whale - squash", "whale --squash"};
+  for (int i = 0; i < 3; i++) {
+    SHOULD_BE(GetLinks(bad[i], ptr) == 0);
+  }
+  
+  END_TEST_CASE;
+}
+
+
+// Test case: CACHE:1
+// This test case calls CanonicalQuery() for lines that only differ in case, spacing, grouping and
+// the order of operands. They should all get ((squash whale) OR libation), and whale -squash should not.
+
+int TestCACHE1() {
+  START_TEST_CASE;
+  
+  Arena arena;
+  InitializeArena(&arena);
+  char *same[4] = {"squash whale OR libation", "libation OR Whale  AND squash", "(libation) OR (whale (squash))",
+                   "libation OR (whale squash)"};
+  
+  for (int i = 0; i < 4; i++) {
+    char *key = CanonicalQuery(ParseQuery(same[i], &arena), &arena);
+    SHOULD_BE(key != NULL && strcmp(key, "((squash whale) OR libation)") == 0);
+  }
+  SHOULD_BE(strcmp(CanonicalQuery(ParseQuery("whale -squash", &arena), &arena), "(-squash whale)") == 0);
+  
+  FreeArena(&arena); // Cleanup.
+  END_TEST_CASE;
+}
+
+
+// Test case: CACHE:2
+// This test case keeps the results of squash AND whale, then of two more queries, in a cache with room
+// for two of them. The first should be given up, as the least recently used, unless it is looked up
+// in between. Results found should be the ones kept, and the hits, misses and evictions counted.
+
+int TestCACHE2() {
+  START_TEST_CASE;
+  
+  ResultCache cache;
+  DocumentNode dn = {NULL, 1130, 2, 1.5, NULL};
+  size_t size = sizeof(CacheEntry) + sizeof(CachedResult) + strlen("(squash whale)") + 1;
+  int found;
+  
+  InitializeCache(&cache, 2 * size);
+  SHOULD_BE(LookupCache(&cache, "(squash whale)", &found) == NULL && !found);
+  SHOULD_BE(InsertCache(&cache, "(squash whale)", &dn) == 1);
+  SHOULD_BE(InsertCache(&cache, "(squash other)", &dn) == 1);
+  
+  // Looked up, so it is kept.
+  DocumentNode *list = LookupCache(&cache, "(squash whale)", &found);
+  SHOULD_BE(found && list != NULL && list->doc_id == 1130 && list->freq == 2 && list->score == 1.5f);
+  SHOULD_BE(list->next == NULL);
+  free(list);
+  SHOULD_BE(InsertCache(&cache, "(squash third)", &dn) == 1);
+  SHOULD_BE(LookupCache(&cache, "(squash other)", &found) == NULL && !found);
+  
+  // Not looked up, so it is given up.
+  SHOULD_BE(InsertCache(&cache, "(squash again)", NULL) == 1);
+  SHOULD_BE(LookupCache(&cache, "(squash whale)", &found) == NULL && !found);
+  SHOULD_BE(LookupCache(&cache, "(squash again)", &found) == NULL && found);
+  
+  SHOULD_BE(cache.hits == 2 && cache.misses == 3 && cache.evictions == 2);
+  ClearCache(&cache);
+  SHOULD_BE(cache.size == 0 && cache.head == NULL);
+  
+  END_TEST_CASE;
+}
+
+
+// Test case: PAIRS:1
+// This test case plans computer science with a PairCache. The pair should only be kept the second
+// time, then used by computer AND science AND the too, with the same documents, frequencies
+// and BM25 scores as without the cache. Pairs with a rare word, like squash whale, are never kept.
+
+int TestPAIRS1() {
+  START_TEST_CASE;
+  
+  PairCache pair_cache;
+  Arena arena;
+  char *lines[3] = {"computer science", "science computer", "computer AND science AND the"};
+  InitializePairCache(&pair_cache, PAIR_CACHE_SIZE);
+  InitializeArena(&arena);
+  
+  // Ranked with BM25, from the document table.
+  DocFile table;
+  Ranker bm25;
+  SHOULD_BE(OpenDocFile(&table, "../../indexer/index.dat.docs") == 1);
+  SHOULD_BE(InitializeRanker(&bm25, &table) == 1);
+  
+  for (int i=0; i < 3; i++) {
+    PlanNode *plan = PlanQuery(ParseQuery(lines[i], &arena), ptr, &pair_cache, &arena);
+    PlanNode *plain = PlanQuery(ParseQuery(lines[i], &arena), ptr, NULL, &arena);
+    SHOULD_BE(plan != NULL && plain != NULL && plain->pair == NULL);
+    SHOULD_BE((plan->pair != NULL) == (i > 0));
+    
+    // Same documents, frequencies and scores.
+    DocumentNode *list = ExecutePlan(plan, &bm25, 0, ptr);
+    DocumentNode *other = ExecutePlan(plain, &bm25, 0, ptr);
+    SHOULD_BE(list != NULL);
+    DocumentNode *dn = list, *on = other;
+    for ( ; dn != NULL && on != NULL; dn = dn->next, on = on->next) {
+      SHOULD_BE(dn->doc_id == on->doc_id && dn->freq == on->freq && dn->score == on->score);
+    }
+    SHOULD_BE(dn == NULL && on == NULL);
+    FreeDocuments(list);
+    FreeDocuments(other);
+  }
+  SHOULD_BE(pair_cache.pairs.hits == 1 && pair_cache.pairs.misses == 2);
+  
+  // Never kept.
+  for (int i=0; i < 3; i++) {
+    PlanNode *plan = PlanQuery(ParseQuery("squash whale", &arena), ptr, &pair_cache, &arena);
+    SHOULD_BE(plan != NULL && plan->pair == NULL);
+  }
+  SHOULD_BE(pair_cache.pairs.misses == 2);
+  
+  // Cleanup.
+  FreeArena(&arena);
+  ClearPairCache(&pair_cache);
+  SHOULD_BE(pair_cache.pairs.size == 0 && pair_cache.uses.size == 0);
+  FreeRanker(&bm25);
+  CloseDocFile(&table);
+  
+  END_TEST_CASE;
+}
+
+
+// Test case: THREADS:1
+// This test case runs FindDocuments() from THREADS threads at once on one mapped index, whose
+// words are decoded as the threads look them up. Each thread should find the same documents,
+// with the same frequencies, as one thread on an index of its own.
+
+#define THREADS 4
+#define THREAD_LINES 8
+
+typedef struct ThreadsArg {
+  HashTable *Index;                        // index shared by the threads
+  DocumentNode **expected;                 // documents of each line, found by one thread
+  int first;                               // line the thread starts from
+  int same;                                // 1 while every line found the expected documents
+} ThreadsArg;
+
+char *thread_lines[THREAD_LINES] = {"computer science", "whale OR squash", "\"computer science\"",
+    "the -computer", "(libation OR hindrance) the", "university AND student AND the",
+    "science OR dog OR cat", "squash whale"};
+
+void *FindInThread(void *arg) {
+  ThreadsArg *thread = (ThreadsArg *)arg;
+  
+  for (int i=0; i < 4 * THREAD_LINES; i++) {
+    int line = (thread->first + i) % THREAD_LINES;
+    char buffer[64];
+    DocumentNode *list;
+    strcpy(buffer, thread_lines[line]);
+    thread->same &= FindDocuments(buffer, thread->Index, NULL, &list);
+    
+    DocumentNode *dn = list, *en = thread->expected[line];
+    for ( ; dn != NULL && en != NULL; dn = dn->next, en = en->next) {
+      thread->same &= (dn->doc_id == en->doc_id && dn->freq == en->freq);
+    }
+    thread->same &= (dn == NULL && en == NULL);
+    FreeDocuments(list);
+  }
+  return NULL;
+}
+
+int TestTHREADS1() {
+  START_TEST_CASE;
+  
+  HashTable own, shared;
+  DocumentNode *expected[THREAD_LINES];
+  ThreadsArg args[THREADS];
+  pthread_t ids[THREADS];
+  InitializeHashTable(&own);
+  InitializeHashTable(&shared);
+  SHOULD_BE(MapIndex(file, &own) != NULL && MapIndex(file, &shared) != NULL);
+  
+  // Found by one thread.
+  for (int i=0; i < THREAD_LINES; i++) {
+    char buffer[64];
+    strcpy(buffer, thread_lines[i]);
+    SHOULD_BE(FindDocuments(buffer, &own, NULL, &expected[i]) == 1);
+  }
+  SHOULD_BE(expected[0] != NULL && expected[1] != NULL);
+  
+  // Found by every thread at once, each starting from another line.
+  for (int t=0; t < THREADS; t++) {
+    args[t].Index = &shared;
+    args[t].expected = expected;
+    args[t].first = t;
+    args[t].same = 1;
+    SHOULD_BE(pthread_create(&ids[t], NULL, FindInThread, &args[t]) == 0);
+  }
+  for (int t=0; t < THREADS; t++) {
+    pthread_join(ids[t], NULL);
+    SHOULD_BE(args[t].same == 1);
+  }
+  
+  // Cleanup.
+  for (int i=0; i < THREAD_LINES; i++) {
+    FreeDocuments(expected[i]);
+  }
+  CleanHashTable(&own);
+  FreeHashTable(&own);
+  CleanHashTable(&shared);
+  FreeHashTable(&shared);
+  
+  END_TEST_CASE;
+}
+
+
+// Test case: SHARDS:1
+// This test case merges hand-made results of three shards, best first with ties to the lower doc_id,
+// and skips and keeps pages of them. A #search request should be read into its K, statistics and line.
+// A ranker given the table's own statistics should score like InitializeRanker(), and WordWeight()
+// should use the df given for a word over the one of the shard.
+
+DocumentNode *ShardList(const int *doc_ids, const float *scores, int num) {
+  DocumentNode *list = NULL;
+  for (int i=num-1; i >= 0; i--) {
+    DocumentNode *dn = (DocumentNode *)calloc(1, sizeof(DocumentNode));
+    dn->doc_id = doc_ids[i];
+    dn->freq = (int)scores[i];
+    dn->score = scores[i];
+    dn->next = list;
+    list = dn;
+  }
+  return list;
+}
+
+int TestSHARDS1() {
+  START_TEST_CASE;
+  
+  int ids0[3] = {4, 1, 7}, ids1[2] = {12, 10}, ids2[3] = {25, 21, 20};
+  float scores0[3] = {9, 5, 2}, scores1[2] = {8, 5}, scores2[3] = {9, 3, 1};
+  int order[8] = {4, 25, 12, 1, 10, 21, 7, 20};
+  
+  // Every result, by score then by frequency.
+  for (int by_score=0; by_score < 2; by_score++) {
+    DocumentNode *lists[3] = {ShardList(ids0, scores0, 3), ShardList(ids1, scores1, 2), ShardList(ids2, scores2, 3)};
+    DocumentNode *list = MergeShardResults(lists, 3, by_score, 0, 0);
+    int n = 0;
+    for (DocumentNode *dn = list; dn != NULL; dn = dn->next, n++) {
+      SHOULD_BE(n < 8 && dn->doc_id == order[n]);
+    }
+    SHOULD_BE(n == 8);
+    FreeDocuments(list);
+  }
+  
+  // Pages of them; an empty shard.
+  DocumentNode *lists[3] = {ShardList(ids0, scores0, 3), NULL, ShardList(ids2, scores2, 3)};
+  DocumentNode *list = MergeShardResults(lists, 3, 1, 2, 3);
+  SHOULD_BE(list != NULL && list->doc_id == 1 && list->next != NULL && list->next->doc_id == 21);
+  SHOULD_BE(list->next->next != NULL && list->next->next->doc_id == 7 && list->next->next->next == NULL);
+  FreeDocuments(list);
+  DocumentNode *few[2] = {ShardList(ids1, scores1, 2), NULL};
+  SHOULD_BE(MergeShardResults(few, 2, 1, 5, 3) == NULL);
+  
+  // A #search request.
+  char request[] = "#search 10 1500 900000.5 whale=11 squash=2\twhale AND squash\n";
+  int k;
+  ShardStats stats;
+  char *line;
+  SHOULD_BE(ReadShardSearch(request, &k, &stats, &line) == 1);
+  SHOULD_BE(k == 10 && stats.num_docs == 1500 && stats.total_length == 900000.5);
+  SHOULD_BE(stats.num_words == 2 && strcmp(stats.words[1], "squash") == 0 && stats.dfs[1] == 2);
+  SHOULD_BE(strncmp(line, "whale AND squash", 16) == 0);
+  char plain[] = "#search 0\twhale\n";
+  SHOULD_BE(ReadShardSearch(plain, &k, &stats, &line) == 1 && k == 0 && stats.num_docs == 0);
+  char bad[] = "#search ten\twhale\n";
+  SHOULD_BE(ReadShardSearch(bad, &k, &stats, &line) == 0);
+  
+  // The table's own statistics.
+  DocFile table;
+  Ranker bm25, shard;
+  SHOULD_BE(OpenDocFile(&table, "../../indexer/index.dat.docs") == 1);
+  SHOULD_BE(InitializeRanker(&bm25, &table) == 1);
+  SHOULD_BE(InitializeShardRanker(&shard, &table, table.header->num_docs, (double)table.header->total_length) == 1);
+  SHOULD_BE(shard.num_docs == bm25.num_docs && shard.max_doc_id == bm25.max_doc_id);
+  SHOULD_BE(memcmp(shard.norms, bm25.norms, (bm25.max_doc_id + 1) * sizeof(float)) == 0);
+  SHOULD_BE(InitializeShardRanker(&bm25, &table, 0, 1) == 0);
+  
+  // The df given for a word.
+  char *words[1] = {"whale"};
+  int dfs[1] = {2};
+  shard.words = words;
+  shard.dfs = dfs;
+  shard.num_words = 1;
+  SHOULD_BE(WordWeight(&shard, "whale", 11) == TermWeight(&shard, 2));
+  SHOULD_BE(WordWeight(&shard, "squash", 11) == TermWeight(&shard, 11));
+  
+  // Cleanup.
+  FreeRanker(&shard);
+  FreeRanker(&bm25);
+  CloseDocFile(&table);
+  
+  END_TEST_CASE;
+}
+
+
 // Test case: DISPLAY:1
 // This test case calls Display() where final_list contains a list of DocumentNodes.
 // Each DocumentNode of final_list will be printed in "DOCUMENT ID:  URL:  " format.
@@ -554,6 +1426,35 @@ int TestDISPLAY1() {
 
 
 
+// Test case: DISPLAY:2
+// This test case calls Display() with the document table of the index mapped.
+// The URLs come from the table, and a doc_id not in the table has no DocRecord.
+// Returns 1 upon completion.
+
+int TestDISPLAY2() {
+  START_TEST_CASE;
+  
+  SHOULD_BE(OpenDocFile(&doc_file, "../../indexer/index.dat.docs") == 1);
+  SHOULD_BE(GetDocRecord(&doc_file, 1467) != NULL);
+  SHOULD_BE(GetDocRecord(&doc_file, 0) == NULL);
+  SHOULD_BE(GetDocRecord(&doc_file, 100000) == NULL);
+  
+  DocumentNode *dn = (DocumentNode *)calloc(1, sizeof(DocumentNode));
+  dn->doc_id = 1467;
+  dn->freq = 4;
+  final_list = dn;
+  
+  int result = Display();
+  
+  SHOULD_BE(result == 1);
+  
+  FreeList(1); // Cleanup.
+  CloseDocFile(&doc_file);
+  
+  END_TEST_CASE;
+}
+
+
 // Main program.
 int main(int argc, char** argv) {
   int cnt = 0;
@@ -561,6 +1462,10 @@ int main(int argc, char** argv) {
   // Load and recreate an InvertedIndex from index file.
   InitializeHashTable(&Index);
   ptr = ReadFile(file, &Index);
+  if (!ptr) {
+    printf("Could not read the index %s. Please run the indexer first.\n", file);
+    return 1;
+  }
   
   // Perform the tests.
   RUN_TEST(TestGETLINKS1, "GetLinks Test case 1");
@@ -570,6 +1475,7 @@ int main(int argc, char** argv) {
   RUN_TEST(TestGETLINKS5, "GetLinks Test case 5");
   RUN_TEST(TestGETLINKS6, "GetLinks Test case 6");
   RUN_TEST(TestGETLINKS7, "GetLinks Test case 7");
+  RUN_TEST(TestGETLINKS8, "GetLinks Test case 8");
   
   RUN_TEST(TestAND1, "And Test case 1");
   RUN_TEST(TestAND2, "And Test case 2");
@@ -577,10 +1483,37 @@ int main(int argc, char** argv) {
   
   RUN_TEST(TestOR1, "Or Test case 1");
   RUN_TEST(TestOR2, "Or Test case 2");
+  RUN_TEST(TestOR3, "Or Test case 3");
   
   RUN_TEST(TestSORT1, "Sort Test case 1");
+  RUN_TEST(TestSORT2, "Sort Test case 2");
+  RUN_TEST(TestSORT3, "Sort Test case 3");
+  RUN_TEST(TestSORT4, "Sort Test case 4");
+  
+  RUN_TEST(TestPHRASE1, "Phrase Test case 1");
+  RUN_TEST(TestPHRASE2, "Phrase Test case 2");
+  
+  RUN_TEST(TestINTERSECT1, "Intersect Test case 1");
+  
+  RUN_TEST(TestTOPK1, "TopK Test case 1");
+  
+  RUN_TEST(TestPARSE1, "Parse Test case 1");
+  
+  RUN_TEST(TestPLAN1, "Plan Test case 1");
+  
+  RUN_TEST(TestEXCLUDE1, "Exclude Test case 1");
+  
+  RUN_TEST(TestCACHE1, "Cache Test case 1");
+  RUN_TEST(TestCACHE2, "Cache Test case 2");
+  
+  RUN_TEST(TestPAIRS1, "Pairs Test case 1");
+  
+  RUN_TEST(TestTHREADS1, "Threads Test case 1");
+  
+  RUN_TEST(TestSHARDS1, "Shards Test case 1");
   
   RUN_TEST(TestDISPLAY1, "Display Test case 1");
+  RUN_TEST(TestDISPLAY2, "Display Test case 2");
   
   
   // Cleanup.
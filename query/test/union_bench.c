@@ -0,0 +1,275 @@
+/* ========================================================================== */
+/* File: union_bench.c
+ *
+ * Project name: CS50 Tiny Search Engine
+ * Component name: Query Engine
+ *
+ * OR microbenchmark on the index of the crawler data. For queries of 2 to 16
+ * common words OR'ed together, merges the DocumentNodes of the words with the
+ * old nested-loop Or, which looked through final_list for every DocumentNode,
+ * and with Union, the heap merge of every block at once, checks that both
+ * give the same documents, and shows the time per query.
+ *
+ * Then finds the top 10 documents of the same queries, by frequency and by
+ * BM25, in full (Union, then TopK) and with BlockMaxTopK, checks that both
+ * give the same documents, and shows the fraction of the postings scored.
+ *
+ * Usage: ./union_bench [index.dat] [rounds]
+ */
+/* ========================================================================== */
+#define _POSIX_C_SOURCE 199309L              // clock_gettime
+
+// ---------------- Open Issues
+
+// ---------------- System includes e.g., <stdio.h>
+#include <stdio.h>                           // printf
+#include <stdlib.h>                          // calloc, atoi
+#include <string.h>                          // memcmp
+#include <time.h>                            // clock_gettime
+
+// ---------------- Local includes  e.g., "file.h"
+#include "../src/qhashtable.h"               // hashtable functionality
+#include "docfile.h"                         // DocFile
+#include "../src/rank.h"                     // Ranker
+#include "../src/phrase.h"                   // Phrase
+#include "../src/cache.h"                    // PairCache
+#include "../src/query_func.h"               // query functionality
+#include "../src/topk.h"                     // BlockMaxTopK
+#include "segments.h"                        // DocsName
+
+// ---------------- Constant definitions
+#define NUM_WORDS 16
+#define TOP 10                               // documents of the top-k queries
+
+// ---------------- Macro definitions
+
+// ---------------- Structures/Types
+
+// ---------------- Private variables
+char *dir_path = NULL;                       // used by query_func.c
+DocFile doc_file;
+Ranker *ranker = NULL;
+int top_k = 0;
+PairCache *pairs = NULL;
+static char *words[NUM_WORDS] = {"the", "history", "computer", "university", "science", "first",
+		"world", "also", "new", "states", "american", "known", "used", "people", "between", "time"};
+
+// ---------------- Private prototypes
+static double Now(void);
+static void NestedOr(void);
+static int Count(DocumentNode *, int *);
+static double TopTen(HashTable *, WordNode **, int, int, int *, TopKStats *);
+
+
+int main(int argc, char *argv[]) {
+
+	char *file_name = (argc > 1) ? argv[1] : "../../indexer/index.dat";
+	int rounds = (argc > 2) ? atoi(argv[2]) : 20;
+	HashTable Index;
+	WordNode *nodes[NUM_WORDS];
+
+	InitializeHashTable(&Index);
+	if (rounds <= 0 || !MapIndex(file_name, &Index)) {
+		printf("Usage: ./union_bench [index.dat] [rounds]\n");
+		return 1;
+	}
+	for (int w = 0; w < NUM_WORDS; w++) {
+		if (!(nodes[w] = FindWord(words[w], &Index))) {
+			printf("%s is not in %s.\n", words[w], file_name);
+			return 1;
+		}
+	}
+
+	printf("%d rounds\n", rounds);
+	printf("\nwords   postings   documents   ms per query\n");
+	printf("                                nested      heap\n");
+	for (int k = 2; k <= NUM_WORDS; k *= 2) {
+		double ms[2];
+		int found[2], sums[2], postings = 0;
+		for (int w = 0; w < k; w++) {
+			postings += nodes[w]->df;
+		}
+
+		for (int method = 0; method < 2; method++) {
+			double total = 0;
+			for (int r = 0; r < rounds; r++) {
+
+				// Copy the DocumentNodes of each word, as for an AND block of one word.
+				DocumentNode *lists[NUM_WORDS];
+				for (int w = 0; w < k; w++) {
+					temp_list = NULL;
+					StartList(nodes[w]);
+					lists[w] = temp_list;
+				}
+				temp_list = NULL;
+				final_list = NULL;
+
+				double start = Now();
+				if (method == 0) {
+					for (int w = 0; w < k; w++) {
+						temp_list = lists[w];
+						NestedOr();
+					}
+				}
+				else {
+					Union(lists, k);
+				}
+				total += Now() - start;
+
+				found[method] = Count(final_list, &sums[method]);
+				FreeList(1);
+			}
+			ms[method] = total * 1e3 / rounds;
+		}
+
+		if (found[0] != found[1] || sums[0] != sums[1]) {
+			printf("\nnested and heap disagree for %d words!\n", k);
+			return 1;
+		}
+		printf("%5d %10d %11d %11.3f %9.3f\n", k, postings, found[1], ms[0], ms[1]);
+	}
+
+	// Rank by frequency, then by BM25 if the index has a document table.
+	Ranker bm25_ranker;
+	char *docs_name = DocsName(file_name);
+	int num_rankings = (docs_name && OpenDocFile(&doc_file, docs_name) &&
+			InitializeRanker(&bm25_ranker, &doc_file)) ? 2 : 1;
+	free(docs_name);
+	for (int r = 0; r < num_rankings; r++) {
+		ranker = r ? &bm25_ranker : NULL;
+		printf("\ntop %d by %s\n", TOP, r ? "BM25" : "frequency");
+		printf("words   postings   scored   ms per query\n");
+		printf("                              full   block-max\n");
+		for (int k = 2; k <= NUM_WORDS; k *= 2) {
+			int best[2][TOP];
+			double ms[2];
+			TopKStats stats;
+			for (int method = 0; method < 2; method++) {
+				ms[method] = 0;
+				for (int round = 0; round < rounds; round++) {
+					ms[method] += TopTen(&Index, nodes, k, method, best[method], &stats);
+				}
+				ms[method] = ms[method] * 1e3 / rounds;
+			}
+			if (memcmp(best[0], best[1], sizeof(best[0])) != 0) {
+				printf("\nfull and block-max disagree for %d words!\n", k);
+				return 1;
+			}
+			printf("%5d %10ld %7.1f%% %9.3f %9.3f\n", k, stats.postings,
+					100.0 * stats.scored / stats.postings, ms[0], ms[1]);
+		}
+	}
+	if (num_rankings == 2) {
+		FreeRanker(&bm25_ranker);
+	}
+	CloseDocFile(&doc_file);
+
+	CleanHashTable(&Index);
+	FreeHashTable(&Index);
+	return 0;
+}
+
+
+static double Now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/*
+ * NestedOr - the old Or, for comparison.
+ *
+ * Pseudocode:
+ *     1. For each DocumentNode of temp_list, look through final_list for its doc_id.
+ *     2. Keep the higher frequency if it is there, and append a copy if not.
+ */
+
+static void NestedOr(void) {
+
+	if (final_list == NULL) {
+		final_list = temp_list;
+		temp_list = NULL;
+		return;
+	}
+
+	DocumentNode *ptr, *ptr2, *runner = NULL;
+	for (ptr = temp_list; ptr != NULL; ptr = ptr->next) {
+		for (ptr2 = final_list; ptr2 != NULL; ptr2 = ptr2->next) {
+			if (ptr->doc_id == ptr2->doc_id) {
+				ptr2->freq = (ptr->freq > ptr2->freq) ? ptr->freq : ptr2->freq;
+				break;
+			}
+			if (ptr2->next == NULL) {
+				runner = ptr2;
+			}
+		}
+		if (ptr2 == NULL) {
+			DocumentNode *dn = (DocumentNode *)calloc(1, sizeof(DocumentNode));
+			dn->doc_id = ptr->doc_id;
+			dn->freq = ptr->freq;
+			runner->next = dn;
+		}
+	}
+	FreeList(0);
+}
+
+
+/*
+ * Count - count the DocumentNodes of a list, and sum their doc_ids and frequencies.
+ */
+
+static int Count(DocumentNode *list, int *sum) {
+	int num = 0;
+	*sum = 0;
+	for (; list != NULL; list = list->next) {
+		num++;
+		*sum += list->doc_id + list->freq;
+	}
+	return num;
+}
+
+
+/*
+ * TopTen - find the TOP highest ranked documents of the first k words OR'ed together.
+ * @Index: InvertedIndex of the words.
+ * @nodes: WordNodes of the words.
+ * @k: number of words.
+ * @method: 0 to rank every document (Union, then TopK), 1 for BlockMaxTopK.
+ * @best: filled in with the doc_ids of the documents, best first, -1 past the last one.
+ * @stats: filled in with the postings scored by BlockMaxTopK.
+ *
+ * Returns the time taken, in seconds.
+ */
+
+static double TopTen(HashTable *Index, WordNode **nodes, int k, int method, int *best, TopKStats *stats) {
+	double start = Now();
+	if (method == 0) {
+		DocumentNode *lists[NUM_WORDS];
+		for (int w = 0; w < k; w++) {
+			temp_list = NULL;
+			StartList(nodes[w]);
+			lists[w] = temp_list;
+		}
+		temp_list = NULL;
+		final_list = NULL;
+		Union(lists, k);
+	}
+	else {
+		int sizes[NUM_WORDS];
+		for (int w = 0; w < k; w++) {
+			sizes[w] = 1;
+		}
+		final_list = BlockMaxTopK(nodes, sizes, k, TOP, ranker, Index, stats);
+	}
+	TopK(0, TOP);
+	double time = Now() - start;
+
+	DocumentNode *dn = final_list;
+	for (int i = 0; i < TOP; i++) {
+		best[i] = dn ? dn->doc_id : -1;
+		dn = dn ? dn->next : NULL;
+	}
+	FreeList(1);
+	return time;
+}